@@ -0,0 +1,122 @@
+// Copyright 2010-2014 Google
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+// Checks the ArenaTrail (see constraint_solver/arena_trail.h) on the complete
+// search tree of n boolean variables: values saved several times in each node
+// are restored upon backtrack, and the trail marks at most one node per
+// search node, whatever the number of values saved in it.
+
+#include <cstdio>
+#include <string>
+#include <vector>
+
+#include "base/commandlineflags.h"
+#include "base/integral_types.h"
+#include "base/logging.h"
+#include "constraint_solver/arena_trail.h"
+#include "constraint_solver/constraint_solver.h"
+
+DEFINE_int32(num_vars, 12, "Number of boolean variables.");
+DEFINE_int32(saves_per_node, 5, "Number of values saved in each node.");
+
+namespace operations_research {
+namespace {
+
+// Assigns the variables in order, and saves values on the trail before each
+// decision.
+class SaveValuesDecisionBuilder : public DecisionBuilder {
+ public:
+  SaveValuesDecisionBuilder(ArenaTrail* const trail,
+                            const std::vector<IntVar*>& vars)
+      : trail_(trail),
+        vars_(vars),
+        size_(vars.size()),
+        depths_(size_ + 1, 0),
+        rev_depth_(0) {}
+  ~SaveValuesDecisionBuilder() override {}
+
+  Decision* Next(Solver* const s) override {
+    int depth = 0;
+    while (depth < size_ && vars_[depth]->Bound()) ++depth;
+    // The values saved by the ancestors are restored.
+    CHECK_EQ(depth, rev_depth_.Value());
+    for (int i = 0; i < size_ + 1; ++i) {
+      CHECK_EQ(i < depth ? i + 1 : 0, depths_[i]);
+    }
+    CHECK_LE(trail_->num_nodes(), depth);
+    rev_depth_.SetValue(trail_, depth + 1);
+    const int num_nodes = trail_->num_nodes();
+    CHECK_LE(num_nodes, depth + 1);
+    for (int i = 0; i < FLAGS_saves_per_node; ++i) {
+      trail_->SaveValue(&depths_[depth]);
+      depths_[depth] = depth + 1;
+      CHECK_EQ(num_nodes, trail_->num_nodes());
+    }
+    if (depth == size_) return nullptr;
+    return s->MakeAssignVariableValue(vars_[depth], 0);
+  }
+
+  std::string DebugString() const override {
+    return "SaveValuesDecisionBuilder";
+  }
+
+ private:
+  ArenaTrail* const trail_;
+  const std::vector<IntVar*> vars_;
+  const int size_;
+  // depths_[i] is i + 1 below the node at depth i, 0 elsewhere.
+  std::vector<int> depths_;
+  ArenaRev<int> rev_depth_;
+};
+
+void RunArenaTrailTest(int num_vars) {
+  Solver s("arena_trail_test");
+  ArenaTrailParameters parameters;
+  // Small blocks, so that the search compresses and decompresses some.
+  parameters.block_size = 16;
+  parameters.num_hot_blocks = 1;
+  parameters.background_compression = false;
+  ArenaTrail* const trail = s.RevAlloc(new ArenaTrail(&s, parameters));
+  std::vector<IntVar*> vars;
+  s.MakeBoolVarArray(num_vars, "x", &vars);
+  DecisionBuilder* const db =
+      s.RevAlloc(new SaveValuesDecisionBuilder(trail, vars));
+  int64 num_solutions = 0;
+  s.NewSearch(db);
+  while (s.NextSolution()) {
+    // One node per level of the branch, plus the leaf.
+    CHECK_EQ(num_vars + 1, trail->num_nodes());
+    ++num_solutions;
+  }
+  s.EndSearch();
+  CHECK_EQ(static_cast<int64>(1) << num_vars, num_solutions);
+  CHECK_EQ(0, trail->num_nodes());
+  printf("%s", trail->StatsString().c_str());
+  printf("OK: %lld solutions\n",
+         static_cast<long long>(num_solutions));  // NOLINT
+}
+
+}  // namespace
+}  // namespace operations_research
+
+static const char kUsage[] =
+    "Usage: see flags.\n"
+    "Checks the reversible values and the nodes of the ArenaTrail on a "
+    "complete search tree.";
+
+int main(int argc, char** argv) {
+  gflags::SetUsageMessage(kUsage);
+  gflags::ParseCommandLineFlags(&argc, &argv, true);
+  operations_research::RunArenaTrailTest(FLAGS_num_vars);
+  return EXIT_SUCCESS;
+}
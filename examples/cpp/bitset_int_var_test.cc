@@ -0,0 +1,330 @@
+// Copyright 2010-2014 Google
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+// Checks the BitsetIntVar (see constraint_solver/bitset_int_var.h) against
+// a regular domain variable created by Solver::MakeIntVar() with the same
+// values. A complete binary search tree applies the same random
+// modifications (SetValues(), RemoveValues(), RemoveInterval(),
+// RemoveValue() and bound changes) to both variables in each branch, and
+// checks that:
+// - both domains are equal after the modifications,
+// - both domains are restored upon backtrack,
+// - the hole iterator of the bitset variable returns values that were
+//   removed, including all the removed values still inside the bounds.
+
+#include <algorithm>
+#include <cstdio>
+#include <iterator>
+#include <memory>
+#include <string>
+#include <vector>
+
+#include "base/commandlineflags.h"
+#include "base/integral_types.h"
+#include "base/logging.h"
+#include "base/random.h"
+#include "base/stringprintf.h"
+#include "constraint_solver/bitset_int_var.h"
+#include "constraint_solver/constraint_solver.h"
+#include "constraint_solver/constraint_solveri.h"
+
+DEFINE_int32(span, 1000, "Span of the initial domain.");
+DEFINE_int32(depth, 8, "Depth of the complete binary search tree.");
+DEFINE_int32(changes_per_branch, 4,
+             "Number of random modifications in each branch.");
+DEFINE_int32(seed, 0, "Random seed.");
+
+namespace operations_research {
+namespace {
+
+std::vector<int64> DomainValues(const IntVar* const var) {
+  std::vector<int64> values;
+  std::unique_ptr<IntVarIterator> it(var->MakeDomainIterator(false));
+  for (it->Init(); it->Ok(); it->Next()) values.push_back(it->Value());
+  return values;
+}
+
+// Checks that the variable has exactly the given sorted values.
+void CheckDomain(const std::vector<int64>& expected, const IntVar* const var) {
+  CHECK(!expected.empty());
+  CHECK_EQ(expected.front(), var->Min()) << var->DebugString();
+  CHECK_EQ(expected.back(), var->Max()) << var->DebugString();
+  CHECK_EQ(expected.size(), var->Size()) << var->DebugString();
+  CHECK(expected == DomainValues(var)) << var->DebugString();
+  for (int64 v = expected.front(); v <= expected.back(); ++v) {
+    CHECK_EQ(std::binary_search(expected.begin(), expected.end(), v),
+             var->Contains(v))
+        << var->DebugString() << " " << v;
+  }
+}
+
+// The state of the last branch, checked when its propagation is done.
+struct BranchState {
+  BranchState() : pending(false) {}
+  bool pending;
+  // The domain before the branch.
+  std::vector<int64> before;
+  // The holes returned by the hole iterator during the branch.
+  std::vector<int64> holes;
+};
+
+// Each hole was removed in the branch, and each removed value inside the new
+// bounds is a hole. The other removed values were removed by bound changes.
+void CheckHoles(const BranchState& state, const std::vector<int64>& after) {
+  std::vector<int64> removed;
+  std::set_difference(state.before.begin(), state.before.end(), after.begin(),
+                      after.end(), std::back_inserter(removed));
+  std::vector<int64> holes = state.holes;
+  std::sort(holes.begin(), holes.end());
+  holes.erase(std::unique(holes.begin(), holes.end()), holes.end());
+  for (const int64 hole : holes) {
+    CHECK(std::binary_search(removed.begin(), removed.end(), hole)) << hole;
+  }
+  for (const int64 value : removed) {
+    if (value > after.front() && value < after.back()) {
+      CHECK(std::binary_search(holes.begin(), holes.end(), value)) << value;
+    }
+  }
+}
+
+// Appends the holes of the variable to 'holes' each time its domain
+// changes.
+class HoleRecorder : public Constraint {
+ public:
+  HoleRecorder(Solver* const s, IntVar* const var,
+               std::vector<int64>* const holes)
+      : Constraint(s),
+        var_(var),
+        iterator_(var->MakeHoleIterator(true)),
+        holes_(holes) {}
+  ~HoleRecorder() override {}
+
+  void Post() override {
+    var_->WhenDomain(MakeConstraintDemon0(
+        solver(), this, &HoleRecorder::RecordHoles, "RecordHoles"));
+  }
+  void InitialPropagate() override {}
+
+  void RecordHoles() {
+    for (iterator_->Init(); iterator_->Ok(); iterator_->Next()) {
+      const int64 hole = iterator_->Value();
+      CHECK(!var_->Contains(hole)) << hole;
+      holes_->push_back(hole);
+    }
+  }
+
+  std::string DebugString() const override { return "HoleRecorder"; }
+
+ private:
+  IntVar* const var_;
+  IntVarIterator* const iterator_;
+  std::vector<int64>* const holes_;
+};
+
+// Applies the same random modifications to both variables. A modification
+// that would empty the domain is skipped, so the branches never fail.
+class RandomChangesDecision : public Decision {
+ public:
+  RandomChangesDecision(IntVar* const bitset_var, IntVar* const regular_var,
+                        BranchState* const state, int32 seed)
+      : bitset_var_(bitset_var),
+        regular_var_(regular_var),
+        state_(state),
+        seed_(seed),
+        values_(DomainValues(regular_var)) {}
+  ~RandomChangesDecision() override {}
+
+  void Apply(Solver* const s) override { Branch(seed_); }
+  void Refute(Solver* const s) override { Branch(seed_ + 1); }
+
+  std::string DebugString() const override { return "RandomChanges"; }
+
+ private:
+  void Branch(int32 seed) {
+    // The domains are the ones of the parent node, restored upon backtrack
+    // for the right branch.
+    CheckDomain(values_, regular_var_);
+    CheckDomain(values_, bitset_var_);
+    state_->pending = true;
+    state_->before = values_;
+    state_->holes.clear();
+    ACMRandom random(seed);
+    for (int i = 0; i < FLAGS_changes_per_branch; ++i) {
+      ApplyRandomChange(DomainValues(regular_var_), &random);
+      CheckDomain(DomainValues(regular_var_), bitset_var_);
+    }
+  }
+
+  // Returns 'count' random values around the given domain.
+  std::vector<int64> RandomValues(const std::vector<int64>& domain, int count,
+                                  ACMRandom* const random) const {
+    const int64 span = domain.back() - domain.front() + 3;
+    std::vector<int64> values;
+    for (int i = 0; i < count; ++i) {
+      values.push_back(domain.front() - 1 + random->Uniform(span));
+    }
+    return values;
+  }
+
+  void ApplyRandomChange(const std::vector<int64>& domain,
+                         ACMRandom* const random) {
+    const int size = domain.size();
+    const int64 a = domain[random->Uniform(size)];
+    const int64 b = domain[random->Uniform(size)];
+    const int64 l = std::min(a, b);
+    const int64 u = std::max(a, b);
+    std::vector<int64> remaining;
+    switch (random->Uniform(6)) {
+      case 0: {
+        // Keeps a random subset of the domain, plus values outside of it.
+        std::vector<int64> values = RandomValues(domain, size / 4, random);
+        values.push_back(a);
+        regular_var_->SetValues(values);
+        bitset_var_->SetValues(values);
+        break;
+      }
+      case 1: {
+        const std::vector<int64> values =
+            RandomValues(domain, 1 + size / 8, random);
+        for (const int64 value : domain) {
+          if (std::find(values.begin(), values.end(), value) == values.end()) {
+            remaining.push_back(value);
+          }
+        }
+        if (remaining.empty()) return;
+        regular_var_->RemoveValues(values);
+        bitset_var_->RemoveValues(values);
+        break;
+      }
+      case 2:
+        if (l == domain.front() && u == domain.back()) return;
+        regular_var_->RemoveInterval(l, u);
+        bitset_var_->RemoveInterval(l, u);
+        break;
+      case 3:
+        if (size == 1) return;
+        regular_var_->RemoveValue(a);
+        bitset_var_->RemoveValue(a);
+        break;
+      case 4:
+        regular_var_->SetRange(l, u);
+        bitset_var_->SetRange(l, u);
+        break;
+      case 5:
+        if (random->OneIn(2)) {
+          regular_var_->SetMin(l);
+          bitset_var_->SetMin(l);
+        } else {
+          regular_var_->SetMax(u);
+          bitset_var_->SetMax(u);
+        }
+        break;
+    }
+  }
+
+  IntVar* const bitset_var_;
+  IntVar* const regular_var_;
+  BranchState* const state_;
+  const int32 seed_;
+  // The domain at the creation of the decision.
+  const std::vector<int64> values_;
+};
+
+// Builds a complete binary tree of the given depth.
+class RandomChangesDecisionBuilder : public DecisionBuilder {
+ public:
+  RandomChangesDecisionBuilder(IntVar* const bitset_var,
+                               IntVar* const regular_var,
+                               BranchState* const state, int depth)
+      : bitset_var_(bitset_var),
+        regular_var_(regular_var),
+        state_(state),
+        depth_(depth),
+        current_depth_(0),
+        num_decisions_(0) {}
+  ~RandomChangesDecisionBuilder() override {}
+
+  Decision* Next(Solver* const s) override {
+    // The branch that led here is fully propagated.
+    if (state_->pending) {
+      CheckHoles(*state_, DomainValues(regular_var_));
+      state_->pending = false;
+    }
+    if (current_depth_.Value() == depth_) return nullptr;
+    current_depth_.SetValue(s, current_depth_.Value() + 1);
+    ++num_decisions_;
+    return s->RevAlloc(new RandomChangesDecision(
+        bitset_var_, regular_var_, state_,
+        FLAGS_seed + 2 * static_cast<int32>(num_decisions_)));
+  }
+
+  std::string DebugString() const override {
+    return "RandomChangesDecisionBuilder";
+  }
+
+  int64 num_decisions() const { return num_decisions_; }
+
+ private:
+  IntVar* const bitset_var_;
+  IntVar* const regular_var_;
+  BranchState* const state_;
+  const int depth_;
+  Rev<int> current_depth_;
+  int64 num_decisions_;
+};
+
+void RunBitsetIntVarTest() {
+  Solver s("bitset_int_var_test");
+  // A domain with holes: the values of [0, span) that are not multiples of
+  // 7.
+  std::vector<int64> values;
+  for (int64 v = 0; v < FLAGS_span; ++v) {
+    if (v % 7 != 0) values.push_back(v);
+  }
+  IntVar* const bitset_var = MakeBitsetIntVar(&s, values, "bitset");
+  IntVar* const regular_var = s.MakeIntVar(values, "regular");
+  CheckDomain(values, bitset_var);
+  BranchState state;
+  s.AddConstraint(
+      s.RevAlloc(new HoleRecorder(&s, bitset_var, &state.holes)));
+  RandomChangesDecisionBuilder* const db =
+      s.RevAlloc(new RandomChangesDecisionBuilder(bitset_var, regular_var,
+                                                  &state, FLAGS_depth));
+  int64 num_leaves = 0;
+  s.NewSearch(db);
+  while (s.NextSolution()) ++num_leaves;
+  s.EndSearch();
+  CHECK_EQ(static_cast<int64>(1) << FLAGS_depth, num_leaves);
+  CHECK_EQ(0, s.failures());
+  // The search is over, so the initial domains are restored.
+  CheckDomain(values, bitset_var);
+  CheckDomain(values, regular_var);
+  printf("OK: %lld leaves, %lld decisions\n",
+         static_cast<long long>(num_leaves),            // NOLINT
+         static_cast<long long>(db->num_decisions()));  // NOLINT
+}
+
+}  // namespace
+}  // namespace operations_research
+
+static const char kUsage[] =
+    "Usage: see flags.\n"
+    "Checks the BitsetIntVar against a regular domain variable.";
+
+int main(int argc, char** argv) {
+  gflags::SetUsageMessage(kUsage);
+  gflags::ParseCommandLineFlags(&argc, &argv, true);
+  CHECK_GE(FLAGS_span, 16);
+  operations_research::RunBitsetIntVarTest();
+  return EXIT_SUCCESS;
+}
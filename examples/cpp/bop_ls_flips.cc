@@ -0,0 +1,213 @@
+// Copyright 2010-2014 Google
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+// Measures the number of flips per second of the FlatFeasibilityMaintainer
+// used for the local search in Bop. The problem is either read from an .opb
+// file or is a random set partitioning problem. A simple WalkSAT-like search
+// is run on it:
+// - If some constraints are violated, one of them is picked at random and the
+//   variable of this constraint with the best flip score is flipped (or a
+//   random one with a small probability).
+// - Otherwise, the objective value is recorded and a random variable is
+//   flipped.
+//
+// The search is run with and without the incremental score table. Then the
+// throughput of the batched evaluation of all the flips is measured for
+// different numbers of threads.
+
+#include <string>
+#include <vector>
+
+#include "base/commandlineflags.h"
+#include "base/integral_types.h"
+#include "base/logging.h"
+#include "base/random.h"
+#include "base/timer.h"
+#include "cpp/opb_reader.h"
+#include "bop/bop_ls_flat.h"
+#include "bop/bop_solution.h"
+#include "bop/bop_types.h"
+#include "sat/boolean_problem.pb.h"
+
+DEFINE_string(input, "",
+              "Input file in the .opb format. If empty, a random set "
+              "partitioning problem is generated.");
+DEFINE_int32(num_variables, 1000000,
+             "Number of variables of the random set partitioning problem.");
+DEFINE_int32(num_constraints, 10000,
+             "Number of constraints of the random set partitioning problem.");
+DEFINE_int32(max_column_size, 8,
+             "Maximum number of constraints in which a variable of the random "
+             "set partitioning problem appears.");
+DEFINE_int32(num_flips, 1000000, "Number of steps of each search.");
+DEFINE_double(noise, 0.1,
+              "Probability of flipping a random variable of the selected "
+              "violated constraint.");
+DEFINE_int32(max_num_threads, 8,
+             "The batched evaluation is measured with 1, 2, 4, ... threads up "
+             "to this number.");
+DEFINE_int32(seed, 0, "Random seed.");
+
+namespace operations_research {
+namespace bop {
+namespace {
+
+void GenerateSetPartitioningProblem(LinearBooleanProblem* problem) {
+  MTRandom random(FLAGS_seed);
+  problem->set_name("random_set_partitioning");
+  problem->set_num_variables(FLAGS_num_variables);
+  std::vector<LinearBooleanConstraint*> constraints;
+  for (int c = 0; c < FLAGS_num_constraints; ++c) {
+    LinearBooleanConstraint* constraint = problem->add_constraints();
+    constraint->set_lower_bound(1);
+    constraint->set_upper_bound(1);
+    constraints.push_back(constraint);
+  }
+  LinearObjective* objective = problem->mutable_objective();
+  for (int v = 0; v < FLAGS_num_variables; ++v) {
+    const int column_size = 1 + random.Uniform(FLAGS_max_column_size);
+    for (int i = 0; i < column_size; ++i) {
+      LinearBooleanConstraint* constraint =
+          constraints[random.Uniform(FLAGS_num_constraints)];
+      constraint->add_literals(v + 1);
+      constraint->add_coefficients(1);
+    }
+    objective->add_literals(v + 1);
+    objective->add_coefficients(1 + random.Uniform(100));
+  }
+}
+
+// Runs the search described in the file comment and returns the number of
+// flips per second.
+double RunSearch(const LinearBooleanProblem& problem, bool use_score_table) {
+  FlatFeasibilityMaintainer maintainer(problem);
+  maintainer.UseScoreTable(use_score_table);
+  maintainer.SetAssignment(BopSolution(problem, "zero"));
+
+  MTRandom random(FLAGS_seed);
+  int64 best_objective = kint64max;
+  // Only the actual flips are counted: the steps that pick a violated
+  // constraint without variables do nothing.
+  int64 num_flips = 0;
+  WallTimer timer;
+  timer.Start();
+  for (int i = 0; i < FLAGS_num_flips; ++i) {
+    const std::vector<ConstraintIndex>& violated =
+        maintainer.ViolatedConstraints();
+    if (violated.empty()) {
+      best_objective = std::min(best_objective, maintainer.ObjectiveValue());
+      maintainer.Flip(VariableIndex(random.Uniform(problem.num_variables())));
+      ++num_flips;
+      continue;
+    }
+    const ConstraintIndex constraint =
+        violated[random.Uniform(violated.size())];
+    const auto variables = maintainer.ConstraintVariables(constraint);
+    // A constraint without variables can't be repaired by a flip.
+    if (variables.begin() == variables.end()) continue;
+    VariableIndex best_var(-1);
+    if (random.RandDouble() < FLAGS_noise) {
+      int num_seen = 0;
+      for (const VariableIndex var : variables) {
+        if (random.OneIn(++num_seen)) best_var = var;
+      }
+    } else {
+      int64 best_score = kint64min;
+      for (const VariableIndex var : variables) {
+        // Ties are broken by the objective.
+        const int64 score = maintainer.FlipScore(var);
+        if (best_var < 0 || score > best_score ||
+            (score == best_score &&
+             maintainer.FlipObjectiveDelta(var) >
+                 maintainer.FlipObjectiveDelta(best_var))) {
+          best_score = score;
+          best_var = var;
+        }
+      }
+    }
+    maintainer.Flip(best_var);
+    ++num_flips;
+  }
+  const double flips_per_second = num_flips / timer.Get();
+  LOG(INFO) << (use_score_table ? "With" : "Without")
+            << " score table: " << num_flips << " flips, " << flips_per_second
+            << " flips/s, "
+            << maintainer.ViolatedConstraints().size()
+            << " violated constraints at the end.";
+  if (best_objective < kint64max) {
+    LOG(INFO) << "Best objective of a feasible assignment: " << best_objective;
+  }
+  return flips_per_second;
+}
+
+// Measures the number of flip evaluations per second of EvaluateFlips() on
+// all the variables, without the score table.
+void RunBatchedEvaluation(const LinearBooleanProblem& problem,
+                          int num_threads) {
+  FlatFeasibilityMaintainer maintainer(problem);
+  maintainer.UseScoreTable(false);
+  maintainer.SetNumThreads(num_threads);
+  maintainer.SetAssignment(BopSolution(problem, "zero"));
+  std::vector<VariableIndex> candidates(problem.num_variables());
+  for (int v = 0; v < problem.num_variables(); ++v) {
+    candidates[v] = VariableIndex(v);
+  }
+  std::vector<int64> scores;
+  const int kNumRounds = 10;
+  WallTimer timer;
+  timer.Start();
+  for (int i = 0; i < kNumRounds; ++i) {
+    maintainer.EvaluateFlips(candidates, &scores);
+  }
+  LOG(INFO) << "Batched evaluation with " << num_threads << " thread(s): "
+            << kNumRounds * candidates.size() / timer.Get()
+            << " evaluations/s.";
+}
+
+void Run() {
+  LinearBooleanProblem problem;
+  if (FLAGS_input.empty()) {
+    GenerateSetPartitioningProblem(&problem);
+  } else {
+    sat::OpbReader reader;
+    if (!reader.Load(FLAGS_input, &problem)) {
+      LOG(FATAL) << "Cannot load file '" << FLAGS_input << "'.";
+    }
+  }
+  LOG(INFO) << "Problem with " << problem.num_variables() << " variables and "
+            << problem.constraints_size() << " constraints.";
+
+  const double with_table = RunSearch(problem, /*use_score_table=*/true);
+  const double without_table = RunSearch(problem, /*use_score_table=*/false);
+  LOG(INFO) << "Speedup of the score table: " << with_table / without_table;
+  for (int num_threads = 1; num_threads <= FLAGS_max_num_threads;
+       num_threads *= 2) {
+    RunBatchedEvaluation(problem, num_threads);
+  }
+}
+
+}  // namespace
+}  // namespace bop
+}  // namespace operations_research
+
+static const char kUsage[] =
+    "Usage: see flags.\n"
+    "Benchmarks the number of flips per second of the Bop local search "
+    "structures.";
+
+int main(int argc, char** argv) {
+  gflags::SetUsageMessage(kUsage);
+  gflags::ParseCommandLineFlags(&argc, &argv, true);
+  operations_research::bop::Run();
+  return EXIT_SUCCESS;
+}
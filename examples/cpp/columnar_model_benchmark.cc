@@ -0,0 +1,190 @@
+// Copyright 2010-2014 Google
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+// Compares the load time of a model stored as a binary MPModelProto and as a
+// columnar model file (see linear_solver/columnar_model.h). The model is read
+// from an MPModelProto or an .mps file, or is a random sparse model. It is
+// written in both formats, and each of them is then loaded:
+// - in memory: proto parsing vs. mapping the columnar file,
+// - into a glop::LinearProgram: through the proto vs. through a SparseMPModel,
+// - into an MPSolver: LoadModelFromProto() vs. LoadModelFromMappedFile().
+
+#include <string>
+
+#include "base/commandlineflags.h"
+#include "base/file.h"
+#include "base/integral_types.h"
+#include "base/logging.h"
+#include "base/random.h"
+#include "base/strutil.h"
+#include "base/timer.h"
+#include "glop/proto_utils.h"
+#include "linear_solver/columnar_model.h"
+#include "linear_solver/linear_solver.h"
+#include "linear_solver/linear_solver.pb.h"
+#include "linear_solver/parallel_mps_reader.h"
+#include "linear_solver/sparse_model.h"
+#include "lp_data/lp_data.h"
+
+DEFINE_string(input, "",
+              "Input file: an MPModelProto or a .mps(.gz) file. If empty, a "
+              "random model is generated.");
+DEFINE_int32(num_variables, 1000000,
+             "Number of variables of the random model.");
+DEFINE_int32(num_constraints, 100000,
+             "Number of constraints of the random model.");
+DEFINE_int32(entries_per_constraint, 50,
+             "Number of entries per constraint of the random model.");
+DEFINE_string(output_prefix, "/tmp/columnar_model_benchmark",
+              "Prefix of the files written by the benchmark.");
+DEFINE_bool(load_into_mpsolver, true,
+            "Also measure the loading of the model into an MPSolver.");
+DEFINE_int32(seed, 0, "Random seed.");
+
+namespace operations_research {
+namespace {
+
+void GenerateRandomModel(MPModelProto* model) {
+  MTRandom random(FLAGS_seed);
+  model->set_name("random_model");
+  for (int v = 0; v < FLAGS_num_variables; ++v) {
+    MPVariableProto* const variable = model->add_variable();
+    variable->set_lower_bound(0.0);
+    variable->set_upper_bound(1.0 + random.Uniform(10));
+    variable->set_objective_coefficient(random.RandDouble());
+    variable->set_is_integer(random.OneIn(4));
+    variable->set_name(StrCat("x", v));
+  }
+  for (int c = 0; c < FLAGS_num_constraints; ++c) {
+    MPConstraintProto* const constraint = model->add_constraint();
+    constraint->set_lower_bound(-MPSolver::infinity());
+    constraint->set_upper_bound(FLAGS_entries_per_constraint);
+    constraint->set_name(StrCat("c", c));
+    // The stride avoids duplicate indices, which the solvers reject.
+    const int first = random.Uniform(FLAGS_num_variables);
+    for (int i = 0; i < FLAGS_entries_per_constraint; ++i) {
+      constraint->add_var_index((first + i * 7919) % FLAGS_num_variables);
+      constraint->add_coefficient(random.RandDouble() * 2.0 - 1.0);
+    }
+  }
+}
+
+void LogTime(const std::string& what, double seconds) {
+  LOG(INFO) << what << ": " << seconds << " s.";
+}
+
+void Run() {
+  MPModelProto model;
+  if (FLAGS_input.empty()) {
+    GenerateRandomModel(&model);
+  } else if (HasSuffixString(FLAGS_input, ".mps") ||
+             HasSuffixString(FLAGS_input, ".mps.gz")) {
+    const util::Status status = ReadMpsFileToProto(FLAGS_input, 8, &model);
+    CHECK(status.ok()) << status.error_message();
+  } else {
+    CHECK(file::ReadFileToProto(FLAGS_input, &model));
+  }
+  LOG(INFO) << "Model with " << model.variable_size() << " variables and "
+            << model.constraint_size() << " constraints.";
+
+  const std::string proto_file = FLAGS_output_prefix + ".pb";
+  const std::string columnar_file = FLAGS_output_prefix + ".col";
+  CHECK(file::SetBinaryProto(proto_file, model, file::Defaults()).ok());
+  const util::Status write_status = WriteColumnarModel(model, columnar_file);
+  CHECK(write_status.ok()) << write_status.error_message();
+  model.Clear();
+
+  // In memory.
+  double time = 0.0;
+  {
+    ScopedWallTime timer(&time);
+    std::string data;
+    CHECK(file::GetContents(proto_file, &data, file::Defaults()).ok());
+    CHECK(model.ParseFromString(data));
+  }
+  LogTime("Proto parsing", time);
+  time = 0.0;
+  ColumnarModelView view;
+  {
+    ScopedWallTime timer(&time);
+    const util::Status status = view.Open(columnar_file);
+    CHECK(status.ok()) << status.error_message();
+  }
+  LogTime("Columnar mapping and validation", time);
+  time = 0.0;
+  {
+    ScopedWallTime timer(&time);
+    MPModelProto converted;
+    ColumnarModelToProto(view, &converted);
+  }
+  LogTime("Columnar to proto conversion", time);
+
+  // Into a LinearProgram.
+  time = 0.0;
+  {
+    ScopedWallTime timer(&time);
+    glop::LinearProgram lp;
+    glop::MPModelProtoToLinearProgram(model, &lp);
+  }
+  LogTime("Proto to LinearProgram", time);
+  time = 0.0;
+  {
+    ScopedWallTime timer(&time);
+    SparseMPModel sparse_model;
+    ColumnarModelToSparseModel(view, &sparse_model);
+    glop::LinearProgram lp;
+    sparse_model.ExtractToLinearProgram(&lp);
+  }
+  LogTime("Columnar to LinearProgram", time);
+
+  // Into an MPSolver.
+  if (FLAGS_load_into_mpsolver) {
+    std::string error_message;
+    time = 0.0;
+    {
+      ScopedWallTime timer(&time);
+      MPSolver solver("proto", MPSolver::GLOP_LINEAR_PROGRAMMING);
+      CHECK_EQ(MPSOLVER_MODEL_IS_VALID,
+               solver.LoadModelFromProto(model, &error_message))
+          << error_message;
+    }
+    LogTime("MPSolver::LoadModelFromProto", time);
+    time = 0.0;
+    {
+      ScopedWallTime timer(&time);
+      MPSolver solver("columnar", MPSolver::GLOP_LINEAR_PROGRAMMING);
+      CHECK_EQ(MPSOLVER_MODEL_IS_VALID,
+               LoadModelFromMappedFile(columnar_file, &solver, &error_message))
+          << error_message;
+    }
+    LogTime("LoadModelFromMappedFile", time);
+  }
+  view.Close();
+  File::Delete(proto_file);
+  File::Delete(columnar_file);
+}
+
+}  // namespace
+}  // namespace operations_research
+
+static const char kUsage[] =
+    "Usage: see flags.\n"
+    "Compares the load time of the binary MPModelProto and of the columnar "
+    "model format.";
+
+int main(int argc, char** argv) {
+  gflags::SetUsageMessage(kUsage);
+  gflags::ParseCommandLineFlags(&argc, &argv, true);
+  operations_research::Run();
+  return EXIT_SUCCESS;
+}
@@ -50,6 +50,7 @@
 #include "base/concise_iterator.h"
 #include "base/map_util.h"
 #include "base/hash.h"
+#include "constraint_solver/bitset_int_var.h"
 #include "constraint_solver/constraint_solver.h"
 #include "cpp/fap_model_printer.h"
 #include "cpp/fap_parser.h"
@@ -77,6 +78,8 @@ DEFINE_bool(display_time, true,
             "Print how much time the solving process took.");
 DEFINE_bool(display_results, true,
             "Print the results of the solving process.");
+DEFINE_bool(bitset_domains, false,
+            "Use bitset domains for the large and dense frequency domains.");
 
 
 namespace operations_research {
@@ -136,7 +139,14 @@ void CreateModelVariables(const std::map<int, FapVariable>& data_variables,
   for (ConstIter<std::map<int, FapVariable> > it(data_variables);
        !it.at_end(); ++it) {
     CHECK_LT(index, model_variables->size());
-    (*model_variables)[index] = solver->MakeIntVar(it->second.domain_);
+    if (FLAGS_bitset_domains) {
+      const std::vector<int64> domain(it->second.domain_.begin(),
+                                      it->second.domain_.end());
+      (*model_variables)[index] = MakeIntVarFromValues(
+          solver, domain, "", BitsetDomainParameters());
+    } else {
+      (*model_variables)[index] = solver->MakeIntVar(it->second.domain_);
+    }
     InsertOrUpdate(index_from_key, it->first, index);
     (*key_from_index)[index] = it->first;
 
@@ -32,11 +32,15 @@
 #include "base/logging.h"
 #include "base/stringprintf.h"
 #include "constraint_solver/constraint_solver.h"
+#include "constraint_solver/parallel_search.h"
 
 DEFINE_bool(print, false, "If true, print the minimal solution.");
 DEFINE_int32(
     size, 0,
     "Size of the problem. If equal to 0, will test several increasing sizes.");
+DEFINE_int32(num_workers, 1,
+             "Number of search threads. If greater than 1, the search tree is "
+             "split between several replicas of the model.");
 
 static const int kBestSolutions[] = {0,   1,   3,   6,   11,  17,  25,
                                      34,  44,  55,  72,  85,
@@ -47,59 +51,94 @@ static const int kKnownSolutions = 19;
 
 namespace operations_research {
 
-void GolombRuler(int size) {
-  CHECK_GE(size, 1);
-  Solver s("golomb");
-
-  // model
-  std::vector<IntVar*> ticks(size);
-  ticks[0] = s.MakeIntConst(0);  // X(0) = 0
+void BuildModel(Solver* const s, int size, std::vector<IntVar*>* ticks) {
+  ticks->resize(size);
+  (*ticks)[0] = s->MakeIntConst(0);  // X(0) = 0
   const int64 max = 1 + size * size * size;
   for (int i = 1; i < size; ++i) {
-    ticks[i] = s.MakeIntVar(1, max, StringPrintf("X%02d", i));
+    (*ticks)[i] = s->MakeIntVar(1, max, StringPrintf("X%02d", i));
   }
   std::vector<IntVar*> diffs;
   for (int i = 0; i < size; ++i) {
     for (int j = i + 1; j < size; ++j) {
-      IntVar* const diff = s.MakeDifference(ticks[j], ticks[i])->Var();
+      IntVar* const diff = s->MakeDifference((*ticks)[j], (*ticks)[i])->Var();
       diffs.push_back(diff);
       diff->SetMin(1);
     }
   }
-  s.AddConstraint(s.MakeAllDifferent(diffs));
+  s->AddConstraint(s->MakeAllDifferent(diffs));
+}
 
-  OptimizeVar* const length = s.MakeMinimize(ticks[size - 1], 1);
-  SolutionCollector* const collector = s.MakeLastSolutionCollector();
-  collector->Add(ticks);
-  DecisionBuilder* const db = s.MakePhase(ticks, Solver::CHOOSE_FIRST_UNBOUND,
-                                          Solver::ASSIGN_MIN_VALUE);
-  s.Solve(db, collector, length);  // go!
-  CHECK_EQ(collector->solution_count(), 1);
-  const int64 result = collector->Value(0, ticks[size - 1]);
-  const int num_failures = collector->failures(0);
+void PrintSolution(int size, int64 result, int64 num_failures,
+                   const std::vector<int64>& ticks) {
   printf("N = %d, optimal length = %d (fails:%d)\n", size,
-         static_cast<int>(result), num_failures);
+         static_cast<int>(result), static_cast<int>(num_failures));
   if (size - 1 < kKnownSolutions) {
     CHECK_EQ(result, kBestSolutions[size - 1]);
   }
   if (FLAGS_print) {
     for (int i = 0; i < size; ++i) {
-      const int64 tick = collector->Value(0, ticks[i]);
-      printf("%d ", static_cast<int>(tick));
+      printf("%d ", static_cast<int>(ticks[i]));
     }
     printf("\n");
   }
 }
 
+void GolombRuler(int size) {
+  CHECK_GE(size, 1);
+  Solver s("golomb");
+
+  // model
+  std::vector<IntVar*> ticks;
+  BuildModel(&s, size, &ticks);
+
+  OptimizeVar* const length = s.MakeMinimize(ticks[size - 1], 1);
+  SolutionCollector* const collector = s.MakeLastSolutionCollector();
+  collector->Add(ticks);
+  DecisionBuilder* const db = s.MakePhase(ticks, Solver::CHOOSE_FIRST_UNBOUND,
+                                          Solver::ASSIGN_MIN_VALUE);
+  s.Solve(db, collector, length);  // go!
+  CHECK_EQ(collector->solution_count(), 1);
+  std::vector<int64> values(size);
+  for (int i = 0; i < size; ++i) {
+    values[i] = collector->Value(0, ticks[i]);
+  }
+  PrintSolution(size, values[size - 1], collector->failures(0), values);
+}
+
+// Same as GolombRuler(), with the search split between FLAGS_num_workers
+// replicas of the model.
+void ParallelGolombRuler(int size) {
+  CHECK_GE(size, 1);
+  ParallelSearch search(
+      "golomb", FLAGS_num_workers,
+      [size](Solver* s, ParallelSearchReplica* replica) {
+        std::vector<IntVar*> ticks;
+        BuildModel(s, size, &ticks);
+        replica->decision_builder = s->MakePhase(
+            ticks, Solver::CHOOSE_FIRST_UNBOUND, Solver::ASSIGN_MIN_VALUE);
+        replica->objective = ticks[size - 1];
+        replica->collector = s->MakeLastSolutionCollector();
+        replica->collector->Add(ticks);
+      });
+  CHECK(search.Solve());
+  const int best = search.best_solution();
+  PrintSolution(size, search.objective_value(best), search.failures(),
+                search.solution_values(best));
+}
+
 }  // namespace operations_research
 
 int main(int argc, char** argv) {
   gflags::ParseCommandLineFlags( &argc, &argv, true);
+  void (*const golomb)(int) = FLAGS_num_workers > 1
+                                  ? operations_research::ParallelGolombRuler
+                                  : operations_research::GolombRuler;
   if (FLAGS_size != 0) {
-    operations_research::GolombRuler(FLAGS_size);
+    golomb(FLAGS_size);
   } else {
     for (int n = 1; n < 11; ++n) {
-      operations_research::GolombRuler(n);
+      golomb(n);
     }
   }
   return 0;
@@ -25,6 +25,7 @@
 #include "base/logging.h"
 #include "base/stringprintf.h"
 #include "constraint_solver/constraint_solver.h"
+#include "constraint_solver/nogood_recorder.h"
 
 DEFINE_int32(size, 0, "Size of the magic square.");
 DEFINE_bool(impact, false, "Use impact search.");
@@ -44,6 +45,9 @@ DEFINE_double(restart_log_size, -1.0,
               " phase.");
 DEFINE_bool(verbose_impact, false, "Verbose output of impact search.");
 DEFINE_bool(use_nogoods, false, "Use no goods in automatic restart.");
+DEFINE_bool(restart_nogoods, false,
+            "Record nogoods from the search tree at each restart of the "
+            "restart monitor.");
 
 namespace operations_research {
 
@@ -128,6 +132,10 @@ void MagicSquare(int grid_size) {
           : NULL;
   if (restart) {
     monitors.push_back(restart);
+    if (FLAGS_restart_nogoods) {
+      monitors.push_back(
+          MakeNoGoodRecorder(&solver, NoGoodRecorderParameters()));
+    }
   }
   solver.NewSearch(db, monitors);
   if (solver.NextSolution()) {
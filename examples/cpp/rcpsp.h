@@ -0,0 +1,110 @@
+// Copyright 2010-2014 Google
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+//
+// A resource-constrained project scheduling problem (RCPSP) is made of tasks
+// linked by precedences and of renewable resources with a given capacity.
+// Each task has a duration and consumes a given amount of each resource while
+// it is executed. The objective is to minimize the makespan.
+//
+// This parser reads the Patterson format (.rcp files) used by the PSPLIB and
+// RanGen instances:
+//   num_tasks num_resources
+//   capacity_1 ... capacity_r
+//   duration demand_1 ... demand_r num_successors successor_1 ... (per task)
+// The successors are 1-based task indices. The first and last tasks are
+// usually dummy tasks of zero duration.
+
+#ifndef OR_TOOLS_EXAMPLES_RCPSP_H_
+#define OR_TOOLS_EXAMPLES_RCPSP_H_
+
+#include <string>
+#include <vector>
+
+#include "base/integral_types.h"
+#include "base/logging.h"
+#include "base/split.h"
+#include "base/strtoint.h"
+#include "util/filelineiter.h"
+
+namespace operations_research {
+// ----- RcpspData -----
+
+// A RcpspData parses data files and stores all data internally for
+// easy retrieval.
+class RcpspData {
+ public:
+  struct Task {
+    int duration;
+    std::vector<int> demands;
+    std::vector<int> successors;  // 0-based.
+  };
+
+  RcpspData() : horizon_(0), num_tasks_(0) {}
+
+  // Parses a file in the Patterson format. Note that the format is only
+  // partially checked: bad inputs might cause undefined behavior.
+  void Load(const std::string& filename) {
+    std::vector<int> values;
+    for (const std::string& line : FileLines(filename)) {
+      for (const std::string& word :
+           strings::Split(line, " ", strings::SkipEmpty())) {
+        if (word == "\t" || word == "\r") continue;
+        values.push_back(atoi32(word));
+      }
+    }
+    int index = 0;
+    CHECK_GE(values.size(), 2);
+    num_tasks_ = values[index++];
+    const int num_resources = values[index++];
+    for (int r = 0; r < num_resources; ++r) {
+      capacities_.push_back(values[index++]);
+    }
+    tasks_.resize(num_tasks_);
+    for (Task& task : tasks_) {
+      task.duration = values[index++];
+      horizon_ += task.duration;
+      for (int r = 0; r < num_resources; ++r) {
+        task.demands.push_back(values[index++]);
+      }
+      const int num_successors = values[index++];
+      for (int s = 0; s < num_successors; ++s) {
+        task.successors.push_back(values[index++] - 1);
+      }
+    }
+    CHECK_EQ(index, values.size());
+    LOG(INFO) << num_tasks_ << " tasks and " << num_resources << " resources";
+  }
+
+  // The number of tasks, including the dummy ones.
+  int num_tasks() const { return num_tasks_; }
+
+  // The number of renewable resources and their capacities.
+  int num_resources() const { return capacities_.size(); }
+  int capacity(int resource) const { return capacities_[resource]; }
+
+  // The sum of all durations, which is a trivial upper bound of the optimal
+  // makespan.
+  int horizon() const { return horizon_; }
+
+  const Task& task(int index) const { return tasks_[index]; }
+
+ private:
+  int horizon_;
+  int num_tasks_;
+  std::vector<int> capacities_;
+  std::vector<Task> tasks_;
+};
+}  // namespace operations_research
+
+#endif  // OR_TOOLS_EXAMPLES_RCPSP_H_
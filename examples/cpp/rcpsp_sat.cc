@@ -0,0 +1,110 @@
+// Copyright 2010-2014 Google
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+// Solves a resource-constrained project scheduling problem with the SAT
+// integer layer and the CumulativeConstraint. See cpp/rcpsp.h for the data
+// format.
+
+#include <vector>
+
+#include "base/commandlineflags.h"
+#include "base/logging.h"
+#include "base/timer.h"
+#include "cpp/rcpsp.h"
+#include "sat/cumulative.h"
+#include "sat/intervals.h"
+#include "sat/model.h"
+#include "sat/optimization.h"
+#include "sat/precedences.h"
+#include "sat/sat_solver.h"
+
+DEFINE_string(input, "", "Rcpsp data file name (Patterson format).");
+DEFINE_string(params, "", "Sat parameters in text proto format.");
+
+namespace operations_research {
+namespace sat {
+
+void Solve(const RcpspData& data) {
+  Model model;
+  model.Add(NewSatParameters(FLAGS_params));
+
+  const int horizon = data.horizon();
+  const IntegerVariable makespan = model.Add(NewIntegerVariable(0, horizon));
+
+  // Zero-duration tasks are modeled with an interval too, but they do not
+  // consume any resource.
+  std::vector<IntervalVariable> intervals;
+  for (int t = 0; t < data.num_tasks(); ++t) {
+    const IntervalVariable interval =
+        model.Add(NewInterval(data.task(t).duration));
+    model.Add(GreaterOrEqual(model.Get(StartVar(interval)), 0));
+    model.Add(EndBefore(interval, makespan));
+    intervals.push_back(interval);
+  }
+  for (int t = 0; t < data.num_tasks(); ++t) {
+    for (const int successor : data.task(t).successors) {
+      model.Add(EndBeforeStart(intervals[t], intervals[successor]));
+    }
+  }
+
+  for (int r = 0; r < data.num_resources(); ++r) {
+    std::vector<IntervalVariable> resource_intervals;
+    std::vector<IntegerVariable> demands;
+    for (int t = 0; t < data.num_tasks(); ++t) {
+      const int demand = data.task(t).demands[r];
+      if (demand == 0 || data.task(t).duration == 0) continue;
+      resource_intervals.push_back(intervals[t]);
+      demands.push_back(model.Add(NewIntegerVariable(demand, demand)));
+    }
+    const IntegerVariable capacity =
+        model.Add(NewIntegerVariable(data.capacity(r), data.capacity(r)));
+    model.Add(Cumulative(resource_intervals, demands, capacity));
+  }
+
+  LOG(INFO) << "#tasks:" << data.num_tasks();
+  LOG(INFO) << "#resources:" << data.num_resources();
+
+  WallTimer timer;
+  timer.Start();
+  const SatSolver::Status status = MinimizeIntegerVariableWithLinearScan(
+      makespan,
+      /*feasible_solution_observer=*/
+      [makespan, &timer](const Model& model) {
+        const IntegerTrail* integer_trail = model.Get<IntegerTrail>();
+        LOG(INFO) << "Makespan " << integer_trail->LowerBound(makespan)
+                  << " after " << timer.Get() << "s";
+      },
+      &model);
+  LOG(INFO) << "Status: " << status << " wall time: " << timer.Get() << "s";
+}
+
+}  // namespace sat
+
+void LoadAndSolve() {
+  RcpspData data;
+  data.Load(FLAGS_input);
+  if (data.num_tasks() == 0) {
+    LOG(FATAL) << "No tasks in '" << FLAGS_input << "'.";
+  }
+  operations_research::sat::Solve(data);
+}
+}  // namespace operations_research
+
+int main(int argc, char** argv) {
+  gflags::ParseCommandLineFlags( &argc, &argv, true);
+  if (FLAGS_input.empty()) {
+    LOG(FATAL) << "Please supply a data file with --input=";
+  }
+  operations_research::LoadAndSolve();
+  return EXIT_SUCCESS;
+}
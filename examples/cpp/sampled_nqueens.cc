@@ -0,0 +1,184 @@
+// Copyright 2010-2014 Google
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+// Profiles the n-queens problem with the SamplingDemonProfiler (see
+// constraint_solver/sampling_profiler.h), without instrumenting the solver.
+// The three all-different constraints are custom constraints that mark their
+// propagation with ScopedSampledPropagator. The estimated time of each
+// constraint and demon is exported in the ConstraintRuns format and printed.
+
+#include <cstdio>
+#include <string>
+#include <vector>
+
+#include "base/commandlineflags.h"
+#include "base/integral_types.h"
+#include "base/logging.h"
+#include "base/stringprintf.h"
+#include "constraint_solver/constraint_solveri.h"
+#include "constraint_solver/demon_profiler.pb.h"
+#include "constraint_solver/sampling_profiler.h"
+
+DEFINE_int32(size, 11, "Size of the n-queens problem.");
+DEFINE_int32(sampling_period_us, 1000,
+             "Sampling period, in microseconds of CPU time.");
+
+namespace operations_research {
+namespace {
+
+// Value-based all-different, with one demon per variable, profiled with
+// ScopedSampledPropagator.
+class SampledAllDifferent : public Constraint {
+ public:
+  SampledAllDifferent(Solver* const s, const std::vector<IntVar*>& vars,
+                      const std::string& name,
+                      SamplingDemonProfiler* const profiler)
+      : Constraint(s),
+        vars_(vars),
+        size_(vars.size()),
+        name_(name),
+        profiler_(profiler) {}
+  ~SampledAllDifferent() override {}
+
+  void Post() override {
+    for (int i = 0; i < size_; ++i) {
+      Demon* const demon = MakeConstraintDemon1(
+          solver(), this, &SampledAllDifferent::ProcessVar, "ProcessVar", i);
+      profiler_->RegisterSampledDemon(this, demon);
+      demons_.push_back(demon);
+      vars_[i]->WhenBound(demon);
+    }
+  }
+
+  void InitialPropagate() override {
+    ScopedSampledPropagator propagator(this);
+    for (int i = 0; i < size_; ++i) {
+      if (vars_[i]->Bound()) RemoveValue(i);
+    }
+  }
+
+  void ProcessVar(int index) {
+    ScopedSampledPropagator propagator(demons_[index]);
+    RemoveValue(index);
+  }
+
+  std::string DebugString() const override {
+    return StringPrintf("SampledAllDifferent(%s)", name_.c_str());
+  }
+
+ private:
+  void RemoveValue(int index) {
+    const int64 value = vars_[index]->Min();
+    for (int j = 0; j < size_; ++j) {
+      if (j != index) vars_[j]->RemoveValue(value);
+    }
+  }
+
+  const std::vector<IntVar*> vars_;
+  const int size_;
+  const std::string name_;
+  SamplingDemonProfiler* const profiler_;
+  std::vector<Demon*> demons_;
+};
+
+// The runs all start at 0, so the time of a constraint is the sum of the end
+// times.
+int64 InitialPropagationTime(const ConstraintRuns& constraint_runs) {
+  int64 time = 0;
+  for (int i = 0; i < constraint_runs.initial_propagation_end_time_size();
+       ++i) {
+    time += constraint_runs.initial_propagation_end_time(i);
+  }
+  return time;
+}
+
+int64 DemonsTime(const ConstraintRuns& constraint_runs) {
+  int64 time = 0;
+  for (const DemonRuns& demon_runs : constraint_runs.demons()) {
+    for (int i = 0; i < demon_runs.end_time_size(); ++i) {
+      time += demon_runs.end_time(i);
+    }
+  }
+  return time;
+}
+
+void SampledNQueens(int size) {
+  Solver s("nqueens");
+  SamplingDemonProfiler* const profiler = s.RevAlloc(
+      new SamplingDemonProfiler(&s, FLAGS_sampling_period_us));
+  std::vector<IntVar*> queens;
+  for (int i = 0; i < size; ++i) {
+    queens.push_back(s.MakeIntVar(0, size - 1, StringPrintf("queen%04d", i)));
+  }
+  s.AddConstraint(
+      s.RevAlloc(new SampledAllDifferent(&s, queens, "rows", profiler)));
+  std::vector<IntVar*> vars(size);
+  for (int i = 0; i < size; ++i) {
+    vars[i] = s.MakeSum(queens[i], i)->Var();
+  }
+  s.AddConstraint(
+      s.RevAlloc(new SampledAllDifferent(&s, vars, "diagonals", profiler)));
+  for (int i = 0; i < size; ++i) {
+    vars[i] = s.MakeSum(queens[i], -i)->Var();
+  }
+  s.AddConstraint(s.RevAlloc(
+      new SampledAllDifferent(&s, vars, "anti-diagonals", profiler)));
+  SolutionCollector* const solution_counter = s.MakeAllSolutionCollector(NULL);
+  DecisionBuilder* const db = s.MakePhase(queens, Solver::CHOOSE_FIRST_UNBOUND,
+                                          Solver::ASSIGN_MIN_VALUE);
+
+  // Passing the profiler to Solve() installs it. Its BeginFail() counts the
+  // failures, and resets the current propagator as a failure leaves the
+  // propagation without running the ScopedSampledPropagator destructors.
+  profiler->StartSampling();
+  s.Solve(db, solution_counter, profiler);
+  profiler->StopSampling();
+
+  std::vector<ConstraintRuns> runs;
+  profiler->ExportConstraintRuns(&runs);
+  printf("%d queens: %d solutions\n%s\n", size,
+         solution_counter->solution_count(), profiler->DebugString().c_str());
+  int64 exported_us = 0;
+  for (const ConstraintRuns& constraint_runs : runs) {
+    const int64 initial_propagation_us =
+        InitialPropagationTime(constraint_runs);
+    const int64 demons_us = DemonsTime(constraint_runs);
+    printf("%-40s initial propagation: %8lldus  demons (%d): %10lldus\n",
+           constraint_runs.constraint_id().c_str(),
+           static_cast<long long>(initial_propagation_us),  // NOLINT
+           constraint_runs.demons_size(),
+           static_cast<long long>(demons_us));  // NOLINT
+    exported_us += initial_propagation_us + demons_us;
+  }
+
+  // Every sample that was not dropped is exported in a propagator.
+  CHECK_EQ((profiler->num_samples() -
+            profiler->num_samples_outside_propagation() -
+            profiler->num_dropped_samples()) *
+               FLAGS_sampling_period_us,
+           exported_us);
+}
+
+}  // namespace
+}  // namespace operations_research
+
+static const char kUsage[] =
+    "Usage: see flags.\n"
+    "Profiles the propagation of the n-queens problem by sampling.";
+
+int main(int argc, char** argv) {
+  gflags::SetUsageMessage(kUsage);
+  gflags::ParseCommandLineFlags(&argc, &argv, true);
+  operations_research::SampledNQueens(FLAGS_size);
+  return EXIT_SUCCESS;
+}
@@ -0,0 +1,173 @@
+// Copyright 2010-2014 Google
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+// Measures the per-query latency of many small assumption queries against the
+// same formula, like a configuration checker would issue them. Each query
+// assumes a random suffix of literals after a prefix shared by all the
+// queries. The same queries are answered by:
+// - SatSolver::ResetAndSolveWithGivenAssumptions(), which backtracks to level
+//   zero each time.
+// - The IncrementalSatSolver, which keeps the shared prefix on the trail.
+
+#include <string>
+#include <vector>
+
+#include "base/commandlineflags.h"
+#include "base/integral_types.h"
+#include "base/logging.h"
+#include "base/random.h"
+#include "base/strutil.h"
+#include "base/timer.h"
+#include "google/protobuf/text_format.h"
+#include "cpp/opb_reader.h"
+#include "cpp/sat_cnf_reader.h"
+#include "sat/boolean_problem.h"
+#include "sat/incremental_solver.h"
+#include "sat/sat_solver.h"
+#include "util/stats.h"
+
+DEFINE_string(input, "", "Required: input file (.cnf or .opb).");
+DEFINE_string(params, "", "Parameters for the sat solver in a text format.");
+DEFINE_int32(num_queries, 1000, "Number of assumption queries to run.");
+DEFINE_int32(prefix_size, 10,
+             "Number of assumptions shared by all the queries.");
+DEFINE_int32(suffix_size, 5, "Number of random assumptions per query.");
+DEFINE_int32(max_conflicts_per_query, 1000,
+             "Conflict limit of each query. Queries reaching it are counted "
+             "as LIMIT_REACHED.");
+DEFINE_int32(seed, 0, "Random seed used to generate the queries.");
+
+namespace operations_research {
+namespace sat {
+namespace {
+
+void LoadProblem(const std::string& filename, LinearBooleanProblem* problem) {
+  if (HasSuffixString(filename, ".opb") ||
+      HasSuffixString(filename, ".opb.bz2")) {
+    OpbReader reader;
+    if (!reader.Load(filename, problem)) {
+      LOG(FATAL) << "Cannot load file '" << filename << "'.";
+    }
+  } else {
+    SatCnfReader reader;
+    if (!reader.Load(filename, problem)) {
+      LOG(FATAL) << "Cannot load file '" << filename << "'.";
+    }
+  }
+}
+
+std::vector<std::vector<Literal>> GenerateQueries(int num_variables) {
+  MTRandom random(FLAGS_seed);
+  const auto random_literal = [&random, num_variables]() {
+    return Literal(BooleanVariable(random.Uniform(num_variables)),
+                   random.OneIn(2));
+  };
+  std::vector<Literal> prefix;
+  for (int i = 0; i < FLAGS_prefix_size; ++i) {
+    prefix.push_back(random_literal());
+  }
+  std::vector<std::vector<Literal>> queries(FLAGS_num_queries, prefix);
+  for (std::vector<Literal>& query : queries) {
+    for (int i = 0; i < FLAGS_suffix_size; ++i) {
+      query.push_back(random_literal());
+    }
+  }
+  return queries;
+}
+
+void LoadSolver(const LinearBooleanProblem& problem, SatSolver* solver) {
+  SatParameters parameters;
+  CHECK(google::protobuf::TextFormat::ParseFromString(FLAGS_params,
+                                                      &parameters));
+  parameters.set_max_number_of_conflicts(FLAGS_max_conflicts_per_query);
+  solver->SetParameters(parameters);
+  CHECK(LoadBooleanProblem(problem, solver));
+}
+
+// Answers all the queries with the given function and returns the number of
+// queries of each status.
+template <typename SolveFunction>
+std::vector<int> RunQueries(const std::string& name,
+                            const std::vector<std::vector<Literal>>& queries,
+                            const SolveFunction& solve) {
+  TimeDistribution latency(name);
+  std::vector<int> num_per_status(SatSolver::LIMIT_REACHED + 1, 0);
+  WallTimer timer;
+  timer.Start();
+  for (const std::vector<Literal>& query : queries) {
+    latency.StartTimer();
+    const SatSolver::Status status = solve(query);
+    latency.StopTimerAndAddElapsedTime();
+    ++num_per_status[status];
+  }
+  LOG(INFO) << latency.StatString();
+  LOG(INFO) << name << ": " << queries.size() << " queries in " << timer.Get()
+            << "s, sat: " << num_per_status[SatSolver::MODEL_SAT]
+            << " assumptions_unsat: "
+            << num_per_status[SatSolver::ASSUMPTIONS_UNSAT]
+            << " limit_reached: " << num_per_status[SatSolver::LIMIT_REACHED];
+  return num_per_status;
+}
+
+void Run() {
+  LinearBooleanProblem problem;
+  LoadProblem(FLAGS_input, &problem);
+  const std::vector<std::vector<Literal>> queries =
+      GenerateQueries(problem.num_variables());
+
+  SatSolver reset_solver;
+  LoadSolver(problem, &reset_solver);
+  const std::vector<int> reset_results =
+      RunQueries("ResetAndSolve", queries,
+                 [&reset_solver](const std::vector<Literal>& assumptions) {
+                   return reset_solver.ResetAndSolveWithGivenAssumptions(
+                       assumptions);
+                 });
+
+  SatSolver solver;
+  LoadSolver(problem, &solver);
+  IncrementalSatSolver incremental_solver(&solver);
+  const std::vector<int> incremental_results =
+      RunQueries("Incremental", queries,
+                 [&incremental_solver](const std::vector<Literal>& assumptions) {
+                   return incremental_solver.Solve(assumptions);
+                 });
+  LOG(INFO) << "Reused decision levels: "
+            << incremental_solver.num_reused_levels() << ", enqueued "
+            << incremental_solver.num_enqueued_assumptions()
+            << " assumptions.";
+
+  // Both methods must agree on the queries that were fully solved.
+  if (reset_results[SatSolver::LIMIT_REACHED] == 0 &&
+      incremental_results[SatSolver::LIMIT_REACHED] == 0) {
+    CHECK(reset_results == incremental_results);
+  }
+}
+
+}  // namespace
+}  // namespace sat
+}  // namespace operations_research
+
+static const char kUsage[] =
+    "Usage: see flags.\n"
+    "Benchmarks the latency of incremental assumption queries.";
+
+int main(int argc, char** argv) {
+  gflags::SetUsageMessage(kUsage);
+  gflags::ParseCommandLineFlags(&argc, &argv, true);
+  if (FLAGS_input.empty()) {
+    LOG(FATAL) << "Please supply a data file with --input=";
+  }
+  operations_research::sat::Run();
+  return EXIT_SUCCESS;
+}
@@ -30,10 +30,12 @@
 #include "sat/drat.h"
 #include "cpp/opb_reader.h"
 #include "sat/optimization.h"
+#include "sat/parallel_optimization.h"
 #include "cpp/sat_cnf_reader.h"
 #include "sat/sat_solver.h"
 #include "sat/simplification.h"
 #include "sat/symmetry.h"
+#include "sat/symmetry_breaking.h"
 #include "util/time_limit.h"
 #include "base/random.h"
 #include "base/status.h"
@@ -88,6 +90,10 @@ DEFINE_bool(core_enc, false,
 DEFINE_bool(linear_scan, false,
             "If true, search the optimal solution with the linear scan algo.");
 
+DEFINE_int32(parallel_optimization, 0,
+             "If positive, search the optimal solution with that many threads "
+             "running core-guided and linear scan workers in parallel.");
+
 DEFINE_int32(randomize, 500,
              "If positive, solve that many times the problem with a random "
              "decision heuristic before trying to optimize it.");
@@ -96,6 +102,16 @@ DEFINE_bool(use_symmetry, false,
             "If true, find and exploit the eventual symmetries "
             "of the problem.");
 
+DEFINE_double(symmetry_time_limit, 60.0,
+              "With --use_symmetry, the time limit in seconds of the symmetry "
+              "detection. The generators found so far are used if it is "
+              "reached.");
+
+DEFINE_int32(lex_leader_support_size, 0,
+             "With --use_symmetry, if positive, break the symmetries "
+             "statically by adding lex-leader clauses on that many variables "
+             "of each generator instead of using the symmetry propagator.");
+
 DEFINE_bool(presolve, true,
             "Only work on pure SAT problem. If true, presolve the problem.");
 
@@ -135,7 +151,7 @@ void LoadBooleanProblem(std::string filename, LinearBooleanProblem* problem) {
              HasSuffixString(filename, ".wcnf.gz")) {
     SatCnfReader reader;
     if (FLAGS_fu_malik || FLAGS_linear_scan || FLAGS_wpm1 || FLAGS_qmaxsat ||
-        FLAGS_core_enc) {
+        FLAGS_core_enc || FLAGS_parallel_optimization > 0) {
       reader.InterpretCnfAsMaxSat(true);
     }
     if (!reader.Load(filename, problem)) {
@@ -243,26 +259,38 @@ int Run() {
     CHECK(!FLAGS_presolve) << "incompatible";
     LOG(INFO) << "Finding symmetries of the problem.";
     std::vector<std::unique_ptr<SparsePermutation>> generators;
-    FindLinearBooleanProblemSymmetries(problem, &generators);
-    std::unique_ptr<SymmetryPropagator> propagator(new SymmetryPropagator);
-    for (int i = 0; i < generators.size(); ++i) {
-      propagator->AddSymmetry(std::move(generators[i]));
+    FindLinearBooleanProblemSymmetriesWithTimeLimit(
+        problem, FLAGS_symmetry_time_limit, &generators);
+    if (FLAGS_lex_leader_support_size > 0) {
+      if (!AddLexLeaderSymmetryBreakingClauses(
+              generators, FLAGS_lex_leader_support_size, solver.get())) {
+        LOG(INFO) << "UNSAT when adding the symmetry breaking clauses.";
+      }
+    } else {
+      std::unique_ptr<SymmetryPropagator> propagator(new SymmetryPropagator);
+      for (int i = 0; i < generators.size(); ++i) {
+        propagator->AddSymmetry(std::move(generators[i]));
+      }
+      solver->AddPropagator(std::move(propagator));
     }
-    solver->AddPropagator(std::move(propagator));
   }
 
   // Optimize?
   std::vector<bool> solution;
   SatSolver::Status result = SatSolver::LIMIT_REACHED;
   if (FLAGS_fu_malik || FLAGS_linear_scan || FLAGS_wpm1 || FLAGS_qmaxsat ||
-      FLAGS_core_enc) {
+      FLAGS_core_enc || FLAGS_parallel_optimization > 0) {
     if (FLAGS_randomize > 0 && (FLAGS_linear_scan || FLAGS_qmaxsat)) {
       CHECK(!FLAGS_reduce_memory_usage) << "incompatible";
       result = SolveWithRandomParameters(STDOUT_LOG, problem, FLAGS_randomize,
                                          solver.get(), &solution);
     }
     if (result == SatSolver::LIMIT_REACHED) {
-      if (FLAGS_qmaxsat) {
+      if (FLAGS_parallel_optimization > 0) {
+        result = SolveWithParallelPortfolio(STDOUT_LOG, problem, parameters,
+                                            FLAGS_parallel_optimization,
+                                            &solution);
+      } else if (FLAGS_qmaxsat) {
         solver.reset(new SatSolver());
         solver->SetParameters(parameters);
         CHECK(LoadBooleanProblem(problem, solver.get()));
@@ -300,7 +328,8 @@ int Run() {
 
   // Print the solution status.
   if (result == SatSolver::MODEL_SAT) {
-    if (FLAGS_fu_malik || FLAGS_linear_scan || FLAGS_wpm1 || FLAGS_core_enc) {
+    if (FLAGS_fu_malik || FLAGS_linear_scan || FLAGS_wpm1 || FLAGS_core_enc ||
+        FLAGS_parallel_optimization > 0) {
       printf("s OPTIMUM FOUND\n");
       CHECK(!solution.empty());
       const Coefficient objective = ComputeObjectiveValue(problem, solution);
@@ -0,0 +1,196 @@
+// Copyright 2010-2014 Google
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+// Runs several local searches in parallel, each on its own Solver and
+// thread, sharing their solutions through a SharedSolutionPool (see
+// constraint_solver/shared_solution_pool.h).
+//
+// The problem assigns the distinct values 0..n-1 to n variables, minimizing
+// sum(weight[i] * x[i]). Swapping the values of two variables is enough to
+// reach the optimum, which gives the weights in decreasing order the values
+// in increasing order, so every solver must end on it. The content of the
+// pool is checked at the end.
+
+#include <algorithm>
+#include <cstdio>
+#include <functional>
+#include <memory>
+#include <string>
+#include <vector>
+
+#include "base/callback.h"
+#include "base/commandlineflags.h"
+#include "base/integral_types.h"
+#include "base/logging.h"
+#include "base/random.h"
+#include "base/stringprintf.h"
+#include "base/threadpool.h"
+#include "constraint_solver/constraint_solver.h"
+#include "constraint_solver/constraint_solveri.h"
+#include "constraint_solver/shared_solution_pool.h"
+
+DEFINE_int32(size, 40, "Number of variables.");
+DEFINE_int32(num_solvers, 2, "Number of solvers, each on its own thread.");
+DEFINE_int32(pool_capacity, 8, "Capacity of the shared pool.");
+DEFINE_int32(min_distance, 2,
+             "Minimum number of different variables between two solutions "
+             "of the pool.");
+DEFINE_int32(seed, 0, "Random seed of the weights.");
+
+namespace operations_research {
+namespace {
+
+// Swaps the values of two variables.
+class SwapValues : public IntVarLocalSearchOperator {
+ public:
+  explicit SwapValues(const std::vector<IntVar*>& vars)
+      : IntVarLocalSearchOperator(vars), index1_(0), index2_(0) {}
+  ~SwapValues() override {}
+
+ protected:
+  bool MakeOneNeighbor() override {
+    const int size = Size();
+    if (++index2_ >= size) {
+      ++index1_;
+      index2_ = index1_ + 1;
+    }
+    if (index2_ >= size) return false;
+    SetValue(index1_, OldValue(index2_));
+    SetValue(index2_, OldValue(index1_));
+    return true;
+  }
+
+ private:
+  void OnStart() override {
+    index1_ = 0;
+    index2_ = 0;
+  }
+
+  int index1_;
+  int index2_;
+};
+
+struct SolverResult {
+  SolverResult() : objective(0), num_restarts(0), num_syncs(0) {}
+  int64 objective;
+  int64 num_restarts;
+  int64 num_syncs;
+};
+
+// Solves the problem with the given weights. The solvers start from
+// different first solutions.
+void RunSolver(const std::vector<int64>* weights,
+               SharedSolutionPool* shared, int id, SolverResult* result) {
+  const int size = weights->size();
+  Solver s(StringPrintf("solver%d", id));
+  std::vector<IntVar*> vars;
+  s.MakeIntVarArray(size, 0, size - 1, "x", &vars);
+  s.AddConstraint(s.MakeAllDifferent(vars));
+  IntVar* const cost = s.MakeScalProd(vars, *weights)->Var();
+  OptimizeVar* const objective = s.MakeMinimize(cost, 1);
+  DecisionBuilder* const first_solution = s.MakePhase(
+      vars, Solver::CHOOSE_FIRST_UNBOUND,
+      id % 2 == 0 ? Solver::ASSIGN_MIN_VALUE : Solver::ASSIGN_MAX_VALUE);
+  SharedSolutionPoolClient* const pool = s.RevAlloc(
+      new SharedSolutionPoolClient(shared, cost, 0.5, FLAGS_seed + id));
+  LocalSearchPhaseParameters* const parameters =
+      s.MakeLocalSearchPhaseParameters(
+          pool, s.RevAlloc(new SwapValues(vars)),
+          s.MakePhase(vars, Solver::CHOOSE_FIRST_UNBOUND,
+                      Solver::ASSIGN_MIN_VALUE));
+  DecisionBuilder* const ls =
+      s.MakeLocalSearchPhase(vars, first_solution, parameters);
+  SolutionCollector* const collector = s.MakeLastSolutionCollector();
+  collector->Add(vars);
+  collector->AddObjective(cost);
+  CHECK(s.Solve(ls, collector, objective));
+  result->objective = collector->objective_value(0);
+  result->num_restarts = pool->num_restarts();
+  result->num_syncs = pool->num_syncs();
+}
+
+// Checks that the pool is sorted, and that its solutions are far enough
+// from each other.
+void CheckPool(const SharedSolutionPool& shared, int64 optimum) {
+  const std::shared_ptr<const SharedSolutionPool::Snapshot> snapshot =
+      shared.GetSnapshot();
+  const int size = snapshot->solutions.size();
+  CHECK_GE(size, 1);
+  CHECK_LE(size, FLAGS_pool_capacity);
+  CHECK_EQ(optimum, snapshot->solutions[0]->objective);
+  CHECK_EQ(optimum, shared.best_objective());
+  CHECK_EQ(snapshot->generation, shared.generation());
+  for (int i = 0; i < size; ++i) {
+    const SharedSolutionPool::Solution& a = *snapshot->solutions[i];
+    if (i > 0) CHECK_LE(snapshot->solutions[i - 1]->objective, a.objective);
+    for (int j = i + 1; j < size; ++j) {
+      const SharedSolutionPool::Solution& b = *snapshot->solutions[j];
+      CHECK_GE(SharedSolutionPool::Distance(a.mins, a.maxs, b.mins, b.maxs),
+               FLAGS_min_distance);
+    }
+  }
+}
+
+void RunSharedPoolLs(int size, int num_solvers) {
+  ACMRandom random(FLAGS_seed);
+  std::vector<int64> weights(size);
+  for (int i = 0; i < size; ++i) weights[i] = 1 + random.Uniform(100);
+  std::vector<int64> sorted_weights = weights;
+  std::sort(sorted_weights.begin(), sorted_weights.end(),
+            std::greater<int64>());
+  int64 optimum = 0;
+  for (int i = 0; i < size; ++i) optimum += sorted_weights[i] * i;
+
+  SharedSolutionPool shared(/*maximize=*/false, FLAGS_pool_capacity,
+                            FLAGS_min_distance);
+  std::vector<SolverResult> results(num_solvers);
+  {
+    ThreadPool pool("SharedPoolLs", num_solvers);
+    pool.StartWorkers();
+    for (int i = 0; i < num_solvers; ++i) {
+      pool.Add(NewCallback(&RunSolver,
+                           static_cast<const std::vector<int64>*>(&weights),
+                           &shared, i, &results[i]));
+    }
+  }
+
+  for (int i = 0; i < num_solvers; ++i) {
+    printf("solver%d: objective %lld, %lld restarts, %lld syncs\n", i,
+           static_cast<long long>(results[i].objective),     // NOLINT
+           static_cast<long long>(results[i].num_restarts),  // NOLINT
+           static_cast<long long>(results[i].num_syncs));    // NOLINT
+    CHECK_EQ(optimum, results[i].objective);
+  }
+  printf("%s\n", shared.DebugString().c_str());
+  // Each solver publishes at least its first solution.
+  CHECK_GE(shared.num_published(), num_solvers);
+  CheckPool(shared, optimum);
+  printf("OK: optimum %lld\n", static_cast<long long>(optimum));  // NOLINT
+}
+
+}  // namespace
+}  // namespace operations_research
+
+static const char kUsage[] =
+    "Usage: see flags.\n"
+    "Runs parallel local searches sharing a pool of elite solutions, and "
+    "checks the result.";
+
+int main(int argc, char** argv) {
+  gflags::SetUsageMessage(kUsage);
+  gflags::ParseCommandLineFlags(&argc, &argv, true);
+  CHECK_GE(FLAGS_size, 2);
+  CHECK_GE(FLAGS_num_solvers, 1);
+  operations_research::RunSharedPoolLs(FLAGS_size, FLAGS_num_solvers);
+  return EXIT_SUCCESS;
+}
@@ -25,6 +25,8 @@
 #include "glop/proto_utils.h"
 #include "linear_solver/linear_solver.h"
 #include "linear_solver/linear_solver.pb.h"
+#include "linear_solver/model_stream_writer.h"
+#include "linear_solver/parallel_mps_reader.h"
 #include "lp_data/mps_reader.h"
 #include "util/proto_tools.h"
 
@@ -40,6 +42,12 @@ DEFINE_int64(time_limit_ms, 0,
              " time.");
 DEFINE_string(forced_mps_format, "",
               "Set to force the mps format to use: free, fixed");
+DEFINE_int32(mps_reader_threads, 0,
+             "If positive, read the .mps or .mps.gz input with the parallel "
+             "free MPS reader using this number of threads.");
+DEFINE_string(dump_model, "",
+              "If non-empty, write the loaded model there. The format is "
+              "given by the suffix: .mps, .lp, .mps.gz or .lp.gz.");
 
 DEFINE_string(output, "",
               "If non-empty, write the MPSolverResponse there. "
@@ -127,8 +135,15 @@ void Run() {
   // Load the problem into an MPModelProto.
   MPModelProto model_proto;
   MPModelRequest request_proto;
-  if (HasSuffixString(FLAGS_input, ".mps") ||
-      HasSuffixString(FLAGS_input, ".mps.gz")) {
+  const bool is_mps_input = HasSuffixString(FLAGS_input, ".mps") ||
+                            HasSuffixString(FLAGS_input, ".mps.gz");
+  if (is_mps_input && FLAGS_mps_reader_threads > 0) {
+    const util::Status status = ReadMpsFileToProto(
+        FLAGS_input, FLAGS_mps_reader_threads, &model_proto);
+    CHECK(status.ok()) << "Error while parsing the mps file '" << FLAGS_input
+                       << "': " << status.error_message();
+    LOG(INFO) << "Read file with the parallel MPS reader.";
+  } else if (is_mps_input) {
     glop::LinearProgram linear_program_fixed;
     glop::LinearProgram linear_program_free;
     glop::MPSReader mps_reader;
@@ -176,6 +191,11 @@ void Run() {
     }
   }
   printf("%-12s: '%s'\n", "File", FLAGS_input.c_str());
+  if (!FLAGS_dump_model.empty()) {
+    const util::Status status =
+        WriteModelToFile(model_proto, FLAGS_dump_model, /*obfuscated=*/false);
+    CHECK(status.ok()) << status.error_message();
+  }
 
   // Load the proto into the solver.
   std::string error_message;
@@ -0,0 +1,216 @@
+// Copyright 2010-2014 Google
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+// Checks SparseMPModel::SynchronizeLinearProgram() (see
+// linear_solver/sparse_model.h): a random model is edited in several rounds
+// with new rows and columns, changed bounds, integrality and objective, and
+// new or overwritten coefficients. After each round, the LinearProgram kept
+// up to date incrementally must be equal to a full rebuild of the model.
+
+#include <cstdio>
+#include <string>
+#include <vector>
+
+#include "base/commandlineflags.h"
+#include "base/integral_types.h"
+#include "base/logging.h"
+#include "base/random.h"
+#include "base/stringprintf.h"
+#include "linear_solver/sparse_model.h"
+#include "lp_data/lp_data.h"
+#include "lp_data/lp_types.h"
+
+DEFINE_int32(num_columns, 50, "Number of columns of the initial model.");
+DEFINE_int32(num_rows, 30, "Number of rows of the initial model.");
+DEFINE_int32(num_rounds, 20, "Number of rounds of changes.");
+DEFINE_int32(changes_per_round, 40, "Number of changes in each round.");
+DEFINE_int32(seed, 0, "Random seed.");
+
+namespace operations_research {
+namespace {
+
+// Returns the coefficients of the column, with the zeros of the missing
+// entries.
+std::vector<double> ColumnCoefficients(const glop::LinearProgram& lp,
+                                       glop::ColIndex col) {
+  std::vector<double> result(lp.num_constraints().value(), 0.0);
+  for (const glop::SparseColumn::Entry e : lp.GetSparseColumn(col)) {
+    result[e.row().value()] = e.coefficient();
+  }
+  return result;
+}
+
+void CheckSameLinearProgram(const glop::LinearProgram& expected,
+                            const glop::LinearProgram& actual) {
+  CHECK_EQ(expected.num_variables(), actual.num_variables());
+  CHECK_EQ(expected.num_constraints(), actual.num_constraints());
+  CHECK_EQ(expected.IsMaximizationProblem(), actual.IsMaximizationProblem());
+  CHECK_EQ(expected.objective_offset(), actual.objective_offset());
+  for (glop::RowIndex row(0); row < expected.num_constraints(); ++row) {
+    CHECK_EQ(expected.constraint_lower_bounds()[row],
+             actual.constraint_lower_bounds()[row]);
+    CHECK_EQ(expected.constraint_upper_bounds()[row],
+             actual.constraint_upper_bounds()[row]);
+    CHECK_EQ(expected.GetConstraintName(row), actual.GetConstraintName(row));
+  }
+  for (glop::ColIndex col(0); col < expected.num_variables(); ++col) {
+    CHECK_EQ(expected.variable_lower_bounds()[col],
+             actual.variable_lower_bounds()[col]);
+    CHECK_EQ(expected.variable_upper_bounds()[col],
+             actual.variable_upper_bounds()[col]);
+    CHECK_EQ(expected.objective_coefficients()[col],
+             actual.objective_coefficients()[col]);
+    CHECK_EQ(expected.IsVariableInteger(col), actual.IsVariableInteger(col));
+    CHECK_EQ(expected.GetVariableName(col), actual.GetVariableName(col));
+    const std::vector<double> expected_column =
+        ColumnCoefficients(expected, col);
+    const std::vector<double> actual_column = ColumnCoefficients(actual, col);
+    const int num_rows = expected_column.size();
+    for (int row = 0; row < num_rows; ++row) {
+      CHECK_EQ(expected_column[row], actual_column[row])
+          << "row " << row << ", column " << col.value();
+    }
+  }
+}
+
+// A random small integer value, as a double to compare exactly.
+double RandomValue(ACMRandom* random) {
+  return static_cast<double>(random->Uniform(21)) - 10.0;
+}
+
+void AddRandomEntries(int num_entries, ACMRandom* random,
+                      SparseMPModel* model) {
+  for (int i = 0; i < num_entries; ++i) {
+    model->SetCoefficient(random->Uniform(model->num_rows()),
+                          random->Uniform(model->num_columns()),
+                          RandomValue(random));
+  }
+}
+
+// Applies one random change to the model.
+void ApplyRandomChange(ACMRandom* random, SparseMPModel* model) {
+  const int column = random->Uniform(model->num_columns());
+  const int row = random->Uniform(model->num_rows());
+  const double value = RandomValue(random);
+  switch (random->Uniform(9)) {
+    case 0: {
+      const int new_row = model->AddRow(value, value + random->Uniform(5));
+      model->SetRowName(new_row, StringPrintf("r%d", new_row));
+      model->SetCoefficient(new_row, column, RandomValue(random));
+      break;
+    }
+    case 1: {
+      const int new_column = model->AddColumn(
+          value, value + random->Uniform(5), random->OneIn(2));
+      model->SetColumnName(new_column, StringPrintf("c%d", new_column));
+      model->SetObjectiveCoefficient(new_column, RandomValue(random));
+      model->SetCoefficient(row, new_column, RandomValue(random));
+      break;
+    }
+    case 2:
+      model->SetColumnBounds(column, value, value + random->Uniform(5));
+      break;
+    case 3:
+      model->SetRowBounds(row, value, value + random->Uniform(5));
+      break;
+    case 4:
+      model->SetColumnIntegrality(column, random->OneIn(2));
+      break;
+    case 5:
+      model->SetObjectiveCoefficient(column, value);
+      break;
+    case 6:
+      // Builds the hash index, so that the next overwrites are done in place.
+      model->GetCoefficient(row, column);
+      model->SetCoefficient(row, column, value);
+      break;
+    case 7:
+      // Without the index, the new value is appended and the last one wins.
+      model->SetCoefficient(row, column, value);
+      break;
+    case 8: {
+      // A bulk tail of entries, which invalidates the hash index.
+      const double lower_bounds[] = {value};
+      const double upper_bounds[] = {value + 1.0};
+      const int starts[] = {0, 2};
+      const int columns[] = {column, (column + 1) % model->num_columns()};
+      const double coefficients[] = {RandomValue(random),
+                                     RandomValue(random)};
+      model->AddRows(1, lower_bounds, upper_bounds, starts, columns,
+                     coefficients);
+      break;
+    }
+  }
+}
+
+void RunSparseModelSyncTest() {
+  ACMRandom random(FLAGS_seed);
+  SparseMPModel model;
+  std::vector<double> lower_bounds(FLAGS_num_columns);
+  std::vector<double> upper_bounds(FLAGS_num_columns);
+  std::vector<double> objective(FLAGS_num_columns);
+  for (int c = 0; c < FLAGS_num_columns; ++c) {
+    lower_bounds[c] = RandomValue(&random);
+    upper_bounds[c] = lower_bounds[c] + random.Uniform(5);
+    objective[c] = RandomValue(&random);
+  }
+  model.AddColumns(FLAGS_num_columns, lower_bounds.data(),
+                   upper_bounds.data(), objective.data(), nullptr, nullptr,
+                   nullptr, nullptr);
+  for (int r = 0; r < FLAGS_num_rows; ++r) {
+    model.AddRow(-10.0, 10.0);
+  }
+  AddRandomEntries(FLAGS_num_columns * 3, &random, &model);
+
+  glop::LinearProgram synchronized;
+  glop::LinearProgram rebuilt;
+  model.SynchronizeLinearProgram(&synchronized);
+  model.ExtractToLinearProgram(&rebuilt);
+  CheckSameLinearProgram(rebuilt, synchronized);
+  CHECK_EQ(0, model.NumPendingChanges());
+
+  int64 num_changes = 0;
+  for (int round = 0; round < FLAGS_num_rounds; ++round) {
+    for (int i = 0; i < FLAGS_changes_per_round; ++i) {
+      ApplyRandomChange(&random, &model);
+    }
+    model.SetObjectiveOffset(RandomValue(&random));
+    model.SetMaximization(random.OneIn(2));
+    num_changes += model.NumPendingChanges();
+    model.SynchronizeLinearProgram(&synchronized);
+    CHECK_EQ(0, model.NumPendingChanges());
+    model.ExtractToLinearProgram(&rebuilt);
+    CheckSameLinearProgram(rebuilt, synchronized);
+  }
+  printf("OK: %d columns, %d rows, %lld entries, %lld changes replayed\n",
+         model.num_columns(), model.num_rows(),
+         static_cast<long long>(model.num_entries()),  // NOLINT
+         static_cast<long long>(num_changes));         // NOLINT
+}
+
+}  // namespace
+}  // namespace operations_research
+
+static const char kUsage[] =
+    "Usage: see flags.\n"
+    "Checks that SparseMPModel::SynchronizeLinearProgram() gives the same "
+    "LinearProgram as a full extraction.";
+
+int main(int argc, char** argv) {
+  gflags::SetUsageMessage(kUsage);
+  gflags::ParseCommandLineFlags(&argc, &argv, true);
+  CHECK_GE(FLAGS_num_columns, 2);
+  CHECK_GE(FLAGS_num_rows, 1);
+  operations_research::RunSparseModelSyncTest();
+  return EXIT_SUCCESS;
+}
@@ -0,0 +1,633 @@
+// Copyright 2010-2014 Google
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#ifndef OR_TOOLS_BOP_BOP_BANDIT_PORTFOLIO_H_
+#define OR_TOOLS_BOP_BOP_BANDIT_PORTFOLIO_H_
+
+// A portfolio of Bop optimizers where the next optimizer to run is selected as
+// in a multi-armed bandit problem: each optimizer is an arm whose reward is
+// the gain (objective improvement plus lower bound improvement) per unit of
+// time it brings. Contrary to the OptimizerSelector of bop_portfolio.h that
+// follows a fixed order, the BanditOptimizerSelector balances the
+// exploitation of the optimizers that were productive so far with the
+// exploration of the others, using either the UCB1 rule or Thompson sampling.
+//
+// The BanditPortfolioOptimizer can also run several optimizers at once on a
+// thread pool. In this case, the most promising optimizers are selected for
+// each batch and they get a share of the time of the batch proportional to
+// their score.
+
+#include <algorithm>
+#include <cmath>
+#include <limits>
+#include <memory>
+#include <random>
+#include <string>
+#include <vector>
+
+#include "base/callback.h"
+#include "base/integral_types.h"
+#include "base/join.h"
+#include "base/logging.h"
+#include "base/stl_util.h"
+#include "base/stringprintf.h"
+#include "base/threadpool.h"
+#include "base/timer.h"
+#include "bop/bop_base.h"
+#include "bop/bop_parameters.pb.h"
+#include "bop/bop_portfolio.h"
+#include "bop/bop_solution.h"
+#include "bop/bop_types.h"
+#include "sat/boolean_problem.pb.h"
+#include "util/stats.h"
+#include "util/time_limit.h"
+
+namespace operations_research {
+namespace bop {
+
+class BanditOptimizerSelector {
+ public:
+  enum Policy {
+    // Upper confidence bound: the score of an optimizer is its mean gain per
+    // unit of time plus an exploration term that decreases with its number of
+    // calls.
+    UCB,
+
+    // The probability of success of a call of each optimizer follows a Beta
+    // posterior distribution, and the score is a sample of this distribution
+    // divided by the mean time of a call.
+    THOMPSON_SAMPLING,
+  };
+
+  // Statistics about one optimizer. All the times are cumulative.
+  struct OptimizerStats {
+    explicit OptimizerStats(const std::string& n)
+        : name(n),
+          num_calls(0),
+          num_successes(0),
+          total_gain(0),
+          normalized_gain(0.0),
+          deterministic_time(0.0),
+          wall_time(0.0),
+          last_score(0.0) {}
+
+    std::string name;
+    int num_calls;
+    int num_successes;
+    int64 total_gain;
+
+    // The sum of the gains of each call divided by the largest gain seen so
+    // far at the time of the call, so that each term is in [0, 1].
+    double normalized_gain;
+    double deterministic_time;
+    double wall_time;
+
+    // The score computed at the last selection.
+    double last_score;
+  };
+
+  // The names are only used for the statistics.
+  BanditOptimizerSelector(const std::vector<std::string>& names, Policy policy,
+                          int random_seed);
+
+  // The coefficient of the exploration term of UCB. The default is sqrt(2).
+  void set_exploration_coefficient(double c) { exploration_coefficient_ = c; }
+
+  // The time of a call used in the scores is
+  //   (1 - w) * deterministic_time + w * wall_time.
+  // The default w = 0 makes the selection deterministic.
+  void set_wall_time_weight(double w) { wall_time_weight_ = w; }
+
+  // Returns the runnable and selectable optimizer with the best score, or
+  // kInvalidOptimizerIndex if there is none. The optimizers that were never
+  // called have an infinite score and are selected first, in their order.
+  OptimizerIndex SelectOptimizer();
+
+  // Same as SelectOptimizer() but returns up to num_optimizers distinct
+  // optimizers sorted by decreasing score.
+  std::vector<OptimizerIndex> SelectOptimizers(int num_optimizers);
+
+  // Returns the share of the time of a batch that each of the given
+  // optimizers (as returned by the last SelectOptimizers()) should get. The
+  // shares are proportional to the scores, and sum to one.
+  std::vector<double> TimeShares(const std::vector<OptimizerIndex>& selected);
+
+  // Updates the statistics of the given optimizer after one of its calls. A
+  // positive gain makes all the optimizers selectable again.
+  void UpdateScore(OptimizerIndex optimizer_index, int64 gain,
+                   double deterministic_time, double wall_time);
+
+  // Same semantic as in the OptimizerSelector.
+  void TemporarilyMarkOptimizerAsUnselectable(OptimizerIndex optimizer_index);
+  void MakeAllOptimizersSelectable();
+  void SetOptimizerRunnability(OptimizerIndex optimizer_index, bool runnable);
+
+  int NumOptimizers() const { return stats_.size(); }
+  int NumCallsForOptimizer(OptimizerIndex optimizer_index) const {
+    return stats_[optimizer_index].num_calls;
+  }
+  const OptimizerStats& Stats(OptimizerIndex optimizer_index) const {
+    return stats_[optimizer_index];
+  }
+
+  // Returns a one-line summary of the statistics of the given optimizer.
+  std::string PrintStats(OptimizerIndex optimizer_index) const;
+
+  // Returns the statistics of all the optimizers as a JSON object of the form
+  //   {"policy": "UCB", "num_calls": 12, "optimizers": [{"name": ...}, ...]}
+  // which is easy to aggregate over a family of instances.
+  std::string StatsReport() const;
+
+ private:
+  // Returns the time of a call (see set_wall_time_weight()).
+  double TimeSpent(double deterministic_time, double wall_time) const {
+    return (1.0 - wall_time_weight_) * deterministic_time +
+           wall_time_weight_ * wall_time;
+  }
+
+  // Computes the score of the given optimizer and stores it in last_score.
+  double ComputeScore(OptimizerIndex optimizer_index);
+
+  // Returns a sample of the Beta(a, b) distribution.
+  double SampleBeta(double a, double b);
+
+  const Policy policy_;
+  double exploration_coefficient_;
+  double wall_time_weight_;
+  ITIVector<OptimizerIndex, OptimizerStats> stats_;
+  ITIVector<OptimizerIndex, bool> runnable_;
+  ITIVector<OptimizerIndex, bool> selectable_;
+  int num_calls_;
+  int64 max_gain_;
+  std::mt19937 random_;
+};
+
+// A BopOptimizerBase that runs a portfolio of optimizers selected by a
+// BanditOptimizerSelector. Each arm is a PortfolioOptimizer restricted to one
+// method of the given optimizer set, so that the optimizers are created
+// exactly as in the default portfolio.
+//
+// With num_threads > 1, each call to Optimize() runs a batch of up to
+// num_threads distinct optimizers concurrently. The batch has a budget of
+// batch_deterministic_time per optimizer, which is split between them
+// according to BanditOptimizerSelector::TimeShares(). The learned information
+// of all the optimizers of the batch is merged in the returned one.
+class BanditPortfolioOptimizer : public BopOptimizerBase {
+ public:
+  BanditPortfolioOptimizer(const ProblemState& problem_state,
+                           const BopParameters& parameters,
+                           const BopSolverOptimizerSet& optimizer_set,
+                           const std::string& name,
+                           BanditOptimizerSelector::Policy policy,
+                           int num_threads);
+  ~BanditPortfolioOptimizer() override;
+
+  bool ShouldBeRun(const ProblemState& problem_state) const override {
+    return true;
+  }
+  Status Optimize(const BopParameters& parameters,
+                  const ProblemState& problem_state, LearnedInfo* learned_info,
+                  TimeLimit* time_limit) override;
+
+  void set_batch_deterministic_time(double t) { batch_deterministic_time_ = t; }
+
+  BanditOptimizerSelector* mutable_selector() { return &selector_; }
+  const BanditOptimizerSelector& selector() const { return selector_; }
+
+ private:
+  // One optimizer of a batch, with its own time limit and learned info.
+  struct Run {
+    explicit Run(const LinearBooleanProblem& problem)
+        : optimizer_index(kInvalidOptimizerIndex),
+          learned_info(problem),
+          status(BopOptimizerBase::ABORT),
+          wall_time(0.0) {}
+
+    OptimizerIndex optimizer_index;
+    std::unique_ptr<TimeLimit> time_limit;
+    LearnedInfo learned_info;
+    BopOptimizerBase::Status status;
+    double wall_time;
+  };
+
+  // Runs the optimizer of the given run. This is called from the thread pool.
+  void ExecuteRun(const BopParameters* parameters,
+                  const ProblemState* problem_state, Run* run);
+
+  // Returns the gain of the given learned info with respect to the problem
+  // state, i.e. the cost improvement plus the lower bound improvement. The
+  // first feasible solution has a gain of one.
+  static int64 ComputeGain(const ProblemState& problem_state,
+                           const LearnedInfo& learned_info);
+
+  // Runs one optimizer with the whole time limit.
+  Status OptimizeSequentially(const BopParameters& parameters,
+                              const ProblemState& problem_state,
+                              LearnedInfo* learned_info, TimeLimit* time_limit);
+
+  // Runs a batch of optimizers concurrently.
+  Status OptimizeInParallel(const BopParameters& parameters,
+                            const ProblemState& problem_state,
+                            LearnedInfo* learned_info, TimeLimit* time_limit);
+
+  // Updates the selector with the result of the given run. Returns the status
+  // to report for this run.
+  Status ProcessRunResult(const ProblemState& problem_state, const Run& run);
+
+  ITIVector<OptimizerIndex, PortfolioOptimizer*> optimizers_;
+  BanditOptimizerSelector selector_;
+  const int num_threads_;
+  double batch_deterministic_time_;
+  int64 state_update_stamp_;
+};
+
+// ============================================================================
+// Implementation.
+// ============================================================================
+
+inline BanditOptimizerSelector::BanditOptimizerSelector(
+    const std::vector<std::string>& names, Policy policy, int random_seed)
+    : policy_(policy),
+      exploration_coefficient_(std::sqrt(2.0)),
+      wall_time_weight_(0.0),
+      runnable_(names.size(), true),
+      selectable_(names.size(), true),
+      num_calls_(0),
+      max_gain_(0),
+      random_(random_seed) {
+  for (const std::string& name : names) stats_.push_back(OptimizerStats(name));
+}
+
+inline double BanditOptimizerSelector::SampleBeta(double a, double b) {
+  std::gamma_distribution<double> gamma_a(a, 1.0);
+  std::gamma_distribution<double> gamma_b(b, 1.0);
+  const double x = gamma_a(random_);
+  const double y = gamma_b(random_);
+  return x + y > 0.0 ? x / (x + y) : 0.5;
+}
+
+inline double BanditOptimizerSelector::ComputeScore(
+    OptimizerIndex optimizer_index) {
+  OptimizerStats& stats = stats_[optimizer_index];
+  if (stats.num_calls == 0) {
+    stats.last_score = std::numeric_limits<double>::infinity();
+    return stats.last_score;
+  }
+
+  // A small minimum time avoids infinite scores for the optimizers that
+  // return right away.
+  const double kMinTime = 1e-6;
+  const double total_time = std::max(
+      kMinTime, TimeSpent(stats.deterministic_time, stats.wall_time));
+  const double mean_time = total_time / stats.num_calls;
+  switch (policy_) {
+    case UCB:
+      stats.last_score =
+          stats.normalized_gain / total_time +
+          exploration_coefficient_ *
+              std::sqrt(std::log(static_cast<double>(num_calls_)) /
+                        stats.num_calls) /
+              mean_time;
+      break;
+    case THOMPSON_SAMPLING:
+      stats.last_score =
+          SampleBeta(1.0 + stats.num_successes,
+                     1.0 + stats.num_calls - stats.num_successes) /
+          mean_time;
+      break;
+  }
+  return stats.last_score;
+}
+
+inline OptimizerIndex BanditOptimizerSelector::SelectOptimizer() {
+  const std::vector<OptimizerIndex> selected = SelectOptimizers(1);
+  return selected.empty() ? kInvalidOptimizerIndex : selected[0];
+}
+
+inline std::vector<OptimizerIndex> BanditOptimizerSelector::SelectOptimizers(
+    int num_optimizers) {
+  std::vector<std::pair<double, OptimizerIndex>> candidates;
+  for (OptimizerIndex i(0); i < stats_.size(); ++i) {
+    if (!runnable_[i] || !selectable_[i]) continue;
+
+    // Sorting by decreasing score, then by increasing index.
+    candidates.push_back(std::make_pair(-ComputeScore(i), i));
+  }
+  std::sort(candidates.begin(), candidates.end());
+  std::vector<OptimizerIndex> selected;
+  for (int i = 0; i < std::min<int>(num_optimizers, candidates.size()); ++i) {
+    selected.push_back(candidates[i].second);
+  }
+  return selected;
+}
+
+inline std::vector<double> BanditOptimizerSelector::TimeShares(
+    const std::vector<OptimizerIndex>& selected) {
+  // The optimizers never called have the share of the best one that was.
+  double max_finite_score = 0.0;
+  for (const OptimizerIndex i : selected) {
+    if (std::isfinite(stats_[i].last_score)) {
+      max_finite_score = std::max(max_finite_score, stats_[i].last_score);
+    }
+  }
+  if (max_finite_score == 0.0) max_finite_score = 1.0;
+
+  // Each optimizer gets at least a fraction of the uniform share, so that
+  // the unproductive ones are still explored.
+  const double kMinRelativeScore = 0.1;
+  std::vector<double> shares;
+  double sum = 0.0;
+  for (const OptimizerIndex i : selected) {
+    const double score = std::isfinite(stats_[i].last_score)
+                             ? stats_[i].last_score
+                             : max_finite_score;
+    shares.push_back(std::max(score, kMinRelativeScore * max_finite_score));
+    sum += shares.back();
+  }
+  for (double& share : shares) share /= sum;
+  return shares;
+}
+
+inline void BanditOptimizerSelector::UpdateScore(OptimizerIndex optimizer_index,
+                                                 int64 gain,
+                                                 double deterministic_time,
+                                                 double wall_time) {
+  OptimizerStats& stats = stats_[optimizer_index];
+  ++num_calls_;
+  ++stats.num_calls;
+  stats.deterministic_time += deterministic_time;
+  stats.wall_time += wall_time;
+  if (gain <= 0) return;
+  ++stats.num_successes;
+  stats.total_gain += gain;
+  max_gain_ = std::max(max_gain_, gain);
+  stats.normalized_gain += static_cast<double>(gain) / max_gain_;
+  MakeAllOptimizersSelectable();
+}
+
+inline void BanditOptimizerSelector::TemporarilyMarkOptimizerAsUnselectable(
+    OptimizerIndex optimizer_index) {
+  selectable_[optimizer_index] = false;
+}
+
+inline void BanditOptimizerSelector::MakeAllOptimizersSelectable() {
+  selectable_.assign(selectable_.size(), true);
+}
+
+inline void BanditOptimizerSelector::SetOptimizerRunnability(
+    OptimizerIndex optimizer_index, bool runnable) {
+  runnable_[optimizer_index] = runnable;
+}
+
+inline std::string BanditOptimizerSelector::PrintStats(
+    OptimizerIndex optimizer_index) const {
+  const OptimizerStats& stats = stats_[optimizer_index];
+  return StringPrintf(
+      "    %40s : %3d/%-3d  (%6.2f%%)  Total gain: %6lld  Det time: %.2f  "
+      "Wall time: %.2f  Score: %.4g",
+      stats.name.c_str(), stats.num_successes, stats.num_calls,
+      stats.num_calls == 0 ? 0.0 : 100.0 * stats.num_successes /
+                                       stats.num_calls,
+      stats.total_gain, stats.deterministic_time, stats.wall_time,
+      stats.last_score);
+}
+
+inline std::string BanditOptimizerSelector::StatsReport() const {
+  std::string report =
+      StrCat("{\"policy\": \"", policy_ == UCB ? "UCB" : "THOMPSON_SAMPLING",
+             "\", \"num_calls\": ", num_calls_, ", \"optimizers\": [");
+  for (OptimizerIndex i(0); i < stats_.size(); ++i) {
+    const OptimizerStats& stats = stats_[i];
+    if (i > 0) report += ", ";
+    report += StringPrintf(
+        "{\"name\": \"%s\", \"num_calls\": %d, \"num_successes\": %d, "
+        "\"total_gain\": %lld, \"normalized_gain\": %.6g, "
+        "\"deterministic_time\": %.6g, \"wall_time\": %.6g, "
+        "\"runnable\": %s, \"last_score\": %.6g}",
+        stats.name.c_str(), stats.num_calls, stats.num_successes,
+        stats.total_gain, stats.normalized_gain, stats.deterministic_time,
+        stats.wall_time, runnable_[i] ? "true" : "false",
+        std::isfinite(stats.last_score) ? stats.last_score : -1.0);
+  }
+  report += "]}";
+  return report;
+}
+
+inline BanditPortfolioOptimizer::BanditPortfolioOptimizer(
+    const ProblemState& problem_state, const BopParameters& parameters,
+    const BopSolverOptimizerSet& optimizer_set, const std::string& name,
+    BanditOptimizerSelector::Policy policy, int num_threads)
+    : BopOptimizerBase(name),
+      selector_(
+          [&optimizer_set]() {
+            std::vector<std::string> names;
+            for (const BopOptimizerMethod& method : optimizer_set.methods()) {
+              names.push_back(
+                  BopOptimizerMethod::OptimizerType_Name(method.type()));
+            }
+            return names;
+          }(),
+          policy, parameters.random_seed()),
+      num_threads_(std::max(1, num_threads)),
+      batch_deterministic_time_(1.0),
+      state_update_stamp_(ProblemState::kInitialStampValue) {
+  for (const BopOptimizerMethod& method : optimizer_set.methods()) {
+    BopSolverOptimizerSet single_method_set;
+    *single_method_set.add_methods() = method;
+    optimizers_.push_back(new PortfolioOptimizer(
+        problem_state, parameters, single_method_set,
+        StrCat(name, "_",
+               BopOptimizerMethod::OptimizerType_Name(method.type()))));
+  }
+}
+
+inline BanditPortfolioOptimizer::~BanditPortfolioOptimizer() {
+  IF_STATS_ENABLED({
+    for (OptimizerIndex i(0); i < selector_.NumOptimizers(); ++i) {
+      LOG(INFO) << selector_.PrintStats(i);
+    }
+    LOG(INFO) << selector_.StatsReport();
+  });
+  STLDeleteElements(&optimizers_);
+}
+
+inline BopOptimizerBase::Status BanditPortfolioOptimizer::Optimize(
+    const BopParameters& parameters, const ProblemState& problem_state,
+    LearnedInfo* learned_info, TimeLimit* time_limit) {
+  CHECK(learned_info != nullptr);
+  CHECK(time_limit != nullptr);
+  learned_info->Clear();
+
+  // The optimizers that aborted may be able to run on the new state.
+  if (state_update_stamp_ != problem_state.update_stamp()) {
+    state_update_stamp_ = problem_state.update_stamp();
+    selector_.MakeAllOptimizersSelectable();
+  }
+  return num_threads_ == 1 ? OptimizeSequentially(parameters, problem_state,
+                                                  learned_info, time_limit)
+                           : OptimizeInParallel(parameters, problem_state,
+                                                learned_info, time_limit);
+}
+
+inline BopOptimizerBase::Status BanditPortfolioOptimizer::OptimizeSequentially(
+    const BopParameters& parameters, const ProblemState& problem_state,
+    LearnedInfo* learned_info, TimeLimit* time_limit) {
+  Run run(problem_state.original_problem());
+  run.optimizer_index = selector_.SelectOptimizer();
+  if (run.optimizer_index == kInvalidOptimizerIndex) {
+    VLOG(1) << "All the optimizers are done.";
+    return BopOptimizerBase::ABORT;
+  }
+  const double initial_deterministic_time =
+      time_limit->GetElapsedDeterministicTime();
+  WallTimer timer;
+  timer.Start();
+  run.status = optimizers_[run.optimizer_index]->Optimize(
+      parameters, problem_state, &run.learned_info, time_limit);
+  run.wall_time = timer.Get();
+
+  const int64 gain = ComputeGain(problem_state, run.learned_info);
+  selector_.UpdateScore(
+      run.optimizer_index, gain,
+      time_limit->GetElapsedDeterministicTime() - initial_deterministic_time,
+      run.wall_time);
+  *learned_info = run.learned_info;
+  return ProcessRunResult(problem_state, run);
+}
+
+inline BopOptimizerBase::Status BanditPortfolioOptimizer::OptimizeInParallel(
+    const BopParameters& parameters, const ProblemState& problem_state,
+    LearnedInfo* learned_info, TimeLimit* time_limit) {
+  const std::vector<OptimizerIndex> selected =
+      selector_.SelectOptimizers(num_threads_);
+  if (selected.empty()) {
+    VLOG(1) << "All the optimizers are done.";
+    return BopOptimizerBase::ABORT;
+  }
+  const std::vector<double> shares = selector_.TimeShares(selected);
+  const double batch_time =
+      std::min(time_limit->GetDeterministicTimeLeft(),
+               batch_deterministic_time_ * selected.size());
+
+  std::vector<std::unique_ptr<Run>> runs;
+  for (int i = 0; i < selected.size(); ++i) {
+    runs.emplace_back(new Run(problem_state.original_problem()));
+    runs.back()->optimizer_index = selected[i];
+    runs.back()->time_limit.reset(
+        new TimeLimit(time_limit->GetTimeLeft(), shares[i] * batch_time));
+  }
+
+  // The optimizers share the problem state, and read the cached values of its
+  // solution concurrently: they must be computed before.
+  problem_state.solution().IsFeasible();
+  problem_state.solution().GetCost();
+  {
+    ThreadPool pool("BanditPortfolioOptimizer", runs.size());
+    pool.StartWorkers();
+    for (const std::unique_ptr<Run>& run : runs) {
+      pool.Add(NewCallback(this, &BanditPortfolioOptimizer::ExecuteRun,
+                           &parameters, &problem_state, run.get()));
+    }
+  }
+
+  // Merge the results. The optimizers ran concurrently, so the batch took
+  // the deterministic time of the longest one.
+  double max_deterministic_time = 0.0;
+  Status status = BopOptimizerBase::ABORT;
+  for (const std::unique_ptr<Run>& run : runs) {
+    const double deterministic_time =
+        run->time_limit->GetElapsedDeterministicTime();
+    max_deterministic_time =
+        std::max(max_deterministic_time, deterministic_time);
+    selector_.UpdateScore(run->optimizer_index,
+                          ComputeGain(problem_state, run->learned_info),
+                          deterministic_time, run->wall_time);
+
+    const LearnedInfo& info = run->learned_info;
+    if (info.solution.IsFeasible() &&
+        (!learned_info->solution.IsFeasible() ||
+         info.solution.GetCost() < learned_info->solution.GetCost())) {
+      learned_info->solution = info.solution;
+    }
+    learned_info->lower_bound =
+        std::max(learned_info->lower_bound, info.lower_bound);
+    learned_info->fixed_literals.insert(learned_info->fixed_literals.end(),
+                                        info.fixed_literals.begin(),
+                                        info.fixed_literals.end());
+    learned_info->binary_clauses.insert(learned_info->binary_clauses.end(),
+                                        info.binary_clauses.begin(),
+                                        info.binary_clauses.end());
+    if (learned_info->lp_values.empty()) {
+      learned_info->lp_values = info.lp_values;
+    }
+
+    // The statuses are ordered by decreasing priority in the enum, except
+    // that any status beats ABORT.
+    const Status run_status = ProcessRunResult(problem_state, *run);
+    if (status == BopOptimizerBase::ABORT ||
+        (run_status != BopOptimizerBase::ABORT && run_status < status)) {
+      status = run_status;
+    }
+  }
+  time_limit->AdvanceDeterministicTime(max_deterministic_time);
+  return status;
+}
+
+inline void BanditPortfolioOptimizer::ExecuteRun(
+    const BopParameters* parameters, const ProblemState* problem_state,
+    Run* run) {
+  WallTimer timer;
+  timer.Start();
+  run->status = optimizers_[run->optimizer_index]->Optimize(
+      *parameters, *problem_state, &run->learned_info, run->time_limit.get());
+  run->wall_time = timer.Get();
+}
+
+inline BopOptimizerBase::Status BanditPortfolioOptimizer::ProcessRunResult(
+    const ProblemState& problem_state, const Run& run) {
+  switch (run.status) {
+    case BopOptimizerBase::ABORT:
+      // The optimizer can't run on the current state.
+      selector_.TemporarilyMarkOptimizerAsUnselectable(run.optimizer_index);
+      return BopOptimizerBase::CONTINUE;
+    case BopOptimizerBase::LIMIT_REACHED:
+      // In a batch, this is likely the limit of this run only. The caller
+      // checks its own limit.
+      return BopOptimizerBase::CONTINUE;
+    default:
+      return run.status;
+  }
+}
+
+inline int64 BanditPortfolioOptimizer::ComputeGain(
+    const ProblemState& problem_state, const LearnedInfo& learned_info) {
+  int64 gain = 0;
+  if (learned_info.solution.IsFeasible()) {
+    if (!problem_state.solution().IsFeasible()) {
+      gain += 1;
+    } else {
+      gain += std::max(int64{0}, problem_state.solution().GetCost() -
+                                     learned_info.solution.GetCost());
+    }
+  }
+  if (learned_info.lower_bound != kint64min) {
+    gain += std::max(int64{0},
+                     learned_info.lower_bound - problem_state.lower_bound());
+  }
+  return gain;
+}
+
+}  // namespace bop
+}  // namespace operations_research
+
+#endif  // OR_TOOLS_BOP_BOP_BANDIT_PORTFOLIO_H_
@@ -0,0 +1,477 @@
+// Copyright 2010-2014 Google
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#ifndef OR_TOOLS_BOP_BOP_LS_FLAT_H_
+#define OR_TOOLS_BOP_BOP_LS_FLAT_H_
+
+// A flat, cache-friendly alternative to the constraint storage of the
+// AssignmentAndConstraintFeasibilityMaintainer of bop_ls.h, meant for local
+// search on very large problems (e.g. set partitioning with millions of
+// variables) where the evaluation of the flips dominates the running time.
+//
+// The problem is stored twice in compressed sparse row format, once by
+// variable and once by constraint, with all the entries of a column (resp. a
+// row) contiguous in memory. On top of the constraint activities, this class
+// can maintain a score table giving for each variable the decrease of the
+// total violation of the constraints if it were flipped. The table is updated
+// incrementally on each flip by a branch-free loop over the rows of the
+// flipped variable, so that selecting a flip is just a lookup.
+
+#include <algorithm>
+#include <vector>
+
+#include "base/callback.h"
+#include "base/integral_types.h"
+#include "base/logging.h"
+#include "base/threadpool.h"
+#include "bop/bop_solution.h"
+#include "bop/bop_types.h"
+#include "sat/boolean_problem.pb.h"
+#include "util/iterators.h"
+#include "util/stats.h"
+
+namespace operations_research {
+namespace bop {
+
+// Maintains an assignment of all the variables of a LinearBooleanProblem, the
+// activity of all its constraints and the set of the violated ones. Contrary
+// to the AssignmentAndConstraintFeasibilityMaintainer, the objective is not
+// treated as a constraint and the assignment does not need to be feasible: the
+// local search is free to go through infeasible assignments.
+//
+// The violation of a constraint lb <= activity <= ub is the distance from its
+// activity to the interval [lb, ub], and the total violation is the sum of the
+// violations of all the constraints.
+//
+// Like the AssignmentAndConstraintFeasibilityMaintainer, this class is
+// reversible: all the flips since the last AddBacktrackingLevel() can be
+// undone by BacktrackOneLevel().
+class FlatFeasibilityMaintainer {
+ public:
+  explicit FlatFeasibilityMaintainer(const LinearBooleanProblem& problem);
+  ~FlatFeasibilityMaintainer() {
+    IF_STATS_ENABLED({
+      LOG(INFO) << stats_.StatString();
+      LOG(INFO) << "num_flips " << num_flips_;
+    });
+  }
+
+  // If true (the default), the flip scores are maintained incrementally on
+  // each flip. Otherwise, each call to FlipScore() scans the column of the
+  // variable, which is better when only a few flips are evaluated between two
+  // actual flips of variables appearing in long constraints. This must be
+  // called before SetAssignment().
+  void UseScoreTable(bool v) { use_score_table_ = v; }
+
+  // Number of threads used by SetAssignment() and EvaluateFlips(). Note that
+  // each call creates its own thread pool, so this is only worth it for large
+  // batches of candidates.
+  void SetNumThreads(int num_threads) { num_threads_ = num_threads; }
+
+  // Sets the current assignment and recomputes everything from scratch. This
+  // also clears all the backtracking levels.
+  void SetAssignment(const BopSolution& solution);
+
+  // Flips the value of the given variable in the current assignment.
+  void Flip(VariableIndex var);
+
+  // Reversibility, see the class comment.
+  void AddBacktrackingLevel();
+  void BacktrackOneLevel();
+  void BacktrackAll();
+
+  // Returns the value of the given variable in the current assignment.
+  bool Value(VariableIndex var) const { return values_[var.value()]; }
+
+  // Copies the current assignment into the given solution.
+  void ExtractSolution(BopSolution* solution) const;
+
+  // The violated constraints, in no particular order. Note that the indices
+  // are the ones of the constraints in the LinearBooleanProblem.
+  const std::vector<ConstraintIndex>& ViolatedConstraints() const {
+    return violated_constraints_;
+  }
+  bool IsFeasible() const { return violated_constraints_.empty(); }
+  int64 TotalViolation() const { return total_violation_; }
+
+  // Returns the objective value of the current assignment, without the offset
+  // and the scaling factor of the problem (as BopSolution::GetCost()).
+  int64 ObjectiveValue() const { return objective_value_; }
+
+  // Returns by how much the total violation (resp. the objective value)
+  // decreases if the given variable is flipped. A positive score is thus an
+  // improvement.
+  int64 FlipScore(VariableIndex var) const {
+    return use_score_table_ ? scores_[var.value()] : ComputeFlipScore(var);
+  }
+  int64 FlipObjectiveDelta(VariableIndex var) const {
+    return values_[var.value()] ? objective_[var.value()]
+                                : -objective_[var.value()];
+  }
+
+  // Returns the flip score of the given variable by scanning its column. This
+  // does not use the score table.
+  int64 ComputeFlipScore(VariableIndex var) const;
+
+  // Fills scores with the FlipScore() of each candidate, possibly in parallel
+  // (see SetNumThreads()).
+  void EvaluateFlips(const std::vector<VariableIndex>& candidates,
+                     std::vector<int64>* scores) const;
+
+  // Returns the variables of the given constraint. This is useful to select
+  // the variable to flip in a violated constraint.
+  BeginEndWrapper<std::vector<VariableIndex>::const_iterator>
+  ConstraintVariables(ConstraintIndex constraint) const {
+    return BeginEndRange(
+        row_variables_.begin() + row_starts_[constraint.value()],
+        row_variables_.begin() + row_starts_[constraint.value() + 1]);
+  }
+
+  int NumVariables() const { return values_.size(); }
+  int NumConstraints() const { return lower_bounds_.size(); }
+  int64 ConstraintActivity(ConstraintIndex constraint) const {
+    return activities_[constraint.value()];
+  }
+  int64 num_flips() const { return num_flips_; }
+
+ private:
+  int64 Violation(int constraint, int64 activity) const {
+    return std::max(int64{0}, lower_bounds_[constraint] - activity) +
+           std::max(int64{0}, activity - upper_bounds_[constraint]);
+  }
+
+  // Flips the variable without recording it on the trail.
+  void FlipInternal(int var);
+
+  // Sets (*scores)[i] to FlipScore(candidates[i]) for i in [begin, end).
+  void EvaluateFlipsInRange(const std::vector<VariableIndex>* candidates,
+                            int begin, int end,
+                            std::vector<int64>* scores) const;
+
+  void UpdateViolatedSet(int constraint);
+
+  // The constraints by variable. The entries of the variable v are in
+  // [column_starts_[v], column_starts_[v + 1]). For each entry, the position
+  // of the same term in the rows is also stored.
+  std::vector<int> column_starts_;
+  std::vector<int> column_constraints_;
+  std::vector<int64> column_weights_;
+  std::vector<int> column_row_positions_;
+
+  // The variables by constraint. For each term, row_deltas_ is the change of
+  // the constraint activity if its variable is flipped, i.e. its weight if the
+  // variable is false and minus its weight otherwise.
+  std::vector<int> row_starts_;
+  std::vector<VariableIndex> row_variables_;
+  std::vector<int64> row_deltas_;
+
+  // The constraint bounds, after the negated literals were moved to the
+  // bounds. A missing bound is replaced by the extremal activity.
+  std::vector<int64> lower_bounds_;
+  std::vector<int64> upper_bounds_;
+
+  // The objective coefficient of each variable, after the same
+  // transformation, and the constant coming from the negated literals.
+  std::vector<int64> objective_;
+  int64 objective_offset_;
+
+  // The current state.
+  std::vector<bool> values_;
+  std::vector<int64> activities_;
+  std::vector<int64> scores_;
+  int64 total_violation_;
+  int64 objective_value_;
+
+  // The violated constraints, and the position of each constraint in this
+  // vector (or -1) for O(1) insertion and removal.
+  std::vector<ConstraintIndex> violated_constraints_;
+  std::vector<int> violated_positions_;
+
+  // The flipped variables and the trail size at each backtracking level.
+  std::vector<int> trail_;
+  std::vector<int> level_starts_;
+
+  bool use_score_table_;
+  int num_threads_;
+  int64 num_flips_;
+  mutable StatsGroup stats_;
+  DISALLOW_COPY_AND_ASSIGN(FlatFeasibilityMaintainer);
+};
+
+// ============================================================================
+// Implementation.
+// ============================================================================
+
+inline FlatFeasibilityMaintainer::FlatFeasibilityMaintainer(
+    const LinearBooleanProblem& problem)
+    : objective_offset_(0),
+      total_violation_(0),
+      objective_value_(0),
+      use_score_table_(true),
+      num_threads_(1),
+      num_flips_(0),
+      stats_("FlatFeasibilityMaintainer") {
+  const int num_variables = problem.num_variables();
+  const int num_constraints = problem.constraints_size();
+
+  // Build the rows, moving the negated literals to the bounds.
+  row_starts_.assign(1, 0);
+  std::vector<int64> weights;
+  std::vector<int> column_sizes(num_variables + 1, 0);
+  for (const LinearBooleanConstraint& constraint : problem.constraints()) {
+    int64 offset = 0;
+    int64 min_activity = 0;
+    int64 max_activity = 0;
+    for (int i = 0; i < constraint.literals_size(); ++i) {
+      const int literal = constraint.literals(i);
+      const int64 coefficient = constraint.coefficients(i);
+      const int64 weight = literal > 0 ? coefficient : -coefficient;
+      if (literal < 0) offset += coefficient;
+      const int var = std::abs(literal) - 1;
+      row_variables_.push_back(VariableIndex(var));
+      weights.push_back(weight);
+      ++column_sizes[var + 1];
+      (weight > 0 ? max_activity : min_activity) += weight;
+    }
+    row_starts_.push_back(row_variables_.size());
+    lower_bounds_.push_back(constraint.has_lower_bound()
+                                ? constraint.lower_bound() - offset
+                                : min_activity);
+    upper_bounds_.push_back(constraint.has_upper_bound()
+                                ? constraint.upper_bound() - offset
+                                : max_activity);
+  }
+  row_deltas_ = weights;
+
+  // Build the columns by a counting sort of the row entries.
+  column_starts_.assign(num_variables + 1, 0);
+  for (int v = 0; v < num_variables; ++v) {
+    column_starts_[v + 1] = column_starts_[v] + column_sizes[v + 1];
+  }
+  const int num_entries = row_variables_.size();
+  column_constraints_.resize(num_entries);
+  column_weights_.resize(num_entries);
+  column_row_positions_.resize(num_entries);
+  std::vector<int> next_position(column_starts_.begin(),
+                                 column_starts_.end() - 1);
+  for (int c = 0; c < num_constraints; ++c) {
+    for (int i = row_starts_[c]; i < row_starts_[c + 1]; ++i) {
+      const int position = next_position[row_variables_[i].value()]++;
+      column_constraints_[position] = c;
+      column_weights_[position] = weights[i];
+      column_row_positions_[position] = i;
+    }
+  }
+
+  objective_.assign(num_variables, 0);
+  const LinearObjective& objective = problem.objective();
+  for (int i = 0; i < objective.literals_size(); ++i) {
+    const int literal = objective.literals(i);
+    const int var = std::abs(literal) - 1;
+    if (literal > 0) {
+      objective_[var] += objective.coefficients(i);
+    } else {
+      objective_[var] -= objective.coefficients(i);
+      objective_offset_ += objective.coefficients(i);
+    }
+  }
+
+  values_.assign(num_variables, false);
+  activities_.assign(num_constraints, 0);
+  violated_positions_.assign(num_constraints, -1);
+}
+
+inline void FlatFeasibilityMaintainer::SetAssignment(
+    const BopSolution& solution) {
+  SCOPED_TIME_STAT(&stats_);
+  CHECK_EQ(solution.Size(), NumVariables());
+  trail_.clear();
+  level_starts_.clear();
+  objective_value_ = objective_offset_;
+  activities_.assign(NumConstraints(), 0);
+  for (int v = 0; v < NumVariables(); ++v) {
+    const bool value = solution.Value(VariableIndex(v));
+    values_[v] = value;
+    if (value) objective_value_ += objective_[v];
+    for (int i = column_starts_[v]; i < column_starts_[v + 1]; ++i) {
+      const int64 weight = column_weights_[i];
+      row_deltas_[column_row_positions_[i]] = value ? -weight : weight;
+      if (value) activities_[column_constraints_[i]] += weight;
+    }
+  }
+
+  total_violation_ = 0;
+  violated_constraints_.clear();
+  violated_positions_.assign(NumConstraints(), -1);
+  for (int c = 0; c < NumConstraints(); ++c) {
+    total_violation_ += Violation(c, activities_[c]);
+    UpdateViolatedSet(c);
+  }
+
+  // The initial scores are computed by column, which can be done in parallel.
+  if (use_score_table_) {
+    std::vector<VariableIndex> all_variables(NumVariables());
+    for (int v = 0; v < NumVariables(); ++v) {
+      all_variables[v] = VariableIndex(v);
+    }
+    use_score_table_ = false;
+    EvaluateFlips(all_variables, &scores_);
+    use_score_table_ = true;
+  }
+}
+
+inline void FlatFeasibilityMaintainer::Flip(VariableIndex var) {
+  trail_.push_back(var.value());
+  FlipInternal(var.value());
+}
+
+inline void FlatFeasibilityMaintainer::FlipInternal(int var) {
+  ++num_flips_;
+  objective_value_ -= FlipObjectiveDelta(VariableIndex(var));
+  for (int i = column_starts_[var]; i < column_starts_[var + 1]; ++i) {
+    const int c = column_constraints_[i];
+    const int position = column_row_positions_[i];
+    const int64 delta = row_deltas_[position];
+    const int64 old_activity = activities_[c];
+    const int64 new_activity = old_activity + delta;
+    const int64 old_violation = Violation(c, old_activity);
+    const int64 new_violation = Violation(c, new_activity);
+    activities_[c] = new_activity;
+    total_violation_ += new_violation - old_violation;
+    if ((old_violation == 0) != (new_violation == 0)) UpdateViolatedSet(c);
+
+    if (use_score_table_) {
+      // The contribution of this constraint to the score of each of its
+      // variables u is Violation(activity) - Violation(activity + delta_u).
+      // This loop only reads contiguous arrays and has no data-dependent
+      // branches, so that the compiler can vectorize the computation of the
+      // deltas. The variable var itself is treated like the others and then
+      // fixed below since its delta changes sign.
+      const int64 lb = lower_bounds_[c];
+      const int64 ub = upper_bounds_[c];
+      const int end = row_starts_[c + 1];
+      for (int j = row_starts_[c]; j < end; ++j) {
+        const int64 d = row_deltas_[j];
+        const int64 old_after = old_activity + d;
+        const int64 new_after = new_activity + d;
+        const int64 old_after_violation = std::max(int64{0}, lb - old_after) +
+                                          std::max(int64{0}, old_after - ub);
+        const int64 new_after_violation = std::max(int64{0}, lb - new_after) +
+                                          std::max(int64{0}, new_after - ub);
+        scores_[row_variables_[j].value()] +=
+            (new_violation - new_after_violation) -
+            (old_violation - old_after_violation);
+      }
+
+      // Since new_activity - delta = old_activity, the contribution of this
+      // constraint to the score of var is now new_violation - old_violation
+      // instead of new_violation - Violation(new_activity + delta).
+      scores_[var] += Violation(c, new_activity + delta) - old_violation;
+    }
+    row_deltas_[position] = -delta;
+  }
+  values_[var] = !values_[var];
+}
+
+inline void FlatFeasibilityMaintainer::UpdateViolatedSet(int constraint) {
+  const bool is_violated = Violation(constraint, activities_[constraint]) > 0;
+  const int position = violated_positions_[constraint];
+  if (is_violated && position == -1) {
+    violated_positions_[constraint] = violated_constraints_.size();
+    violated_constraints_.push_back(ConstraintIndex(constraint));
+  } else if (!is_violated && position != -1) {
+    const ConstraintIndex last = violated_constraints_.back();
+    violated_constraints_[position] = last;
+    violated_positions_[last.value()] = position;
+    violated_constraints_.pop_back();
+    violated_positions_[constraint] = -1;
+  }
+}
+
+inline void FlatFeasibilityMaintainer::AddBacktrackingLevel() {
+  level_starts_.push_back(trail_.size());
+}
+
+inline void FlatFeasibilityMaintainer::BacktrackOneLevel() {
+  if (level_starts_.empty()) return;
+  const int start = level_starts_.back();
+  level_starts_.pop_back();
+  while (trail_.size() > start) {
+    FlipInternal(trail_.back());
+    trail_.pop_back();
+  }
+}
+
+inline void FlatFeasibilityMaintainer::BacktrackAll() {
+  while (!level_starts_.empty()) BacktrackOneLevel();
+}
+
+inline void FlatFeasibilityMaintainer::ExtractSolution(
+    BopSolution* solution) const {
+  CHECK_EQ(solution->Size(), NumVariables());
+  for (int v = 0; v < NumVariables(); ++v) {
+    solution->SetValue(VariableIndex(v), values_[v]);
+  }
+}
+
+inline int64 FlatFeasibilityMaintainer::ComputeFlipScore(
+    VariableIndex var) const {
+  int64 score = 0;
+  const int v = var.value();
+  for (int i = column_starts_[v]; i < column_starts_[v + 1]; ++i) {
+    const int c = column_constraints_[i];
+    const int64 activity = activities_[c];
+    score += Violation(c, activity) -
+             Violation(c, activity + row_deltas_[column_row_positions_[i]]);
+  }
+  return score;
+}
+
+inline void FlatFeasibilityMaintainer::EvaluateFlips(
+    const std::vector<VariableIndex>& candidates,
+    std::vector<int64>* scores) const {
+  SCOPED_TIME_STAT(&stats_);
+  const int num_candidates = candidates.size();
+  scores->resize(num_candidates);
+
+  // Below this size, the cost of starting the threads is not worth it.
+  const int kMinCandidatesPerThread = 1024;
+  const int num_threads =
+      std::min(num_threads_, num_candidates / kMinCandidatesPerThread);
+  if (num_threads <= 1) {
+    EvaluateFlipsInRange(&candidates, 0, num_candidates, scores);
+    return;
+  }
+  ThreadPool pool("FlatFeasibilityMaintainer", num_threads);
+  pool.StartWorkers();
+  const int chunk_size = (num_candidates + num_threads - 1) / num_threads;
+  for (int begin = 0; begin < num_candidates; begin += chunk_size) {
+    pool.Add(NewCallback(this, &FlatFeasibilityMaintainer::EvaluateFlipsInRange,
+                         &candidates, begin,
+                         std::min(begin + chunk_size, num_candidates),
+                         scores));
+  }
+}
+
+inline void FlatFeasibilityMaintainer::EvaluateFlipsInRange(
+    const std::vector<VariableIndex>* candidates, int begin, int end,
+    std::vector<int64>* scores) const {
+  for (int i = begin; i < end; ++i) {
+    (*scores)[i] = FlipScore((*candidates)[i]);
+  }
+}
+
+}  // namespace bop
+}  // namespace operations_research
+
+#endif  // OR_TOOLS_BOP_BOP_LS_FLAT_H_
@@ -0,0 +1,583 @@
+// Copyright 2010-2014 Google
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#ifndef OR_TOOLS_BOP_BOP_SHARED_STATE_H_
+#define OR_TOOLS_BOP_BOP_SHARED_STATE_H_
+
+// Multi-threaded BOP where each thread runs its own PortfolioOptimizer on its
+// own ProblemState, and where the learned information is exchanged through a
+// shared hub:
+// - In the asynchronous mode (NO_SYNCHRONIZATION), the workers publish their
+//   solutions, fixed literals and binary clauses to a lock-free
+//   BopSharedState as soon as they are learned, and pull the new ones before
+//   each optimizer selected by their portfolio is run.
+// - In the deterministic mode (any other synchronization type), the exchanges
+//   are batched: each worker only exchanges its information at fixed
+//   intervals of its own deterministic time, with all the other workers, and
+//   in a fixed order. The result is thus reproducible (as long as no wall time
+//   limit is reached).
+
+#include <atomic>
+#include <memory>
+#include <string>
+#include <vector>
+
+#include "base/callback.h"
+#include "base/integral_types.h"
+#include "base/join.h"
+#include "base/logging.h"
+#include "base/mutex.h"
+#include "base/threadpool.h"
+#include "google/protobuf/text_format.h"
+#include "bop/bop_base.h"
+#include "bop/bop_parameters.pb.h"
+#include "bop/bop_portfolio.h"
+#include "bop/bop_solution.h"
+#include "bop/bop_types.h"
+#include "sat/boolean_problem.pb.h"
+#include "sat/clause.h"
+#include "util/time_limit.h"
+
+namespace operations_research {
+namespace bop {
+
+// The shared and versioned state of the problem. All the published fixed
+// literals and binary clauses are stored in an append-only log: a publisher
+// reserves a slot with an atomic increment of the sequence number, fills it
+// and marks it as ready. A reader remembers the sequence number up to which
+// it has read and only looks at the newer slots. The best solution and the
+// lower bound are updated with compare-and-swap loops.
+//
+// All the functions are thread-safe and no lock is ever taken. Note that the
+// log has a bounded capacity, after which the new entries are dropped (which
+// is always safe since they are just redundant information).
+class BopSharedState {
+ public:
+  explicit BopSharedState(const LinearBooleanProblem& problem);
+  ~BopSharedState();
+
+  // Publishes all the information of the given learned info. The solution is
+  // only published if it is feasible and better than the best one.
+  void Publish(const LearnedInfo& learned_info);
+
+  // Fills learned_info with all the information published since the given
+  // sequence number, and updates it. Returns false if nothing new was found.
+  // Note that learned_info is not cleared first.
+  bool PullNewInformation(int64* sequence, const BopSolution** last_solution,
+                          LearnedInfo* learned_info) const;
+
+  // Marks the search as finished (the problem is solved or infeasible). The
+  // workers poll IsDone() between two optimizer calls.
+  void MarkAsDone() { done_.store(true, std::memory_order_release); }
+  bool IsDone() const { return done_.load(std::memory_order_acquire); }
+
+  int64 lower_bound() const { return lower_bound_.load(); }
+  int64 num_published_entries() const { return num_reserved_.load(); }
+  int64 num_dropped_entries() const {
+    return std::max<int64>(0, num_reserved_.load() - kCapacity);
+  }
+
+ private:
+  struct Entry {
+    std::atomic<bool> ready;
+    bool is_binary_clause;
+    sat::Literal a;
+    sat::Literal b;
+  };
+  struct SolutionNode {
+    SolutionNode(const BopSolution& s, int64 c)
+        : solution(s), cost(c), next(nullptr) {}
+    const BopSolution solution;
+    const int64 cost;
+    SolutionNode* next;
+  };
+
+  static const int kChunkSize = 1 << 12;
+  static const int kMaxNumChunks = 1 << 10;
+  static const int64 kCapacity = static_cast<int64>(kChunkSize) * kMaxNumChunks;
+
+  void PublishEntry(bool is_binary_clause, sat::Literal a, sat::Literal b);
+  Entry* GetOrCreateChunk(int chunk_index);
+
+  const LinearBooleanProblem& problem_;
+  std::atomic<int64> num_reserved_;
+  std::atomic<Entry*> chunks_[kMaxNumChunks];
+  std::atomic<int64> lower_bound_;
+
+  // best_solution_ points to the best of all the published solutions. They
+  // are all kept in the all_solutions_ list until destruction, so a reader
+  // never sees a deleted solution.
+  std::atomic<SolutionNode*> best_solution_;
+  std::atomic<SolutionNode*> all_solutions_;
+
+  // Only goes from false to true.
+  std::atomic<bool> done_;
+
+  DISALLOW_COPY_AND_ASSIGN(BopSharedState);
+};
+
+// Multi-threaded solver of Boolean Optimization Problems. It uses
+// parameters.number_of_solvers() workers, the worker i using the optimizer
+// set parameters.solver_optimizer_sets(i) if it exists, or the default one
+// otherwise.
+class BopSharedStateSolver {
+ public:
+  explicit BopSharedStateSolver(const LinearBooleanProblem& problem);
+  ~BopSharedStateSolver();
+
+  void SetParameters(const BopParameters& parameters) {
+    parameters_ = parameters;
+  }
+
+  // In the deterministic mode, the workers exchange their information each
+  // time their deterministic time increases by this amount.
+  void set_deterministic_synchronization_period(double period) {
+    synchronization_period_ = period;
+  }
+
+  BopSolveStatus SolveWithTimeLimit(TimeLimit* time_limit);
+
+  // Results. They are only valid after a solve.
+  const BopSolution& best_solution() const { return problem_state_.solution(); }
+  double GetScaledBestBound() const {
+    return problem_state_.GetScaledLowerBound();
+  }
+
+ private:
+  struct Worker {
+    Worker(const LinearBooleanProblem& problem, int i)
+        : id(i),
+          problem_state(problem),
+          learned_info(problem),
+          sequence(0),
+          last_solution(nullptr),
+          outbox(problem),
+          next_synchronization_time(0.0) {}
+    const int id;
+    BopParameters parameters;
+    ProblemState problem_state;
+    std::unique_ptr<PortfolioOptimizer> portfolio;
+    std::unique_ptr<TimeLimit> time_limit;
+    LearnedInfo learned_info;
+
+    // Asynchronous mode: the position in the shared state.
+    int64 sequence;
+    const BopSolution* last_solution;
+
+    // Deterministic mode: the information learned since the last exchange.
+    LearnedInfo outbox;
+    double next_synchronization_time;
+  };
+
+  // Runs the given worker until the problem is solved or its time limit is
+  // reached.
+  void RunWorker(Worker* worker);
+
+  // Merges the given learned info in the problem state of the worker, and
+  // returns false if the search is finished.
+  bool MergeIntoWorker(const LearnedInfo& learned_info,
+                       BopOptimizerBase::Status status, Worker* worker);
+
+  // Deterministic mode: waits for all the (still running) workers to reach
+  // their synchronization point, and merges all their outboxes in the id
+  // order. Returns false if the search is finished.
+  bool SynchronizeDeterministically(Worker* worker);
+
+  // Blocks until all the active workers called it. If leave is true, the
+  // worker is not waited for anymore by the next calls.
+  void WaitForOtherWorkers(bool leave);
+
+  const LinearBooleanProblem& problem_;
+  ProblemState problem_state_;
+  BopParameters parameters_;
+  double synchronization_period_;
+  bool deterministic_;
+
+  std::unique_ptr<BopSharedState> shared_state_;
+  std::vector<std::unique_ptr<Worker>> workers_;
+
+  // Deterministic mode synchronization. The outboxes of the workers are
+  // published in published_[id] between the two calls to
+  // WaitForOtherWorkers() of a synchronization.
+  Mutex mutex_;
+  CondVar condition_;
+  int num_active_workers_ GUARDED_BY(mutex_);
+  int num_waiting_workers_ GUARDED_BY(mutex_);
+  int64 barrier_generation_ GUARDED_BY(mutex_);
+  bool deterministic_done_;
+  std::vector<const LearnedInfo*> published_;
+
+  DISALLOW_COPY_AND_ASSIGN(BopSharedStateSolver);
+};
+
+// ============================================================================
+// Implementation.
+// ============================================================================
+
+inline BopSharedState::BopSharedState(const LinearBooleanProblem& problem)
+    : problem_(problem),
+      num_reserved_(0),
+      lower_bound_(kint64min),
+      best_solution_(nullptr),
+      all_solutions_(nullptr),
+      done_(false) {
+  for (int i = 0; i < kMaxNumChunks; ++i) chunks_[i].store(nullptr);
+}
+
+inline BopSharedState::~BopSharedState() {
+  for (int i = 0; i < kMaxNumChunks; ++i) delete[] chunks_[i].load();
+  SolutionNode* node = all_solutions_.load();
+  while (node != nullptr) {
+    SolutionNode* next = node->next;
+    delete node;
+    node = next;
+  }
+}
+
+inline BopSharedState::Entry* BopSharedState::GetOrCreateChunk(
+    int chunk_index) {
+  Entry* chunk = chunks_[chunk_index].load(std::memory_order_acquire);
+  if (chunk != nullptr) return chunk;
+  Entry* new_chunk = new Entry[kChunkSize]();
+  if (chunks_[chunk_index].compare_exchange_strong(
+          chunk, new_chunk, std::memory_order_acq_rel,
+          std::memory_order_acquire)) {
+    return new_chunk;
+  }
+  // Another publisher created it first.
+  delete[] new_chunk;
+  return chunk;
+}
+
+inline void BopSharedState::PublishEntry(bool is_binary_clause, sat::Literal a,
+                                         sat::Literal b) {
+  const int64 index = num_reserved_.fetch_add(1, std::memory_order_relaxed);
+  if (index >= kCapacity) return;
+  Entry* entry = &GetOrCreateChunk(index / kChunkSize)[index % kChunkSize];
+  entry->is_binary_clause = is_binary_clause;
+  entry->a = a;
+  entry->b = b;
+  entry->ready.store(true, std::memory_order_release);
+}
+
+inline void BopSharedState::Publish(const LearnedInfo& learned_info) {
+  for (const sat::Literal literal : learned_info.fixed_literals) {
+    PublishEntry(false, literal, literal);
+  }
+  for (const sat::BinaryClause& clause : learned_info.binary_clauses) {
+    PublishEntry(true, clause.a, clause.b);
+  }
+
+  int64 lower_bound = lower_bound_.load(std::memory_order_relaxed);
+  while (learned_info.lower_bound > lower_bound &&
+         !lower_bound_.compare_exchange_weak(lower_bound,
+                                             learned_info.lower_bound)) {
+  }
+
+  // Note that IsFeasible() and GetCost() are computed here, so the readers of
+  // the stored copy never modify its cached values.
+  const BopSolution& solution = learned_info.solution;
+  if (!solution.IsFeasible()) return;
+  const int64 cost = solution.GetCost();
+  SolutionNode* best = best_solution_.load(std::memory_order_acquire);
+  if (best != nullptr && best->cost <= cost) return;
+  SolutionNode* node = new SolutionNode(solution, cost);
+  node->next = all_solutions_.load(std::memory_order_relaxed);
+  while (!all_solutions_.compare_exchange_weak(node->next, node,
+                                               std::memory_order_release,
+                                               std::memory_order_relaxed)) {
+  }
+  while (best == nullptr || cost < best->cost) {
+    if (best_solution_.compare_exchange_weak(best, node,
+                                             std::memory_order_acq_rel,
+                                             std::memory_order_acquire)) {
+      break;
+    }
+  }
+}
+
+inline bool BopSharedState::PullNewInformation(
+    int64* sequence, const BopSolution** last_solution,
+    LearnedInfo* learned_info) const {
+  bool found = false;
+  const int64 end = std::min(
+      num_reserved_.load(std::memory_order_acquire), kCapacity);
+  int64 index = *sequence;
+  for (; index < end; ++index) {
+    const Entry* chunk =
+        chunks_[index / kChunkSize].load(std::memory_order_acquire);
+    if (chunk == nullptr) break;
+    const Entry& entry = chunk[index % kChunkSize];
+
+    // This slot is reserved but not yet filled, we will resume from here.
+    if (!entry.ready.load(std::memory_order_acquire)) break;
+    if (entry.is_binary_clause) {
+      learned_info->binary_clauses.push_back(
+          sat::BinaryClause(entry.a, entry.b));
+    } else {
+      learned_info->fixed_literals.push_back(entry.a);
+    }
+    found = true;
+  }
+  *sequence = index;
+
+  const int64 lower_bound = lower_bound_.load(std::memory_order_relaxed);
+  if (lower_bound > learned_info->lower_bound) {
+    learned_info->lower_bound = lower_bound;
+    found = true;
+  }
+  const SolutionNode* best = best_solution_.load(std::memory_order_acquire);
+  if (best != nullptr && &best->solution != *last_solution) {
+    *last_solution = &best->solution;
+    learned_info->solution = best->solution;
+    found = true;
+  }
+  return found;
+}
+
+inline BopSharedStateSolver::BopSharedStateSolver(
+    const LinearBooleanProblem& problem)
+    : problem_(problem),
+      problem_state_(problem),
+      synchronization_period_(0.1),
+      deterministic_(false),
+      num_active_workers_(0),
+      num_waiting_workers_(0),
+      barrier_generation_(0),
+      deterministic_done_(false) {}
+
+inline BopSharedStateSolver::~BopSharedStateSolver() {}
+
+inline BopSolveStatus BopSharedStateSolver::SolveWithTimeLimit(
+    TimeLimit* time_limit) {
+  problem_state_.SetParameters(parameters_);
+  deterministic_ = parameters_.synchronization_type() !=
+                   BopParameters::NO_SYNCHRONIZATION;
+  shared_state_.reset(new BopSharedState(problem_));
+  deterministic_done_ = false;
+
+  const int num_workers = std::max(1, parameters_.number_of_solvers());
+  workers_.clear();
+  published_.assign(num_workers, nullptr);
+  num_active_workers_ = num_workers;
+  num_waiting_workers_ = 0;
+  for (int i = 0; i < num_workers; ++i) {
+    workers_.emplace_back(new Worker(problem_, i));
+    Worker* worker = workers_.back().get();
+    worker->parameters = parameters_;
+    worker->parameters.set_random_seed(parameters_.random_seed() + i);
+    worker->problem_state.SetParameters(worker->parameters);
+    BopSolverOptimizerSet optimizer_set;
+    if (i < parameters_.solver_optimizer_sets_size()) {
+      optimizer_set = parameters_.solver_optimizer_sets(i);
+    } else {
+      CHECK(google::protobuf::TextFormat::ParseFromString(
+          parameters_.default_solver_optimizer_sets(), &optimizer_set));
+    }
+    worker->portfolio.reset(new PortfolioOptimizer(
+        worker->problem_state, worker->parameters, optimizer_set,
+        StrCat("Portfolio_", i)));
+
+    // Each worker has its own time limit since the deterministic time is not
+    // shared.
+    worker->time_limit.reset(new TimeLimit(
+        std::min(parameters_.max_time_in_seconds(), time_limit->GetTimeLeft()),
+        std::min(parameters_.max_deterministic_time(),
+                 time_limit->GetDeterministicTimeLeft())));
+
+    // The other workers read the outbox solution concurrently, so its cached
+    // values must be computed before they can see it.
+    worker->outbox.solution.IsFeasible();
+    worker->outbox.solution.GetCost();
+  }
+
+  {
+    ThreadPool pool("BopSharedStateSolver", num_workers);
+    pool.StartWorkers();
+    for (int i = 0; i < num_workers; ++i) {
+      pool.Add(NewCallback(this, &BopSharedStateSolver::RunWorker,
+                           workers_[i].get()));
+    }
+  }
+
+  // Collect the results of all the workers.
+  double max_deterministic_time = 0.0;
+  for (const std::unique_ptr<Worker>& worker : workers_) {
+    max_deterministic_time =
+        std::max(max_deterministic_time,
+                 worker->time_limit->GetElapsedDeterministicTime());
+    if (worker->problem_state.IsInfeasible()) {
+      problem_state_.MarkAsInfeasible();
+      continue;
+    }
+    LearnedInfo learned_info(problem_);
+    learned_info.solution = worker->problem_state.solution();
+    learned_info.lower_bound = worker->problem_state.lower_bound();
+    problem_state_.MergeLearnedInfo(learned_info,
+                                    BopOptimizerBase::INFORMATION_FOUND);
+  }
+  time_limit->AdvanceDeterministicTime(max_deterministic_time);
+
+  if (problem_state_.IsInfeasible()) return BopSolveStatus::INFEASIBLE_PROBLEM;
+  if (!problem_state_.solution().IsFeasible()) {
+    return BopSolveStatus::NO_SOLUTION_FOUND;
+  }
+  return problem_state_.IsOptimal() ? BopSolveStatus::OPTIMAL_SOLUTION_FOUND
+                                    : BopSolveStatus::FEASIBLE_SOLUTION_FOUND;
+}
+
+inline bool BopSharedStateSolver::MergeIntoWorker(
+    const LearnedInfo& learned_info, BopOptimizerBase::Status status,
+    Worker* worker) {
+  worker->problem_state.MergeLearnedInfo(learned_info, status);
+  return !worker->problem_state.IsOptimal() &&
+         !worker->problem_state.IsInfeasible();
+}
+
+inline void BopSharedStateSolver::RunWorker(Worker* worker) {
+  TimeLimit* time_limit = worker->time_limit.get();
+  LearnedInfo pulled_info(problem_);
+  bool running = true;
+  while (running && !time_limit->LimitReached()) {
+    // Stop as soon as another worker solved the problem.
+    if (!deterministic_ && shared_state_->IsDone()) break;
+
+    // Exchange the information with the other workers.
+    if (deterministic_) {
+      if (time_limit->GetElapsedDeterministicTime() >=
+          worker->next_synchronization_time) {
+        worker->next_synchronization_time += synchronization_period_;
+        if (!SynchronizeDeterministically(worker)) break;
+      }
+    } else {
+      pulled_info.Clear();
+      if (shared_state_->PullNewInformation(
+              &worker->sequence, &worker->last_solution, &pulled_info) &&
+          !MergeIntoWorker(pulled_info, BopOptimizerBase::INFORMATION_FOUND,
+                           worker)) {
+        break;
+      }
+    }
+
+    // Run one optimizer selected by the portfolio.
+    worker->learned_info.Clear();
+    const BopOptimizerBase::Status status = worker->portfolio->Optimize(
+        worker->parameters, worker->problem_state, &worker->learned_info,
+        time_limit);
+    if (status == BopOptimizerBase::INFEASIBLE) {
+      worker->problem_state.MarkAsInfeasible();
+    } else if (status == BopOptimizerBase::OPTIMAL_SOLUTION_FOUND) {
+      MergeIntoWorker(worker->learned_info, status, worker);
+      worker->problem_state.MarkAsOptimal();
+    } else {
+      running = MergeIntoWorker(worker->learned_info, status, worker);
+    }
+    const bool solved = worker->problem_state.IsInfeasible() ||
+                        worker->problem_state.IsOptimal();
+    if (solved) running = false;
+
+    // Publish what was learned.
+    if (deterministic_) {
+      LearnedInfo* outbox = &worker->outbox;
+      const LearnedInfo& info = worker->learned_info;
+      outbox->fixed_literals.insert(outbox->fixed_literals.end(),
+                                    info.fixed_literals.begin(),
+                                    info.fixed_literals.end());
+      outbox->binary_clauses.insert(outbox->binary_clauses.end(),
+                                    info.binary_clauses.begin(),
+                                    info.binary_clauses.end());
+      outbox->lower_bound = worker->problem_state.lower_bound();
+      outbox->solution = worker->problem_state.solution();
+
+      // Computes the cached values now, so that the other workers can read
+      // them concurrently.
+      outbox->solution.IsFeasible();
+      outbox->solution.GetCost();
+    } else {
+      worker->learned_info.solution = worker->problem_state.solution();
+      worker->learned_info.lower_bound = worker->problem_state.lower_bound();
+      shared_state_->Publish(worker->learned_info);
+    }
+    if (solved) {
+      if (deterministic_) {
+        deterministic_done_ = true;
+      } else {
+        shared_state_->MarkAsDone();
+      }
+    }
+    if (status == BopOptimizerBase::ABORT) running = false;
+  }
+
+  // Publish the final state of this worker one last time, and leave.
+  if (deterministic_) {
+    SynchronizeDeterministically(worker);
+    WaitForOtherWorkers(/*leave=*/true);
+  }
+}
+
+inline void BopSharedStateSolver::WaitForOtherWorkers(bool leave) {
+  MutexLock lock(&mutex_);
+  if (leave) {
+    --num_active_workers_;
+  } else {
+    ++num_waiting_workers_;
+  }
+  if (num_waiting_workers_ >= num_active_workers_) {
+    num_waiting_workers_ = 0;
+    ++barrier_generation_;
+    condition_.SignalAll();
+    return;
+  }
+  if (leave) return;
+  const int64 generation = barrier_generation_;
+  while (generation == barrier_generation_) condition_.Wait(&mutex_);
+}
+
+inline bool BopSharedStateSolver::SynchronizeDeterministically(
+    Worker* worker) {
+  published_[worker->id] = &worker->outbox;
+  WaitForOtherWorkers(/*leave=*/false);
+
+  // Merge all the other outboxes in the id order. Note that a worker that
+  // already left still has its last outbox published.
+  LearnedInfo merged_info(problem_);
+  for (int i = 0; i < published_.size(); ++i) {
+    if (i == worker->id || published_[i] == nullptr) continue;
+    const LearnedInfo& info = *published_[i];
+    merged_info.fixed_literals.insert(merged_info.fixed_literals.end(),
+                                      info.fixed_literals.begin(),
+                                      info.fixed_literals.end());
+    merged_info.binary_clauses.insert(merged_info.binary_clauses.end(),
+                                      info.binary_clauses.begin(),
+                                      info.binary_clauses.end());
+    merged_info.lower_bound =
+        std::max(merged_info.lower_bound, info.lower_bound);
+    if (info.solution.IsFeasible() &&
+        (!merged_info.solution.IsFeasible() ||
+         info.solution.GetCost() < merged_info.solution.GetCost())) {
+      merged_info.solution = info.solution;
+    }
+  }
+  const bool done = deterministic_done_;
+
+  // Nobody must modify its outbox before all the others read it.
+  WaitForOtherWorkers(/*leave=*/false);
+  worker->outbox.Clear();
+  return MergeIntoWorker(merged_info, BopOptimizerBase::INFORMATION_FOUND,
+                         worker) &&
+         !done;
+}
+
+}  // namespace bop
+}  // namespace operations_research
+#endif  // OR_TOOLS_BOP_BOP_SHARED_STATE_H_
@@ -0,0 +1,1250 @@
+// Copyright 2010-2014 Google
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+// Integer-aware presolve of a mixed integer linear program, meant to be run
+// before the IntegralSolver (and thus before the BopSolver it builds on).
+//
+// The glop preprocessors (see glop/preprocessor.h) only preserve the set of
+// optimal solutions of the LP relaxation and can't be used on a MIP. The
+// reductions below preserve the set of feasible integer solutions instead (up
+// to the postsolve), and they exploit the integrality:
+// - Bound propagation with rounding of the bounds of the integer variables,
+//   removal of the redundant rows and of the fixed columns.
+// - Coefficient tightening of the binary variables in one-sided rows.
+// - Clique detection: the knapsack rows on binary variables are turned into
+//   set packing rows when they are equivalent, or a clique row is extracted
+//   from them, and the set packing rows dominated by another clique are
+//   removed.
+// - Dominated columns: a column whose objective pushes it towards a bound
+//   that no row prevents it to reach is fixed to this bound (dual fixing).
+// - Removal of the continuous columns with no cost that appear in only one
+//   row: they are slack variables of the row, whose bounds are relaxed.
+// - Probing on the binary variables: each value is propagated, which can fix
+//   the variable or tighten the bounds implied by both values.
+// - Implied integers: the continuous variable of an equality row whose other
+//   terms and right hand side are integral is marked as integer.
+//
+// The transformations that remove columns are kept on a postsolve stack which
+// is replayed in reverse order by RecoverSolution(), similarly to what
+// glop::MainLpPreprocessor does with its list of preprocessors.
+//
+// A classical reference is:
+// T. Achterberg, R. E. Bixby, Z. Gu, E. Rothberg, D. Weninger, "Presolve
+// Reductions in Mixed Integer Programming.", ZIB-Report 16-44 (2016).
+
+#ifndef OR_TOOLS_BOP_MIP_PRESOLVE_H_
+#define OR_TOOLS_BOP_MIP_PRESOLVE_H_
+
+#include <algorithm>
+#include <cmath>
+#include <memory>
+#include <string>
+#include <utility>
+#include <vector>
+
+#include "base/integral_types.h"
+#include "base/logging.h"
+#include "base/macros.h"
+#include "base/port.h"
+#include "base/stringprintf.h"
+#include "bop/bop_parameters.pb.h"
+#include "bop/bop_types.h"
+#include "bop/integral_solver.h"
+#include "lp_data/lp_data.h"
+#include "lp_data/lp_types.h"
+#include "util/time_limit.h"
+
+namespace operations_research {
+namespace bop {
+
+// Options of the MipPresolver. Each reduction can be disabled individually.
+struct MipPresolveOptions {
+  MipPresolveOptions()
+      : max_num_rounds(10),
+        use_coefficient_tightening(true),
+        use_clique_detection(true),
+        use_dual_fixing(true),
+        use_slack_column_removal(true),
+        use_probing(true),
+        use_implied_integers(true),
+        max_num_added_cliques(100000),
+        max_num_probed_variables(10000),
+        max_work(200000000),
+        tolerance(1e-9),
+        integrality_tolerance(1e-6) {}
+
+  // Number of rounds of the cheap reductions. The rounds stop as soon as one
+  // of them doesn't reduce the problem.
+  int max_num_rounds;
+
+  bool use_coefficient_tightening;
+  bool use_clique_detection;
+  bool use_dual_fixing;
+  bool use_slack_column_removal;
+  bool use_probing;
+  bool use_implied_integers;
+
+  // Maximum number of clique rows added to the problem.
+  int max_num_added_cliques;
+
+  // Maximum number of binary variables to probe. The ones appearing in the
+  // largest number of rows are probed first.
+  int max_num_probed_variables;
+
+  // Limit on the number of matrix entries visited by the bound propagation
+  // (during each call), by the probing and by the detection of the dominated
+  // cliques. This bounds the time spent on big problems.
+  int64 max_work;
+
+  // Tolerance used on the comparisons of the bounds and activities.
+  double tolerance;
+
+  // Tolerance used when rounding the bounds of the integer variables.
+  double integrality_tolerance;
+};
+
+// The number of reductions done by each step of the presolve.
+struct MipPresolveStats {
+  MipPresolveStats()
+      : num_removed_rows(0),
+        num_fixed_columns(0),
+        num_removed_slack_columns(0),
+        num_tightened_bounds(0),
+        num_tightened_coefficients(0),
+        num_set_packing_rows(0),
+        num_added_cliques(0),
+        num_dominated_cliques(0),
+        num_dual_fixings(0),
+        num_probing_fixings(0),
+        num_probing_implied_bounds(0),
+        num_implied_integers(0) {}
+
+  int64 num_removed_rows;
+  int64 num_fixed_columns;
+  int64 num_removed_slack_columns;
+  int64 num_tightened_bounds;
+  int64 num_tightened_coefficients;
+  int64 num_set_packing_rows;
+  int64 num_added_cliques;
+  int64 num_dominated_cliques;
+  int64 num_dual_fixings;
+  int64 num_probing_fixings;
+  int64 num_probing_implied_bounds;
+  int64 num_implied_integers;
+
+  // Returns the total number of reductions. Used to detect a fixed point.
+  int64 NumReductions() const;
+  std::string DebugString() const;
+};
+
+// Presolves a MIP given as a glop::LinearProgram into a smaller one.
+//
+// Usage:
+//   MipPresolver presolver;
+//   glop::LinearProgram presolved;
+//   if (!presolver.Run(linear_program, time_limit, &presolved)) {
+//     // The problem is infeasible.
+//   }
+//   ... solve presolved ...
+//   presolver.RecoverSolution(presolved_solution, &solution);
+//
+// The presolved problem has the same objective value as the original one for
+// a solution and its recovered counterpart (the objective of the fixed
+// columns is moved into the objective offset).
+class MipPresolver {
+ public:
+  MipPresolver();
+
+  void SetOptions(const MipPresolveOptions& options) { options_ = options; }
+
+  // Presolves the given problem. Returns false if the problem was proven
+  // infeasible, in which case presolved is not modified. Otherwise presolved
+  // contains the reduced problem. The time limit can be nullptr.
+  bool Run(const glop::LinearProgram& linear_program, TimeLimit* time_limit,
+           glop::LinearProgram* presolved) MUST_USE_RESULT;
+
+  // Computes a solution of the original problem from a solution of the
+  // presolved problem. A feasible presolved solution gives a feasible
+  // solution (up to the tolerances) with the same objective value.
+  void RecoverSolution(const glop::DenseRow& presolved_values,
+                       glop::DenseRow* values) const;
+
+  const MipPresolveStats& stats() const { return stats_; }
+
+ private:
+  struct Entry {
+    Entry(int c, double v) : col(c), coefficient(v) {}
+    int col;
+    double coefficient;
+  };
+
+  // A step of the postsolve stack. It restores the value of a removed column.
+  struct PostsolveStep {
+    enum Type { FIX_COLUMN, SLACK_COLUMN };
+    Type type;
+    int col;
+
+    // The value of a fixed column.
+    double value;
+
+    // For a slack column, the row it was removed from, at the time of the
+    // removal: its bounds, the coefficient of the column and the other
+    // entries. The value of the column is chosen in [col_lb, col_ub] so that
+    // the row is satisfied.
+    double coefficient;
+    double row_lb;
+    double row_ub;
+    double col_lb;
+    double col_ub;
+    std::vector<Entry> row_entries;
+  };
+
+  // The bounds on the activity of a row, with the number of infinite terms.
+  struct Activity {
+    double min;
+    double max;
+    int num_min_infinite;
+    int num_max_infinite;
+  };
+
+  void LoadProblem(const glop::LinearProgram& linear_program);
+  void BuildPresolvedProblem(glop::LinearProgram* presolved);
+
+  bool IsInteger(int col) const { return is_integer_[col]; }
+  bool IsBinary(int col) const {
+    return is_integer_[col] && col_lb_[col] == 0.0 && col_ub_[col] == 1.0;
+  }
+  double Tolerance(double value) const {
+    return options_.tolerance * std::max(1.0, std::abs(value));
+  }
+  bool LimitReached(TimeLimit* time_limit) const {
+    return time_limit != nullptr && time_limit->LimitReached();
+  }
+
+  // Rounds the bounds of the integer columns. Returns false if a domain
+  // becomes empty.
+  bool RoundIntegerBounds();
+
+  // Removes a row, or fixes a column and removes it from its rows.
+  void RemoveRow(int row);
+  void FixColumn(int col, double value);
+
+  // Recomputes col_rows_, which may contain rows that no longer contain the
+  // column after the rows or entries removals.
+  void RebuildColumnLists();
+
+  void ComputeActivity(int row, const std::vector<double>& lb,
+                       const std::vector<double>& ub,
+                       Activity* activity) const;
+
+  // Propagates the rows in row_queue_ on the given bounds, until the queue is
+  // empty or *work exceeds options_.max_work. The columns whose bounds change
+  // are appended to modified_columns and their rows are enqueued. Returns
+  // false if a row or a domain is found infeasible.
+  bool PropagateRows(std::vector<double>* lb, std::vector<double>* ub,
+                     std::vector<int>* modified_columns, int64* work);
+  bool TightenLowerBound(int col, double value, bool small_improvement_ok,
+                         std::vector<double>* lb, std::vector<double>* ub,
+                         std::vector<int>* modified_columns);
+  bool TightenUpperBound(int col, double value, bool small_improvement_ok,
+                         std::vector<double>* lb, std::vector<double>* ub,
+                         std::vector<int>* modified_columns);
+  double MinImprovement(int col, double bound, bool small_improvement_ok) const;
+  void EnqueueRowsOfColumn(int col);
+
+  // The reductions. The ones returning a bool return false if the problem is
+  // proven infeasible.
+  bool PropagateAllRows();
+  bool RemoveFixedColumnsAndRedundantRows();
+  bool DetectImpliedIntegers();
+  void TightenCoefficients();
+  void DualFixing();
+  void RemoveSlackColumns();
+  void DetectCliques();
+  void RemoveDominatedCliques();
+  bool Probe(TimeLimit* time_limit);
+
+  MipPresolveOptions options_;
+  MipPresolveStats stats_;
+
+  // The problem being presolved. The rows and columns are never renumbered:
+  // they are only flagged as removed.
+  std::string name_;
+  bool maximize_;
+  double objective_offset_;
+  int num_original_cols_;
+  std::vector<double> col_lb_;
+  std::vector<double> col_ub_;
+  std::vector<double> objective_;
+  std::vector<bool> is_integer_;
+  std::vector<bool> col_removed_;
+  std::vector<std::string> col_names_;
+  std::vector<double> row_lb_;
+  std::vector<double> row_ub_;
+  std::vector<bool> row_removed_;
+  std::vector<std::string> row_names_;
+  std::vector<std::vector<Entry>> rows_;
+  std::vector<std::vector<int>> col_rows_;
+
+  // The propagation queue.
+  std::vector<int> row_queue_;
+  std::vector<bool> in_queue_;
+
+  // The postsolve stack, and the original index of each presolved column.
+  std::vector<PostsolveStep> postsolve_stack_;
+  std::vector<int> presolved_to_original_col_;
+
+  DISALLOW_COPY_AND_ASSIGN(MipPresolver);
+};
+
+// Same interface as IntegralSolver, but the problem is presolved with a
+// MipPresolver first and the solution is mapped back to the original problem.
+class PresolvedIntegralSolver {
+ public:
+  PresolvedIntegralSolver();
+
+  void SetParameters(const BopParameters& parameters) {
+    parameters_ = parameters;
+  }
+  void SetPresolveOptions(const MipPresolveOptions& options) {
+    presolve_options_ = options;
+  }
+
+  BopSolveStatus Solve(const glop::LinearProgram& linear_problem)
+      MUST_USE_RESULT;
+  BopSolveStatus SolveWithTimeLimit(const glop::LinearProgram& linear_problem,
+                                    TimeLimit* time_limit) MUST_USE_RESULT;
+
+  // Same as the IntegralSolver accessors. The values are the ones of the
+  // original problem.
+  glop::Fractional objective_value() const { return objective_value_; }
+  glop::Fractional best_bound() const { return best_bound_; }
+  const glop::DenseRow& variable_values() const { return variable_values_; }
+
+  // The reductions done by the last presolve.
+  const MipPresolveStats& presolve_stats() const { return presolve_stats_; }
+
+ private:
+  BopParameters parameters_;
+  MipPresolveOptions presolve_options_;
+  MipPresolveStats presolve_stats_;
+  glop::DenseRow variable_values_;
+  glop::Fractional objective_value_;
+  glop::Fractional best_bound_;
+
+  DISALLOW_COPY_AND_ASSIGN(PresolvedIntegralSolver);
+};
+
+// ============================================================================
+// Implementation.
+// ============================================================================
+
+inline int64 MipPresolveStats::NumReductions() const {
+  return num_removed_rows + num_fixed_columns + num_removed_slack_columns +
+         num_tightened_bounds + num_tightened_coefficients +
+         num_set_packing_rows + num_added_cliques + num_dominated_cliques +
+         num_dual_fixings + num_probing_fixings + num_probing_implied_bounds +
+         num_implied_integers;
+}
+
+inline std::string MipPresolveStats::DebugString() const {
+  return StringPrintf(
+      "removed rows: %lld, fixed columns: %lld, removed slack columns: %lld, "
+      "tightened bounds: %lld, tightened coefficients: %lld, set packing "
+      "rows: %lld, added cliques: %lld, dominated cliques: %lld, dual "
+      "fixings: %lld, probing fixings: %lld, probing implied bounds: %lld, "
+      "implied integers: %lld",
+      num_removed_rows, num_fixed_columns, num_removed_slack_columns,
+      num_tightened_bounds, num_tightened_coefficients, num_set_packing_rows,
+      num_added_cliques, num_dominated_cliques, num_dual_fixings,
+      num_probing_fixings, num_probing_implied_bounds, num_implied_integers);
+}
+
+inline MipPresolver::MipPresolver()
+    : maximize_(false), objective_offset_(0.0), num_original_cols_(0) {}
+
+inline void MipPresolver::LoadProblem(
+    const glop::LinearProgram& linear_program) {
+  const int num_cols = linear_program.num_variables().value();
+  const int num_rows = linear_program.num_constraints().value();
+  stats_ = MipPresolveStats();
+  name_ = linear_program.name();
+  maximize_ = linear_program.IsMaximizationProblem();
+  objective_offset_ = linear_program.objective_offset();
+  num_original_cols_ = num_cols;
+  col_lb_.resize(num_cols);
+  col_ub_.resize(num_cols);
+  objective_.resize(num_cols);
+  is_integer_.resize(num_cols);
+  col_names_.resize(num_cols);
+  col_removed_.assign(num_cols, false);
+  row_lb_.resize(num_rows);
+  row_ub_.resize(num_rows);
+  row_names_.resize(num_rows);
+  row_removed_.assign(num_rows, false);
+  rows_.assign(num_rows, std::vector<Entry>());
+  col_rows_.assign(num_cols, std::vector<int>());
+  for (int col = 0; col < num_cols; ++col) {
+    const glop::ColIndex index(col);
+    col_lb_[col] = linear_program.variable_lower_bounds()[index];
+    col_ub_[col] = linear_program.variable_upper_bounds()[index];
+    objective_[col] = linear_program.objective_coefficients()[index];
+    is_integer_[col] = linear_program.IsVariableInteger(index);
+    col_names_[col] = linear_program.GetVariableName(index);
+    for (const glop::SparseColumn::Entry e :
+         linear_program.GetSparseColumn(index)) {
+      if (e.coefficient() == 0.0) continue;
+      rows_[e.row().value()].push_back(Entry(col, e.coefficient()));
+      col_rows_[col].push_back(e.row().value());
+    }
+  }
+  for (int row = 0; row < num_rows; ++row) {
+    const glop::RowIndex index(row);
+    row_lb_[row] = linear_program.constraint_lower_bounds()[index];
+    row_ub_[row] = linear_program.constraint_upper_bounds()[index];
+    row_names_[row] = linear_program.GetConstraintName(index);
+  }
+  in_queue_.assign(num_rows, false);
+  row_queue_.clear();
+  postsolve_stack_.clear();
+  presolved_to_original_col_.clear();
+}
+
+inline bool MipPresolver::RoundIntegerBounds() {
+  const int num_cols = col_lb_.size();
+  for (int col = 0; col < num_cols; ++col) {
+    if (col_removed_[col]) continue;
+    if (is_integer_[col]) {
+      col_lb_[col] = std::ceil(col_lb_[col] - options_.integrality_tolerance);
+      col_ub_[col] = std::floor(col_ub_[col] + options_.integrality_tolerance);
+    }
+    if (col_lb_[col] > col_ub_[col] + Tolerance(col_ub_[col])) return false;
+  }
+  return true;
+}
+
+inline void MipPresolver::RemoveRow(int row) {
+  DCHECK(!row_removed_[row]);
+  row_removed_[row] = true;
+  std::vector<Entry>().swap(rows_[row]);
+  ++stats_.num_removed_rows;
+}
+
+inline void MipPresolver::FixColumn(int col, double value) {
+  DCHECK(!col_removed_[col]);
+  col_removed_[col] = true;
+  col_lb_[col] = value;
+  col_ub_[col] = value;
+  objective_offset_ += objective_[col] * value;
+  for (const int row : col_rows_[col]) {
+    if (row_removed_[row]) continue;
+    std::vector<Entry>& entries = rows_[row];
+    for (int i = 0; i < static_cast<int>(entries.size()); ++i) {
+      if (entries[i].col != col) continue;
+      const double activity = entries[i].coefficient * value;
+      if (row_lb_[row] != -glop::kInfinity) row_lb_[row] -= activity;
+      if (row_ub_[row] != glop::kInfinity) row_ub_[row] -= activity;
+      entries[i] = entries.back();
+      entries.pop_back();
+      break;
+    }
+  }
+  std::vector<int>().swap(col_rows_[col]);
+  PostsolveStep step;
+  step.type = PostsolveStep::FIX_COLUMN;
+  step.col = col;
+  step.value = value;
+  postsolve_stack_.push_back(step);
+  ++stats_.num_fixed_columns;
+}
+
+inline void MipPresolver::RebuildColumnLists() {
+  for (std::vector<int>& rows : col_rows_) rows.clear();
+  const int num_rows = rows_.size();
+  for (int row = 0; row < num_rows; ++row) {
+    if (row_removed_[row]) continue;
+    for (const Entry& e : rows_[row]) col_rows_[e.col].push_back(row);
+  }
+}
+
+inline void MipPresolver::ComputeActivity(int row,
+                                          const std::vector<double>& lb,
+                                          const std::vector<double>& ub,
+                                          Activity* activity) const {
+  activity->min = 0.0;
+  activity->max = 0.0;
+  activity->num_min_infinite = 0;
+  activity->num_max_infinite = 0;
+  for (const Entry& e : rows_[row]) {
+    const double min_bound = e.coefficient > 0.0 ? lb[e.col] : ub[e.col];
+    const double max_bound = e.coefficient > 0.0 ? ub[e.col] : lb[e.col];
+    if (std::isinf(min_bound)) {
+      ++activity->num_min_infinite;
+    } else {
+      activity->min += e.coefficient * min_bound;
+    }
+    if (std::isinf(max_bound)) {
+      ++activity->num_max_infinite;
+    } else {
+      activity->max += e.coefficient * max_bound;
+    }
+  }
+}
+
+inline void MipPresolver::EnqueueRowsOfColumn(int col) {
+  for (const int row : col_rows_[col]) {
+    if (row_removed_[row] || in_queue_[row]) continue;
+    in_queue_[row] = true;
+    row_queue_.push_back(row);
+  }
+}
+
+// A small improvement of a continuous bound is only worth it for a singleton
+// row, which is then removed. Otherwise the propagation may converge very
+// slowly.
+inline double MipPresolver::MinImprovement(int col, double bound,
+                                           bool small_improvement_ok) const {
+  if (small_improvement_ok || is_integer_[col] || std::isinf(bound)) {
+    return 0.0;
+  }
+  return 1e-3 * std::max(1.0, std::abs(bound));
+}
+
+inline bool MipPresolver::TightenLowerBound(
+    int col, double value, bool small_improvement_ok, std::vector<double>* lb,
+    std::vector<double>* ub, std::vector<int>* modified_columns) {
+  if (is_integer_[col]) {
+    value = std::ceil(value - options_.integrality_tolerance);
+  } else if (std::abs(value) > 1e12) {
+    // Such implied bounds are numerically meaningless.
+    return true;
+  }
+  const double old_lb = (*lb)[col];
+  if (value <= old_lb + MinImprovement(col, old_lb, small_improvement_ok)) {
+    return true;
+  }
+  if (value > (*ub)[col]) {
+    if (value > (*ub)[col] + Tolerance((*ub)[col])) return false;
+    value = (*ub)[col];
+  }
+  (*lb)[col] = value;
+  modified_columns->push_back(col);
+  EnqueueRowsOfColumn(col);
+  return true;
+}
+
+inline bool MipPresolver::TightenUpperBound(
+    int col, double value, bool small_improvement_ok, std::vector<double>* lb,
+    std::vector<double>* ub, std::vector<int>* modified_columns) {
+  if (is_integer_[col]) {
+    value = std::floor(value + options_.integrality_tolerance);
+  } else if (std::abs(value) > 1e12) {
+    return true;
+  }
+  const double old_ub = (*ub)[col];
+  if (value >= old_ub - MinImprovement(col, old_ub, small_improvement_ok)) {
+    return true;
+  }
+  if (value < (*lb)[col]) {
+    if (value < (*lb)[col] - Tolerance((*lb)[col])) return false;
+    value = (*lb)[col];
+  }
+  (*ub)[col] = value;
+  modified_columns->push_back(col);
+  EnqueueRowsOfColumn(col);
+  return true;
+}
+
+inline bool MipPresolver::PropagateRows(std::vector<double>* lb,
+                                        std::vector<double>* ub,
+                                        std::vector<int>* modified_columns,
+                                        int64* work) {
+  bool feasible = true;
+  Activity activity;
+  for (int i = 0; i < static_cast<int>(row_queue_.size()); ++i) {
+    const int row = row_queue_[i];
+    in_queue_[row] = false;
+    if (!feasible || row_removed_[row] || *work > options_.max_work) continue;
+    const std::vector<Entry>& entries = rows_[row];
+    *work += entries.size();
+    ComputeActivity(row, *lb, *ub, &activity);
+    const double row_lb = row_lb_[row];
+    const double row_ub = row_ub_[row];
+    if ((activity.num_min_infinite == 0 &&
+         activity.min > row_ub + Tolerance(row_ub)) ||
+        (activity.num_max_infinite == 0 &&
+         activity.max < row_lb - Tolerance(row_lb))) {
+      feasible = false;
+      continue;
+    }
+    const bool singleton = entries.size() == 1;
+    for (const Entry& e : entries) {
+      const double a = e.coefficient;
+      const double min_bound = a > 0.0 ? (*lb)[e.col] : (*ub)[e.col];
+      const double max_bound = a > 0.0 ? (*ub)[e.col] : (*lb)[e.col];
+
+      // The activity of the other terms of the row.
+      double min_rest = -glop::kInfinity;
+      if (activity.num_min_infinite == 0) {
+        min_rest = activity.min - a * min_bound;
+      } else if (activity.num_min_infinite == 1 && std::isinf(min_bound)) {
+        min_rest = activity.min;
+      }
+      double max_rest = glop::kInfinity;
+      if (activity.num_max_infinite == 0) {
+        max_rest = activity.max - a * max_bound;
+      } else if (activity.num_max_infinite == 1 && std::isinf(max_bound)) {
+        max_rest = activity.max;
+      }
+
+      bool ok = true;
+      if (row_ub != glop::kInfinity && min_rest != -glop::kInfinity) {
+        const double bound = (row_ub - min_rest) / a;
+        ok = a > 0.0 ? TightenUpperBound(e.col, bound, singleton, lb,
+                                         ub, modified_columns)
+                     : TightenLowerBound(e.col, bound, singleton, lb,
+                                         ub, modified_columns);
+      }
+      if (ok && row_lb != -glop::kInfinity && max_rest != glop::kInfinity) {
+        const double bound = (row_lb - max_rest) / a;
+        ok = a > 0.0 ? TightenLowerBound(e.col, bound, singleton, lb,
+                                         ub, modified_columns)
+                     : TightenUpperBound(e.col, bound, singleton, lb,
+                                         ub, modified_columns);
+      }
+      if (!ok) {
+        feasible = false;
+        break;
+      }
+    }
+  }
+  row_queue_.clear();
+  return feasible;
+}
+
+inline bool MipPresolver::PropagateAllRows() {
+  const int num_rows = rows_.size();
+  for (int row = 0; row < num_rows; ++row) {
+    if (row_removed_[row] || in_queue_[row]) continue;
+    in_queue_[row] = true;
+    row_queue_.push_back(row);
+  }
+  std::vector<int> modified_columns;
+  int64 work = 0;
+  if (!PropagateRows(&col_lb_, &col_ub_, &modified_columns, &work)) {
+    return false;
+  }
+  stats_.num_tightened_bounds += modified_columns.size();
+  return RemoveFixedColumnsAndRedundantRows();
+}
+
+inline bool MipPresolver::RemoveFixedColumnsAndRedundantRows() {
+  const int num_cols = col_lb_.size();
+  for (int col = 0; col < num_cols; ++col) {
+    if (col_removed_[col]) continue;
+    const double lb = col_lb_[col];
+    const double ub = col_ub_[col];
+    if (ub - lb > Tolerance(lb)) continue;
+    FixColumn(col, is_integer_[col] ? std::round(lb) : lb);
+  }
+  const int num_rows = rows_.size();
+  Activity activity;
+  for (int row = 0; row < num_rows; ++row) {
+    if (row_removed_[row]) continue;
+    ComputeActivity(row, col_lb_, col_ub_, &activity);
+    const double row_lb = row_lb_[row];
+    const double row_ub = row_ub_[row];
+    if ((activity.num_min_infinite == 0 &&
+         activity.min > row_ub + Tolerance(row_ub)) ||
+        (activity.num_max_infinite == 0 &&
+         activity.max < row_lb - Tolerance(row_lb))) {
+      return false;
+    }
+
+    // A side of the row that can't be violated is relaxed.
+    if (activity.num_min_infinite == 0 &&
+        activity.min >= row_lb - Tolerance(row_lb)) {
+      row_lb_[row] = -glop::kInfinity;
+    }
+    if (activity.num_max_infinite == 0 &&
+        activity.max <= row_ub + Tolerance(row_ub)) {
+      row_ub_[row] = glop::kInfinity;
+    }
+    if (row_lb_[row] == -glop::kInfinity && row_ub_[row] == glop::kInfinity) {
+      RemoveRow(row);
+    }
+  }
+  return true;
+}
+
+inline bool MipPresolver::DetectImpliedIntegers() {
+  const int num_rows = rows_.size();
+  const double tolerance = options_.tolerance;
+  for (int row = 0; row < num_rows; ++row) {
+    if (row_removed_[row] || row_lb_[row] != row_ub_[row]) continue;
+    int continuous_index = -1;
+    for (int i = 0; i < static_cast<int>(rows_[row].size()); ++i) {
+      if (is_integer_[rows_[row][i].col]) continue;
+      if (continuous_index != -1) {
+        continuous_index = -2;
+        break;
+      }
+      continuous_index = i;
+    }
+    if (continuous_index < 0) continue;
+
+    // The column is integral if the right hand side and all the other
+    // coefficients are integer multiples of its coefficient.
+    const Entry& continuous = rows_[row][continuous_index];
+    bool integral = true;
+    const double rhs = row_ub_[row] / continuous.coefficient;
+    if (std::abs(rhs - std::round(rhs)) > tolerance) continue;
+    for (const Entry& e : rows_[row]) {
+      const double ratio = e.coefficient / continuous.coefficient;
+      if (std::abs(ratio - std::round(ratio)) > tolerance) {
+        integral = false;
+        break;
+      }
+    }
+    if (!integral) continue;
+    is_integer_[continuous.col] = true;
+    ++stats_.num_implied_integers;
+  }
+  return RoundIntegerBounds();
+}
+
+inline void MipPresolver::TightenCoefficients() {
+  const int num_rows = rows_.size();
+  const double tolerance = options_.tolerance;
+  Activity activity;
+  for (int row = 0; row < num_rows; ++row) {
+    if (row_removed_[row]) continue;
+
+    // Only the one-sided rows are considered. They are seen as
+    // sign * (a.x) <= rhs.
+    const bool has_lb = row_lb_[row] != -glop::kInfinity;
+    const bool has_ub = row_ub_[row] != glop::kInfinity;
+    if (has_lb == has_ub) continue;
+    const double sign = has_ub ? 1.0 : -1.0;
+    double rhs = has_ub ? row_ub_[row] : -row_lb_[row];
+    ComputeActivity(row, col_lb_, col_ub_, &activity);
+    const int num_infinite =
+        has_ub ? activity.num_max_infinite : activity.num_min_infinite;
+    if (num_infinite > 0) continue;
+    double max_activity = has_ub ? activity.max : -activity.min;
+    for (Entry& e : rows_[row]) {
+      if (!IsBinary(e.col)) continue;
+      const double a = sign * e.coefficient;
+      if (a > 0.0) {
+        // If the row can't be violated when the variable is 0, its
+        // coefficient and the rhs can both be decreased by the slack.
+        const double slack = rhs - (max_activity - a);
+        if (slack <= Tolerance(rhs)) continue;
+        e.coefficient = sign * (a - slack);
+        rhs -= slack;
+        max_activity -= slack;
+      } else {
+        // If the row can't be violated when the variable is 1, its
+        // coefficient can be increased up to the point where it can.
+        const double slack = rhs - (max_activity + a);
+        if (slack <= Tolerance(rhs)) continue;
+        e.coefficient = sign * (a + slack);
+      }
+      ++stats_.num_tightened_coefficients;
+    }
+    if (has_ub) {
+      row_ub_[row] = rhs;
+    } else {
+      row_lb_[row] = -rhs;
+    }
+
+    // Remove the coefficients that became zero.
+    std::vector<Entry>& entries = rows_[row];
+    for (int i = 0; i < static_cast<int>(entries.size());) {
+      if (std::abs(entries[i].coefficient) <= tolerance) {
+        entries[i] = entries.back();
+        entries.pop_back();
+      } else {
+        ++i;
+      }
+    }
+  }
+}
+
+inline void MipPresolver::DualFixing() {
+  const int num_cols = col_lb_.size();
+  for (int col = 0; col < num_cols; ++col) {
+    if (col_removed_[col]) continue;
+    const double cost = maximize_ ? -objective_[col] : objective_[col];
+
+    // The number of rows that forbid to decrease (resp. increase) the value
+    // of the column.
+    int num_down_locks = 0;
+    int num_up_locks = 0;
+    for (const int row : col_rows_[col]) {
+      for (const Entry& e : rows_[row]) {
+        if (e.col != col) continue;
+        const bool has_lb = row_lb_[row] != -glop::kInfinity;
+        const bool has_ub = row_ub_[row] != glop::kInfinity;
+        if (e.coefficient > 0.0 ? has_lb : has_ub) ++num_down_locks;
+        if (e.coefficient > 0.0 ? has_ub : has_lb) ++num_up_locks;
+        break;
+      }
+    }
+    const double lb = col_lb_[col];
+    const double ub = col_ub_[col];
+    double value;
+    if (cost >= 0.0 && num_down_locks == 0 && lb != -glop::kInfinity) {
+      value = lb;
+    } else if (cost <= 0.0 && num_up_locks == 0 && ub != glop::kInfinity) {
+      value = ub;
+    } else if (cost == 0.0 && num_down_locks == 0 && num_up_locks == 0) {
+      value = std::max(lb, std::min(ub, 0.0));
+    } else {
+      continue;
+    }
+    FixColumn(col, value);
+    ++stats_.num_dual_fixings;
+  }
+}
+
+inline void MipPresolver::RemoveSlackColumns() {
+  const int num_cols = col_lb_.size();
+  for (int col = 0; col < num_cols; ++col) {
+    if (col_removed_[col] || is_integer_[col] || objective_[col] != 0.0) {
+      continue;
+    }
+
+    // Note that col_rows_ may contain removed rows but no stale entries here:
+    // the rows only lose entries in this function.
+    int row = -1;
+    int num_rows = 0;
+    for (const int r : col_rows_[col]) {
+      if (row_removed_[r]) continue;
+      row = r;
+      ++num_rows;
+    }
+    if (num_rows != 1 || rows_[row].size() < 2) continue;
+    std::vector<Entry>& entries = rows_[row];
+    int index = 0;
+    while (entries[index].col != col) ++index;
+    const double a = entries[index].coefficient;
+
+    PostsolveStep step;
+    step.type = PostsolveStep::SLACK_COLUMN;
+    step.col = col;
+    step.value = 0.0;
+    step.coefficient = a;
+    step.row_lb = row_lb_[row];
+    step.row_ub = row_ub_[row];
+    step.col_lb = col_lb_[col];
+    step.col_ub = col_ub_[col];
+    entries[index] = entries.back();
+    entries.pop_back();
+    step.row_entries = entries;
+
+    // The new bounds of the other terms, given the range of a * col.
+    const double term_min = a > 0.0 ? a * col_lb_[col] : a * col_ub_[col];
+    const double term_max = a > 0.0 ? a * col_ub_[col] : a * col_lb_[col];
+    row_lb_[row] = std::isinf(term_max) ? -glop::kInfinity
+                                        : row_lb_[row] - term_max;
+    row_ub_[row] = std::isinf(term_min) ? glop::kInfinity
+                                        : row_ub_[row] - term_min;
+    postsolve_stack_.push_back(step);
+    col_removed_[col] = true;
+    std::vector<int>().swap(col_rows_[col]);
+    ++stats_.num_removed_slack_columns;
+    if (row_lb_[row] == -glop::kInfinity && row_ub_[row] == glop::kInfinity) {
+      RemoveRow(row);
+    }
+  }
+}
+
+inline void MipPresolver::DetectCliques() {
+  const int num_rows = rows_.size();
+  std::vector<double> coefficients;
+  for (int row = 0; row < num_rows; ++row) {
+    if (row_removed_[row] || rows_[row].size() < 2) continue;
+    const bool has_lb = row_lb_[row] != -glop::kInfinity;
+    const bool has_ub = row_ub_[row] != glop::kInfinity;
+    if (has_lb == has_ub) continue;
+    const double sign = has_ub ? 1.0 : -1.0;
+    const double rhs = has_ub ? row_ub_[row] : -row_lb_[row];
+
+    // Only the rows sign * (a.x) <= rhs with a > 0 on binary variables are
+    // considered. Two variables are in conflict if the sum of their
+    // coefficients exceeds rhs.
+    std::vector<std::pair<double, int>> terms;
+    bool is_set_packing = rhs == 1.0;
+    for (const Entry& e : rows_[row]) {
+      const double a = sign * e.coefficient;
+      if (!IsBinary(e.col) || a <= 0.0) {
+        terms.clear();
+        break;
+      }
+      if (a != 1.0) is_set_packing = false;
+      terms.push_back(std::make_pair(a, e.col));
+    }
+    if (terms.empty() || is_set_packing) continue;
+    std::sort(terms.begin(), terms.end(),
+              std::greater<std::pair<double, int>>());
+    const int num_terms = terms.size();
+
+    // The largest k such that the k biggest coefficients pairwise conflict.
+    int k = 1;
+    while (k < num_terms &&
+           terms[k - 1].first + terms[k].first > rhs + Tolerance(rhs)) {
+      ++k;
+    }
+    if (k < 2) continue;
+    if (k == num_terms && terms[0].first <= rhs + Tolerance(rhs)) {
+      // The row is equivalent to a set packing row.
+      for (Entry& e : rows_[row]) e.coefficient = 1.0;
+      row_lb_[row] = -glop::kInfinity;
+      row_ub_[row] = 1.0;
+      ++stats_.num_set_packing_rows;
+    } else if (k >= 3 && k < num_terms &&
+               stats_.num_added_cliques < options_.max_num_added_cliques) {
+      // Note that the variables whose coefficient exceed the rhs are fixed
+      // by the propagation, so they never end up in a clique.
+      rows_.push_back(std::vector<Entry>());
+      for (int i = 0; i < k; ++i) {
+        rows_.back().push_back(Entry(terms[i].second, 1.0));
+      }
+      row_lb_.push_back(-glop::kInfinity);
+      row_ub_.push_back(1.0);
+      row_removed_.push_back(false);
+      row_names_.push_back(StringPrintf("clique_%lld",
+                                        stats_.num_added_cliques));
+      in_queue_.push_back(false);
+      ++stats_.num_added_cliques;
+    }
+  }
+}
+
+inline void MipPresolver::RemoveDominatedCliques() {
+  // The clique rows: sum x <= 1 (removable) or sum x = 1 over binaries with
+  // unit coefficients.
+  const int num_rows = rows_.size();
+  std::vector<bool> is_clique(num_rows, false);
+  for (int row = 0; row < num_rows; ++row) {
+    if (row_removed_[row] || row_ub_[row] != 1.0) continue;
+    if (row_lb_[row] != -glop::kInfinity && row_lb_[row] != 1.0) continue;
+    bool clique = true;
+    for (const Entry& e : rows_[row]) {
+      if (e.coefficient != 1.0 || !IsBinary(e.col)) {
+        clique = false;
+        break;
+      }
+    }
+    is_clique[row] = clique;
+  }
+
+  // A row R is dominated by a clique S if support(R) is included in
+  // support(S). The candidates S are the cliques containing the variable of
+  // R that appears in the fewest cliques.
+  std::vector<int> num_cliques(col_lb_.size(), 0);
+  for (int row = 0; row < num_rows; ++row) {
+    if (!is_clique[row]) continue;
+    for (const Entry& e : rows_[row]) ++num_cliques[e.col];
+  }
+  std::vector<int> marks(col_lb_.size(), -1);
+  int64 work = 0;
+  for (int row = 0; row < num_rows && work < options_.max_work; ++row) {
+    if (!is_clique[row] || row_lb_[row] == 1.0 || rows_[row].empty()) {
+      continue;
+    }
+    int pivot = rows_[row][0].col;
+    for (const Entry& e : rows_[row]) {
+      marks[e.col] = row;
+      if (num_cliques[e.col] < num_cliques[pivot]) pivot = e.col;
+    }
+    const int size = rows_[row].size();
+    for (const int other : col_rows_[pivot]) {
+      if (other == row || !is_clique[other] || row_removed_[other]) continue;
+      const int other_size = rows_[other].size();
+      if (other_size < size) continue;
+
+      // Among identical removable rows, only the first one is kept.
+      if (other_size == size && row_lb_[other] != 1.0 && other > row) {
+        continue;
+      }
+      int num_marked = 0;
+      for (const Entry& e : rows_[other]) {
+        if (marks[e.col] == row) ++num_marked;
+      }
+      work += other_size;
+      if (num_marked == size) {
+        for (const Entry& e : rows_[row]) --num_cliques[e.col];
+        RemoveRow(row);
+        ++stats_.num_dominated_cliques;
+        break;
+      }
+    }
+  }
+}
+
+inline bool MipPresolver::Probe(TimeLimit* time_limit) {
+  const int num_cols = col_lb_.size();
+  std::vector<std::pair<int, int>> candidates;
+  for (int col = 0; col < num_cols; ++col) {
+    if (col_removed_[col] || !IsBinary(col) || col_rows_[col].empty()) {
+      continue;
+    }
+    candidates.push_back(
+        std::make_pair(-static_cast<int>(col_rows_[col].size()), col));
+  }
+  std::sort(candidates.begin(), candidates.end());
+  if (static_cast<int>(candidates.size()) > options_.max_num_probed_variables) {
+    candidates.resize(options_.max_num_probed_variables);
+  }
+
+  // The bounds of each probe. They are restored to the global bounds after
+  // each probe using the list of modified columns.
+  std::vector<double> lb = col_lb_;
+  std::vector<double> ub = col_ub_;
+  std::vector<int> modified[2];
+  std::vector<double> implied_lb[2];
+  std::vector<double> implied_ub[2];
+  std::vector<int> probe_of_column(num_cols, -1);
+  int64 work = 0;
+  for (int c = 0; c < static_cast<int>(candidates.size()); ++c) {
+    const int col = candidates[c].second;
+    if (work > options_.max_work || LimitReached(time_limit)) break;
+    if (col_lb_[col] == col_ub_[col]) continue;
+    bool feasible[2];
+    for (int value = 0; value < 2; ++value) {
+      modified[value].clear();
+      modified[value].push_back(col);
+      lb[col] = value;
+      ub[col] = value;
+      EnqueueRowsOfColumn(col);
+      feasible[value] = PropagateRows(&lb, &ub, &modified[value], &work);
+      implied_lb[value].clear();
+      implied_ub[value].clear();
+      for (const int m : modified[value]) {
+        implied_lb[value].push_back(lb[m]);
+        implied_ub[value].push_back(ub[m]);
+      }
+      for (const int m : modified[value]) {
+        lb[m] = col_lb_[m];
+        ub[m] = col_ub_[m];
+      }
+    }
+    if (!feasible[0] && !feasible[1]) return false;
+
+    // Collect the global bound changes, and update both lb/ub and the global
+    // bounds. The caller propagates them and removes the fixed columns.
+    int64 num_changes = 0;
+    for (int value = 0; value < 2; ++value) {
+      if (feasible[value] && !feasible[1 - value]) {
+        // The variable can only take this value, and everything that was
+        // implied by it holds.
+        for (int i = 0; i < static_cast<int>(modified[value].size()); ++i) {
+          const int m = modified[value][i];
+          col_lb_[m] = std::max(col_lb_[m], implied_lb[value][i]);
+          col_ub_[m] = std::min(col_ub_[m], implied_ub[value][i]);
+          lb[m] = col_lb_[m];
+          ub[m] = col_ub_[m];
+        }
+        ++stats_.num_probing_fixings;
+      }
+    }
+    if (feasible[0] && feasible[1]) {
+      // A bound implied by both values holds. Note that a column may appear
+      // more than once in modified, always with its final implied bounds.
+      for (int i = 0; i < static_cast<int>(modified[0].size()); ++i) {
+        probe_of_column[modified[0][i]] = i;
+      }
+      for (int i = 0; i < static_cast<int>(modified[1].size()); ++i) {
+        const int m = modified[1][i];
+        if (m == col || probe_of_column[m] == -1) continue;
+        const int j = probe_of_column[m];
+        const double new_lb = std::min(implied_lb[0][j], implied_lb[1][i]);
+        const double new_ub = std::max(implied_ub[0][j], implied_ub[1][i]);
+        if (new_lb > col_lb_[m] + Tolerance(col_lb_[m])) {
+          col_lb_[m] = new_lb;
+          ++num_changes;
+        }
+        if (new_ub < col_ub_[m] - Tolerance(col_ub_[m])) {
+          col_ub_[m] = new_ub;
+          ++num_changes;
+        }
+        lb[m] = col_lb_[m];
+        ub[m] = col_ub_[m];
+      }
+      for (const int m : modified[0]) probe_of_column[m] = -1;
+    }
+    stats_.num_probing_implied_bounds += num_changes;
+  }
+  return true;
+}
+
+inline bool MipPresolver::Run(const glop::LinearProgram& linear_program,
+                              TimeLimit* time_limit,
+                              glop::LinearProgram* presolved) {
+  LoadProblem(linear_program);
+  if (!RoundIntegerBounds()) return false;
+  for (int round = 0; round < options_.max_num_rounds; ++round) {
+    const int64 num_reductions = stats_.NumReductions();
+    if (!PropagateAllRows()) return false;
+    if (options_.use_implied_integers && !DetectImpliedIntegers()) {
+      return false;
+    }
+    if (options_.use_coefficient_tightening) TightenCoefficients();
+    RebuildColumnLists();
+    if (options_.use_dual_fixing) DualFixing();
+    if (options_.use_slack_column_removal) RemoveSlackColumns();
+    if (stats_.NumReductions() == num_reductions || LimitReached(time_limit)) {
+      break;
+    }
+  }
+  if (options_.use_clique_detection && !LimitReached(time_limit)) {
+    DetectCliques();
+    RebuildColumnLists();
+    RemoveDominatedCliques();
+  }
+  if (options_.use_probing && !LimitReached(time_limit)) {
+    RebuildColumnLists();
+    if (!Probe(time_limit)) return false;
+    if (!PropagateAllRows()) return false;
+  }
+  if (!RemoveFixedColumnsAndRedundantRows()) return false;
+  BuildPresolvedProblem(presolved);
+  VLOG(1) << "MIP presolve: " << stats_.DebugString();
+  return true;
+}
+
+inline void MipPresolver::BuildPresolvedProblem(
+    glop::LinearProgram* presolved) {
+  presolved->Clear();
+  presolved->SetName(name_);
+  presolved->SetMaximizationProblem(maximize_);
+  presolved->SetObjectiveOffset(objective_offset_);
+  const int num_cols = col_lb_.size();
+  std::vector<int> new_index(num_cols, -1);
+  presolved_to_original_col_.clear();
+  for (int col = 0; col < num_cols; ++col) {
+    if (col_removed_[col]) continue;
+    const glop::ColIndex index = presolved->CreateNewVariable();
+    new_index[col] = index.value();
+    presolved_to_original_col_.push_back(col);
+    presolved->SetVariableBounds(index, col_lb_[col], col_ub_[col]);
+    presolved->SetObjectiveCoefficient(index, objective_[col]);
+    presolved->SetVariableIntegrality(index, is_integer_[col]);
+    presolved->SetVariableName(index, col_names_[col]);
+  }
+  const int num_rows = rows_.size();
+  for (int row = 0; row < num_rows; ++row) {
+    if (row_removed_[row] || rows_[row].empty()) continue;
+    const glop::RowIndex index = presolved->CreateNewConstraint();
+    presolved->SetConstraintBounds(index, row_lb_[row], row_ub_[row]);
+    presolved->SetConstraintName(index, row_names_[row]);
+    for (const Entry& e : rows_[row]) {
+      presolved->SetCoefficient(index, glop::ColIndex(new_index[e.col]),
+                                e.coefficient);
+    }
+  }
+  presolved->CleanUp();
+}
+
+inline void MipPresolver::RecoverSolution(
+    const glop::DenseRow& presolved_values, glop::DenseRow* values) const {
+  values->assign(num_original_cols_, 0.0);
+  const int num_presolved_cols = presolved_to_original_col_.size();
+  for (int i = 0; i < num_presolved_cols; ++i) {
+    (*values)[glop::ColIndex(presolved_to_original_col_[i])] =
+        presolved_values[glop::ColIndex(i)];
+  }
+  for (int i = postsolve_stack_.size() - 1; i >= 0; --i) {
+    const PostsolveStep& step = postsolve_stack_[i];
+    const glop::ColIndex col(step.col);
+    if (step.type == PostsolveStep::FIX_COLUMN) {
+      (*values)[col] = step.value;
+      continue;
+    }
+
+    // SLACK_COLUMN: the column must satisfy
+    // row_lb - rest <= coefficient * col <= row_ub - rest.
+    double rest = 0.0;
+    for (const Entry& e : step.row_entries) {
+      rest += e.coefficient * (*values)[glop::ColIndex(e.col)];
+    }
+    double lb = step.col_lb;
+    double ub = step.col_ub;
+    const double a = step.coefficient;
+    const double term_lb = step.row_lb - rest;
+    const double term_ub = step.row_ub - rest;
+    if (a > 0.0) {
+      lb = std::max(lb, term_lb / a);
+      ub = std::min(ub, term_ub / a);
+    } else {
+      lb = std::max(lb, term_ub / a);
+      ub = std::min(ub, term_lb / a);
+    }
+    // Pick the value closest to zero. If the interval is empty because of
+    // the tolerances, the column bounds win.
+    double value = std::max(lb, std::min(ub, 0.0));
+    value = std::max(step.col_lb, std::min(step.col_ub, value));
+    (*values)[col] = value;
+  }
+}
+
+inline PresolvedIntegralSolver::PresolvedIntegralSolver()
+    : objective_value_(0.0), best_bound_(0.0) {}
+
+inline BopSolveStatus PresolvedIntegralSolver::Solve(
+    const glop::LinearProgram& linear_problem) {
+  std::unique_ptr<TimeLimit> time_limit =
+      TimeLimit::FromParameters(parameters_);
+  return SolveWithTimeLimit(linear_problem, time_limit.get());
+}
+
+inline BopSolveStatus PresolvedIntegralSolver::SolveWithTimeLimit(
+    const glop::LinearProgram& linear_problem, TimeLimit* time_limit) {
+  MipPresolver presolver;
+  presolver.SetOptions(presolve_options_);
+  glop::LinearProgram presolved;
+  const bool feasible = presolver.Run(linear_problem, time_limit, &presolved);
+  presolve_stats_ = presolver.stats();
+  if (!feasible) return BopSolveStatus::INFEASIBLE_PROBLEM;
+
+  if (presolved.num_variables() == 0) {
+    // Everything was fixed by the presolve.
+    presolver.RecoverSolution(glop::DenseRow(), &variable_values_);
+    objective_value_ = linear_problem.objective_offset();
+    for (glop::ColIndex col(0); col < linear_problem.num_variables(); ++col) {
+      objective_value_ +=
+          linear_problem.objective_coefficients()[col] * variable_values_[col];
+    }
+    best_bound_ = objective_value_;
+    return BopSolveStatus::OPTIMAL_SOLUTION_FOUND;
+  }
+
+  IntegralSolver solver;
+  solver.SetParameters(parameters_);
+  const BopSolveStatus status =
+      solver.SolveWithTimeLimit(presolved, time_limit);
+  objective_value_ = solver.objective_value();
+  best_bound_ = solver.best_bound();
+  if (status == BopSolveStatus::OPTIMAL_SOLUTION_FOUND ||
+      status == BopSolveStatus::FEASIBLE_SOLUTION_FOUND) {
+    presolver.RecoverSolution(solver.variable_values(), &variable_values_);
+  }
+  return status;
+}
+
+}  // namespace bop
+}  // namespace operations_research
+
+#endif  // OR_TOOLS_BOP_MIP_PRESOLVE_H_
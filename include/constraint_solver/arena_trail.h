@@ -0,0 +1,522 @@
+// Copyright 2010-2014 Google
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+// A trail for the reversible state of constraints, designed for very deep
+// searches.
+//
+// The solver trail stores the saved values in blocks which are either kept
+// as is or compressed with zlib, synchronously, as soon as they are full
+// (see ConstraintSolverParameters::compress_trail). On searches that are
+// millions of decisions deep, the first option uses a lot of memory and the
+// second one stalls the search each time a block is compressed.
+//
+// The ArenaTrail is an additional trail, on top of the solver one, that
+// stores the saved values of each type in a stack of fixed-size blocks:
+// - The last 'num_hot_blocks' blocks of each stack are never compressed, so
+//   that saving and restoring values near the top of the stack is a plain
+//   array access.
+// - The colder blocks are compressed with a fast LZ compressor (see
+//   util/fast_compression.h), by default on a background thread. The search
+//   never waits for a compression, and a block that is needed again before
+//   its compression is over is simply used as is; the compression thread
+//   works on its own reference to the block data, which is copied on the
+//   next write if it is still shared.
+// - Compressed blocks are decompressed on demand when backtracking reaches
+//   them.
+// The trail also counts the saved and restored values of each type, which
+// tells which kind of state dominates the memory of a search.
+//
+// The ArenaTrail registers one backtrack action on the solver per search node
+// in which it saves a value, and restores its values in this action. It must
+// be created, and owned by the solver, before the search:
+//   ArenaTrail* const trail = solver->RevAlloc(
+//       new ArenaTrail(solver, ArenaTrailParameters()));
+// The reversible state is then saved with trail->SaveValue(&value), or held
+// in ArenaRev<T> objects, which have the same stamp optimization as Rev<T>.
+
+#ifndef OR_TOOLS_CONSTRAINT_SOLVER_ARENA_TRAIL_H_
+#define OR_TOOLS_CONSTRAINT_SOLVER_ARENA_TRAIL_H_
+
+#include <algorithm>
+#include <memory>
+#include <string>
+#include <vector>
+
+#include "base/callback.h"
+#include "base/integral_types.h"
+#include "base/logging.h"
+#include "base/macros.h"
+#include "base/mutex.h"
+#include "base/stringprintf.h"
+#include "base/threadpool.h"
+#include "constraint_solver/constraint_solver.h"
+#include "util/fast_compression.h"
+
+namespace operations_research {
+
+struct ArenaTrailParameters {
+  ArenaTrailParameters()
+      : block_size(8192),
+        num_hot_blocks(2),
+        compress_cold_blocks(true),
+        background_compression(true) {}
+
+  // Number of saved values per block.
+  int block_size;
+  // Number of blocks at the top of each stack that are never compressed. At
+  // least 1.
+  int num_hot_blocks;
+  // Whether the blocks below the hot ones are compressed.
+  bool compress_cold_blocks;
+  // Whether the compression runs on a background thread. Otherwise, it runs
+  // synchronously when a new block is started.
+  bool background_compression;
+};
+
+// A stack of (address, value) pairs stored in blocks, used by ArenaTrail for
+// one type of values.
+template <class T>
+class ChunkedTrailStack {
+ public:
+  ChunkedTrailStack(const std::string& name,
+                    const ArenaTrailParameters& parameters, ThreadPool* pool);
+
+  // Saves the current value at the given address.
+  void Push(T* address);
+
+  // Restores the values saved after the stack had the given size, most
+  // recent first.
+  void RestoreTo(int64 size);
+
+  int64 size() const { return size_; }
+  const std::string& name() const { return name_; }
+
+  // Statistics.
+  int64 num_saves() const { return num_saves_; }
+  int64 num_restores() const { return num_restores_; }
+  int64 max_size() const { return max_size_; }
+  int64 num_compressions() const;
+  int64 num_decompressions() const { return num_decompressions_; }
+  // Memory used by the blocks, in bytes.
+  int64 MemoryUsage() const;
+  std::string DebugString() const;
+
+ private:
+  struct Entry {
+    T* address;
+    T value;
+  };
+  typedef std::vector<Entry> Entries;
+
+  // A RAW block whose raw data is null is an unused block above the top.
+  struct Block {
+    enum State { RAW, QUEUED, COMPRESSED };
+    Block() : state(RAW) {}
+    State state;
+    std::shared_ptr<Entries> raw;
+    std::string compressed;
+  };
+
+  // Makes the block usable by the search thread: decompresses it if needed,
+  // cancels a pending compression and copies the data if the compression
+  // thread still holds it.
+  void EnsureRaw(Block* const block);
+  // Called when a new block is started: compresses the block that just left
+  // the hot window.
+  void CompressColdBlock();
+  // Runs on the compression thread, or inline.
+  void CompressBlock(Block* const block);
+  // Frees the memory of the given block, if it exists.
+  void ReleaseBlock(int64 index);
+
+  const std::string name_;
+  const int block_size_;
+  const int num_hot_blocks_;
+  const bool compress_;
+  ThreadPool* const pool_;
+  // Guards the state, raw and compressed fields of the blocks, and
+  // num_compressions_. The hot blocks are only accessed by the search thread.
+  mutable Mutex mutex_;
+  std::vector<std::unique_ptr<Block>> blocks_;
+  // The current top block, which is always RAW.
+  int64 top_index_;
+  Entries* top_;
+  int64 size_;
+  int64 num_saves_;
+  int64 num_restores_;
+  int64 max_size_;
+  int64 num_compressions_;
+  int64 num_decompressions_;
+
+  DISALLOW_COPY_AND_ASSIGN(ChunkedTrailStack);
+};
+
+class ArenaTrail : public BaseObject {
+ public:
+  ArenaTrail(Solver* const solver, const ArenaTrailParameters& parameters);
+  ~ArenaTrail() override;
+
+  // Saves the current value at the given address, to be restored upon
+  // backtrack. The same types as Solver::SaveValue() are supported.
+  void SaveValue(int* address) {
+    MarkNode();
+    int_stack_.Push(address);
+  }
+  void SaveValue(int64* address) {
+    MarkNode();
+    int64_stack_.Push(address);
+  }
+  void SaveValue(uint64* address) {
+    MarkNode();
+    uint64_stack_.Push(address);
+  }
+  void SaveValue(double* address) {
+    MarkNode();
+    double_stack_.Push(address);
+  }
+  void SaveValue(bool* address) {
+    MarkNode();
+    bool_stack_.Push(address);
+  }
+  void SaveValue(void** address) {
+    MarkNode();
+    pointer_stack_.Push(address);
+  }
+  template <class T>
+  void SaveValue(T** address) {
+    SaveValue(reinterpret_cast<void**>(address));
+  }
+
+  template <class T>
+  void SaveAndSetValue(T* address, T value) {
+    if (*address != value) {
+      SaveValue(address);
+      *address = value;
+    }
+  }
+
+  Solver* solver() const { return solver_; }
+
+  // Number of search nodes of the current branch in which a value was saved.
+  int num_nodes() const { return nodes_.size(); }
+
+  // Memory used by the trail, in bytes.
+  int64 MemoryUsage() const;
+  // Per-type statistics, one line per type.
+  std::string StatsString() const;
+  std::string DebugString() const override { return "ArenaTrail"; }
+
+ private:
+  static const int kNumStacks = 6;
+  struct Node {
+    int64 sizes[kNumStacks];
+  };
+
+  // Records the sizes of the stacks and registers a backtrack action the
+  // first time a value is saved in the current search node.
+  void MarkNode();
+  // Restores the values saved since the given node was marked.
+  void BacktrackToNode(int node);
+
+  Solver* const solver_;
+  // Reset first in the destructor, since the compression tasks reference the
+  // blocks of the stacks.
+  std::unique_ptr<ThreadPool> pool_;
+  ChunkedTrailStack<int> int_stack_;
+  ChunkedTrailStack<int64> int64_stack_;
+  ChunkedTrailStack<uint64> uint64_stack_;
+  ChunkedTrailStack<double> double_stack_;
+  ChunkedTrailStack<bool> bool_stack_;
+  ChunkedTrailStack<void*> pointer_stack_;
+  std::vector<Node> nodes_;
+  // The stamp of the solver when the last node was marked.
+  uint64 marked_stamp_;
+
+  DISALLOW_COPY_AND_ASSIGN(ArenaTrail);
+};
+
+// Same as Rev<T>, with the values saved on an ArenaTrail.
+template <class T>
+class ArenaRev {
+ public:
+  explicit ArenaRev(const T& val) : stamp_(0), value_(val) {}
+
+  const T& Value() const { return value_; }
+
+  void SetValue(ArenaTrail* const trail, const T& val) {
+    if (val != value_) {
+      if (stamp_ < trail->solver()->stamp()) {
+        trail->SaveValue(&value_);
+        stamp_ = trail->solver()->stamp();
+      }
+      value_ = val;
+    }
+  }
+
+ private:
+  uint64 stamp_;
+  T value_;
+};
+
+// ============================================================================
+// Implementation.
+// ============================================================================
+
+template <class T>
+ChunkedTrailStack<T>::ChunkedTrailStack(const std::string& name,
+                                        const ArenaTrailParameters& parameters,
+                                        ThreadPool* pool)
+    : name_(name),
+      block_size_(parameters.block_size),
+      num_hot_blocks_(parameters.num_hot_blocks),
+      compress_(parameters.compress_cold_blocks),
+      pool_(pool),
+      top_index_(-1),
+      top_(nullptr),
+      size_(0),
+      num_saves_(0),
+      num_restores_(0),
+      max_size_(0),
+      num_compressions_(0),
+      num_decompressions_(0) {
+  CHECK_GE(block_size_, 1);
+  CHECK_GE(num_hot_blocks_, 1);
+}
+
+template <class T>
+void ChunkedTrailStack<T>::Push(T* address) {
+  const int offset = size_ % block_size_;
+  if (offset == 0) {
+    const int64 index = size_ / block_size_;
+    if (index == static_cast<int64>(blocks_.size())) {
+      blocks_.emplace_back(new Block());
+    }
+    EnsureRaw(blocks_[index].get());
+    top_index_ = index;
+    top_ = blocks_[index]->raw.get();
+    CompressColdBlock();
+  }
+  Entry& entry = (*top_)[offset];
+  entry.address = address;
+  entry.value = *address;
+  ++size_;
+  ++num_saves_;
+  if (size_ > max_size_) max_size_ = size_;
+}
+
+template <class T>
+void ChunkedTrailStack<T>::RestoreTo(int64 size) {
+  DCHECK_LE(size, size_);
+  while (size_ > size) {
+    const int64 index = (size_ - 1) / block_size_;
+    if (index != top_index_) {
+      EnsureRaw(blocks_[index].get());
+      top_index_ = index;
+      top_ = blocks_[index]->raw.get();
+      // Keeps one free block above the top, for the next descent.
+      ReleaseBlock(index + 2);
+    }
+    const int64 block_start = index * block_size_;
+    const int64 stop = std::max(size, block_start);
+    for (int64 i = size_ - 1; i >= stop; --i) {
+      const Entry& entry = (*top_)[i - block_start];
+      *entry.address = entry.value;
+    }
+    num_restores_ += size_ - stop;
+    size_ = stop;
+  }
+}
+
+template <class T>
+void ChunkedTrailStack<T>::EnsureRaw(Block* const block) {
+  MutexLock lock(&mutex_);
+  switch (block->state) {
+    case Block::RAW:
+      if (block->raw == nullptr) {
+        // Value-initialized, so that the padding bytes compress well.
+        block->raw.reset(new Entries(block_size_));
+      }
+      break;
+    case Block::QUEUED:
+      block->state = Block::RAW;
+      // The compression thread may be reading the data.
+      if (block->raw.use_count() > 1) {
+        block->raw.reset(new Entries(*block->raw));
+      }
+      break;
+    case Block::COMPRESSED: {
+      block->raw.reset(new Entries(block_size_));
+      CHECK(FastUncompress(block->compressed, block_size_ * sizeof(Entry),
+                           block->raw->data()))
+          << "Corrupted trail block in " << name_;
+      std::string().swap(block->compressed);
+      block->state = Block::RAW;
+      ++num_decompressions_;
+      break;
+    }
+  }
+}
+
+template <class T>
+void ChunkedTrailStack<T>::CompressColdBlock() {
+  if (!compress_) return;
+  const int64 index = size_ / block_size_ - num_hot_blocks_;
+  if (index < 0) return;
+  Block* const block = blocks_[index].get();
+  {
+    MutexLock lock(&mutex_);
+    if (block->state != Block::RAW) return;
+    block->state = Block::QUEUED;
+  }
+  if (pool_ != nullptr) {
+    pool_->Add(NewCallback(this, &ChunkedTrailStack<T>::CompressBlock, block));
+  } else {
+    CompressBlock(block);
+  }
+}
+
+template <class T>
+void ChunkedTrailStack<T>::CompressBlock(Block* const block) {
+  std::shared_ptr<Entries> raw;
+  {
+    MutexLock lock(&mutex_);
+    if (block->state != Block::QUEUED) return;
+    raw = block->raw;
+  }
+  std::string compressed;
+  FastCompress(raw->data(), block_size_ * sizeof(Entry), &compressed);
+  MutexLock lock(&mutex_);
+  // The search may have needed the block again in the meantime.
+  if (block->state != Block::QUEUED || block->raw != raw) return;
+  block->compressed.swap(compressed);
+  block->raw.reset();
+  block->state = Block::COMPRESSED;
+  ++num_compressions_;
+}
+
+template <class T>
+void ChunkedTrailStack<T>::ReleaseBlock(int64 index) {
+  if (index >= static_cast<int64>(blocks_.size())) return;
+  Block* const block = blocks_[index].get();
+  MutexLock lock(&mutex_);
+  // A pending compression of this block will see that it is not QUEUED.
+  block->state = Block::RAW;
+  block->raw.reset();
+  std::string().swap(block->compressed);
+}
+
+template <class T>
+int64 ChunkedTrailStack<T>::num_compressions() const {
+  MutexLock lock(&mutex_);
+  return num_compressions_;
+}
+
+template <class T>
+int64 ChunkedTrailStack<T>::MemoryUsage() const {
+  MutexLock lock(&mutex_);
+  int64 memory = 0;
+  for (const std::unique_ptr<Block>& block : blocks_) {
+    if (block->raw != nullptr) memory += block_size_ * sizeof(Entry);
+    memory += block->compressed.capacity();
+  }
+  return memory;
+}
+
+template <class T>
+std::string ChunkedTrailStack<T>::DebugString() const {
+  return StringPrintf(
+      "%-8s saves: %lld, restores: %lld, max size: %lld, memory: %lld bytes, "
+      "compressions: %lld, decompressions: %lld",
+      name_.c_str(), static_cast<long long>(num_saves_),       // NOLINT
+      static_cast<long long>(num_restores_),                    // NOLINT
+      static_cast<long long>(max_size_),                        // NOLINT
+      static_cast<long long>(MemoryUsage()),                    // NOLINT
+      static_cast<long long>(num_compressions()),               // NOLINT
+      static_cast<long long>(num_decompressions_));             // NOLINT
+}
+
+inline ArenaTrail::ArenaTrail(Solver* const solver,
+                              const ArenaTrailParameters& parameters)
+    : solver_(solver),
+      pool_(parameters.compress_cold_blocks &&
+                    parameters.background_compression
+                ? new ThreadPool("ArenaTrail", 1)
+                : nullptr),
+      int_stack_("int", parameters, pool_.get()),
+      int64_stack_("int64", parameters, pool_.get()),
+      uint64_stack_("uint64", parameters, pool_.get()),
+      double_stack_("double", parameters, pool_.get()),
+      bool_stack_("bool", parameters, pool_.get()),
+      pointer_stack_("pointer", parameters, pool_.get()),
+      marked_stamp_(kuint64max) {
+  if (pool_ != nullptr) pool_->StartWorkers();
+}
+
+inline ArenaTrail::~ArenaTrail() {
+  // Waits for the pending compressions before the stacks are destroyed.
+  pool_.reset();
+}
+
+inline void ArenaTrail::MarkNode() {
+  if (solver_->stamp() == marked_stamp_) return;
+  Node node;
+  node.sizes[0] = int_stack_.size();
+  node.sizes[1] = int64_stack_.size();
+  node.sizes[2] = uint64_stack_.size();
+  node.sizes[3] = double_stack_.size();
+  node.sizes[4] = bool_stack_.size();
+  node.sizes[5] = pointer_stack_.size();
+  const int index = nodes_.size();
+  nodes_.push_back(node);
+  solver_->AddBacktrackAction(
+      [this, index](Solver* solver) { BacktrackToNode(index); }, true);
+  // Read after AddBacktrackAction(), which pushes a marker and changes the
+  // stamp, so that the next values saved in this node don't mark it again.
+  marked_stamp_ = solver_->stamp();
+}
+
+inline void ArenaTrail::BacktrackToNode(int node) {
+  DCHECK_LT(node, static_cast<int>(nodes_.size()));
+  const Node& sizes = nodes_[node];
+  int_stack_.RestoreTo(sizes.sizes[0]);
+  int64_stack_.RestoreTo(sizes.sizes[1]);
+  uint64_stack_.RestoreTo(sizes.sizes[2]);
+  double_stack_.RestoreTo(sizes.sizes[3]);
+  bool_stack_.RestoreTo(sizes.sizes[4]);
+  pointer_stack_.RestoreTo(sizes.sizes[5]);
+  nodes_.resize(node);
+  // The next saved value must mark a new node, even if the stamp is the same.
+  marked_stamp_ = kuint64max;
+}
+
+inline int64 ArenaTrail::MemoryUsage() const {
+  return int_stack_.MemoryUsage() + int64_stack_.MemoryUsage() +
+         uint64_stack_.MemoryUsage() + double_stack_.MemoryUsage() +
+         bool_stack_.MemoryUsage() + pointer_stack_.MemoryUsage() +
+         nodes_.capacity() * sizeof(Node);
+}
+
+inline std::string ArenaTrail::StatsString() const {
+  std::string result;
+  result += int_stack_.DebugString() + "\n";
+  result += int64_stack_.DebugString() + "\n";
+  result += uint64_stack_.DebugString() + "\n";
+  result += double_stack_.DebugString() + "\n";
+  result += bool_stack_.DebugString() + "\n";
+  result += pointer_stack_.DebugString() + "\n";
+  return result;
+}
+
+}  // namespace operations_research
+
+#endif  // OR_TOOLS_CONSTRAINT_SOLVER_ARENA_TRAIL_H_
@@ -0,0 +1,315 @@
+// Copyright 2010-2014 Google
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+// Batched processing of variable events for constraints with many
+// variables.
+//
+// The usual way to propagate a constraint on n variables is to attach one
+// demon per variable, e.g. MakeConstraintDemon1(s, this, &C::ProcessVar, i),
+// that runs each time the variable changes. With millions of demons, the
+// cost is dominated by the demon calls themselves: a variable that changes
+// several times in a propagation wave runs its demon each time, and each run
+// usually redoes work that the next one would redo anyway.
+//
+// A BatchedEventQueue replaces these demons by tiny event demons that only
+// record the index of the variable in a ring buffer, and schedules a single
+// delayed demon that processes the recorded indices in a batch:
+// - Repeated events on the same variable within a propagation wave are
+//   coalesced: the index is recorded once until it is processed.
+// - The processing demon is enqueued once per wave, however many events
+//   arrive.
+// - For constraints whose propagation only depends on the current domains,
+//   and not on which variables changed, set_idempotent(true) skips the
+//   recording of the indices altogether: the events only schedule one call
+//   to the flush method per wave.
+//
+// Usage, in a constraint with the methods ProcessVar(int) and Propagate():
+//   void MyConstraint::Post() {
+//     events_ = solver()->RevAlloc(new BatchedEventQueue<MyConstraint>(
+//         solver(), this, vars_.size(), &MyConstraint::ProcessVar,
+//         &MyConstraint::Propagate, "MyConstraint"));
+//     events_->WhenBound(vars_);
+//   }
+//
+// The state of the queue is not reversible: after a failure, the pending
+// indices are dropped, which is detected lazily with Solver::fail_stamp().
+
+#ifndef OR_TOOLS_CONSTRAINT_SOLVER_BATCHED_EVENTS_H_
+#define OR_TOOLS_CONSTRAINT_SOLVER_BATCHED_EVENTS_H_
+
+#include <string>
+#include <vector>
+
+#include "base/integral_types.h"
+#include "base/logging.h"
+#include "base/macros.h"
+#include "base/stringprintf.h"
+#include "constraint_solver/constraint_solver.h"
+
+namespace operations_research {
+
+// A FIFO queue in a power-of-two circular buffer, which grows as needed and
+// never shrinks.
+template <class T>
+class RingBuffer {
+ public:
+  RingBuffer() : data_(16), head_(0), size_(0) {}
+
+  bool empty() const { return size_ == 0; }
+  int size() const { return size_; }
+
+  void push_back(const T& value) {
+    if (size_ == static_cast<int>(data_.size())) Grow();
+    data_[(head_ + size_) & (data_.size() - 1)] = value;
+    ++size_;
+  }
+
+  T pop_front() {
+    DCHECK_GT(size_, 0);
+    const T value = data_[head_];
+    head_ = (head_ + 1) & (data_.size() - 1);
+    --size_;
+    return value;
+  }
+
+  void clear() {
+    head_ = 0;
+    size_ = 0;
+  }
+
+ private:
+  void Grow() {
+    std::vector<T> data(2 * data_.size());
+    for (int i = 0; i < size_; ++i) {
+      data[i] = data_[(head_ + i) & (data_.size() - 1)];
+    }
+    data_.swap(data);
+    head_ = 0;
+  }
+
+  std::vector<T> data_;
+  int head_;
+  int size_;
+};
+
+template <class C>
+class BatchedEventQueue : public PropagationBaseObject {
+ public:
+  typedef void (C::*ProcessMethod)(int index);
+  typedef void (C::*FlushMethod)();
+
+  // 'process' is called once per recorded index, and 'flush' once at the end
+  // of each batch. Either can be nullptr. The indices are in
+  // [0, num_indices). The batch runs with the given priority, which must be
+  // VAR_PRIORITY or DELAYED_PRIORITY.
+  BatchedEventQueue(Solver* const s, C* const ct, int num_indices,
+                    ProcessMethod process, FlushMethod flush,
+                    const std::string& name,
+                    Solver::DemonPriority priority = Solver::DELAYED_PRIORITY);
+  ~BatchedEventQueue() override {}
+
+  // Attaches an event demon for the given index to the variable.
+  void WhenBound(IntVar* const var, int index);
+  void WhenRange(IntVar* const var, int index);
+  void WhenDomain(IntVar* const var, int index);
+  // Same, with the index of each variable in the vector.
+  void WhenBound(const std::vector<IntVar*>& vars);
+  void WhenRange(const std::vector<IntVar*>& vars);
+  void WhenDomain(const std::vector<IntVar*>& vars);
+
+  void set_idempotent(bool idempotent) { idempotent_ = idempotent; }
+
+  // Records an event on the given index, and schedules the batch if needed.
+  void Push(int index);
+
+  // Statistics since the creation of the queue.
+  int64 num_events() const { return num_events_; }
+  int64 num_coalesced_events() const { return num_coalesced_events_; }
+  int64 num_batches() const { return num_batches_; }
+  std::string DebugString() const override;
+
+ private:
+  class EventDemon : public Demon {
+   public:
+    EventDemon(BatchedEventQueue* const queue, int index)
+        : queue_(queue), index_(index) {}
+    ~EventDemon() override {}
+    void Run(Solver* const s) override { queue_->Push(index_); }
+    std::string DebugString() const override {
+      return StringPrintf("EventDemon(%s, %d)", queue_->name().c_str(),
+                          index_);
+    }
+
+   private:
+    BatchedEventQueue* const queue_;
+    const int index_;
+  };
+
+  class BatchDemon : public Demon {
+   public:
+    BatchDemon(BatchedEventQueue* const queue, Solver::DemonPriority priority)
+        : queue_(queue), priority_(priority) {}
+    ~BatchDemon() override {}
+    void Run(Solver* const s) override { queue_->ProcessBatch(); }
+    Solver::DemonPriority priority() const override { return priority_; }
+    std::string DebugString() const override {
+      return StringPrintf("BatchDemon(%s)", queue_->name().c_str());
+    }
+
+   private:
+    BatchedEventQueue* const queue_;
+    const Solver::DemonPriority priority_;
+  };
+
+  // Drops the state left by a failure.
+  void ResetIfFailed();
+  void ProcessBatch();
+
+  C* const constraint_;
+  const ProcessMethod process_;
+  const FlushMethod flush_;
+  const Solver::DemonPriority priority_;
+  Demon* const batch_demon_;
+  RingBuffer<int> pending_;
+  std::vector<bool> is_pending_;
+  bool scheduled_;
+  bool idempotent_;
+  uint64 fail_stamp_;
+  int64 num_events_;
+  int64 num_coalesced_events_;
+  int64 num_batches_;
+
+  DISALLOW_COPY_AND_ASSIGN(BatchedEventQueue);
+};
+
+// ============================================================================
+// Implementation.
+// ============================================================================
+
+template <class C>
+BatchedEventQueue<C>::BatchedEventQueue(Solver* const s, C* const ct,
+                                        int num_indices, ProcessMethod process,
+                                        FlushMethod flush,
+                                        const std::string& name,
+                                        Solver::DemonPriority priority)
+    : PropagationBaseObject(s),
+      constraint_(ct),
+      process_(process),
+      flush_(flush),
+      priority_(priority),
+      batch_demon_(s->RevAlloc(new BatchDemon(this, priority))),
+      is_pending_(num_indices, false),
+      scheduled_(false),
+      idempotent_(false),
+      fail_stamp_(0),
+      num_events_(0),
+      num_coalesced_events_(0),
+      num_batches_(0) {
+  CHECK(priority == Solver::VAR_PRIORITY ||
+        priority == Solver::DELAYED_PRIORITY);
+  set_name(name);
+}
+
+template <class C>
+void BatchedEventQueue<C>::WhenBound(IntVar* const var, int index) {
+  var->WhenBound(solver()->RevAlloc(new EventDemon(this, index)));
+}
+
+template <class C>
+void BatchedEventQueue<C>::WhenRange(IntVar* const var, int index) {
+  var->WhenRange(solver()->RevAlloc(new EventDemon(this, index)));
+}
+
+template <class C>
+void BatchedEventQueue<C>::WhenDomain(IntVar* const var, int index) {
+  var->WhenDomain(solver()->RevAlloc(new EventDemon(this, index)));
+}
+
+template <class C>
+void BatchedEventQueue<C>::WhenBound(const std::vector<IntVar*>& vars) {
+  const int size = vars.size();
+  for (int i = 0; i < size; ++i) WhenBound(vars[i], i);
+}
+
+template <class C>
+void BatchedEventQueue<C>::WhenRange(const std::vector<IntVar*>& vars) {
+  const int size = vars.size();
+  for (int i = 0; i < size; ++i) WhenRange(vars[i], i);
+}
+
+template <class C>
+void BatchedEventQueue<C>::WhenDomain(const std::vector<IntVar*>& vars) {
+  const int size = vars.size();
+  for (int i = 0; i < size; ++i) WhenDomain(vars[i], i);
+}
+
+template <class C>
+void BatchedEventQueue<C>::ResetIfFailed() {
+  const uint64 fail_stamp = solver()->fail_stamp();
+  if (fail_stamp == fail_stamp_) return;
+  fail_stamp_ = fail_stamp;
+  while (!pending_.empty()) is_pending_[pending_.pop_front()] = false;
+  scheduled_ = false;
+}
+
+template <class C>
+void BatchedEventQueue<C>::Push(int index) {
+  ResetIfFailed();
+  ++num_events_;
+  if (!idempotent_) {
+    if (is_pending_[index]) {
+      ++num_coalesced_events_;
+      return;
+    }
+    is_pending_[index] = true;
+    pending_.push_back(index);
+  }
+  if (scheduled_) {
+    if (idempotent_) ++num_coalesced_events_;
+    return;
+  }
+  scheduled_ = true;
+  if (priority_ == Solver::VAR_PRIORITY) {
+    EnqueueVar(batch_demon_);
+  } else {
+    EnqueueDelayedDemon(batch_demon_);
+  }
+}
+
+template <class C>
+void BatchedEventQueue<C>::ProcessBatch() {
+  ResetIfFailed();
+  ++num_batches_;
+  // The events caused by the processing arrive after this demon returns, and
+  // need a new batch.
+  scheduled_ = false;
+  while (!pending_.empty()) {
+    const int index = pending_.pop_front();
+    is_pending_[index] = false;
+    if (process_ != nullptr) (constraint_->*process_)(index);
+  }
+  if (flush_ != nullptr) (constraint_->*flush_)();
+}
+
+template <class C>
+std::string BatchedEventQueue<C>::DebugString() const {
+  return StringPrintf(
+      "BatchedEventQueue(%s, %lld events, %lld coalesced, %lld batches)",
+      name().c_str(), static_cast<long long>(num_events_),  // NOLINT
+      static_cast<long long>(num_coalesced_events_),          // NOLINT
+      static_cast<long long>(num_batches_));                  // NOLINT
+}
+
+}  // namespace operations_research
+
+#endif  // OR_TOOLS_CONSTRAINT_SOLVER_BATCHED_EVENTS_H_
@@ -0,0 +1,786 @@
+// Copyright 2010-2014 Google
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+// An integer variable whose domain is stored as a bitset of 64-bit words.
+//
+// The domain variables created by Solver::MakeIntVar() are tuned for
+// domains given as ranges with a few holes: values are removed and trailed
+// one by one, and RemoveValues() or SetValues() with thousands of values
+// cost thousands of removals. BitsetIntVar is meant for large domains with
+// many holes, like the frequency domains of frequency assignment problems:
+// - RemoveValues(), SetValues(), RemoveInterval() and the mask operations
+//   below work a word at a time, and the size of the domain is maintained
+//   with population counts.
+// - The trail saves whole words, at most once per word and per search node,
+//   instead of one entry per removed value.
+// - The bounds are reversible; bits outside of [Min(), Max()] are ignored,
+//   so bound changes never touch the words.
+// - All the removals of a call are notified to the demons of the variable in
+//   a single propagation event.
+//
+// The memory usage is 5/8 byte per value of the initial span, whatever the
+// number of values: five vectors of one bit per value hold the domain, the
+// save stamps, the pending removals, the holes and a scratch mask. For
+// sparse domains, MakeIntVarFromValues() below chooses between a bitset
+// variable and a regular domain variable, with the thresholds of
+// BitsetDomainParameters.
+
+#ifndef OR_TOOLS_CONSTRAINT_SOLVER_BITSET_INT_VAR_H_
+#define OR_TOOLS_CONSTRAINT_SOLVER_BITSET_INT_VAR_H_
+
+#include <algorithm>
+#include <memory>
+#include <string>
+#include <vector>
+
+#include "base/integral_types.h"
+#include "base/logging.h"
+#include "base/macros.h"
+#include "base/stringprintf.h"
+#include "constraint_solver/constraint_solver.h"
+#include "constraint_solver/constraint_solveri.h"
+#include "util/bitset.h"
+
+namespace operations_research {
+
+// Parameters for the choice of the domain representation in
+// MakeIntVarFromValues().
+struct BitsetDomainParameters {
+  BitsetDomainParameters()
+      : min_domain_size(256), min_density(0.05), max_span(1 << 24) {}
+
+  // Domains with fewer values use a regular domain variable.
+  int64 min_domain_size;
+  // Minimum ratio between the number of values and the span
+  // max - min + 1 of the domain. Sparser domains use a regular domain
+  // variable.
+  double min_density;
+  // Domains with a larger span use a regular domain variable, whatever their
+  // density.
+  int64 max_span;
+};
+
+class BitsetIntVar : public IntVar {
+ public:
+  // Creates a variable with the given values. Duplicates are allowed.
+  BitsetIntVar(Solver* const s, const std::vector<int64>& values,
+               const std::string& name);
+  // Creates a variable with the domain [vmin, vmax].
+  BitsetIntVar(Solver* const s, int64 vmin, int64 vmax,
+               const std::string& name);
+  ~BitsetIntVar() override {}
+
+  int64 Min() const override { return min_.Value(); }
+  void SetMin(int64 m) override;
+  int64 Max() const override { return max_.Value(); }
+  void SetMax(int64 m) override;
+  void SetRange(int64 l, int64 u) override;
+  void SetValue(int64 v) override { SetRange(v, v); }
+  bool Bound() const override { return min_.Value() == max_.Value(); }
+  int64 Value() const override {
+    CHECK_EQ(min_.Value(), max_.Value()) << "variable is not bound";
+    return min_.Value();
+  }
+  void RemoveValue(int64 v) override;
+  void RemoveInterval(int64 l, int64 u) override;
+  void RemoveValues(const std::vector<int64>& values) override;
+  void SetValues(const std::vector<int64>& values) override;
+  void WhenBound(Demon* d) override;
+  void WhenRange(Demon* d) override;
+  void WhenDomain(Demon* d) override;
+  uint64 Size() const override { return size_.Value(); }
+  bool Contains(int64 v) const override;
+  IntVarIterator* MakeHoleIterator(bool reversible) const override;
+  IntVarIterator* MakeDomainIterator(bool reversible) const override;
+  int64 OldMin() const override { return std::min(old_min_, min_.Value()); }
+  int64 OldMax() const override { return std::max(old_max_, max_.Value()); }
+  IntVar* IsEqual(int64 constant) override;
+  IntVar* IsDifferent(int64 constant) override;
+  IntVar* IsGreaterOrEqual(int64 constant) override;
+  IntVar* IsLessOrEqual(int64 constant) override;
+  std::string DebugString() const override;
+  std::string BaseName() const override { return "BitsetIntVar"; }
+
+  // Word-level access. Bit b of word i stands for the value
+  // offset() + 64 * i + b. Only the bits in [Min(), Max()] are meaningful.
+  int64 offset() const { return offset_; }
+  int num_words() const { return num_words_; }
+  uint64 word(int i) const { return words_[i]; }
+
+  // Returns the number of values of the domain in [l, u].
+  int64 CountValuesInRange(int64 l, int64 u) const;
+
+  // Removes from the domain the values whose bit is set in 'mask', which has
+  // num_words() words with the layout above.
+  void RemoveMask(const std::vector<uint64>& mask);
+  // Removes from the domain the values whose bit is not set in 'mask'.
+  void IntersectWithMask(const std::vector<uint64>& mask);
+
+ private:
+  class Handler;
+  class DomainIterator;
+  class HoleIterator;
+  class IsBetweenCt;
+
+  void Init(int64 vmin, int64 vmax);
+  // Returns true if the demons of the variable are running. This is detected
+  // lazily after a failure, which interrupts them.
+  bool InProcess();
+  void Process();
+  void Push() { EnqueueVar(handler_.get()); }
+  // Saves the word once per search node before its first modification.
+  void SaveWord(int index);
+  void RecordHoles(int index, uint64 removed);
+  void ClearHoles();
+  // Removes from the values in [l, u] of the domain the ones whose bit is
+  // set in removed_bits(word_index).
+  template <class F>
+  void RemoveBits(int64 l, int64 u, const F& removed_bits);
+  // Removes the values of 'values' from the domain if 'remove' is true,
+  // keeps only them otherwise.
+  void RemoveOrKeepValues(const std::vector<int64>& values, bool remove);
+  void ApplyPendingRemovals();
+
+  int64 offset_;
+  int num_words_;
+  // The domain, and the stamp of the last save of each word.
+  std::vector<uint64> words_;
+  std::vector<uint64> stamps_;
+  Rev<int64> min_;
+  Rev<int64> max_;
+  Rev<int64> size_;
+  int64 old_min_;
+  int64 old_max_;
+  // Bound changes and removals that arrive while the demons run, applied
+  // when they are done.
+  bool in_process_;
+  uint64 process_fail_stamp_;
+  int64 new_min_;
+  int64 new_max_;
+  std::vector<uint64> pending_;
+  int pending_first_;
+  int pending_last_;
+  // Values removed since the last processing, for the hole iterators.
+  std::vector<uint64> holes_;
+  int holes_first_;
+  int holes_last_;
+  uint64 holes_stamp_;
+  // Scratch mask for RemoveValues(), SetValues() and the pending removals.
+  std::vector<uint64> scratch_;
+  std::unique_ptr<Demon> handler_;
+  SimpleRevFIFO<Demon*> bound_demons_;
+  SimpleRevFIFO<Demon*> range_demons_;
+  SimpleRevFIFO<Demon*> domain_demons_;
+  SimpleRevFIFO<Demon*> delayed_bound_demons_;
+  SimpleRevFIFO<Demon*> delayed_range_demons_;
+  SimpleRevFIFO<Demon*> delayed_domain_demons_;
+
+  DISALLOW_COPY_AND_ASSIGN(BitsetIntVar);
+};
+
+// Creates a bitset variable with the given values, or the domain
+// [vmin, vmax]. The solver takes ownership of the variable.
+IntVar* MakeBitsetIntVar(Solver* const s, const std::vector<int64>& values,
+                         const std::string& name);
+IntVar* MakeBitsetIntVar(Solver* const s, int64 vmin, int64 vmax,
+                         const std::string& name);
+
+// Creates a variable with the given values, with a bitset domain if the
+// domain is large and dense enough according to 'parameters', and with
+// Solver::MakeIntVar() otherwise.
+IntVar* MakeIntVarFromValues(Solver* const s, const std::vector<int64>& values,
+                             const std::string& name,
+                             const BitsetDomainParameters& parameters);
+
+// ============================================================================
+// Implementation.
+// ============================================================================
+
+class BitsetIntVar::Handler : public Demon {
+ public:
+  explicit Handler(BitsetIntVar* const var) : var_(var) {}
+  ~Handler() override {}
+  void Run(Solver* const s) override { var_->Process(); }
+  Solver::DemonPriority priority() const override {
+    return Solver::VAR_PRIORITY;
+  }
+  std::string DebugString() const override {
+    return StringPrintf("Handler(%s)", var_->DebugString().c_str());
+  }
+
+ private:
+  BitsetIntVar* const var_;
+};
+
+class BitsetIntVar::DomainIterator : public IntVarIterator {
+ public:
+  explicit DomainIterator(const BitsetIntVar* const var)
+      : var_(var), current_(0), max_(0) {}
+  ~DomainIterator() override {}
+
+  void Init() override {
+    current_ = var_->Min();
+    max_ = var_->Max();
+  }
+  bool Ok() const override { return current_ <= max_; }
+  int64 Value() const override { return current_; }
+  void Next() override {
+    if (current_ == max_) {
+      current_ = max_ + 1;
+      return;
+    }
+    // The bit of max_ is set, so the search always succeeds.
+    current_ = var_->offset_ + UnsafeLeastSignificantBitPosition64(
+                                   var_->words_.data(),
+                                   current_ + 1 - var_->offset_,
+                                   max_ - var_->offset_);
+  }
+
+ private:
+  const BitsetIntVar* const var_;
+  int64 current_;
+  int64 max_;
+};
+
+class BitsetIntVar::HoleIterator : public IntVarIterator {
+ public:
+  explicit HoleIterator(const BitsetIntVar* const var)
+      : var_(var), index_(0), bits_(0) {}
+  ~HoleIterator() override {}
+
+  void Init() override {
+    index_ = var_->holes_first_;
+    bits_ = index_ <= var_->holes_last_ ? var_->holes_[index_] : 0;
+    Advance();
+  }
+  bool Ok() const override { return index_ <= var_->holes_last_; }
+  int64 Value() const override {
+    return var_->offset_ + 64 * index_ + LeastSignificantBitPosition64(bits_);
+  }
+  void Next() override {
+    bits_ &= bits_ - 1;
+    Advance();
+  }
+
+ private:
+  // Moves to the next word with a hole if the current one has none left.
+  void Advance() {
+    while (bits_ == 0 && index_ <= var_->holes_last_) {
+      ++index_;
+      if (index_ <= var_->holes_last_) bits_ = var_->holes_[index_];
+    }
+  }
+
+  const BitsetIntVar* const var_;
+  int index_;
+  uint64 bits_;
+};
+
+// boolvar == (var in [lo, hi]).
+class BitsetIntVar::IsBetweenCt : public Constraint {
+ public:
+  IsBetweenCt(Solver* const s, BitsetIntVar* const var, int64 lo, int64 hi,
+              IntVar* const boolvar)
+      : Constraint(s), var_(var), lo_(lo), hi_(hi), boolvar_(boolvar) {}
+  ~IsBetweenCt() override {}
+
+  void Post() override {
+    Demon* const demon = solver()->MakeConstraintInitialPropagateCallback(this);
+    var_->WhenDomain(demon);
+    boolvar_->WhenBound(demon);
+  }
+
+  void InitialPropagate() override {
+    if (boolvar_->Min() == 1) {
+      var_->SetRange(lo_, hi_);
+    } else if (boolvar_->Max() == 0) {
+      var_->RemoveInterval(lo_, hi_);
+    } else if (var_->Min() >= lo_ && var_->Max() <= hi_) {
+      boolvar_->SetValue(1);
+    } else if (var_->CountValuesInRange(lo_, hi_) == 0) {
+      boolvar_->SetValue(0);
+    }
+  }
+
+  std::string DebugString() const override {
+    return StringPrintf("IsBetweenCt(%s, %" GG_LL_FORMAT "d, %" GG_LL_FORMAT
+                        "d, %s)",
+                        var_->DebugString().c_str(), lo_, hi_,
+                        boolvar_->DebugString().c_str());
+  }
+
+ private:
+  BitsetIntVar* const var_;
+  const int64 lo_;
+  const int64 hi_;
+  IntVar* const boolvar_;
+};
+
+inline BitsetIntVar::BitsetIntVar(Solver* const s,
+                                  const std::vector<int64>& values,
+                                  const std::string& name)
+    : IntVar(s, name), min_(0), max_(0), size_(0) {
+  CHECK(!values.empty());
+  const int64 vmin = *std::min_element(values.begin(), values.end());
+  const int64 vmax = *std::max_element(values.begin(), values.end());
+  Init(vmin, vmax);
+  int64 size = 0;
+  for (const int64 value : values) {
+    const uint64 position = value - offset_;
+    if (!IsBitSet64(words_.data(), position)) {
+      SetBit64(words_.data(), position);
+      ++size;
+    }
+  }
+  size_.SetValue(s, size);
+}
+
+inline BitsetIntVar::BitsetIntVar(Solver* const s, int64 vmin, int64 vmax,
+                                  const std::string& name)
+    : IntVar(s, name), min_(0), max_(0), size_(0) {
+  CHECK_LE(vmin, vmax);
+  Init(vmin, vmax);
+  const uint64 span = vmax - vmin + 1;
+  for (int i = 0; i < num_words_; ++i) words_[i] = kAllBits64;
+  if (BitPos64(span) != 0) {
+    words_[num_words_ - 1] = IntervalDown64(BitPos64(span) - 1);
+  }
+  size_.SetValue(s, span);
+}
+
+inline void BitsetIntVar::Init(int64 vmin, int64 vmax) {
+  offset_ = vmin;
+  num_words_ = BitLength64(vmax - vmin + 1);
+  words_.assign(num_words_, 0);
+  stamps_.assign(num_words_, 0);
+  min_.SetValue(solver(), vmin);
+  max_.SetValue(solver(), vmax);
+  old_min_ = vmin;
+  old_max_ = vmax;
+  in_process_ = false;
+  process_fail_stamp_ = 0;
+  new_min_ = vmin;
+  new_max_ = vmax;
+  pending_.assign(num_words_, 0);
+  pending_first_ = num_words_;
+  pending_last_ = -1;
+  holes_.assign(num_words_, 0);
+  holes_first_ = num_words_;
+  holes_last_ = -1;
+  holes_stamp_ = 0;
+  scratch_.assign(num_words_, 0);
+  handler_.reset(new Handler(this));
+}
+
+inline bool BitsetIntVar::InProcess() {
+  if (in_process_ && process_fail_stamp_ != solver()->fail_stamp()) {
+    in_process_ = false;
+    for (int i = pending_first_; i <= pending_last_; ++i) pending_[i] = 0;
+    pending_first_ = num_words_;
+    pending_last_ = -1;
+    ClearHoles();
+  }
+  return in_process_;
+}
+
+inline void BitsetIntVar::SaveWord(int index) {
+  const uint64 stamp = solver()->stamp();
+  if (stamps_[index] < stamp) {
+    stamps_[index] = stamp;
+    solver()->SaveValue(&words_[index]);
+  }
+}
+
+inline void BitsetIntVar::RecordHoles(int index, uint64 removed) {
+  const uint64 stamp = solver()->stamp();
+  if (holes_stamp_ != stamp) {
+    ClearHoles();
+    holes_stamp_ = stamp;
+  }
+  holes_[index] |= removed;
+  holes_first_ = std::min(holes_first_, index);
+  holes_last_ = std::max(holes_last_, index);
+}
+
+inline void BitsetIntVar::ClearHoles() {
+  for (int i = holes_first_; i <= holes_last_; ++i) holes_[i] = 0;
+  holes_first_ = num_words_;
+  holes_last_ = -1;
+}
+
+inline void BitsetIntVar::SetMin(int64 m) {
+  if (m <= min_.Value()) return;
+  SetRange(m, max_.Value());
+}
+
+inline void BitsetIntVar::SetMax(int64 m) {
+  if (m >= max_.Value()) return;
+  SetRange(min_.Value(), m);
+}
+
+inline void BitsetIntVar::SetRange(int64 l, int64 u) {
+  const int64 vmin = min_.Value();
+  const int64 vmax = max_.Value();
+  if (l <= vmin && u >= vmax) return;
+  if (l > u || l > vmax || u < vmin) solver()->Fail();
+  if (InProcess()) {
+    new_min_ = std::max(new_min_, l);
+    new_max_ = std::min(new_max_, u);
+    if (new_min_ > new_max_) solver()->Fail();
+    return;
+  }
+  const uint64* const words = words_.data();
+  int64 new_min = vmin;
+  int64 new_max = vmax;
+  if (l > vmin) {
+    const int64 position = LeastSignificantBitPosition64(
+        words, l - offset_, std::min(u, vmax) - offset_);
+    if (position == -1) solver()->Fail();
+    new_min = offset_ + position;
+  }
+  if (u < vmax) {
+    // The bit of new_min is set, so the search always succeeds.
+    new_max = offset_ + UnsafeMostSignificantBitPosition64(
+                            words, new_min - offset_, u - offset_);
+  }
+  int64 removed = 0;
+  if (new_min > vmin) {
+    removed += BitCountRange64(words, vmin - offset_, new_min - 1 - offset_);
+  }
+  if (new_max < vmax) {
+    removed += BitCountRange64(words, new_max + 1 - offset_, vmax - offset_);
+  }
+  min_.SetValue(solver(), new_min);
+  max_.SetValue(solver(), new_max);
+  size_.SetValue(solver(), size_.Value() - removed);
+  Push();
+}
+
+inline void BitsetIntVar::RemoveValue(int64 v) {
+  const int64 vmin = min_.Value();
+  const int64 vmax = max_.Value();
+  if (v < vmin || v > vmax) return;
+  if (v == vmin) {
+    SetMin(v + 1);
+  } else if (v == vmax) {
+    SetMax(v - 1);
+  } else {
+    RemoveBits(v, v, [](int index) { return kAllBits64; });
+  }
+}
+
+inline void BitsetIntVar::RemoveInterval(int64 l, int64 u) {
+  DCHECK_LE(l, u);
+  const int64 vmin = min_.Value();
+  const int64 vmax = max_.Value();
+  if (l <= vmin) {
+    if (u >= vmax) solver()->Fail();
+    SetMin(u + 1);
+  } else if (u >= vmax) {
+    SetMax(l - 1);
+  } else {
+    RemoveBits(l, u, [](int index) { return kAllBits64; });
+  }
+}
+
+template <class F>
+void BitsetIntVar::RemoveBits(int64 l, int64 u, const F& removed_bits) {
+  const uint64 first_bit = std::max(l, min_.Value()) - offset_;
+  const uint64 last_bit = std::min(u, max_.Value()) - offset_;
+  if (first_bit > last_bit) return;
+  const int first = BitOffset64(first_bit);
+  const int last = BitOffset64(last_bit);
+  const uint64 first_mask = IntervalUp64(BitPos64(first_bit));
+  const uint64 last_mask = IntervalDown64(BitPos64(last_bit));
+  uint64* const words = words_.data();
+  if (InProcess()) {
+    for (int i = first; i <= last; ++i) {
+      uint64 removed = words[i] & removed_bits(i);
+      if (i == first) removed &= first_mask;
+      if (i == last) removed &= last_mask;
+      pending_[i] |= removed;
+    }
+    pending_first_ = std::min(pending_first_, first);
+    pending_last_ = std::max(pending_last_, last);
+    return;
+  }
+  int64 num_removed = 0;
+  for (int i = first; i <= last; ++i) {
+    uint64 removed = words[i] & removed_bits(i);
+    if (i == first) removed &= first_mask;
+    if (i == last) removed &= last_mask;
+    if (removed == 0) continue;
+    SaveWord(i);
+    words[i] &= ~removed;
+    num_removed += BitCount64(removed);
+    RecordHoles(i, removed);
+  }
+  if (num_removed == 0) return;
+  if (num_removed == size_.Value()) solver()->Fail();
+  size_.SetValue(solver(), size_.Value() - num_removed);
+  const int64 vmin = min_.Value();
+  const int64 vmax = max_.Value();
+  if (!IsBitSet64(words, vmin - offset_)) {
+    min_.SetValue(solver(), offset_ + LeastSignificantBitPosition64(
+                                          words, vmin - offset_,
+                                          vmax - offset_));
+  }
+  if (!IsBitSet64(words, vmax - offset_)) {
+    // The bit of the new min is set, so the search always succeeds.
+    max_.SetValue(solver(), offset_ + UnsafeMostSignificantBitPosition64(
+                                          words, min_.Value() - offset_,
+                                          vmax - offset_));
+  }
+  Push();
+}
+
+inline void BitsetIntVar::RemoveMask(const std::vector<uint64>& mask) {
+  CHECK_EQ(num_words_, mask.size());
+  RemoveBits(min_.Value(), max_.Value(),
+             [&mask](int index) { return mask[index]; });
+}
+
+inline void BitsetIntVar::IntersectWithMask(const std::vector<uint64>& mask) {
+  CHECK_EQ(num_words_, mask.size());
+  RemoveBits(min_.Value(), max_.Value(),
+             [&mask](int index) { return ~mask[index]; });
+}
+
+inline void BitsetIntVar::RemoveOrKeepValues(const std::vector<int64>& values,
+                                             bool remove) {
+  const int64 vmin = min_.Value();
+  const int64 vmax = max_.Value();
+  // Failures unwind with a long jump, so the scratch mask is cleared before
+  // use rather than after.
+  std::fill(scratch_.begin() + BitOffset64(vmin - offset_),
+            scratch_.begin() + BitOffset64(vmax - offset_) + 1, 0);
+  for (const int64 value : values) {
+    if (value >= vmin && value <= vmax) {
+      SetBit64(scratch_.data(), value - offset_);
+    }
+  }
+  const uint64* const scratch = scratch_.data();
+  if (remove) {
+    RemoveBits(vmin, vmax, [scratch](int index) { return scratch[index]; });
+  } else {
+    RemoveBits(vmin, vmax, [scratch](int index) { return ~scratch[index]; });
+  }
+}
+
+inline void BitsetIntVar::RemoveValues(const std::vector<int64>& values) {
+  RemoveOrKeepValues(values, true);
+}
+
+inline void BitsetIntVar::SetValues(const std::vector<int64>& values) {
+  RemoveOrKeepValues(values, false);
+}
+
+inline void BitsetIntVar::ApplyPendingRemovals() {
+  if (pending_first_ > pending_last_) return;
+  const int first = pending_first_;
+  const int last = pending_last_;
+  pending_first_ = num_words_;
+  pending_last_ = -1;
+  // The removals can fail, so pending_ is cleared before they are applied.
+  for (int i = first; i <= last; ++i) {
+    scratch_[i] = pending_[i];
+    pending_[i] = 0;
+  }
+  const uint64* const scratch = scratch_.data();
+  RemoveBits(offset_ + 64 * first, offset_ + 64 * last + 63,
+             [scratch](int index) { return scratch[index]; });
+}
+
+inline void BitsetIntVar::Process() {
+  CHECK(!InProcess());
+  in_process_ = true;
+  process_fail_stamp_ = solver()->fail_stamp();
+  new_min_ = min_.Value();
+  new_max_ = max_.Value();
+  const bool is_bound = min_.Value() == max_.Value();
+  const bool range_changed =
+      min_.Value() != OldMin() || max_.Value() != OldMax();
+  // Immediate demons.
+  if (is_bound) ExecuteAll(bound_demons_);
+  if (range_changed) ExecuteAll(range_demons_);
+  ExecuteAll(domain_demons_);
+  // Delayed demons.
+  if (is_bound) EnqueueAll(delayed_bound_demons_);
+  if (range_changed) EnqueueAll(delayed_range_demons_);
+  EnqueueAll(delayed_domain_demons_);
+  in_process_ = false;
+  ClearHoles();
+  old_min_ = min_.Value();
+  old_max_ = max_.Value();
+  if (min_.Value() < new_min_) SetMin(new_min_);
+  if (max_.Value() > new_max_) SetMax(new_max_);
+  ApplyPendingRemovals();
+}
+
+inline void BitsetIntVar::WhenBound(Demon* d) {
+  if (min_.Value() == max_.Value()) return;
+  if (d->priority() == Solver::DELAYED_PRIORITY) {
+    delayed_bound_demons_.PushIfNotTop(solver(), solver()->RegisterDemon(d));
+  } else {
+    bound_demons_.PushIfNotTop(solver(), solver()->RegisterDemon(d));
+  }
+}
+
+inline void BitsetIntVar::WhenRange(Demon* d) {
+  if (min_.Value() == max_.Value()) return;
+  if (d->priority() == Solver::DELAYED_PRIORITY) {
+    delayed_range_demons_.PushIfNotTop(solver(), solver()->RegisterDemon(d));
+  } else {
+    range_demons_.PushIfNotTop(solver(), solver()->RegisterDemon(d));
+  }
+}
+
+inline void BitsetIntVar::WhenDomain(Demon* d) {
+  if (min_.Value() == max_.Value()) return;
+  if (d->priority() == Solver::DELAYED_PRIORITY) {
+    delayed_domain_demons_.PushIfNotTop(solver(), solver()->RegisterDemon(d));
+  } else {
+    domain_demons_.PushIfNotTop(solver(), solver()->RegisterDemon(d));
+  }
+}
+
+inline bool BitsetIntVar::Contains(int64 v) const {
+  return v >= min_.Value() && v <= max_.Value() &&
+         IsBitSet64(words_.data(), v - offset_);
+}
+
+inline int64 BitsetIntVar::CountValuesInRange(int64 l, int64 u) const {
+  l = std::max(l, min_.Value());
+  u = std::min(u, max_.Value());
+  if (l > u) return 0;
+  return BitCountRange64(words_.data(), l - offset_, u - offset_);
+}
+
+inline IntVarIterator* BitsetIntVar::MakeHoleIterator(bool reversible) const {
+  IntVarIterator* const it = new HoleIterator(this);
+  return reversible ? solver()->RevAlloc(it) : it;
+}
+
+inline IntVarIterator* BitsetIntVar::MakeDomainIterator(
+    bool reversible) const {
+  IntVarIterator* const it = new DomainIterator(this);
+  return reversible ? solver()->RevAlloc(it) : it;
+}
+
+inline IntVar* BitsetIntVar::IsEqual(int64 constant) {
+  Solver* const s = solver();
+  if (!Contains(constant)) return s->MakeIntConst(0);
+  if (Bound()) return s->MakeIntConst(1);
+  IntVar* const boolvar = s->MakeBoolVar();
+  s->AddConstraint(
+      s->RevAlloc(new IsBetweenCt(s, this, constant, constant, boolvar)));
+  return boolvar;
+}
+
+inline IntVar* BitsetIntVar::IsDifferent(int64 constant) {
+  return solver()->MakeDifference(1, IsEqual(constant))->Var();
+}
+
+inline IntVar* BitsetIntVar::IsGreaterOrEqual(int64 constant) {
+  Solver* const s = solver();
+  if (constant <= Min()) return s->MakeIntConst(1);
+  if (constant > Max()) return s->MakeIntConst(0);
+  IntVar* const boolvar = s->MakeBoolVar();
+  s->AddConstraint(
+      s->RevAlloc(new IsBetweenCt(s, this, constant, kint64max, boolvar)));
+  return boolvar;
+}
+
+inline IntVar* BitsetIntVar::IsLessOrEqual(int64 constant) {
+  Solver* const s = solver();
+  if (constant >= Max()) return s->MakeIntConst(1);
+  if (constant < Min()) return s->MakeIntConst(0);
+  IntVar* const boolvar = s->MakeBoolVar();
+  s->AddConstraint(
+      s->RevAlloc(new IsBetweenCt(s, this, kint64min, constant, boolvar)));
+  return boolvar;
+}
+
+inline std::string BitsetIntVar::DebugString() const {
+  static const int kMaxDisplayedRanges = 32;
+  std::string out = name() + "(";
+  std::unique_ptr<IntVarIterator> it(MakeDomainIterator(false));
+  int num_ranges = 0;
+  int64 range_start = 0;
+  int64 previous = 0;
+  bool first = true;
+  for (const int64 value : InitAndGetValues(it.get())) {
+    if (!first && value == previous + 1) {
+      previous = value;
+      continue;
+    }
+    if (!first) {
+      if (++num_ranges == kMaxDisplayedRanges) break;
+      StringAppendF(&out, "%s ", range_start == previous
+                                     ? StringPrintf("%" GG_LL_FORMAT "d",
+                                                    previous).c_str()
+                                     : StringPrintf("%" GG_LL_FORMAT
+                                                    "d..%" GG_LL_FORMAT "d",
+                                                    range_start,
+                                                    previous).c_str());
+    }
+    first = false;
+    range_start = value;
+    previous = value;
+  }
+  if (num_ranges == kMaxDisplayedRanges) {
+    out += "...)";
+    return out;
+  }
+  if (range_start == previous) {
+    StringAppendF(&out, "%" GG_LL_FORMAT "d)", previous);
+  } else {
+    StringAppendF(&out, "%" GG_LL_FORMAT "d..%" GG_LL_FORMAT "d)",
+                  range_start, previous);
+  }
+  return out;
+}
+
+inline IntVar* MakeBitsetIntVar(Solver* const s,
+                                const std::vector<int64>& values,
+                                const std::string& name) {
+  return s->RegisterIntVar(s->RevAlloc(new BitsetIntVar(s, values, name)));
+}
+
+inline IntVar* MakeBitsetIntVar(Solver* const s, int64 vmin, int64 vmax,
+                                const std::string& name) {
+  return s->RegisterIntVar(
+      s->RevAlloc(new BitsetIntVar(s, vmin, vmax, name)));
+}
+
+inline IntVar* MakeIntVarFromValues(Solver* const s,
+                                    const std::vector<int64>& values,
+                                    const std::string& name,
+                                    const BitsetDomainParameters& parameters) {
+  CHECK(!values.empty());
+  const int64 vmin = *std::min_element(values.begin(), values.end());
+  const int64 vmax = *std::max_element(values.begin(), values.end());
+  // The span is computed in double to avoid overflows.
+  const double span = static_cast<double>(vmax) - vmin + 1;
+  const double num_values = values.size();
+  if (num_values >= parameters.min_domain_size &&
+      span <= parameters.max_span &&
+      num_values >= parameters.min_density * span) {
+    return MakeBitsetIntVar(s, values, name);
+  }
+  return s->MakeIntVar(values, name);
+}
+
+}  // namespace operations_research
+
+#endif  // OR_TOOLS_CONSTRAINT_SOLVER_BITSET_INT_VAR_H_
@@ -0,0 +1,412 @@
+// Copyright 2010-2014 Google
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+// Compact-Table propagation of a table constraint, i.e. a constraint whose
+// allowed assignments are given in extension by an IntTupleSet, as in
+// Solver::MakeAllowedAssignments().
+//
+// The propagator maintains the set of tuples that are still valid, i.e. whose
+// values are all in the domains of the variables, in a reversible sparse
+// bitset with one bit per tuple. Each (variable, value) pair has a support
+// mask, the set of tuples that assign this value to this variable.
+// - When the domain of a variable changes, the valid tuples are intersected
+//   with the union of the masks of the remaining values, or, when fewer
+//   values were removed than remain, with the complement of the union of the
+//   masks of the removed values.
+// - A delayed demon then removes the values whose support mask no longer
+//   intersects the valid tuples. The last intersecting word of each mask is
+//   remembered as a residue, which is checked first the next time.
+//
+// The support masks are stored compactly: each mask only lists its non zero
+// words, with their indices. Their total size is at most the number of
+// tuples times the arity, and much less when the tuples are grouped by value,
+// for instance after IntTupleSet::SortedLexicographically().
+
+#ifndef OR_TOOLS_CONSTRAINT_SOLVER_COMPACT_TABLE_H_
+#define OR_TOOLS_CONSTRAINT_SOLVER_COMPACT_TABLE_H_
+
+#include <algorithm>
+#include <string>
+#include <vector>
+
+#include "base/hash.h"
+#include "base/integral_types.h"
+#include "base/logging.h"
+#include "base/macros.h"
+#include "base/stringprintf.h"
+#include "constraint_solver/constraint_solver.h"
+#include "constraint_solver/constraint_solveri.h"
+#include "util/bitset.h"
+#include "util/tuple_set.h"
+
+namespace operations_research {
+
+// A bitset given by the list of its non zero 64-bit words, by increasing
+// word index.
+struct SparseBitMask {
+  std::vector<int> word_indices;
+  std::vector<uint64> words;
+
+  int NumWords() const { return word_indices.size(); }
+  void SetBit(int64 position) {
+    const int index = BitOffset64(position);
+    if (word_indices.empty() || word_indices.back() != index) {
+      DCHECK(word_indices.empty() || word_indices.back() < index);
+      word_indices.push_back(index);
+      words.push_back(0);
+    }
+    words.back() |= OneBit64(BitPos64(position));
+  }
+};
+
+// A reversible bitset that keeps the indices of its non zero words in a
+// reversible sparse set, so that the operations only visit them. It
+// intersects itself with a temporary mask built by ClearMask() and
+// AddToMask().
+class RevSparseBitset {
+ public:
+  explicit RevSparseBitset(int64 bit_size);
+  ~RevSparseBitset() {}
+
+  // Reversibly sets all the bits.
+  void SetAll(Solver* const solver);
+
+  bool Empty() const { return num_active_words_.Value() == 0; }
+  int ActiveWordSize() const { return num_active_words_.Value(); }
+
+  // Clears the temporary mask on the active words.
+  void ClearMask();
+  // ORs the given mask into the temporary mask.
+  void AddToMask(const SparseBitMask& mask);
+  // Reversibly ANDs the bitset with the temporary mask, or with its
+  // complement if 'complement' is true. Returns true if the bitset changed.
+  bool IntersectWithMask(Solver* const solver, bool complement);
+
+  // Returns true if the bitset intersects the given mask. 'residue' is the
+  // index in the mask of the word to check first, and is updated to the
+  // index of an intersecting word when there is one.
+  bool Intersects(const SparseBitMask& mask, int* residue) const;
+
+ private:
+  void SaveWord(Solver* const solver, int index);
+
+  const int64 bit_size_;
+  const int num_words_;
+  std::vector<uint64> words_;
+  std::vector<uint64> stamps_;
+  std::vector<uint64> mask_;
+  // The first num_active_words_ elements of active_words_ are the indices of
+  // the non zero words. Backtracking only restores the count: the elements
+  // are permuted within the active prefix, which keeps it the same set.
+  std::vector<int> active_words_;
+  NumericalRev<int> num_active_words_;
+
+  DISALLOW_COPY_AND_ASSIGN(RevSparseBitset);
+};
+
+class CompactTableConstraint : public Constraint {
+ public:
+  CompactTableConstraint(Solver* const s, const std::vector<IntVar*>& vars,
+                         const IntTupleSet& tuples);
+  ~CompactTableConstraint() override {}
+
+  void Post() override;
+  void InitialPropagate() override;
+  std::string DebugString() const override;
+  void Accept(ModelVisitor* const visitor) const override;
+
+  // Immediate demon, run when the domain of vars_[var_index] changes.
+  void UpdateVar(int var_index);
+  // Delayed demon, run after the valid tuples changed.
+  void FilterDomains();
+
+ private:
+  // Returns the index of 'value' in the column of the variable, or -1 if no
+  // tuple has this value.
+  int ValueIndex(int var_index, int64 value) const;
+  // Intersects the valid tuples with the supports of the values of the
+  // variable. Returns true if they changed.
+  bool ResetFromDomain(int var_index);
+
+  const std::vector<IntVar*> vars_;
+  const int arity_;
+  const IntTupleSet tuples_;
+  // For each variable, the values of its column, sorted.
+  std::vector<std::vector<int64> > values_;
+  // For each variable, a map from values to their index in values_.
+  std::vector<hash_map<int64, int> > value_indices_;
+  // supports_[var][value_index] is the mask of the tuples with this value.
+  std::vector<std::vector<SparseBitMask> > supports_;
+  std::vector<std::vector<int> > residues_;
+  RevSparseBitset valid_tuples_;
+  std::vector<IntVarIterator*> holes_;
+  std::vector<IntVarIterator*> domains_;
+  Demon* filter_demon_;
+  std::vector<int64> to_remove_;
+
+  DISALLOW_COPY_AND_ASSIGN(CompactTableConstraint);
+};
+
+// Creates a table constraint propagated with the Compact-Table algorithm.
+Constraint* MakeCompactTableConstraint(Solver* const s,
+                                       const std::vector<IntVar*>& vars,
+                                       const IntTupleSet& tuples);
+
+// ============================================================================
+// Implementation.
+// ============================================================================
+
+inline RevSparseBitset::RevSparseBitset(int64 bit_size)
+    : bit_size_(bit_size),
+      num_words_(BitLength64(bit_size)),
+      words_(num_words_, 0),
+      stamps_(num_words_, 0),
+      mask_(num_words_, 0),
+      active_words_(num_words_),
+      num_active_words_(0) {
+  for (int i = 0; i < num_words_; ++i) active_words_[i] = i;
+}
+
+inline void RevSparseBitset::SaveWord(Solver* const solver, int index) {
+  const uint64 stamp = solver->stamp();
+  if (stamps_[index] < stamp) {
+    stamps_[index] = stamp;
+    solver->SaveValue(&words_[index]);
+  }
+}
+
+inline void RevSparseBitset::SetAll(Solver* const solver) {
+  for (int i = 0; i < num_words_; ++i) {
+    uint64 word = kAllBits64;
+    if (i == num_words_ - 1 && BitPos64(bit_size_) != 0) {
+      word = IntervalDown64(BitPos64(bit_size_) - 1);
+    }
+    if (words_[i] != word) {
+      SaveWord(solver, i);
+      words_[i] = word;
+    }
+  }
+  num_active_words_.SetValue(solver, num_words_);
+}
+
+inline void RevSparseBitset::ClearMask() {
+  const int size = num_active_words_.Value();
+  for (int i = 0; i < size; ++i) mask_[active_words_[i]] = 0;
+}
+
+inline void RevSparseBitset::AddToMask(const SparseBitMask& mask) {
+  const int size = mask.NumWords();
+  for (int i = 0; i < size; ++i) mask_[mask.word_indices[i]] |= mask.words[i];
+}
+
+inline bool RevSparseBitset::IntersectWithMask(Solver* const solver,
+                                               bool complement) {
+  const uint64 flip = complement ? kAllBits64 : 0;
+  bool changed = false;
+  int size = num_active_words_.Value();
+  // Going down keeps the swapped words out of the remaining iterations.
+  for (int i = size - 1; i >= 0; --i) {
+    const int index = active_words_[i];
+    const uint64 word = words_[index] & (mask_[index] ^ flip);
+    if (word == words_[index]) continue;
+    changed = true;
+    SaveWord(solver, index);
+    words_[index] = word;
+    if (word == 0) {
+      --size;
+      active_words_[i] = active_words_[size];
+      active_words_[size] = index;
+    }
+  }
+  if (size != num_active_words_.Value()) {
+    num_active_words_.SetValue(solver, size);
+  }
+  return changed;
+}
+
+inline bool RevSparseBitset::Intersects(const SparseBitMask& mask,
+                                        int* residue) const {
+  // Inactive words are null, so all the words can be checked directly.
+  if (*residue < mask.NumWords() &&
+      (words_[mask.word_indices[*residue]] & mask.words[*residue]) != 0) {
+    return true;
+  }
+  const int size = mask.NumWords();
+  for (int i = 0; i < size; ++i) {
+    if ((words_[mask.word_indices[i]] & mask.words[i]) != 0) {
+      *residue = i;
+      return true;
+    }
+  }
+  return false;
+}
+
+inline CompactTableConstraint::CompactTableConstraint(
+    Solver* const s, const std::vector<IntVar*>& vars,
+    const IntTupleSet& tuples)
+    : Constraint(s),
+      vars_(vars),
+      arity_(vars.size()),
+      tuples_(tuples),
+      values_(vars.size()),
+      value_indices_(vars.size()),
+      supports_(vars.size()),
+      residues_(vars.size()),
+      valid_tuples_(tuples.NumTuples()),
+      holes_(vars.size(), nullptr),
+      domains_(vars.size(), nullptr),
+      filter_demon_(nullptr) {
+  CHECK_EQ(arity_, tuples.Arity());
+  const int num_tuples = tuples.NumTuples();
+  for (int var_index = 0; var_index < arity_; ++var_index) {
+    std::vector<int64>& values = values_[var_index];
+    values.reserve(num_tuples);
+    for (int t = 0; t < num_tuples; ++t) {
+      values.push_back(tuples.Value(t, var_index));
+    }
+    std::sort(values.begin(), values.end());
+    values.erase(std::unique(values.begin(), values.end()), values.end());
+    hash_map<int64, int>& value_indices = value_indices_[var_index];
+    const int num_values = values.size();
+    for (int i = 0; i < num_values; ++i) value_indices[values[i]] = i;
+    std::vector<SparseBitMask>& supports = supports_[var_index];
+    supports.resize(num_values);
+    for (int t = 0; t < num_tuples; ++t) {
+      supports[value_indices[tuples.Value(t, var_index)]].SetBit(t);
+    }
+    residues_[var_index].assign(num_values, 0);
+  }
+}
+
+inline int CompactTableConstraint::ValueIndex(int var_index,
+                                              int64 value) const {
+  const hash_map<int64, int>& value_indices = value_indices_[var_index];
+  const hash_map<int64, int>::const_iterator it = value_indices.find(value);
+  return it == value_indices.end() ? -1 : it->second;
+}
+
+inline void CompactTableConstraint::Post() {
+  for (int var_index = 0; var_index < arity_; ++var_index) {
+    IntVar* const var = vars_[var_index];
+    holes_[var_index] = var->MakeHoleIterator(true);
+    domains_[var_index] = var->MakeDomainIterator(true);
+    if (!var->Bound()) {
+      var->WhenDomain(MakeConstraintDemon1(
+          solver(), this, &CompactTableConstraint::UpdateVar, "UpdateVar",
+          var_index));
+    }
+  }
+  filter_demon_ = MakeDelayedConstraintDemon0(
+      solver(), this, &CompactTableConstraint::FilterDomains, "FilterDomains");
+}
+
+inline bool CompactTableConstraint::ResetFromDomain(int var_index) {
+  valid_tuples_.ClearMask();
+  for (const int64 value : InitAndGetValues(domains_[var_index])) {
+    const int value_index = ValueIndex(var_index, value);
+    if (value_index >= 0) {
+      valid_tuples_.AddToMask(supports_[var_index][value_index]);
+    }
+  }
+  return valid_tuples_.IntersectWithMask(solver(), false);
+}
+
+inline void CompactTableConstraint::InitialPropagate() {
+  valid_tuples_.SetAll(solver());
+  for (int var_index = 0; var_index < arity_; ++var_index) {
+    IntVar* const var = vars_[var_index];
+    const std::vector<int64>& values = values_[var_index];
+    if (values.empty()) solver()->Fail();
+    var->SetRange(values.front(), values.back());
+    ResetFromDomain(var_index);
+    if (valid_tuples_.Empty()) solver()->Fail();
+  }
+  FilterDomains();
+}
+
+inline void CompactTableConstraint::UpdateVar(int var_index) {
+  IntVar* const var = vars_[var_index];
+  const int64 vmin = var->Min();
+  const int64 vmax = var->Max();
+  const int64 old_min = var->OldMin();
+  const int64 old_max = var->OldMax();
+  bool changed = false;
+  if ((vmin - old_min) + (old_max - vmax) < static_cast<int64>(var->Size())) {
+    // Few values were removed: subtracts their supports.
+    valid_tuples_.ClearMask();
+    const std::vector<SparseBitMask>& supports = supports_[var_index];
+    for (int64 value = old_min; value < vmin; ++value) {
+      const int value_index = ValueIndex(var_index, value);
+      if (value_index >= 0) valid_tuples_.AddToMask(supports[value_index]);
+    }
+    for (int64 value = vmax + 1; value <= old_max; ++value) {
+      const int value_index = ValueIndex(var_index, value);
+      if (value_index >= 0) valid_tuples_.AddToMask(supports[value_index]);
+    }
+    // Holes can include values already removed. Their tuples are already
+    // invalid, so subtracting them again is harmless.
+    for (const int64 value : InitAndGetValues(holes_[var_index])) {
+      const int value_index = ValueIndex(var_index, value);
+      if (value_index >= 0) valid_tuples_.AddToMask(supports[value_index]);
+    }
+    changed = valid_tuples_.IntersectWithMask(solver(), true);
+  } else {
+    changed = ResetFromDomain(var_index);
+  }
+  if (!changed) return;
+  if (valid_tuples_.Empty()) solver()->Fail();
+  EnqueueDelayedDemon(filter_demon_);
+}
+
+inline void CompactTableConstraint::FilterDomains() {
+  for (int var_index = 0; var_index < arity_; ++var_index) {
+    IntVar* const var = vars_[var_index];
+    if (var->Bound()) continue;
+    const std::vector<SparseBitMask>& supports = supports_[var_index];
+    std::vector<int>& residues = residues_[var_index];
+    to_remove_.clear();
+    for (const int64 value : InitAndGetValues(domains_[var_index])) {
+      const int value_index = ValueIndex(var_index, value);
+      if (value_index < 0 ||
+          !valid_tuples_.Intersects(supports[value_index],
+                                    &residues[value_index])) {
+        to_remove_.push_back(value);
+      }
+    }
+    if (!to_remove_.empty()) var->RemoveValues(to_remove_);
+  }
+}
+
+inline std::string CompactTableConstraint::DebugString() const {
+  return StringPrintf("CompactTable(arity = %d, %d tuples, %d active words)",
+                      tuples_.Arity(), tuples_.NumTuples(),
+                      valid_tuples_.ActiveWordSize());
+}
+
+inline void CompactTableConstraint::Accept(ModelVisitor* const visitor) const {
+  visitor->BeginVisitConstraint(ModelVisitor::kAllowedAssignments, this);
+  visitor->VisitIntegerVariableArrayArgument(ModelVisitor::kVarsArgument,
+                                             vars_);
+  visitor->VisitIntegerMatrixArgument(ModelVisitor::kTuplesArgument, tuples_);
+  visitor->EndVisitConstraint(ModelVisitor::kAllowedAssignments, this);
+}
+
+inline Constraint* MakeCompactTableConstraint(
+    Solver* const s, const std::vector<IntVar*>& vars,
+    const IntTupleSet& tuples) {
+  return s->RevAlloc(new CompactTableConstraint(s, vars, tuples));
+}
+
+}  // namespace operations_research
+
+#endif  // OR_TOOLS_CONSTRAINT_SOLVER_COMPACT_TABLE_H_
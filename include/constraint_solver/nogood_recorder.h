@@ -0,0 +1,507 @@
+// Copyright 2010-2014 Google
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+// Nogood recording from restarts.
+//
+// The NoGoodRecorder is a search monitor to use together with a restart
+// monitor, e.g. Solver::MakeLubyRestart() or Solver::MakeConstantRestart().
+// It follows the current branch of the search tree, and at each restart it
+// extracts the reduced nld-nogoods of the last branch (see "Recording and
+// Minimizing Nogoods from Restarts", C. Lecoutre et al., 2007): if the branch
+// is made of the positive decisions d1, ..., dk and of refuted decisions, each
+// refuted decision d gives the nogood
+//   (positive decisions before d) && d,
+// as the subtree below d has been fully explored. The next searches never
+// enter these subtrees again, which keeps the search complete with restarts.
+//
+// The nogoods are conjunctions of literals var == value, var <= value and
+// var >= value. They are propagated with two watched literals: a nogood only
+// wakes up when one of its two watched literals becomes true, and it removes
+// the last one when all the others are true. Each restart decays the
+// activity of the nogoods, which is bumped each time a nogood prunes or
+// fails; when there are too many nogoods, the least active half is removed.
+//
+// Only the decisions visited as VisitSetVariableValue() or
+// VisitSplitVariableDomain() by a DecisionVisitor are recorded: a branch is
+// only used up to its first positive decision of another kind, e.g. on
+// interval or sequence variables. The decision builders must restrict the
+// domains only through their decisions, and must not switch the branches
+// with Solver::SetBranchSelector().
+//
+// Usage:
+//   monitors.push_back(solver.MakeLubyRestart(100));
+//   monitors.push_back(
+//       MakeNoGoodRecorder(&solver, NoGoodRecorderParameters()));
+//   solver.Solve(db, monitors);
+
+#ifndef OR_TOOLS_CONSTRAINT_SOLVER_NOGOOD_RECORDER_H_
+#define OR_TOOLS_CONSTRAINT_SOLVER_NOGOOD_RECORDER_H_
+
+#include <algorithm>
+#include <memory>
+#include <string>
+#include <utility>
+#include <vector>
+
+#include "base/hash.h"
+#include "base/integral_types.h"
+#include "base/logging.h"
+#include "base/macros.h"
+#include "base/stringprintf.h"
+#include "constraint_solver/constraint_solver.h"
+
+namespace operations_research {
+
+struct NoGoodRecorderParameters {
+  NoGoodRecorderParameters()
+      : max_nogoods(10000), max_nogood_size(64), activity_decay(0.95) {}
+
+  // Above this number of nogoods, the least active half is removed at the
+  // next restart.
+  int max_nogoods;
+  // Longer nogoods are not recorded, as they rarely prune anything.
+  int max_nogood_size;
+  // Factor applied to the activities of the nogoods at each restart.
+  double activity_decay;
+};
+
+class NoGoodRecorder : public SearchMonitor {
+ public:
+  NoGoodRecorder(Solver* const s, const NoGoodRecorderParameters& parameters);
+  ~NoGoodRecorder() override {}
+
+  // Number of nogoods in the store.
+  int NoGoodCount() const { return nogoods_.size(); }
+  // Number of nogoods recorded since the beginning of the search.
+  int64 num_recorded() const { return num_recorded_; }
+  // Number of domain reductions and failures caused by the nogoods.
+  int64 num_propagations() const { return num_propagations_; }
+  int64 num_conflicts() const { return num_conflicts_; }
+
+  // SearchMonitor.
+  void EnterSearch() override;
+  void RestartSearch() override;
+  void ExitSearch() override { active_ = false; }
+  void BeginNextDecision(DecisionBuilder* const db) override;
+  void ApplyDecision(Decision* const d) override { PushDecision(d, true); }
+  void RefuteDecision(Decision* const d) override { PushDecision(d, false); }
+  std::string DebugString() const override;
+
+ private:
+  enum LiteralType { EQUAL, LESS_OR_EQUAL, GREATER_OR_EQUAL };
+
+  struct Literal {
+    IntVar* var;
+    int64 value;
+    LiteralType type;
+  };
+
+  // A decision on the current branch.
+  struct Step {
+    Decision* decision;
+    Literal literal;
+    // False if the decision is not a literal.
+    bool known;
+    bool positive;
+  };
+
+  struct NoGood {
+    // literals[0] and literals[1] are watched.
+    std::vector<Literal> literals;
+    double activity;
+  };
+
+  // A variable of the nogoods, and the nogoods watching it through one of
+  // their first two literals.
+  struct WatchedVar {
+    explicit WatchedVar(IntVar* const v) : var(v), attached(false) {}
+    IntVar* const var;
+    std::vector<int> nogoods;
+    // Reversible: the demon is removed with the state it was attached in.
+    bool attached;
+  };
+
+  class LiteralExtractor : public DecisionVisitor {
+   public:
+    explicit LiteralExtractor(Step* const step) : step_(step) {}
+    ~LiteralExtractor() override {}
+    void VisitSetVariableValue(IntVar* const var, int64 value) override {
+      Set(var, value, EQUAL);
+    }
+    void VisitSplitVariableDomain(IntVar* const var, int64 value,
+                                  bool start_with_lower_half) override {
+      // var >= value + 1 is also implied by the decisions that apply
+      // var >= value, which keeps the nogoods valid for them.
+      if (start_with_lower_half) {
+        Set(var, value, LESS_OR_EQUAL);
+      } else {
+        Set(var, value + 1, GREATER_OR_EQUAL);
+      }
+    }
+
+   private:
+    void Set(IntVar* const var, int64 value, LiteralType type) {
+      step_->literal.var = var;
+      step_->literal.value = value;
+      step_->literal.type = type;
+      step_->known = true;
+    }
+
+    Step* const step_;
+    DISALLOW_COPY_AND_ASSIGN(LiteralExtractor);
+  };
+
+  class WatchDemon : public Demon {
+   public:
+    WatchDemon(NoGoodRecorder* const recorder, int index)
+        : recorder_(recorder), index_(index) {}
+    ~WatchDemon() override {}
+    void Run(Solver* const s) override { recorder_->ProcessVar(index_); }
+    std::string DebugString() const override {
+      return StringPrintf("NoGoodRecorder::WatchDemon(%d)", index_);
+    }
+
+   private:
+    NoGoodRecorder* const recorder_;
+    const int index_;
+  };
+
+  static bool IsTrue(const Literal& literal);
+  static bool IsFalse(const Literal& literal);
+  // Removes the values of the literal from the domain of its variable.
+  static void Negate(const Literal& literal);
+
+  void PushDecision(Decision* const d, bool positive);
+  void RecordBranch();
+  void ReduceStore();
+  // Rebuilds the watches of all nogoods at the root node, and propagates the
+  // nogoods that have a single free literal.
+  void PropagateAtRoot();
+  // Returns the index of the variable in watched_vars_, and adds it if
+  // needed.
+  int WatchedVarIndex(IntVar* const var);
+  void AddWatch(IntVar* const var, int nogood);
+  void ProcessVar(int index);
+  // Updates the watches of the nogood after an event on the variable, and
+  // returns true if the nogood still watches it.
+  bool UpdateWatches(int nogood, IntVar* const var);
+  void Bump(NoGood* const nogood);
+
+  const NoGoodRecorderParameters parameters_;
+  std::vector<NoGood> nogoods_;
+  std::vector<std::unique_ptr<WatchedVar> > watched_vars_;
+  hash_map<IntVar*, int> watched_var_index_;
+  // The branch of the search tree. Only the first path_size_ steps are
+  // current; branch_size_ is the size when the last decision was pushed,
+  // i.e. the size of the branch the search restarts from.
+  std::vector<Step> path_;
+  Rev<int> path_size_;
+  int branch_size_;
+  std::vector<int> units_;
+  std::vector<int> order_;
+  double activity_increment_;
+  bool active_;
+  bool at_root_;
+  int64 num_recorded_;
+  int64 num_propagations_;
+  int64 num_conflicts_;
+
+  DISALLOW_COPY_AND_ASSIGN(NoGoodRecorder);
+};
+
+SearchMonitor* MakeNoGoodRecorder(Solver* const s,
+                                  const NoGoodRecorderParameters& parameters);
+
+// ============================================================================
+// Implementation.
+// ============================================================================
+
+inline NoGoodRecorder::NoGoodRecorder(
+    Solver* const s, const NoGoodRecorderParameters& parameters)
+    : SearchMonitor(s),
+      parameters_(parameters),
+      path_size_(0),
+      branch_size_(0),
+      activity_increment_(1.0),
+      active_(false),
+      at_root_(false),
+      num_recorded_(0),
+      num_propagations_(0),
+      num_conflicts_(0) {
+  CHECK_GT(parameters.activity_decay, 0.0);
+  CHECK_LE(parameters.activity_decay, 1.0);
+}
+
+inline bool NoGoodRecorder::IsTrue(const Literal& literal) {
+  switch (literal.type) {
+    case EQUAL:
+      return literal.var->Bound() && literal.var->Min() == literal.value;
+    case LESS_OR_EQUAL:
+      return literal.var->Max() <= literal.value;
+    case GREATER_OR_EQUAL:
+      return literal.var->Min() >= literal.value;
+  }
+  return false;
+}
+
+inline bool NoGoodRecorder::IsFalse(const Literal& literal) {
+  switch (literal.type) {
+    case EQUAL:
+      return !literal.var->Contains(literal.value);
+    case LESS_OR_EQUAL:
+      return literal.var->Min() > literal.value;
+    case GREATER_OR_EQUAL:
+      return literal.var->Max() < literal.value;
+  }
+  return false;
+}
+
+inline void NoGoodRecorder::Negate(const Literal& literal) {
+  switch (literal.type) {
+    case EQUAL:
+      literal.var->RemoveValue(literal.value);
+      break;
+    case LESS_OR_EQUAL:
+      literal.var->SetMin(literal.value + 1);
+      break;
+    case GREATER_OR_EQUAL:
+      literal.var->SetMax(literal.value - 1);
+      break;
+  }
+}
+
+inline void NoGoodRecorder::EnterSearch() {
+  // The nogoods of a previous search can depend on its objective bound.
+  nogoods_.clear();
+  for (const std::unique_ptr<WatchedVar>& watched : watched_vars_) {
+    watched->nogoods.clear();
+  }
+  path_.clear();
+  path_size_.SetValue(solver(), 0);
+  branch_size_ = 0;
+  activity_increment_ = 1.0;
+  active_ = true;
+  at_root_ = false;
+  num_recorded_ = 0;
+  num_propagations_ = 0;
+  num_conflicts_ = 0;
+}
+
+inline void NoGoodRecorder::RestartSearch() {
+  RecordBranch();
+  path_.clear();
+  branch_size_ = 0;
+  activity_increment_ /= parameters_.activity_decay;
+  if (activity_increment_ > 1e100) {
+    for (NoGood& nogood : nogoods_) nogood.activity *= 1e-100;
+    activity_increment_ *= 1e-100;
+  }
+  if (NoGoodCount() > parameters_.max_nogoods) ReduceStore();
+  // The search can only fail from the root in BeginNextDecision().
+  at_root_ = true;
+}
+
+inline void NoGoodRecorder::BeginNextDecision(DecisionBuilder* const db) {
+  if (at_root_) {
+    at_root_ = false;
+    PropagateAtRoot();
+  }
+}
+
+inline void NoGoodRecorder::PushDecision(Decision* const d, bool positive) {
+  const int size = path_size_.Value();
+  path_.resize(size);
+  // The refutation of a decision replaces its left branch.
+  if (!positive && !path_.empty() && path_.back().decision == d &&
+      path_.back().positive) {
+    path_.pop_back();
+  }
+  path_.push_back(Step());
+  Step* const step = &path_.back();
+  step->decision = d;
+  step->known = false;
+  step->positive = positive;
+  LiteralExtractor extractor(step);
+  d->Accept(&extractor);
+  path_size_.SetValue(solver(), path_.size());
+  branch_size_ = path_.size();
+}
+
+inline void NoGoodRecorder::RecordBranch() {
+  std::vector<Literal> positives;
+  for (int i = 0; i < branch_size_; ++i) {
+    const Step& step = path_[i];
+    if (step.positive) {
+      if (!step.known) break;
+      positives.push_back(step.literal);
+    } else if (step.known &&
+               static_cast<int>(positives.size()) <
+                   parameters_.max_nogood_size) {
+      nogoods_.push_back(NoGood());
+      NoGood* const nogood = &nogoods_.back();
+      nogood->literals = positives;
+      nogood->literals.push_back(step.literal);
+      nogood->activity = activity_increment_;
+      ++num_recorded_;
+    }
+  }
+}
+
+inline void NoGoodRecorder::ReduceStore() {
+  const int size = nogoods_.size();
+  order_.clear();
+  for (int i = 0; i < size; ++i) order_.push_back(i);
+  std::sort(order_.begin(), order_.end(), [this](int a, int b) {
+    return nogoods_[a].activity > nogoods_[b].activity;
+  });
+  const int num_kept = parameters_.max_nogoods / 2;
+  order_.resize(num_kept);
+  std::sort(order_.begin(), order_.end());
+  for (int i = 0; i < num_kept; ++i) {
+    if (order_[i] != i) nogoods_[i] = std::move(nogoods_[order_[i]]);
+  }
+  nogoods_.resize(num_kept);
+}
+
+inline void NoGoodRecorder::PropagateAtRoot() {
+  for (const std::unique_ptr<WatchedVar>& watched : watched_vars_) {
+    watched->nogoods.clear();
+  }
+  units_.clear();
+  const int num_nogoods = nogoods_.size();
+  for (int i = 0; i < num_nogoods; ++i) {
+    std::vector<Literal>& literals = nogoods_[i].literals;
+    const int size = literals.size();
+    // Moves the literals that are not true to the front.
+    int num_free = 0;
+    for (int j = 0; j < size; ++j) {
+      if (!IsTrue(literals[j])) std::swap(literals[num_free++], literals[j]);
+    }
+    if (num_free == 0) {
+      ++num_conflicts_;
+      solver()->Fail();
+    }
+    if (size > 1) {
+      // All the variables of the nogood get a demon, as the watches can move
+      // to any of them during the search.
+      for (const Literal& literal : literals) WatchedVarIndex(literal.var);
+      AddWatch(literals[0].var, i);
+      if (literals[1].var != literals[0].var) AddWatch(literals[1].var, i);
+    }
+    if (num_free == 1) units_.push_back(i);
+  }
+  const int num_watched_vars = watched_vars_.size();
+  for (int i = 0; i < num_watched_vars; ++i) {
+    WatchedVar* const watched = watched_vars_[i].get();
+    if (!watched->attached) {
+      watched->var->WhenDomain(solver()->RevAlloc(new WatchDemon(this, i)));
+      solver()->SaveAndSetValue(&watched->attached, true);
+    }
+  }
+  for (const int index : units_) {
+    NoGood* const nogood = &nogoods_[index];
+    if (IsTrue(nogood->literals[0])) {
+      Bump(nogood);
+      ++num_conflicts_;
+      solver()->Fail();
+    }
+    if (!IsFalse(nogood->literals[0])) {
+      Bump(nogood);
+      ++num_propagations_;
+      Negate(nogood->literals[0]);
+    }
+  }
+}
+
+inline int NoGoodRecorder::WatchedVarIndex(IntVar* const var) {
+  hash_map<IntVar*, int>::const_iterator it = watched_var_index_.find(var);
+  if (it == watched_var_index_.end()) {
+    it = watched_var_index_.insert(std::make_pair(var, watched_vars_.size()))
+             .first;
+    watched_vars_.emplace_back(new WatchedVar(var));
+  }
+  return it->second;
+}
+
+inline void NoGoodRecorder::AddWatch(IntVar* const var, int nogood) {
+  watched_vars_[WatchedVarIndex(var)]->nogoods.push_back(nogood);
+}
+
+inline void NoGoodRecorder::ProcessVar(int index) {
+  if (!active_) return;
+  WatchedVar* const watched = watched_vars_[index].get();
+  std::vector<int>& nogoods = watched->nogoods;
+  // The list stays consistent after each step, as a failure can interrupt
+  // the loop.
+  int i = 0;
+  while (i < static_cast<int>(nogoods.size())) {
+    if (UpdateWatches(nogoods[i], watched->var)) {
+      ++i;
+    } else {
+      nogoods[i] = nogoods.back();
+      nogoods.pop_back();
+    }
+  }
+}
+
+inline bool NoGoodRecorder::UpdateWatches(int index, IntVar* const var) {
+  NoGood* const nogood = &nogoods_[index];
+  std::vector<Literal>& literals = nogood->literals;
+  const int size = literals.size();
+  for (int slot = 0; slot < 2; ++slot) {
+    if (literals[slot].var != var || !IsTrue(literals[slot])) continue;
+    const Literal& other = literals[1 - slot];
+    int replacement = -1;
+    for (int j = 2; j < size; ++j) {
+      if (!IsTrue(literals[j])) {
+        replacement = j;
+        break;
+      }
+    }
+    if (replacement != -1) {
+      std::swap(literals[slot], literals[replacement]);
+      IntVar* const new_var = literals[slot].var;
+      if (new_var != var && new_var != other.var) AddWatch(new_var, index);
+    } else if (IsTrue(other)) {
+      Bump(nogood);
+      ++num_conflicts_;
+      solver()->Fail();
+    } else if (!IsFalse(other)) {
+      Bump(nogood);
+      ++num_propagations_;
+      Negate(other);
+    }
+  }
+  return literals[0].var == var || literals[1].var == var;
+}
+
+inline void NoGoodRecorder::Bump(NoGood* const nogood) {
+  nogood->activity += activity_increment_;
+}
+
+inline std::string NoGoodRecorder::DebugString() const {
+  return StringPrintf("NoGoodRecorder(%d nogoods, %" GG_LL_FORMAT
+                      "d recorded, %" GG_LL_FORMAT
+                      "d propagations, %" GG_LL_FORMAT "d conflicts)",
+                      NoGoodCount(), num_recorded_, num_propagations_,
+                      num_conflicts_);
+}
+
+inline SearchMonitor* MakeNoGoodRecorder(
+    Solver* const s, const NoGoodRecorderParameters& parameters) {
+  return s->RevAlloc(new NoGoodRecorder(s, parameters));
+}
+
+}  // namespace operations_research
+
+#endif  // OR_TOOLS_CONSTRAINT_SOLVER_NOGOOD_RECORDER_H_
@@ -0,0 +1,540 @@
+// Copyright 2010-2014 Google
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+// Parallel tree search for the constraint solver.
+//
+// A Solver and its reversible trail can only be used by one thread, so the
+// search is parallelized by running one replica of the model per worker, each
+// on its own Solver, and by splitting the search tree between them. A node of
+// the tree is identified by its decision path from the root: the sequence of
+// left (Apply) and right (Refute) branches taken to reach it. As long as the
+// decision builder is deterministic, i.e. it returns the same decisions for
+// the same path, a replica can jump to any node by replaying its path.
+//
+// The tree is split by work stealing: when some worker is idle, a busy worker
+// donates the right branch of its shallowest open node (a node whose left
+// branch is being explored). The donated path is pushed to a shared queue, and
+// the donor will fail when it later reaches this right branch. Since the
+// shallowest node is donated, the subproblems are large at first and get
+// smaller as the search progresses, which gives an on-demand version of the
+// Embarrassingly Parallel Search decomposition.
+//
+// For optimization problems, the best objective value is shared between the
+// replicas: each of them constrains its objective with the best value found
+// by any worker. The solutions of the solution collector of each replica are
+// merged into a single list of solutions.
+//
+// Usage:
+//   ParallelSearch search("golomb", 8,
+//       [](Solver* s, ParallelSearchReplica* replica) {
+//         ... build the model on s ...
+//         replica->decision_builder = s->MakePhase(...);
+//         replica->objective = length;
+//         replica->collector = s->MakeLastSolutionCollector();
+//         replica->collector->Add(ticks);
+//       });
+//   if (search.Solve()) {
+//     const std::vector<int64>& ticks = search.solution_values(
+//         search.best_solution());
+//   }
+//
+// Limitations: the decision builder must be deterministic (no randomized
+// selection, no dependency on the state of previous searches), and monitors
+// that restart the search or change the tree shape (restarts, local search)
+// are not supported.
+
+#ifndef OR_TOOLS_CONSTRAINT_SOLVER_PARALLEL_SEARCH_H_
+#define OR_TOOLS_CONSTRAINT_SOLVER_PARALLEL_SEARCH_H_
+
+#include <atomic>
+#include <deque>
+#include <functional>
+#include <memory>
+#include <string>
+#include <vector>
+
+#include "base/callback.h"
+#include "base/integral_types.h"
+#include "base/join.h"
+#include "base/logging.h"
+#include "base/macros.h"
+#include "base/mutex.h"
+#include "base/threadpool.h"
+#include "constraint_solver/constraint_solver.h"
+#include "util/saturated_arithmetic.h"
+
+namespace operations_research {
+
+// What a model builder must fill for each replica. All the objects must be
+// created on the solver of the replica.
+struct ParallelSearchReplica {
+  ParallelSearchReplica()
+      : decision_builder(nullptr),
+        objective(nullptr),
+        maximize(false),
+        step(1),
+        collector(nullptr) {}
+
+  // The (deterministic) decision builder of the search. Mandatory.
+  DecisionBuilder* decision_builder;
+
+  // Additional monitors, e.g. search limits. They must not include the
+  // collector below, nor an OptimizeVar on the objective.
+  std::vector<SearchMonitor*> monitors;
+
+  // The objective to optimize, or nullptr for a satisfaction problem. The
+  // OptimizeVar is created by the parallel search, and the best value is
+  // shared between the replicas.
+  IntVar* objective;
+  bool maximize;
+  int64 step;
+
+  // The collector whose solutions are merged, or nullptr. The same variables
+  // must be added, in the same order, in all replicas.
+  SolutionCollector* collector;
+};
+
+// The queue of the decision paths that remain to be explored, shared by all
+// the workers. A path is a vector of branches, true meaning a right branch.
+// It also keeps track of the idle workers to detect the end of the search.
+class ParallelSearchWorkQueue {
+ public:
+  explicit ParallelSearchWorkQueue(int num_workers);
+
+  // Adds a path to explore.
+  void Push(const std::vector<bool>& path);
+
+  // Blocks until a path is available and returns true, or returns false if
+  // the search is over: the queue is empty and no worker may push a new path,
+  // or Stop() was called. Each worker must call Take() until it returns false.
+  bool Take(std::vector<bool>* path);
+
+  // Returns true when some workers are waiting for a path that is not in the
+  // queue yet. This is cheap and can be called at each node.
+  bool NeedsWork() const {
+    return num_waiting_.load(std::memory_order_relaxed) >
+           num_pending_.load(std::memory_order_relaxed);
+  }
+
+  // Ends the search as soon as possible.
+  void Stop();
+  bool stopped() const { return stopped_.load(std::memory_order_relaxed); }
+
+  int64 num_pushed() const { return num_pushed_; }
+
+ private:
+  Mutex mutex_;
+  CondVar condition_;
+  std::deque<std::vector<bool>> paths_;
+  int num_busy_;
+  int64 num_pushed_;
+  std::atomic<int> num_waiting_;
+  std::atomic<int> num_pending_;
+  std::atomic<bool> stopped_;
+
+  DISALLOW_COPY_AND_ASSIGN(ParallelSearchWorkQueue);
+};
+
+// The best objective value found by any worker.
+class SharedObjectiveBound {
+ public:
+  explicit SharedObjectiveBound(bool maximize)
+      : maximize_(maximize), best_(maximize ? kint64min : kint64max) {}
+
+  // Updates the best value with the given one if it is better. Returns true
+  // if it was.
+  bool Update(int64 value);
+
+  bool has_value() const {
+    return best() != (maximize_ ? kint64min : kint64max);
+  }
+  int64 best() const { return best_.load(std::memory_order_relaxed); }
+
+ private:
+  const bool maximize_;
+  std::atomic<int64> best_;
+
+  DISALLOW_COPY_AND_ASSIGN(SharedObjectiveBound);
+};
+
+// The monitor installed on each replica. It replays the prefix of the current
+// subproblem, donates open nodes to the queue when some workers are idle,
+// fails on the donated branches and applies the shared objective bound.
+class ParallelSearchMonitor : public SearchMonitor {
+ public:
+  // The bound and the objective can be nullptr for a satisfaction problem.
+  ParallelSearchMonitor(Solver* const solver, ParallelSearchWorkQueue* queue,
+                        SharedObjectiveBound* bound, IntVar* objective,
+                        bool maximize, int64 step,
+                        bool stop_after_first_solution);
+  ~ParallelSearchMonitor() override {}
+
+  // Sets the path of the subproblem explored by the next search.
+  void SetPrefix(const std::vector<bool>& prefix) { path_ = prefix; }
+
+  void EnterSearch() override;
+  void BeginNextDecision(DecisionBuilder* const b) override;
+  void ApplyDecision(Decision* const d) override;
+  void RefuteDecision(Decision* const d) override;
+  bool AtSolution() override;
+  std::string DebugString() const override { return "ParallelSearchMonitor"; }
+
+  int64 num_donations() const { return num_donations_; }
+
+ private:
+  // Fails if the search was stopped or if the objective can't improve on the
+  // shared bound.
+  void CheckStopAndBound();
+  void Donate();
+
+  ParallelSearchWorkQueue* const queue_;
+  SharedObjectiveBound* const bound_;
+  IntVar* const objective_;
+  const bool maximize_;
+  const int64 step_;
+  const bool stop_after_first_solution_;
+  // The branches taken at each depth. The first prefix_length_ entries are
+  // forced. Only the entries before depth_ are meaningful.
+  std::vector<bool> path_;
+  // Whether the right branch at each depth was given to another worker.
+  std::vector<bool> donated_;
+  int prefix_length_;
+  // Reversible.
+  int depth_;
+  int64 num_donations_;
+
+  DISALLOW_COPY_AND_ASSIGN(ParallelSearchMonitor);
+};
+
+// Runs a search in parallel on several replicas of a model.
+class ParallelSearch {
+ public:
+  // Builds the model and fills the replica on the given solver. It is called
+  // once per worker, from the worker thread, so it must not modify shared
+  // state. It can build the model from scratch, or load a CpModel exported
+  // once with Solver::ExportModel() through Solver::LoadModel(); in the
+  // latter case the decision builder must still be created by the builder.
+  typedef std::function<void(Solver*, ParallelSearchReplica*)> ModelBuilder;
+
+  ParallelSearch(const std::string& name, int num_workers,
+                 const ModelBuilder& model_builder);
+
+  // If true, the search stops as soon as any worker finds a solution.
+  void set_stop_after_first_solution(bool stop) {
+    stop_after_first_solution_ = stop;
+  }
+
+  // Runs the search and returns true if at least one solution was found. For
+  // an optimization problem, the best solution is optimal unless the search
+  // was stopped by a limit or by set_stop_after_first_solution().
+  bool Solve();
+
+  // The merged solutions of the collectors, in no particular order. The
+  // values are those of the integer variables of the collector, in the order
+  // in which they were added.
+  int solution_count() const { return solution_values_.size(); }
+  const std::vector<int64>& solution_values(int n) const {
+    return solution_values_[n];
+  }
+  int64 objective_value(int n) const { return objective_values_[n]; }
+
+  // The index of the best solution for an optimization problem, of the last
+  // stored solution otherwise, or -1 if there is no solution.
+  int best_solution() const { return best_solution_; }
+
+  // Statistics of the last Solve(), summed over the workers.
+  int64 branches() const { return branches_; }
+  int64 failures() const { return failures_; }
+  int64 num_subproblems() const { return num_subproblems_; }
+  int64 num_donations() const { return num_donations_; }
+
+ private:
+  void RunWorker(int worker);
+
+  const std::string name_;
+  const int num_workers_;
+  const ModelBuilder model_builder_;
+  bool stop_after_first_solution_;
+  std::unique_ptr<ParallelSearchWorkQueue> queue_;
+  std::unique_ptr<SharedObjectiveBound> bound_;
+
+  // Guards the results below while the workers are running.
+  Mutex mutex_;
+  bool maximize_;
+  bool has_objective_;
+  std::vector<std::vector<int64>> solution_values_;
+  std::vector<int64> objective_values_;
+  int best_solution_;
+  int64 branches_;
+  int64 failures_;
+  int64 num_subproblems_;
+  int64 num_donations_;
+
+  DISALLOW_COPY_AND_ASSIGN(ParallelSearch);
+};
+
+// ============================================================================
+// Implementation.
+// ============================================================================
+
+inline ParallelSearchWorkQueue::ParallelSearchWorkQueue(int num_workers)
+    : num_busy_(num_workers),
+      num_pushed_(0),
+      num_waiting_(0),
+      num_pending_(0),
+      stopped_(false) {}
+
+inline void ParallelSearchWorkQueue::Push(const std::vector<bool>& path) {
+  MutexLock lock(&mutex_);
+  paths_.push_back(path);
+  ++num_pushed_;
+  num_pending_.fetch_add(1, std::memory_order_relaxed);
+  condition_.Signal();
+}
+
+inline bool ParallelSearchWorkQueue::Take(std::vector<bool>* path) {
+  MutexLock lock(&mutex_);
+  --num_busy_;
+  num_waiting_.fetch_add(1, std::memory_order_relaxed);
+  // The last busy worker can't push anything anymore, so the waiting workers
+  // must be woken up to see that the search is over.
+  if (num_busy_ == 0) condition_.SignalAll();
+  while (paths_.empty() && num_busy_ > 0 && !stopped()) {
+    condition_.Wait(&mutex_);
+  }
+  num_waiting_.fetch_sub(1, std::memory_order_relaxed);
+  if (paths_.empty() || stopped()) {
+    condition_.SignalAll();
+    return false;
+  }
+  path->swap(paths_.front());
+  paths_.pop_front();
+  num_pending_.fetch_sub(1, std::memory_order_relaxed);
+  ++num_busy_;
+  return true;
+}
+
+inline void ParallelSearchWorkQueue::Stop() {
+  MutexLock lock(&mutex_);
+  stopped_.store(true, std::memory_order_relaxed);
+  condition_.SignalAll();
+}
+
+inline bool SharedObjectiveBound::Update(int64 value) {
+  int64 best = best_.load(std::memory_order_relaxed);
+  while (maximize_ ? value > best : value < best) {
+    if (best_.compare_exchange_weak(best, value)) return true;
+  }
+  return false;
+}
+
+inline ParallelSearchMonitor::ParallelSearchMonitor(
+    Solver* const solver, ParallelSearchWorkQueue* queue,
+    SharedObjectiveBound* bound, IntVar* objective, bool maximize, int64 step,
+    bool stop_after_first_solution)
+    : SearchMonitor(solver),
+      queue_(queue),
+      bound_(bound),
+      objective_(objective),
+      maximize_(maximize),
+      step_(step),
+      stop_after_first_solution_(stop_after_first_solution),
+      prefix_length_(0),
+      depth_(0),
+      num_donations_(0) {}
+
+inline void ParallelSearchMonitor::EnterSearch() {
+  prefix_length_ = path_.size();
+  donated_.assign(prefix_length_, false);
+  depth_ = 0;
+}
+
+inline void ParallelSearchMonitor::CheckStopAndBound() {
+  if (queue_->stopped()) solver()->Fail();
+  if (bound_ != nullptr && bound_->has_value()) {
+    if (maximize_) {
+      objective_->SetMin(CapAdd(bound_->best(), step_));
+    } else {
+      objective_->SetMax(CapSub(bound_->best(), step_));
+    }
+  }
+}
+
+inline void ParallelSearchMonitor::BeginNextDecision(
+    DecisionBuilder* const b) {
+  CheckStopAndBound();
+  if (depth_ > prefix_length_ && queue_->NeedsWork()) Donate();
+}
+
+inline void ParallelSearchMonitor::Donate() {
+  for (int depth = prefix_length_; depth < depth_; ++depth) {
+    if (!path_[depth] && !donated_[depth]) {
+      std::vector<bool> donated_path(path_.begin(),
+                                     path_.begin() + depth + 1);
+      donated_path[depth] = true;
+      queue_->Push(donated_path);
+      donated_[depth] = true;
+      ++num_donations_;
+      return;
+    }
+  }
+}
+
+inline void ParallelSearchMonitor::ApplyDecision(Decision* const d) {
+  const int depth = depth_;
+  solver()->SaveAndAdd(&depth_, 1);
+  if (depth < prefix_length_) {
+    if (path_[depth]) solver()->Fail();
+    return;
+  }
+  if (depth >= static_cast<int>(path_.size())) {
+    path_.resize(depth + 1);
+    donated_.resize(depth + 1);
+  }
+  path_[depth] = false;
+  donated_[depth] = false;
+}
+
+inline void ParallelSearchMonitor::RefuteDecision(Decision* const d) {
+  const int depth = depth_;
+  solver()->SaveAndAdd(&depth_, 1);
+  if (depth < prefix_length_) {
+    if (!path_[depth]) solver()->Fail();
+    return;
+  }
+  // The right branch was given to another worker.
+  if (donated_[depth]) solver()->Fail();
+  path_[depth] = true;
+  CheckStopAndBound();
+}
+
+inline bool ParallelSearchMonitor::AtSolution() {
+  if (bound_ != nullptr) bound_->Update(objective_->Value());
+  if (stop_after_first_solution_) queue_->Stop();
+  return true;
+}
+
+inline ParallelSearch::ParallelSearch(const std::string& name, int num_workers,
+                                      const ModelBuilder& model_builder)
+    : name_(name),
+      num_workers_(num_workers),
+      model_builder_(model_builder),
+      stop_after_first_solution_(false),
+      maximize_(false),
+      has_objective_(false),
+      best_solution_(-1),
+      branches_(0),
+      failures_(0),
+      num_subproblems_(0),
+      num_donations_(0) {
+  CHECK_GE(num_workers, 1);
+}
+
+inline bool ParallelSearch::Solve() {
+  solution_values_.clear();
+  objective_values_.clear();
+  best_solution_ = -1;
+  branches_ = 0;
+  failures_ = 0;
+  num_subproblems_ = 0;
+  num_donations_ = 0;
+  queue_.reset(new ParallelSearchWorkQueue(num_workers_));
+  // The bound is created by the first worker that knows the direction.
+  bound_.reset();
+  queue_->Push(std::vector<bool>());
+  {
+    ThreadPool pool(name_, num_workers_);
+    pool.StartWorkers();
+    for (int worker = 0; worker < num_workers_; ++worker) {
+      pool.Add(NewCallback(this, &ParallelSearch::RunWorker, worker));
+    }
+  }
+  const int num_solutions = solution_values_.size();
+  for (int n = 0; n < num_solutions; ++n) {
+    if (best_solution_ == -1 || !has_objective_) {
+      best_solution_ = n;
+      continue;
+    }
+    const int64 best = objective_values_[best_solution_];
+    if (maximize_ ? objective_values_[n] > best : objective_values_[n] < best) {
+      best_solution_ = n;
+    }
+  }
+  VLOG(1) << name_ << ": " << solution_values_.size() << " solutions, "
+          << num_subproblems_ << " subproblems, " << branches_
+          << " branches, " << failures_ << " failures.";
+  return best_solution_ != -1;
+}
+
+inline void ParallelSearch::RunWorker(int worker) {
+  Solver solver(StrCat(name_, "_", worker));
+  ParallelSearchReplica replica;
+  model_builder_(&solver, &replica);
+  CHECK(replica.decision_builder != nullptr);
+  SharedObjectiveBound* bound = nullptr;
+  if (replica.objective != nullptr) {
+    MutexLock lock(&mutex_);
+    if (bound_ == nullptr) {
+      bound_.reset(new SharedObjectiveBound(replica.maximize));
+      maximize_ = replica.maximize;
+      has_objective_ = true;
+    }
+    bound = bound_.get();
+  }
+  std::vector<SearchMonitor*> monitors = replica.monitors;
+  if (replica.objective != nullptr) {
+    monitors.push_back(solver.MakeOptimize(replica.maximize, replica.objective,
+                                           replica.step));
+    if (replica.collector != nullptr) {
+      replica.collector->AddObjective(replica.objective);
+    }
+  }
+  if (replica.collector != nullptr) monitors.push_back(replica.collector);
+  ParallelSearchMonitor* const monitor = solver.RevAlloc(
+      new ParallelSearchMonitor(&solver, queue_.get(), bound, replica.objective,
+                                replica.maximize, replica.step,
+                                stop_after_first_solution_));
+  monitors.push_back(monitor);
+
+  int64 num_subproblems = 0;
+  std::vector<bool> path;
+  while (queue_->Take(&path)) {
+    ++num_subproblems;
+    monitor->SetPrefix(path);
+    solver.Solve(replica.decision_builder, monitors);
+    if (replica.collector == nullptr) continue;
+    SolutionCollector* const collector = replica.collector;
+    if (collector->solution_count() == 0) continue;
+    MutexLock lock(&mutex_);
+    for (int n = 0; n < collector->solution_count(); ++n) {
+      const Assignment* const solution = collector->solution(n);
+      const Assignment::IntContainer& container = solution->IntVarContainer();
+      std::vector<int64> values(container.Size());
+      for (int i = 0; i < container.Size(); ++i) {
+        values[i] = container.Element(i).Value();
+      }
+      solution_values_.push_back(values);
+      objective_values_.push_back(
+          solution->HasObjective() ? solution->ObjectiveValue() : 0);
+    }
+  }
+  MutexLock lock(&mutex_);
+  branches_ += solver.branches();
+  failures_ += solver.failures();
+  num_subproblems_ += num_subproblems;
+  num_donations_ += monitor->num_donations();
+}
+
+}  // namespace operations_research
+
+#endif  // OR_TOOLS_CONSTRAINT_SOLVER_PARALLEL_SEARCH_H_
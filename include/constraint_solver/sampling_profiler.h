@@ -0,0 +1,507 @@
+// Copyright 2010-2014 Google
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+// A statistical profiler of the propagation, as a cheap alternative to the
+// DemonProfiler behind the profile_propagation parameter, which reads the
+// clock and records the start and end time of every demon run.
+//
+// The SamplingDemonProfiler does not read the clock: it maintains a
+// thread-local "current propagator", i.e. the running demon, or the
+// constraint in its initial propagation. A SIGPROF timer interrupts the
+// process every sampling period of CPU time, and the signal handler counts
+// one sample for the current propagator in a lock-free table. The time of a
+// propagator is estimated as its number of samples times the period.
+//
+// The current propagator is set:
+// - by ScopedSampledPropagator, which custom constraints put in their
+//   propagation methods. This is the only low-overhead way to profile: it
+//   costs two stores per propagation, and the demons and constraints are
+//   named with RegisterSampledDemon().
+// - by the PropagationMonitor events. The solver only reports the demon runs
+//   of the built-in constraints when it instruments demons, i.e. with the
+//   profile_propagation or trace_propagation parameters, which slows down the
+//   propagation by a factor of 2 to 3 whatever the monitor does. Sampling
+//   then only saves the clock reads of the DemonProfiler.
+//
+// See examples/cpp/sampled_nqueens.cc for an example.
+//
+// The result is exported in the ConstraintRuns format of demon_profiler.proto,
+// so that the tools that read the DemonProfiler output work unchanged. As
+// there are no individual runs, each demon and each initial propagation has a
+// single run, starting at 0 and lasting the estimated time, in microseconds.
+//
+// Only one SamplingDemonProfiler can sample at a time in a process, and it
+// uses the ITIMER_PROF timer and the SIGPROF handler.
+
+#ifndef OR_TOOLS_CONSTRAINT_SOLVER_SAMPLING_PROFILER_H_
+#define OR_TOOLS_CONSTRAINT_SOLVER_SAMPLING_PROFILER_H_
+
+#include <signal.h>
+#include <string.h>
+#include <sys/time.h>
+#include <algorithm>
+#include <atomic>
+#include <memory>
+#include <string>
+#include <vector>
+
+#include "base/hash.h"
+#include "base/integral_types.h"
+#include "base/logging.h"
+#include "base/macros.h"
+#include "base/stringprintf.h"
+#include "constraint_solver/constraint_solver.h"
+#include "constraint_solver/constraint_solveri.h"
+#include "constraint_solver/demon_profiler.pb.h"
+
+namespace operations_research {
+
+// The propagator running on the current thread, read by the signal handler.
+// The fields are volatile so that the compiler neither delays nor drops the
+// stores the handler may observe.
+struct SampledPropagator {
+  const Demon* volatile demon;
+  const Constraint* volatile constraint;
+};
+
+// Returns the state of the current thread. It is a trivially constructible
+// thread-local, so that the signal handler can read it.
+SampledPropagator* CurrentSampledPropagator();
+
+// Marks the given demon, or the initial propagation of the given
+// constraint, as the current propagator for the lifetime of the object.
+class ScopedSampledPropagator {
+ public:
+  explicit ScopedSampledPropagator(const Demon* const demon)
+      : state_(CurrentSampledPropagator()), saved_(*state_) {
+    state_->demon = demon;
+  }
+  explicit ScopedSampledPropagator(const Constraint* const constraint)
+      : state_(CurrentSampledPropagator()), saved_(*state_) {
+    state_->demon = nullptr;
+    state_->constraint = constraint;
+  }
+  ~ScopedSampledPropagator() { *state_ = saved_; }
+
+ private:
+  SampledPropagator* const state_;
+  const SampledPropagator saved_;
+  DISALLOW_COPY_AND_ASSIGN(ScopedSampledPropagator);
+};
+
+// A fixed-size table of sample counts by address, that can be updated from
+// a signal handler.
+class SampleCountTable {
+ public:
+  explicit SampleCountTable(int capacity);
+
+  // Adds one sample for the key. Async-signal-safe. The sample is dropped if
+  // the table is full.
+  void Add(const void* const key);
+
+  // Calls callback(key, count) for each key with samples.
+  template <class F>
+  void ForEach(const F& callback) const;
+
+  int64 num_dropped() const {
+    return num_dropped_.load(std::memory_order_relaxed);
+  }
+
+ private:
+  struct Entry {
+    std::atomic<const void*> key;
+    std::atomic<int64> count;
+  };
+
+  const int capacity_;
+  std::unique_ptr<Entry[]> entries_;
+  std::atomic<int64> num_dropped_;
+
+  DISALLOW_COPY_AND_ASSIGN(SampleCountTable);
+};
+
+class SamplingDemonProfiler : public PropagationMonitor {
+ public:
+  // The period is in microseconds of CPU time.
+  SamplingDemonProfiler(Solver* const solver, int sampling_period_us);
+  ~SamplingDemonProfiler() override;
+
+  // Starts and stops the SIGPROF timer.
+  void StartSampling();
+  void StopSampling();
+
+  // Appends one ConstraintRuns per constraint with samples or failures.
+  // Demons of unknown constraints and unregistered demons, like the ones of
+  // the variables, are grouped under pseudo-constraints.
+  void ExportConstraintRuns(std::vector<ConstraintRuns>* const runs) const;
+
+  // Names a demon and its constraint, for the propagators marked with
+  // ScopedSampledPropagator that the solver does not report because it does
+  // not instrument demons. Typically called from the Post() method.
+  void RegisterSampledDemon(const Constraint* const constraint,
+                            const Demon* const demon);
+
+  int64 num_samples() const {
+    return num_samples_.load(std::memory_order_relaxed);
+  }
+  // Samples outside of any propagator, e.g. in the search itself.
+  int64 num_samples_outside_propagation() const {
+    return num_outside_samples_.load(std::memory_order_relaxed);
+  }
+  int64 num_dropped_samples() const {
+    return demon_samples_.num_dropped() + constraint_samples_.num_dropped();
+  }
+
+  // SearchMonitor.
+  void BeginFail() override;
+  std::string DebugString() const override;
+
+  // PropagationMonitor.
+  void BeginConstraintInitialPropagation(
+      Constraint* const constraint) override;
+  void EndConstraintInitialPropagation(Constraint* const constraint) override;
+  void BeginNestedConstraintInitialPropagation(
+      Constraint* const parent, Constraint* const nested) override {}
+  void EndNestedConstraintInitialPropagation(
+      Constraint* const parent, Constraint* const nested) override {}
+  void RegisterDemon(Demon* const demon) override;
+  void BeginDemonRun(Demon* const demon) override;
+  void EndDemonRun(Demon* const demon) override;
+  void StartProcessingIntegerVariable(IntVar* const var) override {}
+  void EndProcessingIntegerVariable(IntVar* const var) override {}
+  void PushContext(const std::string& context) override {}
+  void PopContext() override {}
+  void SetMin(IntExpr* const expr, int64 new_min) override {}
+  void SetMax(IntExpr* const expr, int64 new_max) override {}
+  void SetRange(IntExpr* const expr, int64 new_min, int64 new_max) override {}
+  void SetMin(IntVar* const var, int64 new_min) override {}
+  void SetMax(IntVar* const var, int64 new_max) override {}
+  void SetRange(IntVar* const var, int64 new_min, int64 new_max) override {}
+  void RemoveValue(IntVar* const var, int64 value) override {}
+  void SetValue(IntVar* const var, int64 value) override {}
+  void RemoveInterval(IntVar* const var, int64 imin, int64 imax) override {}
+  void SetValues(IntVar* const var, const std::vector<int64>& values) override {
+  }
+  void RemoveValues(IntVar* const var,
+                    const std::vector<int64>& values) override {}
+  void SetStartMin(IntervalVar* const var, int64 new_min) override {}
+  void SetStartMax(IntervalVar* const var, int64 new_max) override {}
+  void SetStartRange(IntervalVar* const var, int64 new_min,
+                     int64 new_max) override {}
+  void SetEndMin(IntervalVar* const var, int64 new_min) override {}
+  void SetEndMax(IntervalVar* const var, int64 new_max) override {}
+  void SetEndRange(IntervalVar* const var, int64 new_min,
+                   int64 new_max) override {}
+  void SetDurationMin(IntervalVar* const var, int64 new_min) override {}
+  void SetDurationMax(IntervalVar* const var, int64 new_max) override {}
+  void SetDurationRange(IntervalVar* const var, int64 new_min,
+                        int64 new_max) override {}
+  void SetPerformed(IntervalVar* const var, bool value) override {}
+  void RankFirst(SequenceVar* const var, int index) override {}
+  void RankNotFirst(SequenceVar* const var, int index) override {}
+  void RankLast(SequenceVar* const var, int index) override {}
+  void RankNotLast(SequenceVar* const var, int index) override {}
+  void RankSequence(SequenceVar* const var, const std::vector<int>& rank_first,
+                    const std::vector<int>& rank_last,
+                    const std::vector<int>& unperformed) override {}
+
+ private:
+  static void HandleSignal(int signal);
+  void Sample();
+
+  const int sampling_period_us_;
+  SampleCountTable demon_samples_;
+  SampleCountTable constraint_samples_;
+  std::atomic<int64> num_samples_;
+  std::atomic<int64> num_outside_samples_;
+  // The demons whose run enclose the current one.
+  std::vector<const Demon*> demon_stack_;
+  // Names are computed when the objects are registered, as they can be
+  // deleted before the export.
+  hash_map<const Demon*, const Constraint*> demon_owners_;
+  hash_map<const void*, std::string> names_;
+  hash_map<const void*, int64> failures_;
+  bool sampling_;
+  struct sigaction saved_action_;
+
+  DISALLOW_COPY_AND_ASSIGN(SamplingDemonProfiler);
+};
+
+// ============================================================================
+// Implementation.
+// ============================================================================
+
+namespace sampling_profiler_internal {
+
+// The profiler that receives the samples, if any.
+inline std::atomic<SamplingDemonProfiler*>* ActiveProfiler() {
+  static std::atomic<SamplingDemonProfiler*> active(nullptr);
+  return &active;
+}
+
+static const char kUnknownConstraint[] = "Unknown constraint";
+static const char kUnregisteredDemons[] = "Unregistered demons";
+
+}  // namespace sampling_profiler_internal
+
+inline SampledPropagator* CurrentSampledPropagator() {
+  static thread_local SampledPropagator state = {nullptr, nullptr};
+  return &state;
+}
+
+inline SampleCountTable::SampleCountTable(int capacity)
+    : capacity_(capacity), entries_(new Entry[capacity]), num_dropped_(0) {
+  for (int i = 0; i < capacity_; ++i) {
+    entries_[i].key.store(nullptr, std::memory_order_relaxed);
+    entries_[i].count.store(0, std::memory_order_relaxed);
+  }
+}
+
+inline void SampleCountTable::Add(const void* const key) {
+  // Linear probing from a multiplicative hash of the address.
+  uint64 slot = (reinterpret_cast<uint64>(key) * GG_ULONGLONG(
+                     0x9E3779B97F4A7C15)) >> 32;
+  for (int probe = 0; probe < capacity_; ++probe) {
+    Entry* const entry = &entries_[(slot + probe) % capacity_];
+    const void* current = entry->key.load(std::memory_order_relaxed);
+    if (current == nullptr &&
+        entry->key.compare_exchange_strong(current, key)) {
+      current = key;
+    }
+    if (current == key) {
+      entry->count.fetch_add(1, std::memory_order_relaxed);
+      return;
+    }
+  }
+  num_dropped_.fetch_add(1, std::memory_order_relaxed);
+}
+
+template <class F>
+void SampleCountTable::ForEach(const F& callback) const {
+  for (int i = 0; i < capacity_; ++i) {
+    const void* const key = entries_[i].key.load(std::memory_order_relaxed);
+    const int64 count = entries_[i].count.load(std::memory_order_relaxed);
+    if (key != nullptr && count > 0) callback(key, count);
+  }
+}
+
+inline SamplingDemonProfiler::SamplingDemonProfiler(Solver* const solver,
+                                                    int sampling_period_us)
+    : PropagationMonitor(solver),
+      sampling_period_us_(sampling_period_us),
+      demon_samples_(1 << 16),
+      constraint_samples_(1 << 14),
+      num_samples_(0),
+      num_outside_samples_(0),
+      sampling_(false) {
+  CHECK_GT(sampling_period_us, 0);
+}
+
+inline SamplingDemonProfiler::~SamplingDemonProfiler() {
+  if (sampling_) StopSampling();
+}
+
+inline void SamplingDemonProfiler::StartSampling() {
+  CHECK(!sampling_);
+  // Initializes the thread-local before the first signal.
+  CurrentSampledPropagator();
+  SamplingDemonProfiler* expected = nullptr;
+  CHECK(sampling_profiler_internal::ActiveProfiler()->compare_exchange_strong(
+      expected, this))
+      << "Another SamplingDemonProfiler is already sampling.";
+  struct sigaction action;
+  memset(&action, 0, sizeof(action));
+  action.sa_handler = &SamplingDemonProfiler::HandleSignal;
+  action.sa_flags = SA_RESTART;
+  sigemptyset(&action.sa_mask);
+  CHECK_EQ(0, sigaction(SIGPROF, &action, &saved_action_));
+  struct itimerval timer;
+  timer.it_interval.tv_sec = sampling_period_us_ / 1000000;
+  timer.it_interval.tv_usec = sampling_period_us_ % 1000000;
+  timer.it_value = timer.it_interval;
+  CHECK_EQ(0, setitimer(ITIMER_PROF, &timer, nullptr));
+  sampling_ = true;
+}
+
+inline void SamplingDemonProfiler::StopSampling() {
+  CHECK(sampling_);
+  // The handler ignores the signals from now on, including the ones that are
+  // still pending.
+  sampling_profiler_internal::ActiveProfiler()->store(nullptr);
+  struct itimerval timer;
+  memset(&timer, 0, sizeof(timer));
+  setitimer(ITIMER_PROF, &timer, nullptr);
+  // A pending SIGPROF would kill the process with the default action.
+  if (saved_action_.sa_handler == SIG_DFL) {
+    saved_action_.sa_handler = SIG_IGN;
+  }
+  sigaction(SIGPROF, &saved_action_, nullptr);
+  sampling_ = false;
+}
+
+inline void SamplingDemonProfiler::HandleSignal(int signal) {
+  SamplingDemonProfiler* const profiler =
+      sampling_profiler_internal::ActiveProfiler()->load(
+          std::memory_order_acquire);
+  if (profiler != nullptr) profiler->Sample();
+}
+
+inline void SamplingDemonProfiler::Sample() {
+  const SampledPropagator* const state = CurrentSampledPropagator();
+  num_samples_.fetch_add(1, std::memory_order_relaxed);
+  if (state->demon != nullptr) {
+    demon_samples_.Add(state->demon);
+  } else if (state->constraint != nullptr) {
+    constraint_samples_.Add(state->constraint);
+  } else {
+    num_outside_samples_.fetch_add(1, std::memory_order_relaxed);
+  }
+}
+
+inline void SamplingDemonProfiler::BeginConstraintInitialPropagation(
+    Constraint* const constraint) {
+  if (names_.find(constraint) == names_.end()) {
+    names_[constraint] = constraint->DebugString();
+  }
+  SampledPropagator* const state = CurrentSampledPropagator();
+  state->demon = nullptr;
+  state->constraint = constraint;
+}
+
+inline void SamplingDemonProfiler::EndConstraintInitialPropagation(
+    Constraint* const constraint) {
+  CurrentSampledPropagator()->constraint = nullptr;
+}
+
+inline void SamplingDemonProfiler::RegisterDemon(Demon* const demon) {
+  // Demons are registered when their constraint is posted, i.e. during its
+  // initial propagation.
+  demon_owners_[demon] = CurrentSampledPropagator()->constraint;
+  names_[demon] = demon->DebugString();
+}
+
+inline void SamplingDemonProfiler::RegisterSampledDemon(
+    const Constraint* const constraint, const Demon* const demon) {
+  if (names_.find(constraint) == names_.end()) {
+    names_[constraint] = constraint->DebugString();
+  }
+  demon_owners_[demon] = constraint;
+  names_[demon] = demon->DebugString();
+}
+
+inline void SamplingDemonProfiler::BeginDemonRun(Demon* const demon) {
+  SampledPropagator* const state = CurrentSampledPropagator();
+  const Demon* const enclosing = state->demon;
+  demon_stack_.push_back(enclosing);
+  state->demon = demon;
+}
+
+inline void SamplingDemonProfiler::EndDemonRun(Demon* const demon) {
+  // A failure unwinds without ending the runs, see BeginFail().
+  if (demon_stack_.empty()) return;
+  CurrentSampledPropagator()->demon = demon_stack_.back();
+  demon_stack_.pop_back();
+}
+
+inline void SamplingDemonProfiler::BeginFail() {
+  SampledPropagator* const state = CurrentSampledPropagator();
+  if (state->demon != nullptr) {
+    ++failures_[state->demon];
+  } else if (state->constraint != nullptr) {
+    ++failures_[state->constraint];
+  }
+  state->demon = nullptr;
+  state->constraint = nullptr;
+  demon_stack_.clear();
+}
+
+inline void SamplingDemonProfiler::ExportConstraintRuns(
+    std::vector<ConstraintRuns>* const runs) const {
+  using sampling_profiler_internal::kUnknownConstraint;
+  using sampling_profiler_internal::kUnregisteredDemons;
+  const int64 period = sampling_period_us_;
+  // Index in 'runs' of each constraint, the unknown constraint being
+  // keyed by kUnknownConstraint and unregistered demons by
+  // kUnregisteredDemons.
+  hash_map<const void*, int> constraint_index;
+  const auto get_runs = [&](const void* const key,
+                            const std::string& name) -> ConstraintRuns* {
+    const auto it = constraint_index.find(key);
+    if (it != constraint_index.end()) return &(*runs)[it->second];
+    constraint_index[key] = runs->size();
+    runs->push_back(ConstraintRuns());
+    runs->back().set_constraint_id(name);
+    return &runs->back();
+  };
+  const auto name_of = [this](const void* const key) -> const std::string& {
+    return names_.find(key)->second;
+  };
+  const auto failures_of = [this](const void* const key) -> int64 {
+    const auto it = failures_.find(key);
+    return it == failures_.end() ? 0 : it->second;
+  };
+  // The runs are written in increasing address order, to get a
+  // deterministic export for a given search.
+  std::vector<std::pair<const void*, int64> > samples;
+  constraint_samples_.ForEach([&samples](const void* key, int64 count) {
+    samples.push_back(std::make_pair(key, count));
+  });
+  std::sort(samples.begin(), samples.end());
+  for (const std::pair<const void*, int64>& sample : samples) {
+    ConstraintRuns* const constraint_runs =
+        names_.find(sample.first) == names_.end()
+            ? get_runs(kUnknownConstraint, kUnknownConstraint)
+            : get_runs(sample.first, name_of(sample.first));
+    constraint_runs->add_initial_propagation_start_time(0);
+    constraint_runs->add_initial_propagation_end_time(sample.second * period);
+    constraint_runs->set_failures(constraint_runs->failures() +
+                                  failures_of(sample.first));
+  }
+  samples.clear();
+  demon_samples_.ForEach([&samples](const void* key, int64 count) {
+    samples.push_back(std::make_pair(key, count));
+  });
+  std::sort(samples.begin(), samples.end());
+  for (const std::pair<const void*, int64>& sample : samples) {
+    const Demon* const demon = static_cast<const Demon*>(sample.first);
+    const auto owner = demon_owners_.find(demon);
+    ConstraintRuns* constraint_runs = nullptr;
+    if (owner == demon_owners_.end()) {
+      constraint_runs = get_runs(kUnregisteredDemons, kUnregisteredDemons);
+    } else if (owner->second == nullptr) {
+      constraint_runs = get_runs(kUnknownConstraint, kUnknownConstraint);
+    } else {
+      constraint_runs = get_runs(owner->second, name_of(owner->second));
+    }
+    DemonRuns* const demon_runs = constraint_runs->add_demons();
+    demon_runs->set_demon_id(owner == demon_owners_.end()
+                                 ? StringPrintf("%p", sample.first)
+                                 : name_of(demon));
+    demon_runs->add_start_time(0);
+    demon_runs->add_end_time(sample.second * period);
+    demon_runs->set_failures(failures_of(demon));
+  }
+}
+
+inline std::string SamplingDemonProfiler::DebugString() const {
+  return StringPrintf(
+      "SamplingDemonProfiler(period = %dus, %" GG_LL_FORMAT
+      "d samples, %" GG_LL_FORMAT "d outside propagation, %" GG_LL_FORMAT
+      "d dropped)",
+      sampling_period_us_, num_samples(), num_samples_outside_propagation(),
+      num_dropped_samples());
+}
+
+}  // namespace operations_research
+
+#endif  // OR_TOOLS_CONSTRAINT_SOLVER_SAMPLING_PROFILER_H_
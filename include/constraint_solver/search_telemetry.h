@@ -0,0 +1,129 @@
+// Copyright 2010-2014 Google
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+// A search monitor that publishes the progress of a CP search into the
+// counters of a TelemetryStream (see util/telemetry.h). Unlike SearchLog, it
+// never formats anything on the search thread: each event is a few relaxed
+// atomic stores, and the stream samples them on its own timer thread.
+//
+// Usage with the CP solver:
+//   TelemetryStream stream("golomb", 1.0, 1024);
+//   stream.AddWriter(new JsonTelemetryWriter(File::OpenOrDie(path, "w")));
+//   monitors.push_back(MakeSearchTelemetry(&solver, objective->Var(), false,
+//                                          stream.counters()));
+//   stream.Start();
+//   solver.Solve(db, monitors);
+//   stream.Stop();
+//
+// With the routing library, the monitor watches the cost variable:
+//   routing.AddSearchMonitor(MakeSearchTelemetry(
+//       routing.solver(), routing.CostVar(), false, stream.counters()));
+
+#ifndef OR_TOOLS_CONSTRAINT_SOLVER_SEARCH_TELEMETRY_H_
+#define OR_TOOLS_CONSTRAINT_SOLVER_SEARCH_TELEMETRY_H_
+
+#include <string>
+
+#include "base/integral_types.h"
+#include "base/macros.h"
+#include "constraint_solver/constraint_solver.h"
+#include "util/telemetry.h"
+
+namespace operations_research {
+
+class SearchTelemetry : public SearchMonitor {
+ public:
+  // 'objective' can be nullptr. The counters must outlive the search.
+  SearchTelemetry(Solver* const s, IntVar* const objective, bool maximize,
+                  TelemetryCounters* const counters)
+      : SearchMonitor(s),
+        objective_(objective),
+        maximize_(maximize),
+        counters_(counters),
+        num_solutions_(0),
+        best_(0) {}
+  ~SearchTelemetry() override {}
+
+  void EnterSearch() override;
+  void EndInitialPropagation() override;
+  void ApplyDecision(Decision* const d) override { PublishBranch(); }
+  void RefuteDecision(Decision* const d) override { PublishBranch(); }
+  void BeginFail() override {
+    counters_->set_failures(solver()->failures());
+  }
+  bool AtSolution() override;
+  void ExitSearch() override { PublishBranch(); }
+  std::string DebugString() const override { return "SearchTelemetry"; }
+
+ private:
+  void PublishBranch() {
+    counters_->set_branches(solver()->branches());
+    counters_->set_depth(solver()->SearchDepth());
+  }
+
+  IntVar* const objective_;
+  const bool maximize_;
+  TelemetryCounters* const counters_;
+  int64 num_solutions_;
+  int64 best_;
+
+  DISALLOW_COPY_AND_ASSIGN(SearchTelemetry);
+};
+
+SearchMonitor* MakeSearchTelemetry(Solver* const s, IntVar* const objective,
+                                   bool maximize,
+                                   TelemetryCounters* const counters);
+
+// ============================================================================
+// Implementation.
+// ============================================================================
+
+inline void SearchTelemetry::EnterSearch() {
+  num_solutions_ = 0;
+  counters_->set_solutions(0);
+  counters_->set_failures(solver()->failures());
+  PublishBranch();
+}
+
+inline void SearchTelemetry::EndInitialPropagation() {
+  // The bounds of the objective after the initial propagation hold for the
+  // whole search.
+  if (objective_ != nullptr) {
+    counters_->set_objective_bound(maximize_ ? objective_->Max()
+                                             : objective_->Min());
+  }
+}
+
+inline bool SearchTelemetry::AtSolution() {
+  ++num_solutions_;
+  counters_->set_solutions(num_solutions_);
+  if (objective_ != nullptr && objective_->Bound()) {
+    const int64 value = objective_->Value();
+    if (num_solutions_ == 1 || (maximize_ ? value > best_ : value < best_)) {
+      best_ = value;
+      counters_->set_objective(best_);
+    }
+  }
+  return false;
+}
+
+inline SearchMonitor* MakeSearchTelemetry(Solver* const s,
+                                          IntVar* const objective,
+                                          bool maximize,
+                                          TelemetryCounters* const counters) {
+  return s->RevAlloc(new SearchTelemetry(s, objective, maximize, counters));
+}
+
+}  // namespace operations_research
+
+#endif  // OR_TOOLS_CONSTRAINT_SOLVER_SEARCH_TELEMETRY_H_
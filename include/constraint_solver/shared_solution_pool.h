@@ -0,0 +1,442 @@
+// Copyright 2010-2014 Google
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+// A pool of elite solutions shared by several local searches running in
+// parallel, each on its own Solver and thread.
+//
+// The SharedSolutionPool holds a bounded set of good and diverse solutions.
+// Since the variables of two solvers are different objects, the solutions are
+// stored as plain vectors of values, indexed by the position of the variables
+// in the integer variable container of the assignments. All the solvers must
+// thus use assignments with the same variables in the same order, which is the
+// case when they are built by the same code.
+//
+// Each solver gets its own SolutionPool, created by MakeSharedSolutionPool(),
+// to pass to Solver::MakeLocalSearchPhaseParameters():
+//   SharedSolutionPool elite(/*maximize=*/false, /*capacity=*/16,
+//                            /*min_distance=*/2);
+//   // In each thread:
+//   Solver s("worker");
+//   ... build the model ...
+//   SolutionPool* const pool = MakeSharedSolutionPool(&s, &elite, seed);
+//   LocalSearchPhaseParameters* const parameters =
+//       s.MakeLocalSearchPhaseParameters(pool, ls_operator, sub_db, limit);
+//
+// A solution that can't enter the pool is rejected with a few atomic loads.
+// The other solutions are inserted under a mutex, which builds a new immutable
+// snapshot of the pool content. The readers copy the current snapshot with
+// std::atomic_load on a shared_ptr: this is short, but not lock-free with
+// common standard libraries (libstdc++ uses a small internal mutex), and the
+// readers never wait for a writer building a snapshot.
+//
+// See examples/cpp/shared_pool_ls.cc for an example with several threads.
+
+#ifndef OR_TOOLS_CONSTRAINT_SOLVER_SHARED_SOLUTION_POOL_H_
+#define OR_TOOLS_CONSTRAINT_SOLVER_SHARED_SOLUTION_POOL_H_
+
+#include <algorithm>
+#include <atomic>
+#include <memory>
+#include <string>
+#include <vector>
+
+#include "base/integral_types.h"
+#include "base/logging.h"
+#include "base/macros.h"
+#include "base/mutex.h"
+#include "base/random.h"
+#include "base/stringprintf.h"
+#include "constraint_solver/constraint_solver.h"
+
+namespace operations_research {
+
+// The thread-safe elite set. It must outlive the solvers that use it.
+class SharedSolutionPool {
+ public:
+  // A solution of the pool. It is immutable once published.
+  struct Solution {
+    int64 objective;
+    // The bounds of the integer variables of the assignment. They are equal
+    // for a complete solution.
+    std::vector<int64> mins;
+    std::vector<int64> maxs;
+    // Sequential number of the solution in the pool.
+    int64 id;
+  };
+
+  // The content of the pool, sorted from the best solution to the worst.
+  struct Snapshot {
+    Snapshot() : generation(0) {}
+    std::vector<std::shared_ptr<const Solution>> solutions;
+    int64 generation;
+  };
+
+  // The pool keeps at most 'capacity' solutions. Two solutions of the pool
+  // always differ in at least 'min_distance' variables: a new solution that is
+  // too close to some pool solutions replaces them if it is better than all of
+  // them, and is rejected otherwise.
+  SharedSolutionPool(bool maximize, int capacity, int min_distance);
+
+  // Offers a solution to the pool. Returns true if it was added.
+  bool Publish(int64 objective, const std::vector<int64>& mins,
+               const std::vector<int64>& maxs);
+
+  // Returns the current content of the pool. The snapshot stays valid while
+  // the pool is modified. This doesn't wait for the writers, but isn't
+  // lock-free, see the comment at the top of the file.
+  std::shared_ptr<const Snapshot> GetSnapshot() const {
+    return std::atomic_load(&snapshot_);
+  }
+
+  // Returns true if 'a' is a strictly better objective than 'b'.
+  bool Better(int64 a, int64 b) const { return maximize_ ? a > b : a < b; }
+
+  // Number of variables in which two solutions differ.
+  static int Distance(const std::vector<int64>& mins_a,
+                      const std::vector<int64>& maxs_a,
+                      const std::vector<int64>& mins_b,
+                      const std::vector<int64>& maxs_b);
+
+  // Changes each time a solution enters the pool.
+  int64 generation() const {
+    return generation_.load(std::memory_order_acquire);
+  }
+  // The best objective in the pool. Meaningless if the pool is empty.
+  int64 best_objective() const {
+    return best_objective_.load(std::memory_order_acquire);
+  }
+  bool maximize() const { return maximize_; }
+
+  int64 num_published() const { return num_published_.load(); }
+  int64 num_accepted() const { return num_accepted_.load(); }
+  std::string DebugString() const;
+
+ private:
+  const bool maximize_;
+  const int capacity_;
+  const int min_distance_;
+  // Serializes the writers. The readers only use snapshot_, through
+  // std::atomic_load.
+  Mutex mutex_;
+  std::shared_ptr<const Snapshot> snapshot_;
+  // The objective a solution must beat to enter a full pool, for the quick
+  // rejection without locking. Set to the worst possible value while the pool
+  // isn't full.
+  std::atomic<int64> threshold_;
+  std::atomic<int64> best_objective_;
+  std::atomic<int64> generation_;
+  std::atomic<int64> num_published_;
+  std::atomic<int64> num_accepted_;
+  int64 next_id_;
+
+  DISALLOW_COPY_AND_ASSIGN(SharedSolutionPool);
+};
+
+// The SolutionPool of one solver, backed by a SharedSolutionPool.
+//
+// Each new solution of the local search is published to the shared pool.
+// When another solver finds a better solution, SyncNeeded() returns true and
+// the local search restarts from the best solution of the pool. Otherwise,
+// the restarts alternate between intensification and diversification: with
+// probability 'intensification_probability', the search restarts from the best
+// solution of the pool, and otherwise from the pool solution that is the most
+// different from the current one.
+class SharedSolutionPoolClient : public SolutionPool {
+ public:
+  // If the assignments of the local search have no objective, the value of
+  // 'objective' (which can be nullptr) is used.
+  SharedSolutionPoolClient(SharedSolutionPool* const shared, IntVar* objective,
+                           double intensification_probability, int32 seed);
+  ~SharedSolutionPoolClient() override {}
+
+  void Initialize(Assignment* const assignment) override;
+  void RegisterNewSolution(Assignment* const assignment) override;
+  void GetNextSolution(Assignment* const assignment) override;
+  bool SyncNeeded(Assignment* const local_assignment) override;
+  std::string DebugString() const override {
+    return "SharedSolutionPoolClient";
+  }
+
+  int64 num_restarts() const { return num_restarts_; }
+  int64 num_syncs() const { return num_syncs_; }
+
+ private:
+  // Reads the objective and the variable bounds of the assignment in
+  // objective_, mins_ and maxs_. Returns false if the objective is unknown.
+  bool Extract(const Assignment* const assignment);
+  // Copies a pool solution into the assignment.
+  void CopyTo(const SharedSolutionPool::Solution& solution,
+              Assignment* const assignment) const;
+
+  SharedSolutionPool* const shared_;
+  IntVar* const objective_var_;
+  const double intensification_probability_;
+  ACMRandom random_;
+  int64 last_generation_;
+  bool sync_pending_;
+  int64 num_restarts_;
+  int64 num_syncs_;
+  // Buffers for Extract().
+  int64 objective_;
+  std::vector<int64> mins_;
+  std::vector<int64> maxs_;
+
+  DISALLOW_COPY_AND_ASSIGN(SharedSolutionPoolClient);
+};
+
+// Returns a SolutionPool for the given solver, owned by the solver, that
+// shares its solutions through 'shared'.
+SolutionPool* MakeSharedSolutionPool(Solver* const solver,
+                                     SharedSolutionPool* const shared,
+                                     int32 seed);
+SolutionPool* MakeSharedSolutionPool(Solver* const solver,
+                                     SharedSolutionPool* const shared,
+                                     IntVar* const objective,
+                                     double intensification_probability,
+                                     int32 seed);
+
+// ============================================================================
+// Implementation.
+// ============================================================================
+
+inline SharedSolutionPool::SharedSolutionPool(bool maximize, int capacity,
+                                              int min_distance)
+    : maximize_(maximize),
+      capacity_(capacity),
+      min_distance_(min_distance),
+      snapshot_(new Snapshot()),
+      threshold_(maximize ? kint64min : kint64max),
+      best_objective_(maximize ? kint64min : kint64max),
+      generation_(0),
+      num_published_(0),
+      num_accepted_(0),
+      next_id_(0) {
+  CHECK_GE(capacity, 1);
+}
+
+inline int SharedSolutionPool::Distance(const std::vector<int64>& mins_a,
+                                        const std::vector<int64>& maxs_a,
+                                        const std::vector<int64>& mins_b,
+                                        const std::vector<int64>& maxs_b) {
+  DCHECK_EQ(mins_a.size(), mins_b.size());
+  const int size = mins_a.size();
+  int distance = 0;
+  for (int i = 0; i < size; ++i) {
+    if (mins_a[i] != mins_b[i] || maxs_a[i] != maxs_b[i]) ++distance;
+  }
+  return distance;
+}
+
+inline bool SharedSolutionPool::Publish(int64 objective,
+                                        const std::vector<int64>& mins,
+                                        const std::vector<int64>& maxs) {
+  num_published_.fetch_add(1, std::memory_order_relaxed);
+  // This check races with the writers, which can only make the pool accept
+  // one solution less, and saves the lock for most solutions.
+  const int64 threshold = threshold_.load(std::memory_order_acquire);
+  if (threshold != (maximize_ ? kint64min : kint64max) &&
+      !Better(objective, threshold)) {
+    return false;
+  }
+
+  MutexLock lock(&mutex_);
+  const std::shared_ptr<const Snapshot> current = std::atomic_load(&snapshot_);
+  const int size = current->solutions.size();
+  // The pool solutions that are too close to the new one are replaced by it
+  // if they are all worse, and otherwise the new solution is rejected.
+  std::vector<bool> replaced(size, false);
+  int num_replaced = 0;
+  for (int i = 0; i < size; ++i) {
+    const Solution& solution = *current->solutions[i];
+    if (Distance(mins, maxs, solution.mins, solution.maxs) < min_distance_) {
+      if (!Better(objective, solution.objective)) return false;
+      replaced[i] = true;
+      ++num_replaced;
+    }
+  }
+  if (num_replaced == 0 && size == capacity_) {
+    if (!Better(objective, current->solutions.back()->objective)) return false;
+    replaced[size - 1] = true;
+  }
+
+  Solution* const solution = new Solution();
+  solution->objective = objective;
+  solution->mins = mins;
+  solution->maxs = maxs;
+  solution->id = next_id_++;
+  std::shared_ptr<Snapshot> next(new Snapshot());
+  for (int i = 0; i < size; ++i) {
+    if (!replaced[i]) next->solutions.push_back(current->solutions[i]);
+  }
+  next->solutions.push_back(std::shared_ptr<const Solution>(solution));
+  const bool maximize = maximize_;
+  std::stable_sort(next->solutions.begin(), next->solutions.end(),
+                   [maximize](const std::shared_ptr<const Solution>& a,
+                              const std::shared_ptr<const Solution>& b) {
+                     return maximize ? a->objective > b->objective
+                                     : a->objective < b->objective;
+                   });
+  next->generation = current->generation + 1;
+  const int new_size = next->solutions.size();
+  threshold_.store(new_size == capacity_
+                       ? next->solutions.back()->objective
+                       : (maximize_ ? kint64min : kint64max),
+                   std::memory_order_release);
+  best_objective_.store(next->solutions.front()->objective,
+                        std::memory_order_release);
+  generation_.store(next->generation, std::memory_order_release);
+  std::atomic_store(&snapshot_,
+                    std::shared_ptr<const Snapshot>(std::move(next)));
+  num_accepted_.fetch_add(1, std::memory_order_relaxed);
+  return true;
+}
+
+inline std::string SharedSolutionPool::DebugString() const {
+  const std::shared_ptr<const Snapshot> snapshot = GetSnapshot();
+  std::string result = StringPrintf(
+      "SharedSolutionPool(%d solutions, %lld published, %lld accepted)",
+      static_cast<int>(snapshot->solutions.size()),
+      static_cast<long long>(num_published()),   // NOLINT
+      static_cast<long long>(num_accepted()));  // NOLINT
+  for (const std::shared_ptr<const Solution>& solution : snapshot->solutions) {
+    StringAppendF(&result, " %lld",
+                  static_cast<long long>(solution->objective));  // NOLINT
+  }
+  return result;
+}
+
+inline SharedSolutionPoolClient::SharedSolutionPoolClient(
+    SharedSolutionPool* const shared, IntVar* objective,
+    double intensification_probability, int32 seed)
+    : shared_(shared),
+      objective_var_(objective),
+      intensification_probability_(intensification_probability),
+      random_(seed),
+      last_generation_(0),
+      sync_pending_(false),
+      num_restarts_(0),
+      num_syncs_(0),
+      objective_(0) {}
+
+inline bool SharedSolutionPoolClient::Extract(
+    const Assignment* const assignment) {
+  if (assignment->HasObjective()) {
+    objective_ = assignment->ObjectiveValue();
+  } else if (objective_var_ != nullptr && objective_var_->Bound()) {
+    objective_ = objective_var_->Value();
+  } else {
+    return false;
+  }
+  const Assignment::IntContainer& container = assignment->IntVarContainer();
+  const int size = container.Size();
+  mins_.resize(size);
+  maxs_.resize(size);
+  for (int i = 0; i < size; ++i) {
+    mins_[i] = container.Element(i).Min();
+    maxs_[i] = container.Element(i).Max();
+  }
+  return true;
+}
+
+inline void SharedSolutionPoolClient::CopyTo(
+    const SharedSolutionPool::Solution& solution,
+    Assignment* const assignment) const {
+  Assignment::IntContainer* const container =
+      assignment->MutableIntVarContainer();
+  const int size = container->Size();
+  CHECK_EQ(size, static_cast<int>(solution.mins.size()))
+      << "The solvers sharing a pool must have the same variables.";
+  for (int i = 0; i < size; ++i) {
+    container->MutableElement(i)->SetRange(solution.mins[i],
+                                           solution.maxs[i]);
+  }
+  if (assignment->HasObjective()) {
+    assignment->SetObjectiveValue(solution.objective);
+  }
+}
+
+inline void SharedSolutionPoolClient::Initialize(Assignment* const assignment) {
+  last_generation_ = shared_->generation();
+  RegisterNewSolution(assignment);
+}
+
+inline void SharedSolutionPoolClient::RegisterNewSolution(
+    Assignment* const assignment) {
+  if (!Extract(assignment)) return;
+  shared_->Publish(objective_, mins_, maxs_);
+  // Our own solution doesn't require a synchronization.
+  if (shared_->best_objective() == objective_) {
+    last_generation_ = shared_->generation();
+  }
+}
+
+inline void SharedSolutionPoolClient::GetNextSolution(
+    Assignment* const assignment) {
+  const std::shared_ptr<const SharedSolutionPool::Snapshot> snapshot =
+      shared_->GetSnapshot();
+  const int size = snapshot->solutions.size();
+  if (size == 0) return;
+  ++num_restarts_;
+  const bool intensify = sync_pending_ || size == 1 ||
+                         random_.RandDouble() < intensification_probability_ ||
+                         !Extract(assignment);
+  sync_pending_ = false;
+  int chosen = 0;
+  if (!intensify) {
+    // The farthest solution, the best one on ties since they are sorted.
+    int max_distance = -1;
+    for (int i = 0; i < size; ++i) {
+      const SharedSolutionPool::Solution& solution = *snapshot->solutions[i];
+      const int distance = SharedSolutionPool::Distance(
+          mins_, maxs_, solution.mins, solution.maxs);
+      if (distance > max_distance) {
+        chosen = i;
+        max_distance = distance;
+      }
+    }
+  }
+  CopyTo(*snapshot->solutions[chosen], assignment);
+}
+
+inline bool SharedSolutionPoolClient::SyncNeeded(
+    Assignment* const local_assignment) {
+  const int64 generation = shared_->generation();
+  if (generation == last_generation_) return false;
+  last_generation_ = generation;
+  if (Extract(local_assignment) &&
+      !shared_->Better(shared_->best_objective(), objective_)) {
+    return false;
+  }
+  ++num_syncs_;
+  sync_pending_ = true;
+  return true;
+}
+
+inline SolutionPool* MakeSharedSolutionPool(Solver* const solver,
+                                            SharedSolutionPool* const shared,
+                                            IntVar* const objective,
+                                            double intensification_probability,
+                                            int32 seed) {
+  return solver->RevAlloc(new SharedSolutionPoolClient(
+      shared, objective, intensification_probability, seed));
+}
+
+inline SolutionPool* MakeSharedSolutionPool(Solver* const solver,
+                                            SharedSolutionPool* const shared,
+                                            int32 seed) {
+  return MakeSharedSolutionPool(solver, shared, nullptr, 0.5, seed);
+}
+
+}  // namespace operations_research
+
+#endif  // OR_TOOLS_CONSTRAINT_SOLVER_SHARED_SOLUTION_POOL_H_
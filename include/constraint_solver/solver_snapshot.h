@@ -0,0 +1,356 @@
+// Copyright 2010-2014 Google
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+// Snapshots of the state of a solver at a search node, to restart from this
+// node or to continue the search from it on another solver.
+//
+// Going back to a search node usually means replaying the decisions that led
+// to it from the root. A SolverSnapshot instead stores the domains of the
+// decision variables of the model at the node, in a flat buffer. Restoring
+// it reduces the domains of the variables to the stored ones, and the
+// propagation of the constraints rebuilds their internal state: the solver
+// reaches the same node, or a node with tighter domains if the propagation
+// is stronger when the reductions are applied all at once.
+//
+// The variables are registered with a SolverSnapshotter, in the same order on
+// all the solvers that exchange snapshots. Since a snapshot only contains
+// values, it can be copied to another thread and restored on a replica of the
+// model there, which forks the search at the node:
+//   // On the source solver, in the search, e.g. in a decision builder:
+//   SolverSnapshot snapshot;
+//   snapshotter->TakeSnapshot(&snapshot);
+//   ... send the snapshot to the other thread ...
+//   // On the target solver, built by the same code, with its snapshotter:
+//   target->Solve(target->Compose(
+//       target_snapshotter->MakeRestoreSnapshot(&snapshot), db), monitors);
+// The same pattern gives fast restarts for large neighborhood search: take a
+// snapshot once, and start each neighborhood with MakeRestoreSnapshot().
+//
+// Only the domains of the registered integer and interval variables are
+// captured. Variables that are not registered get their domains from the
+// propagation, so registering the decision variables is enough.
+
+#ifndef OR_TOOLS_CONSTRAINT_SOLVER_SOLVER_SNAPSHOT_H_
+#define OR_TOOLS_CONSTRAINT_SOLVER_SOLVER_SNAPSHOT_H_
+
+#include <string.h>
+#include <memory>
+#include <string>
+#include <vector>
+
+#include "base/integral_types.h"
+#include "base/logging.h"
+#include "base/macros.h"
+#include "base/stringprintf.h"
+#include "constraint_solver/constraint_solver.h"
+
+namespace operations_research {
+
+// The domains of the registered variables of a solver at a search node. It is
+// a plain value, that can be copied between threads.
+class SolverSnapshot {
+ public:
+  SolverSnapshot() : num_int_vars_(0), num_interval_vars_(0) {}
+
+  bool empty() const { return buffer_.empty(); }
+  int num_int_vars() const { return num_int_vars_; }
+  int num_interval_vars() const { return num_interval_vars_; }
+  void Clear();
+
+  // Flat binary form, in the byte order of the machine.
+  std::string SerializeAsString() const;
+  // Returns false if the data is not a valid snapshot.
+  bool ParseFromString(const std::string& data);
+
+  int64 MemoryUsage() const { return buffer_.capacity() * sizeof(int64); }
+  std::string DebugString() const;
+
+ private:
+  friend class SolverSnapshotter;
+  static const int64 kMagic = 0x534E41505348544FLL;
+  // Performed status of an interval in the buffer.
+  enum { UNPERFORMED = 0, PERFORMED = 1, UNDECIDED = 2 };
+
+  // Checks that the buffer has the layout below.
+  bool IsValid() const;
+
+  // For each integer variable: the number n of intervals of its domain, then
+  // n (min, max) pairs in increasing order. Then for each interval variable:
+  // start min and max, duration min and max, end min and max, and performed
+  // status.
+  std::vector<int64> buffer_;
+  int num_int_vars_;
+  int num_interval_vars_;
+};
+
+// Takes and restores the snapshots of a given set of variables of a solver.
+class SolverSnapshotter {
+ public:
+  explicit SolverSnapshotter(Solver* const solver) : solver_(solver) {}
+
+  // Registers variables. All the solvers that exchange snapshots must
+  // register the same variables in the same order.
+  void Add(IntVar* const var) { int_vars_.push_back(var); }
+  void Add(const std::vector<IntVar*>& vars);
+  void Add(IntervalVar* const var) { interval_vars_.push_back(var); }
+  void Add(const std::vector<IntervalVar*>& vars);
+
+  // Stores the current domains of the registered variables.
+  void TakeSnapshot(SolverSnapshot* const snapshot) const;
+
+  // Reduces the domains of the registered variables to the ones of the
+  // snapshot. Fails if they are not compatible with the current domains. The
+  // changes are reversible when this is called during the search, e.g. from
+  // MakeRestoreSnapshot(), and definitive before the search.
+  void RestoreSnapshot(const SolverSnapshot& snapshot) const;
+
+  // Decision builders, owned by the solver, that take or restore the given
+  // snapshot when the search reaches them and then return nullptr. The
+  // snapshot must outlive the search.
+  DecisionBuilder* MakeTakeSnapshot(SolverSnapshot* const snapshot) const;
+  DecisionBuilder* MakeRestoreSnapshot(
+      const SolverSnapshot* const snapshot) const;
+
+  Solver* solver() const { return solver_; }
+
+ private:
+  Solver* const solver_;
+  std::vector<IntVar*> int_vars_;
+  std::vector<IntervalVar*> interval_vars_;
+
+  DISALLOW_COPY_AND_ASSIGN(SolverSnapshotter);
+};
+
+// ============================================================================
+// Implementation.
+// ============================================================================
+
+inline void SolverSnapshot::Clear() {
+  buffer_.clear();
+  num_int_vars_ = 0;
+  num_interval_vars_ = 0;
+}
+
+inline std::string SolverSnapshot::SerializeAsString() const {
+  const int64 header[4] = {kMagic, num_int_vars_, num_interval_vars_,
+                           static_cast<int64>(buffer_.size())};
+  std::string data(sizeof(header) + buffer_.size() * sizeof(int64), '\0');
+  memcpy(&data[0], header, sizeof(header));
+  if (!buffer_.empty()) {
+    memcpy(&data[sizeof(header)], buffer_.data(),
+           buffer_.size() * sizeof(int64));
+  }
+  return data;
+}
+
+inline bool SolverSnapshot::ParseFromString(const std::string& data) {
+  int64 header[4];
+  if (data.size() < sizeof(header)) return false;
+  memcpy(header, data.data(), sizeof(header));
+  // The counts are bounded before use: the numbers of variables must fit in
+  // an int, and the buffer size in the data, so that the product below can't
+  // overflow.
+  const int64 max_buffer_size = (data.size() - sizeof(header)) / sizeof(int64);
+  if (header[0] != kMagic || header[1] < 0 || header[1] > kint32max ||
+      header[2] < 0 || header[2] > kint32max || header[3] < 0 ||
+      header[3] > max_buffer_size ||
+      data.size() != sizeof(header) + header[3] * sizeof(int64)) {
+    return false;
+  }
+  num_int_vars_ = header[1];
+  num_interval_vars_ = header[2];
+  buffer_.resize(header[3]);
+  if (!buffer_.empty()) {
+    memcpy(buffer_.data(), data.data() + sizeof(header),
+           buffer_.size() * sizeof(int64));
+  }
+  if (!IsValid()) {
+    Clear();
+    return false;
+  }
+  return true;
+}
+
+inline bool SolverSnapshot::IsValid() const {
+  const int64 size = buffer_.size();
+  int64 position = 0;
+  for (int i = 0; i < num_int_vars_; ++i) {
+    if (position >= size) return false;
+    const int64 num_intervals = buffer_[position++];
+    if (num_intervals < 1 || num_intervals > (size - position) / 2) {
+      return false;
+    }
+    for (int j = 0; j < 2 * num_intervals; ++j) {
+      // The bounds must be increasing, with a hole between the intervals.
+      const int64 gap = j % 2 == 0 ? 2 : 0;
+      if (j > 0 && buffer_[position + j] < buffer_[position + j - 1] + gap) {
+        return false;
+      }
+    }
+    position += 2 * num_intervals;
+  }
+  for (int i = 0; i < num_interval_vars_; ++i) {
+    if (size - position < 7) return false;
+    if (buffer_[position + 6] < UNPERFORMED ||
+        buffer_[position + 6] > UNDECIDED) {
+      return false;
+    }
+    position += 7;
+  }
+  return position == size;
+}
+
+inline std::string SolverSnapshot::DebugString() const {
+  return StringPrintf("SolverSnapshot(%d int vars, %d interval vars, %d bytes)",
+                      num_int_vars_, num_interval_vars_,
+                      static_cast<int>(buffer_.size() * sizeof(int64)));
+}
+
+inline void SolverSnapshotter::Add(const std::vector<IntVar*>& vars) {
+  int_vars_.insert(int_vars_.end(), vars.begin(), vars.end());
+}
+
+inline void SolverSnapshotter::Add(const std::vector<IntervalVar*>& vars) {
+  interval_vars_.insert(interval_vars_.end(), vars.begin(), vars.end());
+}
+
+inline void SolverSnapshotter::TakeSnapshot(
+    SolverSnapshot* const snapshot) const {
+  snapshot->Clear();
+  std::vector<int64>* const buffer = &snapshot->buffer_;
+  buffer->reserve(3 * int_vars_.size() + 7 * interval_vars_.size());
+  for (IntVar* const var : int_vars_) {
+    const int64 min = var->Min();
+    const int64 max = var->Max();
+    if (var->Size() == static_cast<uint64>(max - min) + 1) {
+      buffer->push_back(1);
+      buffer->push_back(min);
+      buffer->push_back(max);
+      continue;
+    }
+    // The domain has holes: it is stored as a list of intervals.
+    const int count_position = buffer->size();
+    buffer->push_back(0);
+    std::unique_ptr<IntVarIterator> it(var->MakeDomainIterator(false));
+    for (const int64 value : InitAndGetValues(it.get())) {
+      if ((*buffer)[count_position] > 0 && value == buffer->back() + 1) {
+        buffer->back() = value;
+      } else {
+        ++(*buffer)[count_position];
+        buffer->push_back(value);
+        buffer->push_back(value);
+      }
+    }
+  }
+  for (IntervalVar* const var : interval_vars_) {
+    if (!var->MayBePerformed()) {
+      buffer->insert(buffer->end(), 6, 0);
+      buffer->push_back(SolverSnapshot::UNPERFORMED);
+      continue;
+    }
+    buffer->push_back(var->StartMin());
+    buffer->push_back(var->StartMax());
+    buffer->push_back(var->DurationMin());
+    buffer->push_back(var->DurationMax());
+    buffer->push_back(var->EndMin());
+    buffer->push_back(var->EndMax());
+    buffer->push_back(var->MustBePerformed() ? SolverSnapshot::PERFORMED
+                                             : SolverSnapshot::UNDECIDED);
+  }
+  snapshot->num_int_vars_ = int_vars_.size();
+  snapshot->num_interval_vars_ = interval_vars_.size();
+}
+
+inline void SolverSnapshotter::RestoreSnapshot(
+    const SolverSnapshot& snapshot) const {
+  CHECK_EQ(snapshot.num_int_vars(), static_cast<int>(int_vars_.size()))
+      << "The snapshot was taken with other variables.";
+  CHECK_EQ(snapshot.num_interval_vars(),
+           static_cast<int>(interval_vars_.size()))
+      << "The snapshot was taken with other variables.";
+  const int64* data = snapshot.buffer_.data();
+  for (IntVar* const var : int_vars_) {
+    const int num_intervals = *data++;
+    DCHECK_GE(num_intervals, 1);
+    var->SetRange(data[0], data[2 * num_intervals - 1]);
+    for (int i = 1; i < num_intervals; ++i) {
+      var->RemoveInterval(data[2 * i - 1] + 1, data[2 * i] - 1);
+    }
+    data += 2 * num_intervals;
+  }
+  for (IntervalVar* const var : interval_vars_) {
+    if (data[6] == SolverSnapshot::UNPERFORMED) {
+      var->SetPerformed(false);
+    } else {
+      if (data[6] == SolverSnapshot::PERFORMED) var->SetPerformed(true);
+      var->SetStartRange(data[0], data[1]);
+      var->SetDurationRange(data[2], data[3]);
+      var->SetEndRange(data[4], data[5]);
+    }
+    data += 7;
+  }
+  DCHECK_EQ(data, snapshot.buffer_.data() + snapshot.buffer_.size());
+}
+
+// The decision builders of SolverSnapshotter.
+class TakeSnapshotBuilder : public DecisionBuilder {
+ public:
+  TakeSnapshotBuilder(const SolverSnapshotter* const snapshotter,
+                      SolverSnapshot* const snapshot)
+      : snapshotter_(snapshotter), snapshot_(snapshot) {}
+  ~TakeSnapshotBuilder() override {}
+
+  Decision* Next(Solver* const s) override {
+    snapshotter_->TakeSnapshot(snapshot_);
+    return nullptr;
+  }
+
+  std::string DebugString() const override { return "TakeSnapshot"; }
+
+ private:
+  const SolverSnapshotter* const snapshotter_;
+  SolverSnapshot* const snapshot_;
+};
+
+class RestoreSnapshotBuilder : public DecisionBuilder {
+ public:
+  RestoreSnapshotBuilder(const SolverSnapshotter* const snapshotter,
+                         const SolverSnapshot* const snapshot)
+      : snapshotter_(snapshotter), snapshot_(snapshot) {}
+  ~RestoreSnapshotBuilder() override {}
+
+  Decision* Next(Solver* const s) override {
+    snapshotter_->RestoreSnapshot(*snapshot_);
+    return nullptr;
+  }
+
+  std::string DebugString() const override { return "RestoreSnapshot"; }
+
+ private:
+  const SolverSnapshotter* const snapshotter_;
+  const SolverSnapshot* const snapshot_;
+};
+
+inline DecisionBuilder* SolverSnapshotter::MakeTakeSnapshot(
+    SolverSnapshot* const snapshot) const {
+  return solver_->RevAlloc(new TakeSnapshotBuilder(this, snapshot));
+}
+
+inline DecisionBuilder* SolverSnapshotter::MakeRestoreSnapshot(
+    const SolverSnapshot* const snapshot) const {
+  return solver_->RevAlloc(new RestoreSnapshotBuilder(this, snapshot));
+}
+
+}  // namespace operations_research
+
+#endif  // OR_TOOLS_CONSTRAINT_SOLVER_SOLVER_SNAPSHOT_H_
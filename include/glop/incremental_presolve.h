@@ -0,0 +1,901 @@
+// Copyright 2010-2014 Google
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+// Presolve for linear programs that are solved many times with the same
+// constraint matrix and different bounds or objective.
+//
+// The MainLpPreprocessor (see preprocessor.h) redoes all its work on each
+// LPSolver::Solve(). Here the reductions are split in two parts:
+// - The structural analysis only depends on the constraint matrix. It finds
+//   the empty and singleton rows, the proportional rows, and then on the
+//   remaining rows the empty and proportional columns. It is computed in
+//   parallel and cached: as long as the matrix doesn't change (this is checked
+//   with a fingerprint), it is reused as is.
+// - The value-dependent passes use the bounds and the objective: the
+//   singleton rows become variable bounds, the bounds of the proportional
+//   rows are merged, the empty columns are fixed and the proportional columns
+//   with proportional costs are merged. They are linear in the size of the
+//   problem and are run on each call.
+//
+// When the reductions give the same reduced matrix as in the previous call,
+// the previous reduced problem is only updated with the new bounds and
+// objective, which also lets the LPSolver warm-start from its last solution.
+
+#ifndef OR_TOOLS_GLOP_INCREMENTAL_PRESOLVE_H_
+#define OR_TOOLS_GLOP_INCREMENTAL_PRESOLVE_H_
+
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+#include <utility>
+#include <vector>
+
+#include "base/callback.h"
+#include "base/hash.h"
+#include "base/integral_types.h"
+#include "base/logging.h"
+#include "base/macros.h"
+#include "base/port.h"
+#include "base/threadpool.h"
+#include "glop/lp_solver.h"
+#include "glop/parameters.pb.h"
+#include "lp_data/lp_data.h"
+#include "lp_data/lp_types.h"
+
+namespace operations_research {
+namespace glop {
+
+// Usage:
+//   IncrementalLpPresolver presolver;
+//   LinearProgram reduced;
+//   for (...) {
+//     ... change the bounds and objective of lp ...
+//     if (presolver.Run(lp, &reduced) != ProblemStatus::INIT) {
+//       // The problem was found infeasible or unbounded.
+//     }
+//     ... solve reduced ...
+//     presolver.RecoverSolution(primal, dual, &lp_primal, &lp_dual);
+//   }
+class IncrementalLpPresolver {
+ public:
+  IncrementalLpPresolver();
+
+  // Number of threads used by the structural analysis.
+  void set_num_threads(int num_threads) { num_threads_ = num_threads; }
+
+  // Presolves the given problem into reduced. Returns ProblemStatus::INIT if
+  // reduced must be solved, or PRIMAL_INFEASIBLE/INFEASIBLE_OR_UNBOUNDED if
+  // the presolve proved it. If reduced is the problem built by the previous
+  // call and wasn't modified, it may only be updated.
+  ProblemStatus Run(const LinearProgram& linear_program,
+                    LinearProgram* reduced) MUST_USE_RESULT;
+
+  // Computes the primal and dual values of the problem given to Run() from
+  // an optimal solution of the reduced problem.
+  void RecoverSolution(const DenseRow& reduced_primal_values,
+                       const DenseColumn& reduced_dual_values,
+                       DenseRow* primal_values,
+                       DenseColumn* dual_values) const;
+
+  // Forgets the cached structure, for instance to free its memory.
+  void ClearCache();
+
+  // Whether the last Run() reused the cached structure, and whether it only
+  // updated the bounds and objective of the reduced problem.
+  bool structure_was_reused() const { return structure_was_reused_; }
+  bool reduced_problem_was_updated() const {
+    return reduced_problem_was_updated_;
+  }
+
+  int64 num_structure_analyses() const { return num_structure_analyses_; }
+  int64 num_structure_reuses() const { return num_structure_reuses_; }
+
+ private:
+  // The chunk methods work on [begin, end) and write their result in the
+  // given slot of the per-chunk outputs.
+  typedef void (IncrementalLpPresolver::*ChunkMethod)(int chunk, int begin,
+                                                      int end);
+  void RunInChunks(int size, ChunkMethod method);
+
+  // Structural analysis.
+  uint64 ComputeFingerprint();
+  void FingerprintChunk(int chunk, int begin, int end);
+  void CopyMatrixChunk(int chunk, int begin, int end);
+  void AnalyzeRowsChunk(int chunk, int begin, int end);
+  void AnalyzeColumnsChunk(int chunk, int begin, int end);
+  void AnalyzeStructure();
+
+  // Groups the proportional vectors with the same hash. The vector i is
+  // given by indices[starts[i], starts[i + 1]) and values, restricted to the
+  // positions where keep() holds. Fills representative and factor so that
+  // vector i = factor[i] * vector representative[i].
+  template <typename KeepFunction>
+  void GroupProportionalVectors(const std::vector<uint64>& hashes,
+                                const std::vector<bool>& candidates,
+                                const std::vector<int64>& starts,
+                                const std::vector<int>& indices,
+                                const std::vector<double>& values,
+                                KeepFunction keep,
+                                std::vector<int>* representative,
+                                std::vector<double>* factor) const;
+
+  // Value-dependent passes.
+  ProblemStatus ComputeReductions(const LinearProgram& linear_program);
+  void BuildReducedProblem(const LinearProgram& linear_program,
+                           LinearProgram* reduced);
+  void UpdateReducedProblem(const LinearProgram& linear_program,
+                            LinearProgram* reduced) const;
+  void MergedColumnBounds(int group, double* lower_bound,
+                          double* upper_bound) const;
+  void DistributeMergedValue(int group, double value,
+                             DenseRow* primal_values) const;
+
+  int num_threads_;
+  const LinearProgram* linear_program_;
+
+  // The cached structure.
+  bool has_structure_;
+  uint64 fingerprint_;
+  int num_rows_;
+  int num_cols_;
+  std::vector<uint64> chunk_hashes_;
+
+  // The matrix in column and row major order.
+  std::vector<int64> col_starts_;
+  std::vector<int> col_rows_;
+  std::vector<double> col_coefficients_;
+  std::vector<int64> row_starts_;
+  std::vector<int> row_cols_;
+  std::vector<double> row_coefficients_;
+
+  // Row kinds. A kept row is its own representative, a row proportional to
+  // a kept row has it as representative with row = factor * representative,
+  // and the empty and singleton rows have no representative (-1).
+  std::vector<int> row_size_;
+  std::vector<uint64> row_hashes_;
+  std::vector<int> row_representative_;
+  std::vector<double> row_factor_;
+  std::vector<int> singleton_rows_;
+  std::vector<int> empty_rows_;
+
+  // Same for the columns, restricted to the kept rows. The proportional
+  // column groups of size at least 2 are stored in
+  // group_cols_[group_starts_[g], group_starts_[g + 1]) with the
+  // representative first.
+  std::vector<int> col_size_;
+  std::vector<uint64> col_hashes_;
+  std::vector<int> col_representative_;
+  std::vector<double> col_factor_;
+  std::vector<int> col_group_;
+  std::vector<int> group_starts_;
+  std::vector<int> group_cols_;
+
+  // The values of the last Run(). The column bounds include the singleton
+  // rows, and *_source_ gives the singleton row of each tightened bound. The
+  // row bounds of a representative are merged over its proportional rows.
+  std::vector<double> col_lb_;
+  std::vector<double> col_ub_;
+  std::vector<int> col_lb_source_;
+  std::vector<int> col_ub_source_;
+  std::vector<double> row_lb_;
+  std::vector<double> row_ub_;
+  std::vector<int> row_lb_source_;
+  std::vector<int> row_ub_source_;
+  std::vector<double> empty_col_values_;
+  std::vector<bool> group_is_merged_;
+  double objective_offset_;
+
+  // The reduced problem of the last Run().
+  const LinearProgram* last_reduced_;
+  std::vector<bool> last_group_is_merged_;
+  std::vector<int> reduced_to_original_col_;
+  std::vector<int> reduced_to_original_row_;
+  std::vector<double> objective_;
+
+  bool structure_was_reused_;
+  bool reduced_problem_was_updated_;
+  int64 num_structure_analyses_;
+  int64 num_structure_reuses_;
+
+  DISALLOW_COPY_AND_ASSIGN(IncrementalLpPresolver);
+};
+
+// An LPSolver preceded by an IncrementalLpPresolver. Note that the LPSolver
+// still runs its own presolve if the parameters ask for it; since that one is
+// rebuilt on each solve, use_preprocessing = false gives the fastest
+// re-solves when the problem changes little.
+class IncrementalLpSolver {
+ public:
+  IncrementalLpSolver() : objective_value_(0.0) {}
+
+  void SetParameters(const GlopParameters& parameters) {
+    solver_.SetParameters(parameters);
+  }
+  void set_num_threads(int num_threads) {
+    presolver_.set_num_threads(num_threads);
+  }
+
+  // Same as LPSolver::Solve(). The values are the ones of the given problem.
+  ProblemStatus Solve(const LinearProgram& linear_program) MUST_USE_RESULT;
+  Fractional GetObjectiveValue() const { return objective_value_; }
+  const DenseRow& variable_values() const { return primal_values_; }
+  const DenseColumn& dual_values() const { return dual_values_; }
+
+  const IncrementalLpPresolver& presolver() const { return presolver_; }
+
+ private:
+  IncrementalLpPresolver presolver_;
+  LinearProgram reduced_;
+  LPSolver solver_;
+  DenseRow primal_values_;
+  DenseColumn dual_values_;
+  Fractional objective_value_;
+
+  DISALLOW_COPY_AND_ASSIGN(IncrementalLpSolver);
+};
+
+// ============================================================================
+// Implementation.
+// ============================================================================
+
+namespace internal {
+
+// Relative tolerance used to compare the proportional coefficients and the
+// bounds.
+static const double kIncrementalPresolveTolerance = 1e-9;
+
+inline bool IsNearlyEqual(double a, double b) {
+  return std::abs(a - b) <=
+         kIncrementalPresolveTolerance *
+             std::max(1.0, std::max(std::abs(a), std::abs(b)));
+}
+
+// Hashes a double with about 30 bits of precision, so that the proportional
+// vectors have the same hash despite the rounding errors (in most cases).
+inline uint64 HashRoundedDouble(double value, uint64 seed) {
+  int exponent = 0;
+  const double mantissa = std::frexp(value, &exponent);
+  const int64 rounded = static_cast<int64>(std::round(mantissa * (1 << 30)));
+  return Hash64NumWithSeed(static_cast<uint64>(rounded),
+                           Hash64NumWithSeed(exponent, seed));
+}
+
+}  // namespace internal
+
+inline IncrementalLpPresolver::IncrementalLpPresolver()
+    : num_threads_(1),
+      linear_program_(nullptr),
+      has_structure_(false),
+      fingerprint_(0),
+      num_rows_(0),
+      num_cols_(0),
+      objective_offset_(0.0),
+      last_reduced_(nullptr),
+      structure_was_reused_(false),
+      reduced_problem_was_updated_(false),
+      num_structure_analyses_(0),
+      num_structure_reuses_(0) {}
+
+inline void IncrementalLpPresolver::ClearCache() {
+  has_structure_ = false;
+  last_reduced_ = nullptr;
+  std::vector<int64>().swap(col_starts_);
+  std::vector<int>().swap(col_rows_);
+  std::vector<double>().swap(col_coefficients_);
+  std::vector<int64>().swap(row_starts_);
+  std::vector<int>().swap(row_cols_);
+  std::vector<double>().swap(row_coefficients_);
+}
+
+inline void IncrementalLpPresolver::RunInChunks(int size, ChunkMethod method) {
+  const int kMinChunkSize = 4096;
+  const int num_chunks =
+      std::max(1, std::min(num_threads_, size / kMinChunkSize));
+  chunk_hashes_.assign(num_chunks, 0);
+  if (num_chunks == 1) {
+    (this->*method)(0, 0, size);
+    return;
+  }
+  ThreadPool pool("IncrementalLpPresolver", num_chunks);
+  pool.StartWorkers();
+  for (int chunk = 0; chunk < num_chunks; ++chunk) {
+    const int begin = static_cast<int64>(size) * chunk / num_chunks;
+    const int end = static_cast<int64>(size) * (chunk + 1) / num_chunks;
+    pool.Add(NewCallback(this, method, chunk, begin, end));
+  }
+}
+
+inline void IncrementalLpPresolver::FingerprintChunk(int chunk, int begin,
+                                                     int end) {
+  // The column hashes are summed so that the result doesn't depend on the
+  // chunks.
+  uint64 sum = 0;
+  for (int col = begin; col < end; ++col) {
+    uint64 hash = col;
+    for (const SparseColumn::Entry e :
+         linear_program_->GetSparseColumn(ColIndex(col))) {
+      uint64 bits;
+      const double coefficient = e.coefficient();
+      memcpy(&bits, &coefficient, sizeof(bits));
+      hash = Hash64NumWithSeed(bits, Hash64NumWithSeed(e.row().value(), hash));
+    }
+    sum += Hash64NumWithSeed(col, hash);
+  }
+  chunk_hashes_[chunk] = sum;
+}
+
+inline uint64 IncrementalLpPresolver::ComputeFingerprint() {
+  const int num_cols = linear_program_->num_variables().value();
+  const int num_rows = linear_program_->num_constraints().value();
+  RunInChunks(num_cols, &IncrementalLpPresolver::FingerprintChunk);
+  uint64 sum = 0;
+  for (const uint64 hash : chunk_hashes_) sum += hash;
+  return Hash64NumWithSeed(sum, Hash64NumWithSeed(num_rows, num_cols));
+}
+
+inline void IncrementalLpPresolver::CopyMatrixChunk(int chunk, int begin,
+                                                    int end) {
+  for (int col = begin; col < end; ++col) {
+    int64 pos = col_starts_[col];
+    for (const SparseColumn::Entry e :
+         linear_program_->GetSparseColumn(ColIndex(col))) {
+      col_rows_[pos] = e.row().value();
+      col_coefficients_[pos] = e.coefficient();
+      ++pos;
+    }
+  }
+}
+
+inline void IncrementalLpPresolver::AnalyzeRowsChunk(int chunk, int begin,
+                                                     int end) {
+  for (int row = begin; row < end; ++row) {
+    const int64 start = row_starts_[row];
+    const int size = row_starts_[row + 1] - start;
+    row_size_[row] = size;
+    if (size < 2) continue;
+
+    // The hash of the row divided by its first coefficient.
+    const double first = row_coefficients_[start];
+    uint64 hash = size;
+    for (int64 i = start; i < start + size; ++i) {
+      hash = internal::HashRoundedDouble(
+          row_coefficients_[i] / first, Hash64NumWithSeed(row_cols_[i], hash));
+    }
+    row_hashes_[row] = hash;
+  }
+}
+
+inline void IncrementalLpPresolver::AnalyzeColumnsChunk(int chunk, int begin,
+                                                        int end) {
+  for (int col = begin; col < end; ++col) {
+    // Same as for the rows, on the entries of the kept rows only.
+    int size = 0;
+    double first = 0.0;
+    uint64 hash = 0;
+    for (int64 i = col_starts_[col]; i < col_starts_[col + 1]; ++i) {
+      const int row = col_rows_[i];
+      if (row_representative_[row] != row) continue;
+      if (size == 0) first = col_coefficients_[i];
+      ++size;
+      hash = internal::HashRoundedDouble(col_coefficients_[i] / first,
+                                         Hash64NumWithSeed(row, hash));
+    }
+    col_size_[col] = size;
+    col_hashes_[col] = Hash64NumWithSeed(size, hash);
+  }
+}
+
+template <typename KeepFunction>
+void IncrementalLpPresolver::GroupProportionalVectors(
+    const std::vector<uint64>& hashes, const std::vector<bool>& candidates,
+    const std::vector<int64>& starts, const std::vector<int>& indices,
+    const std::vector<double>& values, KeepFunction keep,
+    std::vector<int>* representative, std::vector<double>* factor) const {
+  const int size = hashes.size();
+  std::vector<std::pair<uint64, int>> sorted;
+  for (int i = 0; i < size; ++i) {
+    if (candidates[i]) sorted.push_back(std::make_pair(hashes[i], i));
+  }
+  std::sort(sorted.begin(), sorted.end());
+
+  // The kept entries of a vector, as (index, value) in the index order.
+  std::vector<std::pair<int, double>> rep_entries;
+  std::vector<std::pair<int, double>> entries;
+  const auto kept_entries = [&](int i,
+                                std::vector<std::pair<int, double>>* out) {
+    out->clear();
+    for (int64 k = starts[i]; k < starts[i + 1]; ++k) {
+      if (keep(indices[k])) {
+        out->push_back(std::make_pair(indices[k], values[k]));
+      }
+    }
+  };
+  const int num_sorted = sorted.size();
+  for (int begin = 0; begin < num_sorted;) {
+    int end = begin + 1;
+    while (end < num_sorted && sorted[end].first == sorted[begin].first) ++end;
+
+    // Greedy grouping inside a run with the same hash. The runs are almost
+    // always made of proportional vectors, so this is linear in practice.
+    for (int a = begin; a < end; ++a) {
+      const int rep = sorted[a].second;
+      if ((*representative)[rep] != rep) continue;
+      kept_entries(rep, &rep_entries);
+      for (int b = a + 1; b < end; ++b) {
+        const int other = sorted[b].second;
+        if ((*representative)[other] != other) continue;
+        kept_entries(other, &entries);
+        if (entries.size() != rep_entries.size()) continue;
+        const double ratio = entries[0].second / rep_entries[0].second;
+        bool proportional = true;
+        const int num_entries = entries.size();
+        for (int k = 0; k < num_entries; ++k) {
+          if (entries[k].first != rep_entries[k].first ||
+              !internal::IsNearlyEqual(entries[k].second,
+                                       ratio * rep_entries[k].second)) {
+            proportional = false;
+            break;
+          }
+        }
+        if (!proportional) continue;
+        (*representative)[other] = rep;
+        (*factor)[other] = ratio;
+      }
+    }
+    begin = end;
+  }
+}
+
+inline void IncrementalLpPresolver::AnalyzeStructure() {
+  num_rows_ = linear_program_->num_constraints().value();
+  num_cols_ = linear_program_->num_variables().value();
+
+  // Copy of the matrix in column major order, then transposition.
+  col_starts_.assign(num_cols_ + 1, 0);
+  for (int col = 0; col < num_cols_; ++col) {
+    col_starts_[col + 1] =
+        col_starts_[col] +
+        linear_program_->GetSparseColumn(ColIndex(col)).num_entries().value();
+  }
+  col_rows_.resize(col_starts_[num_cols_]);
+  col_coefficients_.resize(col_starts_[num_cols_]);
+  RunInChunks(num_cols_, &IncrementalLpPresolver::CopyMatrixChunk);
+  row_starts_.assign(num_rows_ + 1, 0);
+  for (const int row : col_rows_) ++row_starts_[row + 1];
+  for (int row = 0; row < num_rows_; ++row) {
+    row_starts_[row + 1] += row_starts_[row];
+  }
+  row_cols_.resize(col_rows_.size());
+  row_coefficients_.resize(col_rows_.size());
+  {
+    std::vector<int64> positions(row_starts_.begin(), row_starts_.end() - 1);
+    for (int col = 0; col < num_cols_; ++col) {
+      for (int64 i = col_starts_[col]; i < col_starts_[col + 1]; ++i) {
+        const int64 pos = positions[col_rows_[i]]++;
+        row_cols_[pos] = col;
+        row_coefficients_[pos] = col_coefficients_[i];
+      }
+    }
+  }
+
+  // Rows.
+  row_size_.assign(num_rows_, 0);
+  row_hashes_.assign(num_rows_, 0);
+  RunInChunks(num_rows_, &IncrementalLpPresolver::AnalyzeRowsChunk);
+  row_representative_.resize(num_rows_);
+  row_factor_.assign(num_rows_, 1.0);
+  std::vector<bool> candidates(num_rows_, false);
+  singleton_rows_.clear();
+  empty_rows_.clear();
+  for (int row = 0; row < num_rows_; ++row) {
+    row_representative_[row] = row;
+    if (row_size_[row] == 0) {
+      empty_rows_.push_back(row);
+      row_representative_[row] = -1;
+    } else if (row_size_[row] == 1) {
+      singleton_rows_.push_back(row);
+      row_representative_[row] = -1;
+    } else {
+      candidates[row] = true;
+    }
+  }
+  GroupProportionalVectors(row_hashes_, candidates, row_starts_, row_cols_,
+                           row_coefficients_, [](int col) { return true; },
+                           &row_representative_, &row_factor_);
+
+  // Columns, on the kept rows.
+  col_size_.assign(num_cols_, 0);
+  col_hashes_.assign(num_cols_, 0);
+  RunInChunks(num_cols_, &IncrementalLpPresolver::AnalyzeColumnsChunk);
+  col_representative_.resize(num_cols_);
+  col_factor_.assign(num_cols_, 1.0);
+  candidates.assign(num_cols_, false);
+  for (int col = 0; col < num_cols_; ++col) {
+    col_representative_[col] = col_size_[col] == 0 ? -1 : col;
+    candidates[col] = col_size_[col] > 0;
+  }
+  GroupProportionalVectors(
+      col_hashes_, candidates, col_starts_, col_rows_, col_coefficients_,
+      [this](int row) { return row_representative_[row] == row; },
+      &col_representative_, &col_factor_);
+
+  // The groups of proportional columns, with their representative first.
+  std::vector<int> group_size(num_cols_, 0);
+  for (int col = 0; col < num_cols_; ++col) {
+    if (col_representative_[col] >= 0) ++group_size[col_representative_[col]];
+  }
+  col_group_.assign(num_cols_, -1);
+  group_starts_.assign(1, 0);
+  for (int col = 0; col < num_cols_; ++col) {
+    if (col_representative_[col] != col || group_size[col] < 2) continue;
+    col_group_[col] = group_starts_.size() - 1;
+    group_starts_.push_back(group_starts_.back() + group_size[col]);
+  }
+  group_cols_.resize(group_starts_.back());
+  std::vector<int> positions(group_starts_.begin(), group_starts_.end() - 1);
+  for (int col = 0; col < num_cols_; ++col) {
+    const int rep = col_representative_[col];
+    if (rep < 0 || col_group_[rep] < 0) continue;
+    col_group_[col] = col_group_[rep];
+    group_cols_[positions[col_group_[col]]++] = col;
+  }
+  has_structure_ = true;
+  last_reduced_ = nullptr;
+  VLOG(1) << "Incremental presolve structure: " << empty_rows_.size()
+          << " empty rows, " << singleton_rows_.size() << " singleton rows, "
+          << group_starts_.size() - 1 << " groups of proportional columns.";
+}
+
+inline void IncrementalLpPresolver::MergedColumnBounds(
+    int group, double* lower_bound, double* upper_bound) const {
+  *lower_bound = 0.0;
+  *upper_bound = 0.0;
+  for (int i = group_starts_[group]; i < group_starts_[group + 1]; ++i) {
+    const int col = group_cols_[i];
+    const double f = col_factor_[col];
+    *lower_bound += f > 0.0 ? f * col_lb_[col] : f * col_ub_[col];
+    *upper_bound += f > 0.0 ? f * col_ub_[col] : f * col_lb_[col];
+  }
+}
+
+inline ProblemStatus IncrementalLpPresolver::ComputeReductions(
+    const LinearProgram& linear_program) {
+  const bool maximize = linear_program.IsMaximizationProblem();
+  const DenseColumn& constraint_lb = linear_program.constraint_lower_bounds();
+  const DenseColumn& constraint_ub = linear_program.constraint_upper_bounds();
+  objective_.resize(num_cols_);
+  col_lb_.resize(num_cols_);
+  col_ub_.resize(num_cols_);
+  for (int col = 0; col < num_cols_; ++col) {
+    objective_[col] = linear_program.objective_coefficients()[ColIndex(col)];
+    col_lb_[col] = linear_program.variable_lower_bounds()[ColIndex(col)];
+    col_ub_[col] = linear_program.variable_upper_bounds()[ColIndex(col)];
+  }
+  col_lb_source_.assign(num_cols_, -1);
+  col_ub_source_.assign(num_cols_, -1);
+
+  for (const int row : empty_rows_) {
+    const RowIndex index(row);
+    if (constraint_lb[index] > internal::kIncrementalPresolveTolerance ||
+        constraint_ub[index] < -internal::kIncrementalPresolveTolerance) {
+      return ProblemStatus::PRIMAL_INFEASIBLE;
+    }
+  }
+
+  // The singleton rows become bounds: lb <= a * x <= ub.
+  for (const int row : singleton_rows_) {
+    const int64 pos = row_starts_[row];
+    const int col = row_cols_[pos];
+    const double a = row_coefficients_[pos];
+    const double lb = constraint_lb[RowIndex(row)];
+    const double ub = constraint_ub[RowIndex(row)];
+    const double implied_lb = a > 0.0 ? lb / a : ub / a;
+    const double implied_ub = a > 0.0 ? ub / a : lb / a;
+    if (implied_lb > col_lb_[col]) {
+      col_lb_[col] = implied_lb;
+      col_lb_source_[col] = row;
+    }
+    if (implied_ub < col_ub_[col]) {
+      col_ub_[col] = implied_ub;
+      col_ub_source_[col] = row;
+    }
+    if (col_lb_[col] > col_ub_[col]) {
+      if (!internal::IsNearlyEqual(col_lb_[col], col_ub_[col])) {
+        return ProblemStatus::PRIMAL_INFEASIBLE;
+      }
+      col_ub_[col] = col_lb_[col];
+    }
+  }
+
+  // The bounds of the proportional rows: lb <= factor * (rep.x) <= ub.
+  row_lb_.assign(num_rows_, -kInfinity);
+  row_ub_.assign(num_rows_, kInfinity);
+  row_lb_source_.assign(num_rows_, -1);
+  row_ub_source_.assign(num_rows_, -1);
+  for (int row = 0; row < num_rows_; ++row) {
+    const int rep = row_representative_[row];
+    if (rep < 0) continue;
+    const double f = row_factor_[row];
+    const double lb = constraint_lb[RowIndex(row)];
+    const double ub = constraint_ub[RowIndex(row)];
+    const double scaled_lb = f > 0.0 ? lb / f : ub / f;
+    const double scaled_ub = f > 0.0 ? ub / f : lb / f;
+    if (scaled_lb > row_lb_[rep]) {
+      row_lb_[rep] = scaled_lb;
+      row_lb_source_[rep] = row;
+    }
+    if (scaled_ub < row_ub_[rep]) {
+      row_ub_[rep] = scaled_ub;
+      row_ub_source_[rep] = row;
+    }
+    if (row_lb_[rep] > row_ub_[rep]) {
+      if (!internal::IsNearlyEqual(row_lb_[rep], row_ub_[rep])) {
+        return ProblemStatus::PRIMAL_INFEASIBLE;
+      }
+      row_ub_[rep] = row_lb_[rep];
+    }
+  }
+
+  // The empty columns are fixed to the bound given by their cost.
+  objective_offset_ = linear_program.objective_offset();
+  empty_col_values_.assign(num_cols_, 0.0);
+  for (int col = 0; col < num_cols_; ++col) {
+    if (col_representative_[col] >= 0) continue;
+    const double cost = maximize ? -objective_[col] : objective_[col];
+    double value;
+    if (cost > 0.0) {
+      value = col_lb_[col];
+    } else if (cost < 0.0) {
+      value = col_ub_[col];
+    } else {
+      value = std::max(col_lb_[col], std::min(col_ub_[col], 0.0));
+    }
+    if (std::isinf(value)) return ProblemStatus::INFEASIBLE_OR_UNBOUNDED;
+    empty_col_values_[col] = value;
+    objective_offset_ += objective_[col] * value;
+  }
+
+  // A group of proportional columns is merged if the costs are proportional
+  // with the same factors: sum_k c_k x_k = c_rep * sum_k factor_k x_k.
+  const int num_groups = group_starts_.size() - 1;
+  group_is_merged_.assign(num_groups, true);
+  for (int group = 0; group < num_groups; ++group) {
+    const int rep = group_cols_[group_starts_[group]];
+    for (int i = group_starts_[group] + 1; i < group_starts_[group + 1]; ++i) {
+      const int col = group_cols_[i];
+      if (!internal::IsNearlyEqual(objective_[col],
+                                   col_factor_[col] * objective_[rep])) {
+        group_is_merged_[group] = false;
+        break;
+      }
+    }
+  }
+  return ProblemStatus::INIT;
+}
+
+inline void IncrementalLpPresolver::BuildReducedProblem(
+    const LinearProgram& linear_program, LinearProgram* reduced) {
+  reduced->Clear();
+  reduced->SetName(linear_program.name());
+  reduced->SetMaximizationProblem(linear_program.IsMaximizationProblem());
+  reduced->SetObjectiveOffset(objective_offset_);
+  reduced_to_original_row_.clear();
+  std::vector<int> reduced_row(num_rows_, -1);
+  for (int row = 0; row < num_rows_; ++row) {
+    if (row_representative_[row] != row) continue;
+    const RowIndex index = reduced->CreateNewConstraint();
+    reduced_row[row] = index.value();
+    reduced_to_original_row_.push_back(row);
+    reduced->SetConstraintBounds(index, row_lb_[row], row_ub_[row]);
+    reduced->SetConstraintName(index,
+                               linear_program.GetConstraintName(RowIndex(row)));
+  }
+  reduced_to_original_col_.clear();
+  for (int col = 0; col < num_cols_; ++col) {
+    const int rep = col_representative_[col];
+    if (rep < 0) continue;
+    const int group = col_group_[col];
+    const bool merged = group >= 0 && group_is_merged_[group];
+    if (merged && rep != col) continue;
+    const ColIndex index = reduced->CreateNewVariable();
+    reduced_to_original_col_.push_back(col);
+    reduced->SetVariableName(index,
+                             linear_program.GetVariableName(ColIndex(col)));
+    reduced->SetObjectiveCoefficient(index, objective_[col]);
+    double lb = col_lb_[col];
+    double ub = col_ub_[col];
+    if (merged) MergedColumnBounds(group, &lb, &ub);
+    reduced->SetVariableBounds(index, lb, ub);
+    for (int64 i = col_starts_[col]; i < col_starts_[col + 1]; ++i) {
+      const int row = col_rows_[i];
+      if (reduced_row[row] < 0) continue;
+      reduced->SetCoefficient(RowIndex(reduced_row[row]), index,
+                              col_coefficients_[i]);
+    }
+  }
+  reduced->CleanUp();
+}
+
+inline void IncrementalLpPresolver::UpdateReducedProblem(
+    const LinearProgram& linear_program, LinearProgram* reduced) const {
+  reduced->SetMaximizationProblem(linear_program.IsMaximizationProblem());
+  reduced->SetObjectiveOffset(objective_offset_);
+  const int num_reduced_rows = reduced_to_original_row_.size();
+  for (int i = 0; i < num_reduced_rows; ++i) {
+    const int row = reduced_to_original_row_[i];
+    reduced->SetConstraintBounds(RowIndex(i), row_lb_[row], row_ub_[row]);
+  }
+  const int num_reduced_cols = reduced_to_original_col_.size();
+  for (int i = 0; i < num_reduced_cols; ++i) {
+    const int col = reduced_to_original_col_[i];
+    const int group = col_group_[col];
+    double lb = col_lb_[col];
+    double ub = col_ub_[col];
+    if (group >= 0 && group_is_merged_[group]) {
+      MergedColumnBounds(group, &lb, &ub);
+    }
+    reduced->SetObjectiveCoefficient(ColIndex(i), objective_[col]);
+    reduced->SetVariableBounds(ColIndex(i), lb, ub);
+  }
+}
+
+inline ProblemStatus IncrementalLpPresolver::Run(
+    const LinearProgram& linear_program, LinearProgram* reduced) {
+  linear_program_ = &linear_program;
+  const uint64 fingerprint = ComputeFingerprint();
+  structure_was_reused_ =
+      has_structure_ && fingerprint == fingerprint_ &&
+      num_rows_ == linear_program.num_constraints().value() &&
+      num_cols_ == linear_program.num_variables().value();
+  if (structure_was_reused_) {
+    ++num_structure_reuses_;
+  } else {
+    fingerprint_ = fingerprint;
+    AnalyzeStructure();
+    ++num_structure_analyses_;
+  }
+  linear_program_ = nullptr;
+
+  reduced_problem_was_updated_ = false;
+  const ProblemStatus status = ComputeReductions(linear_program);
+  if (status != ProblemStatus::INIT) {
+    last_reduced_ = nullptr;
+    return status;
+  }
+  if (last_reduced_ == reduced && group_is_merged_ == last_group_is_merged_ &&
+      reduced->num_variables().value() ==
+          static_cast<int>(reduced_to_original_col_.size()) &&
+      reduced->num_constraints().value() ==
+          static_cast<int>(reduced_to_original_row_.size())) {
+    UpdateReducedProblem(linear_program, reduced);
+    reduced_problem_was_updated_ = true;
+  } else {
+    BuildReducedProblem(linear_program, reduced);
+    last_reduced_ = reduced;
+    last_group_is_merged_ = group_is_merged_;
+  }
+  return ProblemStatus::INIT;
+}
+
+inline void IncrementalLpPresolver::DistributeMergedValue(
+    int group, double value, DenseRow* primal_values) const {
+  // Each column starts at a finite bound of its term factor * x, then the
+  // remainder is absorbed column by column within the bounds.
+  double remainder = value;
+  for (int i = group_starts_[group]; i < group_starts_[group + 1]; ++i) {
+    const int col = group_cols_[i];
+    const double f = col_factor_[col];
+    const double term_lb = f > 0.0 ? f * col_lb_[col] : f * col_ub_[col];
+    const double term_ub = f > 0.0 ? f * col_ub_[col] : f * col_lb_[col];
+    const double term = !std::isinf(term_lb)
+                            ? term_lb
+                            : (!std::isinf(term_ub) ? term_ub : 0.0);
+    (*primal_values)[ColIndex(col)] = term / f;
+    remainder -= term;
+  }
+  for (int i = group_starts_[group];
+       i < group_starts_[group + 1] && remainder != 0.0; ++i) {
+    const int col = group_cols_[i];
+    const double f = col_factor_[col];
+    const double term_lb = f > 0.0 ? f * col_lb_[col] : f * col_ub_[col];
+    const double term_ub = f > 0.0 ? f * col_ub_[col] : f * col_lb_[col];
+    const double term = (*primal_values)[ColIndex(col)] * f;
+    const double new_term =
+        std::max(term_lb, std::min(term_ub, term + remainder));
+    remainder -= new_term - term;
+    (*primal_values)[ColIndex(col)] = new_term / f;
+  }
+}
+
+inline void IncrementalLpPresolver::RecoverSolution(
+    const DenseRow& reduced_primal_values,
+    const DenseColumn& reduced_dual_values, DenseRow* primal_values,
+    DenseColumn* dual_values) const {
+  primal_values->assign(num_cols_, 0.0);
+  dual_values->assign(num_rows_, 0.0);
+
+  // Primal values.
+  const int num_reduced_cols = reduced_to_original_col_.size();
+  for (int i = 0; i < num_reduced_cols; ++i) {
+    const int col = reduced_to_original_col_[i];
+    const int group = col_group_[col];
+    const double value = reduced_primal_values[ColIndex(i)];
+    if (group >= 0 && group_is_merged_[group]) {
+      DistributeMergedValue(group, value, primal_values);
+    } else {
+      (*primal_values)[ColIndex(col)] = value;
+    }
+  }
+  for (int col = 0; col < num_cols_; ++col) {
+    if (col_representative_[col] < 0) {
+      (*primal_values)[ColIndex(col)] = empty_col_values_[col];
+    }
+  }
+
+  // Dual values. The dual of a representative row goes to the proportional
+  // row giving its active bound.
+  const int num_reduced_rows = reduced_to_original_row_.size();
+  for (int i = 0; i < num_reduced_rows; ++i) {
+    const int row = reduced_to_original_row_[i];
+    const double dual = reduced_dual_values[RowIndex(i)];
+    if (dual == 0.0) continue;
+    double activity = 0.0;
+    for (int64 k = row_starts_[row]; k < row_starts_[row + 1]; ++k) {
+      activity +=
+          row_coefficients_[k] * (*primal_values)[ColIndex(row_cols_[k])];
+    }
+    const int source =
+        std::abs(activity - row_lb_[row]) <= std::abs(activity - row_ub_[row])
+            ? row_lb_source_[row]
+            : row_ub_source_[row];
+    if (source < 0) continue;
+    (*dual_values)[RowIndex(source)] = dual / row_factor_[source];
+  }
+
+  // The dual of a singleton row giving the active bound of its column is such
+  // that the reduced cost of the column is zero.
+  for (const int row : singleton_rows_) {
+    const int64 pos = row_starts_[row];
+    const int col = row_cols_[pos];
+    const double value = (*primal_values)[ColIndex(col)];
+    const bool active =
+        (col_lb_source_[col] == row &&
+         internal::IsNearlyEqual(value, col_lb_[col])) ||
+        (col_ub_source_[col] == row &&
+         internal::IsNearlyEqual(value, col_ub_[col]));
+    if (!active) continue;
+    double reduced_cost = objective_[col];
+    for (int64 i = col_starts_[col]; i < col_starts_[col + 1]; ++i) {
+      reduced_cost -=
+          (*dual_values)[RowIndex(col_rows_[i])] * col_coefficients_[i];
+    }
+    (*dual_values)[RowIndex(row)] = reduced_cost / row_coefficients_[pos];
+  }
+}
+
+inline ProblemStatus IncrementalLpSolver::Solve(
+    const LinearProgram& linear_program) {
+  const ProblemStatus presolve_status =
+      presolver_.Run(linear_program, &reduced_);
+  if (presolve_status != ProblemStatus::INIT) return presolve_status;
+  const ProblemStatus status = solver_.Solve(reduced_);
+  objective_value_ = solver_.GetObjectiveValue();
+  presolver_.RecoverSolution(solver_.variable_values(), solver_.dual_values(),
+                             &primal_values_, &dual_values_);
+  return status;
+}
+
+}  // namespace glop
+}  // namespace operations_research
+
+#endif  // OR_TOOLS_GLOP_INCREMENTAL_PRESOLVE_H_
@@ -0,0 +1,370 @@
+// Copyright 2010-2014 Google
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#ifndef OR_TOOLS_LINEAR_SOLVER_BATCH_SOLVE_SERVICE_H_
+#define OR_TOOLS_LINEAR_SOLVER_BATCH_SOLVE_SERVICE_H_
+
+// Solves many independent MPModelRequests concurrently.
+//
+// MPSolver::SolveWithProto() creates a new MPSolver, and thus a new solver
+// interface, for each request, which dominates the solve time of small
+// models. Here each worker thread keeps one MPSolver per solver type (and per
+// solver specific parameters) for the lifetime of the service, and only calls
+// Clear() on it between two requests, so the underlying solver objects (the
+// GLOP LPSolver, the BOP solver, ...) and their memory are reused.
+//
+// The responses are returned in the order of the requests, and the latency of
+// each request is recorded in LatencyHistograms reported by StatString():
+// - the solve latency, for all the requests and per solver type,
+// - the response latency, from the moment the request is read from the input
+//   to the moment its response is returned. Since the responses are returned
+//   in order, it includes the time spent waiting for the slower requests that
+//   came before.
+//
+// Example:
+//   BatchSolveService service(8);
+//   std::vector<MPSolutionResponse> responses;
+//   service.SolveBatch(requests, &responses);
+//   LOG(INFO) << service.StatString();
+
+#include <algorithm>
+#include <functional>
+#include <map>
+#include <memory>
+#include <string>
+#include <vector>
+
+#include "base/callback.h"
+#include "base/integral_types.h"
+#include "base/join.h"
+#include "base/logging.h"
+#include "base/macros.h"
+#include "base/mutex.h"
+#include "base/stl_util.h"
+#include "base/threadpool.h"
+#include "base/timer.h"
+#include "linear_solver/linear_solver.h"
+#include "linear_solver/linear_solver.pb.h"
+#include "util/latency_histogram.h"
+#include "util/stats.h"
+
+namespace operations_research {
+
+class BatchSolveService {
+ public:
+  // Returns false when there are no more requests, and fills the given
+  // request otherwise.
+  typedef std::function<bool(MPModelRequest*)> RequestSource;
+
+  // Called in the order of the requests, on one thread at a time, with the
+  // index of the request and its response. The response can be swapped.
+  typedef std::function<void(int64, MPSolutionResponse*)> ResponseSink;
+
+  explicit BatchSolveService(int num_threads);
+  ~BatchSolveService();
+
+  // Solves all the given requests. The i-th response corresponds to the i-th
+  // request.
+  void SolveBatch(const std::vector<MPModelRequest>& requests,
+                  std::vector<MPSolutionResponse>* responses);
+
+  // Streaming version of SolveBatch(). The requests are pulled from the
+  // source by the workers as they become idle. To bound the memory used, at
+  // most max_pending_responses responses (4 per thread by default) are kept
+  // while waiting for a slow request to finish.
+  void SolveStream(const RequestSource& next_request,
+                   const ResponseSink& process_response);
+
+  // Must be at least 1.
+  void set_max_pending_responses(int value) {
+    CHECK_GE(value, 1);
+    max_pending_responses_ = value;
+  }
+
+  // Returns the latency statistics of all the requests solved so far.
+  std::string StatString() const;
+  void ResetStats();
+
+  int num_threads() const { return num_threads_; }
+
+ private:
+  // A solver kept from one request to the next, with the solver specific
+  // parameters it was created with.
+  struct CachedSolver {
+    std::unique_ptr<MPSolver> solver;
+    std::string parameters;
+  };
+
+  // The state owned by one worker thread, reused across calls.
+  struct WorkerState {
+    WorkerState() : solve_latency("solve latency") {}
+    ~WorkerState() { STLDeleteValues(&per_type_latency); }
+    std::map<int, CachedSolver> solvers;
+    MPModelRequest request_buffer;
+    LatencyHistogram solve_latency;
+    std::map<int, LatencyHistogram*> per_type_latency;
+  };
+
+  // Returns the next request to solve, or nullptr if there are none. The
+  // given buffer, owned by the calling worker, can be used to store it.
+  typedef std::function<const MPModelRequest*(MPModelRequest*)>
+      InternalRequestSource;
+
+  // A solved request waiting for the previous ones to be returned.
+  struct PendingResponse {
+    MPSolutionResponse* response;
+    double pull_time;
+  };
+
+  // The state shared by the workers of one call.
+  struct StreamState {
+    StreamState(const InternalRequestSource& source, const ResponseSink& sink)
+        : next_request(source),
+          process_response(sink),
+          source_is_exhausted(false),
+          num_pulled(0),
+          num_processed(0) {
+      timer.Start();
+    }
+    const InternalRequestSource& next_request;
+    const ResponseSink& process_response;
+    WallTimer timer;
+    Mutex mutex;
+    CondVar response_processed;
+    bool source_is_exhausted;
+    int64 num_pulled;
+    int64 num_processed;
+    std::map<int64, PendingResponse> pending_responses;
+  };
+
+  void Run(const InternalRequestSource& next_request,
+           const ResponseSink& process_response);
+  void RunWorker(StreamState* stream, WorkerState* worker);
+  void SolveOneRequest(const MPModelRequest& request, WorkerState* worker,
+                       MPSolutionResponse* response);
+  void MergeWorkerStats();
+
+  const int num_threads_;
+  int max_pending_responses_;
+  std::vector<WorkerState*> workers_;
+
+  mutable StatsGroup stats_;
+  LatencyHistogram solve_latency_;
+  LatencyHistogram response_latency_;
+  std::map<int, LatencyHistogram*> per_type_latency_;
+
+  DISALLOW_COPY_AND_ASSIGN(BatchSolveService);
+};
+
+// ============================================================================
+// Implementation.
+// ============================================================================
+
+inline BatchSolveService::BatchSolveService(int num_threads)
+    : num_threads_(std::max(1, num_threads)),
+      max_pending_responses_(4 * num_threads_),
+      workers_(),
+      stats_("BatchSolveService"),
+      solve_latency_("solve latency", &stats_),
+      response_latency_("response latency", &stats_),
+      per_type_latency_() {
+  for (int i = 0; i < num_threads_; ++i) workers_.push_back(new WorkerState());
+}
+
+inline BatchSolveService::~BatchSolveService() {
+  STLDeleteElements(&workers_);
+  STLDeleteValues(&per_type_latency_);
+}
+
+inline void BatchSolveService::SolveBatch(
+    const std::vector<MPModelRequest>& requests,
+    std::vector<MPSolutionResponse>* responses) {
+  responses->clear();
+  responses->resize(requests.size());
+
+  // The workers read the requests in place instead of copying them.
+  int64 next_index = 0;
+  const int64 num_requests = requests.size();
+  const InternalRequestSource source = [&requests, &next_index, num_requests](
+      MPModelRequest*) -> const MPModelRequest* {
+    return next_index < num_requests ? &requests[next_index++] : nullptr;
+  };
+  const ResponseSink sink = [responses](int64 index,
+                                        MPSolutionResponse* response) {
+    (*responses)[index].Swap(response);
+  };
+  Run(source, sink);
+}
+
+inline void BatchSolveService::SolveStream(
+    const RequestSource& next_request, const ResponseSink& process_response) {
+  const InternalRequestSource source = [&next_request](
+      MPModelRequest* buffer) -> const MPModelRequest* {
+    buffer->Clear();
+    return next_request(buffer) ? buffer : nullptr;
+  };
+  Run(source, process_response);
+}
+
+inline void BatchSolveService::Run(const InternalRequestSource& next_request,
+                                   const ResponseSink& process_response) {
+  StreamState stream(next_request, process_response);
+  if (num_threads_ == 1) {
+    RunWorker(&stream, workers_[0]);
+  } else {
+    ThreadPool pool("BatchSolveService", num_threads_);
+    pool.StartWorkers();
+    for (int i = 0; i < num_threads_; ++i) {
+      pool.Add(NewCallback(this, &BatchSolveService::RunWorker, &stream,
+                           workers_[i]));
+    }
+  }
+  CHECK(stream.pending_responses.empty());
+  MergeWorkerStats();
+}
+
+inline void BatchSolveService::RunWorker(StreamState* stream,
+                                         WorkerState* worker) {
+  while (true) {
+    const MPModelRequest* request = nullptr;
+    int64 index;
+    double pull_time;
+    {
+      MutexLock lock(&stream->mutex);
+      // Waits for the oldest responses to be returned if too many responses
+      // are pending.
+      while (!stream->source_is_exhausted &&
+             stream->num_pulled - stream->num_processed >=
+                 max_pending_responses_) {
+        stream->response_processed.Wait(&stream->mutex);
+      }
+      if (stream->source_is_exhausted) break;
+      request = stream->next_request(&worker->request_buffer);
+      if (request == nullptr) {
+        stream->source_is_exhausted = true;
+        stream->response_processed.SignalAll();
+        break;
+      }
+      index = stream->num_pulled++;
+      pull_time = stream->timer.Get();
+    }
+
+    PendingResponse pending;
+    pending.response = new MPSolutionResponse();
+    pending.pull_time = pull_time;
+    SolveOneRequest(*request, worker, pending.response);
+
+    // Returns all the consecutive responses that are ready.
+    MutexLock lock(&stream->mutex);
+    stream->pending_responses[index] = pending;
+    while (!stream->pending_responses.empty() &&
+           stream->pending_responses.begin()->first ==
+               stream->num_processed) {
+      const PendingResponse next = stream->pending_responses.begin()->second;
+      stream->pending_responses.erase(stream->pending_responses.begin());
+      stream->process_response(stream->num_processed, next.response);
+      delete next.response;
+      response_latency_.AddTimeInSec(stream->timer.Get() - next.pull_time);
+      ++stream->num_processed;
+    }
+    stream->response_processed.SignalAll();
+  }
+}
+
+inline void BatchSolveService::SolveOneRequest(const MPModelRequest& request,
+                                               WorkerState* worker,
+                                               MPSolutionResponse* response) {
+  const int type = request.solver_type();
+  const MPSolver::OptimizationProblemType problem_type =
+      static_cast<MPSolver::OptimizationProblemType>(type);
+  if (!MPSolver::SupportsProblemType(problem_type)) {
+    response->set_status(MPSOLVER_SOLVER_TYPE_UNAVAILABLE);
+    return;
+  }
+  WallTimer timer;
+  timer.Start();
+
+  // The solver is re-created if the parameters changed, since there is no
+  // reliable way to restore the default parameters of all the solvers.
+  CachedSolver& cached = worker->solvers[type];
+  if (cached.solver == nullptr ||
+      cached.parameters != request.solver_specific_parameters()) {
+    cached.solver.reset(new MPSolver("BatchSolveService", problem_type));
+    cached.parameters = request.solver_specific_parameters();
+    if (!cached.parameters.empty() &&
+        !cached.solver->SetSolverSpecificParametersAsString(
+            cached.parameters)) {
+      cached.solver.reset();
+      response->set_status(MPSOLVER_MODEL_INVALID_SOLVER_PARAMETERS);
+      return;
+    }
+  } else {
+    cached.solver->Clear();
+  }
+  MPSolver* const solver = cached.solver.get();
+  std::string error_message;
+  const MPSolverResponseStatus status =
+      solver->LoadModelFromProto(request.model(), &error_message);
+  if (status != MPSOLVER_MODEL_IS_VALID) {
+    VLOG(1) << "Invalid model: " << error_message;
+    response->set_status(status);
+    return;
+  }
+  solver->set_time_limit(
+      request.has_solver_time_limit_seconds()
+          ? static_cast<int64>(request.solver_time_limit_seconds() * 1000)
+          : 0);
+  if (request.enable_internal_solver_output()) {
+    solver->EnableOutput();
+  } else {
+    solver->SuppressOutput();
+  }
+  solver->Solve();
+  solver->FillSolutionResponseProto(response);
+
+  const double seconds = timer.Get();
+  worker->solve_latency.AddTimeInSec(seconds);
+  LatencyHistogram*& per_type = worker->per_type_latency[type];
+  if (per_type == nullptr) per_type = new LatencyHistogram("");
+  per_type->AddTimeInSec(seconds);
+}
+
+inline void BatchSolveService::MergeWorkerStats() {
+  for (WorkerState* const worker : workers_) {
+    solve_latency_.Merge(worker->solve_latency);
+    worker->solve_latency.Reset();
+    for (const auto& entry : worker->per_type_latency) {
+      LatencyHistogram*& histogram = per_type_latency_[entry.first];
+      if (histogram == nullptr) {
+        histogram = new LatencyHistogram(
+            StrCat("solve latency (",
+                   MPModelRequest::SolverType_Name(
+                       static_cast<MPModelRequest::SolverType>(entry.first)),
+                   ")"),
+            &stats_);
+      }
+      histogram->Merge(*entry.second);
+      entry.second->Reset();
+    }
+  }
+}
+
+inline std::string BatchSolveService::StatString() const {
+  return stats_.StatString();
+}
+
+inline void BatchSolveService::ResetStats() { stats_.Reset(); }
+
+}  // namespace operations_research
+
+#endif  // OR_TOOLS_LINEAR_SOLVER_BATCH_SOLVE_SERVICE_H_
@@ -0,0 +1,636 @@
+// Copyright 2010-2014 Google
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#ifndef OR_TOOLS_LINEAR_SOLVER_COLUMNAR_MODEL_H_
+#define OR_TOOLS_LINEAR_SOLVER_COLUMNAR_MODEL_H_
+
+// A binary columnar format for linear (and mixed integer) models, meant to be
+// memory-mapped. Parsing an MPModelProto allocates one message per variable
+// and per constraint plus their repeated fields, which is slow and uses about
+// five times the size of the raw data. Here the model is a header followed by
+// one flat array per attribute:
+//
+//   column lower bounds, upper bounds, objective coefficients  (double[n])
+//   column integrality                                         (uint8[n])
+//   row lower bounds, upper bounds                             (double[m])
+//   matrix in compressed sparse row format: row starts (int64[m + 1]),
+//     column indices (int32[nnz]) and coefficients (double[nnz])
+//   column and row name tables: offsets (int64[n + 1] or int64[m + 1]) and
+//     the concatenated characters
+//   the model name
+//
+// Each array starts at an offset multiple of 8 that is recorded in the header,
+// so a ColumnarModelView can point into the mapped file directly: opening a
+// model costs one mmap() and a validation pass, and the pages are only read
+// when they are used. The numbers are stored in the native byte order, which
+// is checked when opening the file.
+//
+// The model can then be converted to an MPModelProto, appended to a
+// SparseMPModel (and from there given to GLOP without any proto), or loaded
+// into an MPSolver with LoadModelFromMappedFile().
+
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+#include <limits>
+#include <memory>
+#include <string>
+#include <vector>
+
+#include "base/integral_types.h"
+#include "base/join.h"
+#include "base/logging.h"
+#include "base/macros.h"
+#include "base/status.h"
+#include "base/stringpiece.h"
+#include "linear_solver/linear_solver.h"
+#include "linear_solver/linear_solver.pb.h"
+#include "linear_solver/model_stream_writer.h"
+#include "linear_solver/sparse_model.h"
+#include "util/mapped_file.h"
+
+namespace operations_research {
+
+// The sections of a columnar model file, in file order.
+enum ColumnarModelSection {
+  COLUMN_LOWER_BOUNDS,
+  COLUMN_UPPER_BOUNDS,
+  OBJECTIVE_COEFFICIENTS,
+  COLUMN_IS_INTEGER,
+  ROW_LOWER_BOUNDS,
+  ROW_UPPER_BOUNDS,
+  ROW_STARTS,
+  ENTRY_COLUMNS,
+  ENTRY_COEFFICIENTS,
+  COLUMN_NAME_STARTS,
+  COLUMN_NAMES,
+  ROW_NAME_STARTS,
+  ROW_NAMES,
+  MODEL_NAME,
+  NUM_COLUMNAR_MODEL_SECTIONS
+};
+
+// The header at the beginning of a columnar model file.
+struct ColumnarModelHeader {
+  static const uint32 kVersion = 1;
+  static const uint32 kByteOrderMark = 0x01020304;
+
+  char magic[8];
+  uint32 version;
+  uint32 byte_order_mark;
+  int64 num_columns;
+  int64 num_rows;
+  int64 num_entries;
+  double objective_offset;
+  uint32 maximize;
+  uint32 reserved;
+  int64 section_offsets[NUM_COLUMNAR_MODEL_SECTIONS];
+  int64 section_sizes[NUM_COLUMNAR_MODEL_SECTIONS];
+};
+
+// Writes the given model to the given file in the columnar format. The file
+// can't be gzipped since it is meant to be memory-mapped.
+util::Status WriteColumnarModel(const MPModelProto& model,
+                                const std::string& filename);
+
+// A read-only view of a columnar model file. All the pointers and names point
+// into the mapped file and stay valid until the view is closed or destroyed.
+class ColumnarModelView {
+ public:
+  ColumnarModelView() : header_(nullptr) {}
+
+  // Maps the given file and checks its structure: the header, the section
+  // bounds and alignment, that the row starts, the column indices and the
+  // name offsets are in range, and that the non-empty column names and the
+  // non-empty row names are unique. The values themselves are not checked.
+  util::Status Open(const std::string& filename);
+  void Close();
+
+  // The accessors below can only be called on an opened view.
+  int num_columns() const { return header_->num_columns; }
+  int num_rows() const { return header_->num_rows; }
+  int64 num_entries() const { return header_->num_entries; }
+  bool maximize() const { return header_->maximize != 0; }
+  double objective_offset() const { return header_->objective_offset; }
+  StringPiece model_name() const {
+    return StringPiece(Section<char>(MODEL_NAME),
+                       header_->section_sizes[MODEL_NAME]);
+  }
+
+  const double* column_lower_bounds() const {
+    return Section<double>(COLUMN_LOWER_BOUNDS);
+  }
+  const double* column_upper_bounds() const {
+    return Section<double>(COLUMN_UPPER_BOUNDS);
+  }
+  const double* objective_coefficients() const {
+    return Section<double>(OBJECTIVE_COEFFICIENTS);
+  }
+  const uint8* column_is_integer() const {
+    return Section<uint8>(COLUMN_IS_INTEGER);
+  }
+  const double* row_lower_bounds() const {
+    return Section<double>(ROW_LOWER_BOUNDS);
+  }
+  const double* row_upper_bounds() const {
+    return Section<double>(ROW_UPPER_BOUNDS);
+  }
+
+  // The entries of the row r are at the positions [row_starts()[r],
+  // row_starts()[r + 1]) of entry_columns() and entry_coefficients().
+  const int64* row_starts() const { return Section<int64>(ROW_STARTS); }
+  const int32* entry_columns() const { return Section<int32>(ENTRY_COLUMNS); }
+  const double* entry_coefficients() const {
+    return Section<double>(ENTRY_COEFFICIENTS);
+  }
+
+  StringPiece column_name(int column) const {
+    return Name(COLUMN_NAME_STARTS, COLUMN_NAMES, column);
+  }
+  StringPiece row_name(int row) const {
+    return Name(ROW_NAME_STARTS, ROW_NAMES, row);
+  }
+
+ private:
+  template <class T>
+  const T* Section(ColumnarModelSection section) const {
+    return reinterpret_cast<const T*>(file_.data() +
+                                      header_->section_offsets[section]);
+  }
+  StringPiece Name(ColumnarModelSection starts_section,
+                   ColumnarModelSection names_section, int index) const {
+    const int64* const starts = Section<int64>(starts_section);
+    return StringPiece(Section<char>(names_section) + starts[index],
+                       starts[index + 1] - starts[index]);
+  }
+  util::Status Validate() const;
+
+  MappedFile file_;
+  const ColumnarModelHeader* header_;
+
+  DISALLOW_COPY_AND_ASSIGN(ColumnarModelView);
+};
+
+// Converts an opened view to a proto, which is cleared first.
+void ColumnarModelToProto(const ColumnarModelView& view, MPModelProto* model);
+
+// Appends the model of the given view to the given empty SparseMPModel with
+// its bulk API, without creating any per-variable object.
+void ColumnarModelToSparseModel(const ColumnarModelView& view,
+                                SparseMPModel* model);
+
+// Loads the model of the given columnar file into the solver, which is
+// cleared first. This is the counterpart of MPSolver::LoadModelFromProto()
+// without the intermediate proto: the returned status and the error message
+// follow the same conventions. The names are kept: MPSolver requires them to
+// be unique, which ColumnarModelView::Open() checks.
+MPSolverResponseStatus LoadModelFromMappedFile(const std::string& filename,
+                                               MPSolver* solver,
+                                               std::string* error_message);
+
+// ============================================================================
+// Implementation.
+// ============================================================================
+
+namespace internal {
+
+const char kColumnarModelMagic[8] = {'O', 'R', 'C', 'O', 'L', 'M', 'D', 'L'};
+
+inline int64 AlignedColumnarSize(int64 size) { return (size + 7) & ~7LL; }
+
+template <class T>
+void AppendColumnarValue(const T& value, ChunkedModelOutput* output) {
+  output->Append(reinterpret_cast<const char*>(&value), sizeof(value));
+}
+
+inline void PadColumnarSection(int64 size, ChunkedModelOutput* output) {
+  const char kZeros[8] = {0, 0, 0, 0, 0, 0, 0, 0};
+  output->Append(kZeros, AlignedColumnarSize(size) - size);
+}
+
+}  // namespace internal
+
+inline util::Status WriteColumnarModel(const MPModelProto& model,
+                                       const std::string& filename) {
+  const int num_columns = model.variable_size();
+  const int num_rows = model.constraint_size();
+  ColumnarModelHeader header;
+  memset(&header, 0, sizeof(header));
+  memcpy(header.magic, internal::kColumnarModelMagic, sizeof(header.magic));
+  header.version = ColumnarModelHeader::kVersion;
+  header.byte_order_mark = ColumnarModelHeader::kByteOrderMark;
+  header.num_columns = num_columns;
+  header.num_rows = num_rows;
+  header.objective_offset = model.objective_offset();
+  header.maximize = model.maximize() ? 1 : 0;
+
+  // First pass to compute the size of the sections.
+  int64 num_entries = 0;
+  for (const MPConstraintProto& constraint : model.constraint()) {
+    if (constraint.var_index_size() != constraint.coefficient_size()) {
+      return util::Status(util::error::INVALID_ARGUMENT,
+                          StrCat("Constraint '", constraint.name(),
+                                 "' has a different number of indices and "
+                                 "coefficients."));
+    }
+    for (const int var : constraint.var_index()) {
+      if (var < 0 || var >= num_columns) {
+        return util::Status(util::error::INVALID_ARGUMENT,
+                            StrCat("Invalid variable index ", var,
+                                   " in constraint '", constraint.name(),
+                                   "'."));
+      }
+    }
+    num_entries += constraint.var_index_size();
+  }
+  header.num_entries = num_entries;
+  int64 column_names_size = 0;
+  for (const MPVariableProto& variable : model.variable()) {
+    column_names_size += variable.name().size();
+  }
+  int64 row_names_size = 0;
+  for (const MPConstraintProto& constraint : model.constraint()) {
+    row_names_size += constraint.name().size();
+  }
+  const int64 sizes[NUM_COLUMNAR_MODEL_SECTIONS] = {
+      num_columns * 8LL,
+      num_columns * 8LL,
+      num_columns * 8LL,
+      num_columns,
+      num_rows * 8LL,
+      num_rows * 8LL,
+      (num_rows + 1) * 8LL,
+      num_entries * 4,
+      num_entries * 8,
+      (num_columns + 1) * 8LL,
+      column_names_size,
+      (num_rows + 1) * 8LL,
+      row_names_size,
+      static_cast<int64>(model.name().size())};
+  int64 offset = internal::AlignedColumnarSize(sizeof(header));
+  for (int s = 0; s < NUM_COLUMNAR_MODEL_SECTIONS; ++s) {
+    header.section_sizes[s] = sizes[s];
+    header.section_offsets[s] = offset;
+    offset += internal::AlignedColumnarSize(sizes[s]);
+  }
+
+  // Second pass to write the sections in order.
+  File* const file = File::Open(filename, "w");
+  if (file == nullptr) {
+    return util::Status(util::error::INTERNAL,
+                        StrCat("Could not open '", filename, "'."));
+  }
+  ChunkedModelOutput output(file);
+  output.Append(reinterpret_cast<const char*>(&header), sizeof(header));
+  internal::PadColumnarSection(sizeof(header), &output);
+  for (const MPVariableProto& variable : model.variable()) {
+    internal::AppendColumnarValue(variable.lower_bound(), &output);
+  }
+  for (const MPVariableProto& variable : model.variable()) {
+    internal::AppendColumnarValue(variable.upper_bound(), &output);
+  }
+  for (const MPVariableProto& variable : model.variable()) {
+    internal::AppendColumnarValue(variable.objective_coefficient(), &output);
+  }
+  for (const MPVariableProto& variable : model.variable()) {
+    internal::AppendColumnarValue<uint8>(variable.is_integer() ? 1 : 0,
+                                         &output);
+  }
+  internal::PadColumnarSection(num_columns, &output);
+  for (const MPConstraintProto& constraint : model.constraint()) {
+    internal::AppendColumnarValue(constraint.lower_bound(), &output);
+  }
+  for (const MPConstraintProto& constraint : model.constraint()) {
+    internal::AppendColumnarValue(constraint.upper_bound(), &output);
+  }
+  int64 row_start = 0;
+  internal::AppendColumnarValue(row_start, &output);
+  for (const MPConstraintProto& constraint : model.constraint()) {
+    row_start += constraint.var_index_size();
+    internal::AppendColumnarValue(row_start, &output);
+  }
+  for (const MPConstraintProto& constraint : model.constraint()) {
+    for (const int32 var : constraint.var_index()) {
+      internal::AppendColumnarValue(var, &output);
+    }
+  }
+  internal::PadColumnarSection(num_entries * 4, &output);
+  for (const MPConstraintProto& constraint : model.constraint()) {
+    for (const double coefficient : constraint.coefficient()) {
+      internal::AppendColumnarValue(coefficient, &output);
+    }
+  }
+  int64 name_start = 0;
+  internal::AppendColumnarValue(name_start, &output);
+  for (const MPVariableProto& variable : model.variable()) {
+    name_start += variable.name().size();
+    internal::AppendColumnarValue(name_start, &output);
+  }
+  for (const MPVariableProto& variable : model.variable()) {
+    output.Append(variable.name());
+  }
+  internal::PadColumnarSection(column_names_size, &output);
+  name_start = 0;
+  internal::AppendColumnarValue(name_start, &output);
+  for (const MPConstraintProto& constraint : model.constraint()) {
+    name_start += constraint.name().size();
+    internal::AppendColumnarValue(name_start, &output);
+  }
+  for (const MPConstraintProto& constraint : model.constraint()) {
+    output.Append(constraint.name());
+  }
+  internal::PadColumnarSection(row_names_size, &output);
+  output.Append(model.name());
+  internal::PadColumnarSection(model.name().size(), &output);
+
+  const bool written = output.Close();
+  DCHECK(!written || output.num_written_bytes() == offset);
+  if (!file->Close() || !written) {
+    return util::Status(util::error::INTERNAL,
+                        StrCat("Error while writing '", filename, "'."));
+  }
+  return util::Status();
+}
+
+inline util::Status ColumnarModelView::Open(const std::string& filename) {
+  Close();
+  util::Status status = file_.Open(filename);
+  if (!status.ok()) return status;
+  if (file_.size() < static_cast<int64>(sizeof(ColumnarModelHeader))) {
+    file_.Close();
+    return util::Status(util::error::INVALID_ARGUMENT,
+                        StrCat("'", filename, "' is too small."));
+  }
+  header_ = reinterpret_cast<const ColumnarModelHeader*>(file_.data());
+  status = Validate();
+  if (!status.ok()) {
+    Close();
+    return util::Status(util::error::INVALID_ARGUMENT,
+                        StrCat("'", filename, "': ", status.error_message()));
+  }
+  return util::Status();
+}
+
+inline void ColumnarModelView::Close() {
+  file_.Close();
+  header_ = nullptr;
+}
+
+inline util::Status ColumnarModelView::Validate() const {
+  const auto error = [](const std::string& message) {
+    return util::Status(util::error::INVALID_ARGUMENT, message);
+  };
+  if (memcmp(header_->magic, internal::kColumnarModelMagic,
+             sizeof(header_->magic)) != 0) {
+    return error("Not a columnar model file.");
+  }
+  if (header_->byte_order_mark != ColumnarModelHeader::kByteOrderMark) {
+    return error("The file was written with another byte order.");
+  }
+  if (header_->version != ColumnarModelHeader::kVersion) {
+    return error(StrCat("Unsupported version ", header_->version, "."));
+  }
+  const int64 n = header_->num_columns;
+  const int64 m = header_->num_rows;
+  const int64 nnz = header_->num_entries;
+  // The coefficients alone take nnz * 8 bytes of the file, which also keeps
+  // the section sizes below from overflowing.
+  if (n < 0 || n > kint32max || m < 0 || m > kint32max || nnz < 0 ||
+      nnz > file_.size() / 8) {
+    return error("Invalid dimensions.");
+  }
+  const int64* const sizes = header_->section_sizes;
+  const int64 expected_sizes[NUM_COLUMNAR_MODEL_SECTIONS] = {
+      n * 8, n * 8, n * 8, n, m * 8, m * 8, (m + 1) * 8, nnz * 4, nnz * 8,
+      (n + 1) * 8, sizes[COLUMN_NAMES], (m + 1) * 8, sizes[ROW_NAMES],
+      sizes[MODEL_NAME]};
+  for (int s = 0; s < NUM_COLUMNAR_MODEL_SECTIONS; ++s) {
+    const int64 offset = header_->section_offsets[s];
+    if (sizes[s] != expected_sizes[s] || sizes[s] < 0 || offset % 8 != 0 ||
+        offset < static_cast<int64>(sizeof(ColumnarModelHeader)) ||
+        offset > file_.size() || sizes[s] > file_.size() - offset) {
+      return error(StrCat("Invalid section ", s, "."));
+    }
+  }
+
+  // The structure: row starts, column indices and name offsets.
+  const int64* const row_starts = this->row_starts();
+  if (row_starts[0] != 0 || row_starts[m] != nnz) {
+    return error("Invalid row starts.");
+  }
+  for (int64 r = 0; r < m; ++r) {
+    if (row_starts[r] > row_starts[r + 1]) return error("Invalid row starts.");
+  }
+  const int32* const columns = entry_columns();
+  for (int64 k = 0; k < nnz; ++k) {
+    if (columns[k] < 0 || columns[k] >= n) {
+      return error(StrCat("Invalid column index ", columns[k], "."));
+    }
+  }
+  const auto check_names = [this](ColumnarModelSection starts_section,
+                                  ColumnarModelSection names_section,
+                                  int64 size) {
+    const int64* const starts = Section<int64>(starts_section);
+    if (starts[0] != 0 ||
+        starts[size] != header_->section_sizes[names_section]) {
+      return false;
+    }
+    for (int64 i = 0; i < size; ++i) {
+      if (starts[i] > starts[i + 1]) return false;
+    }
+    return true;
+  };
+  if (!check_names(COLUMN_NAME_STARTS, COLUMN_NAMES, n) ||
+      !check_names(ROW_NAME_STARTS, ROW_NAMES, m)) {
+    return error("Invalid name table.");
+  }
+  // MPSolver dies on duplicate names, so they are rejected here.
+  const auto has_duplicate_names = [this](ColumnarModelSection starts_section,
+                                          ColumnarModelSection names_section,
+                                          int64 size) {
+    std::vector<StringPiece> names;
+    for (int64 i = 0; i < size; ++i) {
+      const StringPiece name = Name(starts_section, names_section, i);
+      if (!name.empty()) names.push_back(name);
+    }
+    std::sort(names.begin(), names.end(),
+              [](const StringPiece& a, const StringPiece& b) {
+                return a.compare(b) < 0;
+              });
+    for (int i = 1; i < names.size(); ++i) {
+      if (names[i - 1].compare(names[i]) == 0) return true;
+    }
+    return false;
+  };
+  if (has_duplicate_names(COLUMN_NAME_STARTS, COLUMN_NAMES, n)) {
+    return error("Duplicate column name.");
+  }
+  if (has_duplicate_names(ROW_NAME_STARTS, ROW_NAMES, m)) {
+    return error("Duplicate row name.");
+  }
+  return util::Status();
+}
+
+inline void ColumnarModelToProto(const ColumnarModelView& view,
+                                 MPModelProto* model) {
+  model->Clear();
+  model->set_name(view.model_name().ToString());
+  model->set_maximize(view.maximize());
+  if (view.objective_offset() != 0.0) {
+    model->set_objective_offset(view.objective_offset());
+  }
+  const int num_columns = view.num_columns();
+  model->mutable_variable()->Reserve(num_columns);
+  for (int col = 0; col < num_columns; ++col) {
+    MPVariableProto* const variable = model->add_variable();
+    variable->set_lower_bound(view.column_lower_bounds()[col]);
+    variable->set_upper_bound(view.column_upper_bounds()[col]);
+    variable->set_objective_coefficient(view.objective_coefficients()[col]);
+    variable->set_is_integer(view.column_is_integer()[col] != 0);
+    const StringPiece name = view.column_name(col);
+    if (!name.empty()) variable->set_name(name.data(), name.size());
+  }
+  const int num_rows = view.num_rows();
+  model->mutable_constraint()->Reserve(num_rows);
+  for (int row = 0; row < num_rows; ++row) {
+    MPConstraintProto* const constraint = model->add_constraint();
+    constraint->set_lower_bound(view.row_lower_bounds()[row]);
+    constraint->set_upper_bound(view.row_upper_bounds()[row]);
+    const int64 begin = view.row_starts()[row];
+    const int64 end = view.row_starts()[row + 1];
+    constraint->mutable_var_index()->Reserve(end - begin);
+    constraint->mutable_coefficient()->Reserve(end - begin);
+    for (int64 k = begin; k < end; ++k) {
+      constraint->add_var_index(view.entry_columns()[k]);
+      constraint->add_coefficient(view.entry_coefficients()[k]);
+    }
+    const StringPiece name = view.row_name(row);
+    if (!name.empty()) constraint->set_name(name.data(), name.size());
+  }
+}
+
+inline void ColumnarModelToSparseModel(const ColumnarModelView& view,
+                                       SparseMPModel* model) {
+  CHECK_EQ(0, model->num_columns());
+  CHECK_EQ(0, model->num_rows());
+  const int num_columns = view.num_columns();
+  const int num_rows = view.num_rows();
+  model->Reserve(num_columns, num_rows, view.num_entries());
+  model->SetMaximization(view.maximize());
+  model->SetObjectiveOffset(view.objective_offset());
+  std::unique_ptr<bool[]> is_integer(new bool[num_columns + 1]);
+  for (int col = 0; col < num_columns; ++col) {
+    is_integer[col] = view.column_is_integer()[col] != 0;
+  }
+  model->AddColumns(num_columns, view.column_lower_bounds(),
+                    view.column_upper_bounds(), view.objective_coefficients(),
+                    is_integer.get(), nullptr, nullptr, nullptr);
+
+  // The rows are added by batches since AddRows() takes int starts relative
+  // to the given arrays, while the file stores int64 starts.
+  const int kBatchSize = 1 << 16;
+  std::vector<int> starts;
+  for (int first_row = 0; first_row < num_rows; first_row += kBatchSize) {
+    const int batch_size = std::min(kBatchSize, num_rows - first_row);
+    const int64 base = view.row_starts()[first_row];
+    starts.resize(batch_size + 1);
+    for (int i = 0; i <= batch_size; ++i) {
+      starts[i] = static_cast<int>(view.row_starts()[first_row + i] - base);
+    }
+    model->AddRows(batch_size, view.row_lower_bounds() + first_row,
+                   view.row_upper_bounds() + first_row, starts.data(),
+                   view.entry_columns() + base,
+                   view.entry_coefficients() + base);
+  }
+  for (int col = 0; col < num_columns; ++col) {
+    const StringPiece name = view.column_name(col);
+    if (!name.empty()) model->SetColumnName(col, name.ToString());
+  }
+  for (int row = 0; row < num_rows; ++row) {
+    const StringPiece name = view.row_name(row);
+    if (!name.empty()) model->SetRowName(row, name.ToString());
+  }
+}
+
+inline MPSolverResponseStatus LoadModelFromMappedFile(
+    const std::string& filename, MPSolver* solver,
+    std::string* error_message) {
+  ColumnarModelView view;
+  const util::Status status = view.Open(filename);
+  if (!status.ok()) {
+    *error_message = status.error_message();
+    return MPSOLVER_MODEL_INVALID;
+  }
+
+  // Same checks on the values as FindErrorInMPModelProto().
+  const double kInfinity = std::numeric_limits<double>::infinity();
+  const int num_columns = view.num_columns();
+  const int num_rows = view.num_rows();
+  for (int col = 0; col < num_columns; ++col) {
+    const double lb = view.column_lower_bounds()[col];
+    const double ub = view.column_upper_bounds()[col];
+    if (std::isnan(lb) || std::isnan(ub) || lb == kInfinity ||
+        ub == -kInfinity ||
+        !std::isfinite(view.objective_coefficients()[col])) {
+      *error_message = StrCat("Invalid bounds or objective for variable #",
+                              col, ".");
+      return MPSOLVER_MODEL_INVALID;
+    }
+  }
+  for (int64 k = 0; k < view.num_entries(); ++k) {
+    if (!std::isfinite(view.entry_coefficients()[k])) {
+      *error_message = "Invalid coefficient.";
+      return MPSOLVER_MODEL_INVALID;
+    }
+  }
+  for (int row = 0; row < num_rows; ++row) {
+    const double lb = view.row_lower_bounds()[row];
+    const double ub = view.row_upper_bounds()[row];
+    if (std::isnan(lb) || std::isnan(ub) || lb == kInfinity ||
+        ub == -kInfinity) {
+      *error_message = StrCat("Invalid bounds for constraint #", row, ".");
+      return MPSOLVER_MODEL_INVALID;
+    }
+  }
+
+  solver->Clear();
+  std::vector<MPVariable*> variables(num_columns);
+  MPObjective* const objective = solver->MutableObjective();
+  for (int col = 0; col < num_columns; ++col) {
+    variables[col] = solver->MakeVar(view.column_lower_bounds()[col],
+                                     view.column_upper_bounds()[col],
+                                     view.column_is_integer()[col] != 0,
+                                     view.column_name(col).ToString());
+    const double coefficient = view.objective_coefficients()[col];
+    if (coefficient != 0.0) {
+      objective->SetCoefficient(variables[col], coefficient);
+    }
+  }
+  for (int row = 0; row < num_rows; ++row) {
+    MPConstraint* const constraint = solver->MakeRowConstraint(
+        view.row_lower_bounds()[row], view.row_upper_bounds()[row],
+        view.row_name(row).ToString());
+    for (int64 k = view.row_starts()[row]; k < view.row_starts()[row + 1];
+         ++k) {
+      constraint->SetCoefficient(variables[view.entry_columns()[k]],
+                                 view.entry_coefficients()[k]);
+    }
+  }
+  objective->SetOptimizationDirection(view.maximize());
+  objective->SetOffset(view.objective_offset());
+  return MPSOLVER_MODEL_IS_VALID;
+}
+
+}  // namespace operations_research
+
+#endif  // OR_TOOLS_LINEAR_SOLVER_COLUMNAR_MODEL_H_
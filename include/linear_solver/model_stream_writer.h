@@ -0,0 +1,572 @@
+// Copyright 2010-2014 Google
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#ifndef OR_TOOLS_LINEAR_SOLVER_MODEL_STREAM_WRITER_H_
+#define OR_TOOLS_LINEAR_SOLVER_MODEL_STREAM_WRITER_H_
+
+// Streaming writers of an MPModelProto in the MPS and LP formats. Contrary to
+// the MPModelProtoExporter that builds the whole file in one std::string, the
+// output is accumulated in a buffer of bounded size that is flushed to a
+// File, an std::ostream or a gzip file whenever it is full. The extra memory
+// is thus the chunk size plus the transpose of the constraint matrix (needed
+// by the COLUMNS section of the MPS format), instead of the whole file.
+//
+// The names follow the same rules as in the MPModelProtoExporter: they are
+// used when they are valid and unique, and replaced by "V<index>" or
+// "C<index>" otherwise, or when obfuscated names are requested.
+
+#include <zlib.h>
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <limits>
+#include <memory>
+#include <ostream>
+#include <string>
+#include <vector>
+
+#include "base/file.h"
+#include "base/hash.h"
+#include "base/integral_types.h"
+#include "base/join.h"
+#include "base/logging.h"
+#include "base/status.h"
+#include "base/strutil.h"
+#include "linear_solver/linear_solver.pb.h"
+
+namespace operations_research {
+
+// A buffered output that writes chunks of at most chunk_size bytes to its
+// sink. Exactly one of the sinks is used, depending on the constructor.
+class ChunkedModelOutput {
+ public:
+  static const int kDefaultChunkSize = 1 << 22;
+
+  // Writes to the given File or ostream, which are not owned.
+  explicit ChunkedModelOutput(File* file, int chunk_size = kDefaultChunkSize);
+  explicit ChunkedModelOutput(std::ostream* stream,
+                              int chunk_size = kDefaultChunkSize);
+
+  // Writes to the given gzip file, which is owned and closed by Close().
+  explicit ChunkedModelOutput(gzFile gz_file,
+                              int chunk_size = kDefaultChunkSize);
+
+  ~ChunkedModelOutput() { CHECK(closed_) << "Close() was not called."; }
+
+  void Append(const char* data, int size) {
+    buffer_.append(data, size);
+    if (buffer_.size() >= static_cast<size_t>(chunk_size_)) Flush();
+  }
+  void Append(const std::string& s) { Append(s.data(), s.size()); }
+
+  // Appends the shortest representation of the given value that reads back
+  // to the same double.
+  void AppendDouble(double value);
+
+  // Flushes the buffer and closes the gzip file, if any. Returns false if one
+  // of the writes failed.
+  bool Close();
+
+  int64 num_written_bytes() const { return num_written_bytes_; }
+
+ private:
+  void Flush();
+
+  File* file_;
+  std::ostream* stream_;
+  gzFile gz_file_;
+  const int chunk_size_;
+  std::string buffer_;
+  int64 num_written_bytes_;
+  bool ok_;
+  bool closed_;
+
+  DISALLOW_COPY_AND_ASSIGN(ChunkedModelOutput);
+};
+
+// Writes the model in free MPS format. Returns false on error.
+bool WriteModelAsMps(const MPModelProto& model, bool obfuscated,
+                     ChunkedModelOutput* output);
+
+// Writes the model in the CPLEX LP format. As in the MPModelProtoExporter, a
+// ranged constraint lb <= expr <= ub is written as two constraints. Returns
+// false on error.
+bool WriteModelAsLp(const MPModelProto& model, bool obfuscated,
+                    ChunkedModelOutput* output);
+
+// Writes the model to the given file. The format is given by the suffix of
+// the filename: ".mps" or ".lp", optionally followed by ".gz" for a gzipped
+// output.
+util::Status WriteModelToFile(const MPModelProto& model,
+                              const std::string& filename, bool obfuscated);
+
+// ============================================================================
+// Implementation.
+// ============================================================================
+
+inline ChunkedModelOutput::ChunkedModelOutput(File* file, int chunk_size)
+    : file_(file),
+      stream_(nullptr),
+      gz_file_(nullptr),
+      chunk_size_(chunk_size),
+      num_written_bytes_(0),
+      ok_(true),
+      closed_(false) {
+  buffer_.reserve(chunk_size_ + 1024);
+}
+
+inline ChunkedModelOutput::ChunkedModelOutput(std::ostream* stream,
+                                              int chunk_size)
+    : file_(nullptr),
+      stream_(stream),
+      gz_file_(nullptr),
+      chunk_size_(chunk_size),
+      num_written_bytes_(0),
+      ok_(true),
+      closed_(false) {
+  buffer_.reserve(chunk_size_ + 1024);
+}
+
+inline ChunkedModelOutput::ChunkedModelOutput(gzFile gz_file, int chunk_size)
+    : file_(nullptr),
+      stream_(nullptr),
+      gz_file_(gz_file),
+      chunk_size_(chunk_size),
+      num_written_bytes_(0),
+      ok_(gz_file != nullptr),
+      closed_(false) {
+  buffer_.reserve(chunk_size_ + 1024);
+}
+
+inline void ChunkedModelOutput::AppendDouble(double value) {
+  char buffer[32];
+  int size = snprintf(buffer, sizeof(buffer), "%.15g", value);
+  if (strtod(buffer, nullptr) != value) {
+    size = snprintf(buffer, sizeof(buffer), "%.17g", value);
+  }
+  Append(buffer, size);
+}
+
+inline void ChunkedModelOutput::Flush() {
+  if (buffer_.empty()) return;
+  if (ok_) {
+    if (file_ != nullptr) {
+      ok_ = file_->Write(buffer_.data(), buffer_.size()) == buffer_.size();
+    } else if (stream_ != nullptr) {
+      ok_ = static_cast<bool>(stream_->write(buffer_.data(), buffer_.size()));
+    } else {
+      ok_ = gzwrite(gz_file_, buffer_.data(), buffer_.size()) ==
+            static_cast<int>(buffer_.size());
+    }
+  }
+  num_written_bytes_ += buffer_.size();
+  buffer_.clear();
+}
+
+inline bool ChunkedModelOutput::Close() {
+  Flush();
+  if (gz_file_ != nullptr) {
+    ok_ = (gzclose(gz_file_) == Z_OK) && ok_;
+    gz_file_ = nullptr;
+  }
+  closed_ = true;
+  return ok_;
+}
+
+namespace internal {
+
+// Returns the names to use in the output, see the file comment. The MPS
+// format forbids the spaces, and the LP format also forbids the characters
+// that may be confused with operators.
+template <class ListOfProtosWithNameFields>
+std::vector<std::string> ExportedNames(const ListOfProtosWithNameFields& protos,
+                                       const std::string& prefix,
+                                       bool obfuscate, bool lp_format) {
+  std::vector<std::string> names(protos.size());
+  hash_set<std::string> used_names;
+  const auto is_valid = [lp_format](const std::string& name) {
+    if (name.empty() || name.size() > 255) return false;
+    if (lp_format && (isdigit(name[0]) || name[0] == '.' || name[0] == 'e' ||
+                      name[0] == 'E')) {
+      return false;
+    }
+    for (const char c : name) {
+      if (isspace(c)) return false;
+      if (lp_format && strchr("+-*/^<>=:[]\\", c) != nullptr) return false;
+    }
+    return true;
+  };
+  for (int i = 0; i < protos.size(); ++i) {
+    const std::string& name = protos.Get(i).name();
+    if (!obfuscate && is_valid(name) && used_names.insert(name).second) {
+      names[i] = name;
+    }
+  }
+
+  // The generated names must not collide with the kept ones.
+  for (int i = 0; i < protos.size(); ++i) {
+    if (!names[i].empty()) continue;
+    std::string name = StrCat(prefix, i);
+    while (!used_names.insert(name).second) name += "_";
+    names[i] = name;
+  }
+  return names;
+}
+
+}  // namespace internal
+
+inline bool WriteModelAsMps(const MPModelProto& model, bool obfuscated,
+                            ChunkedModelOutput* output) {
+  const int num_variables = model.variable_size();
+  const int num_constraints = model.constraint_size();
+  const std::vector<std::string> variable_names = internal::ExportedNames(
+      model.variable(), "V", obfuscated, /*lp_format=*/false);
+  const std::vector<std::string> constraint_names = internal::ExportedNames(
+      model.constraint(), "C", obfuscated, /*lp_format=*/false);
+  const double kInfinity = std::numeric_limits<double>::infinity();
+
+  output->Append(StrCat("NAME ", obfuscated ? "" : model.name(), "\n"));
+  if (model.maximize()) output->Append("OBJSENSE\n    MAX\n");
+
+  // ROWS. The objective is named "COST", unless a constraint already has
+  // this name.
+  std::string objective_name = "COST";
+  {
+    const hash_set<std::string> names(constraint_names.begin(),
+                                      constraint_names.end());
+    while (names.count(objective_name) > 0) objective_name += "_";
+  }
+  output->Append(StrCat("ROWS\n N  ", objective_name, "\n"));
+  for (int c = 0; c < num_constraints; ++c) {
+    const MPConstraintProto& constraint = model.constraint(c);
+    const double lb = constraint.lower_bound();
+    const double ub = constraint.upper_bound();
+    const char* type = lb == ub ? " E  " : lb == -kInfinity
+                                               ? (ub == kInfinity ? " N  "
+                                                                  : " L  ")
+                                               : " G  ";
+    output->Append(type);
+    output->Append(constraint_names[c]);
+    output->Append("\n", 1);
+  }
+
+  // COLUMNS. The matrix is transposed with a counting sort.
+  std::vector<int64> starts(num_variables + 1, 0);
+  for (const MPConstraintProto& constraint : model.constraint()) {
+    for (const int var : constraint.var_index()) {
+      if (var < 0 || var >= num_variables) {
+        LOG(ERROR) << "Invalid variable index: " << var;
+        return false;
+      }
+      ++starts[var + 1];
+    }
+  }
+  for (int v = 0; v < num_variables; ++v) starts[v + 1] += starts[v];
+  std::vector<int> transpose_rows(starts[num_variables]);
+  std::vector<double> transpose_values(starts[num_variables]);
+  {
+    std::vector<int64> next(starts.begin(), starts.end() - 1);
+    for (int c = 0; c < num_constraints; ++c) {
+      const MPConstraintProto& constraint = model.constraint(c);
+      for (int i = 0; i < constraint.var_index_size(); ++i) {
+        const int64 position = next[constraint.var_index(i)]++;
+        transpose_rows[position] = c;
+        transpose_values[position] = constraint.coefficient(i);
+      }
+    }
+  }
+  output->Append("COLUMNS\n");
+  bool in_integer_block = false;
+  int marker_index = 0;
+  for (int v = 0; v < num_variables; ++v) {
+    const MPVariableProto& variable = model.variable(v);
+    if (variable.is_integer() != in_integer_block) {
+      in_integer_block = variable.is_integer();
+      output->Append(StrCat("    MARKER_", marker_index++,
+                            "  'MARKER'  ",
+                            in_integer_block ? "'INTORG'\n" : "'INTEND'\n"));
+    }
+    const std::string& name = variable_names[v];
+    if (variable.objective_coefficient() != 0.0) {
+      output->Append("    ", 4);
+      output->Append(name);
+      output->Append("  ", 2);
+      output->Append(objective_name);
+      output->Append("  ", 2);
+      output->AppendDouble(variable.objective_coefficient());
+      output->Append("\n", 1);
+    }
+    for (int64 i = starts[v]; i < starts[v + 1]; ++i) {
+      if (transpose_values[i] == 0.0) continue;
+      output->Append("    ", 4);
+      output->Append(name);
+      output->Append("  ", 2);
+      output->Append(constraint_names[transpose_rows[i]]);
+      output->Append("  ", 2);
+      output->AppendDouble(transpose_values[i]);
+      output->Append("\n", 1);
+    }
+  }
+  if (in_integer_block) {
+    output->Append(
+        StrCat("    MARKER_", marker_index, "  'MARKER'  'INTEND'\n"));
+  }
+
+  // RHS and RANGES. The objective offset is minus the rhs of the objective.
+  output->Append("RHS\n");
+  if (model.objective_offset() != 0.0) {
+    output->Append(StrCat("    RHS  ", objective_name, "  "));
+    output->AppendDouble(-model.objective_offset());
+    output->Append("\n", 1);
+  }
+  std::vector<int> ranged_constraints;
+  for (int c = 0; c < num_constraints; ++c) {
+    const double lb = model.constraint(c).lower_bound();
+    const double ub = model.constraint(c).upper_bound();
+    double rhs = 0.0;
+    if (lb == -kInfinity && ub == kInfinity) continue;
+    if (lb != -kInfinity && ub != kInfinity && lb != ub) {
+      ranged_constraints.push_back(c);
+    }
+    rhs = lb != -kInfinity ? lb : ub;
+    if (rhs == 0.0) continue;
+    output->Append(StrCat("    RHS  ", constraint_names[c], "  "));
+    output->AppendDouble(rhs);
+    output->Append("\n", 1);
+  }
+  if (!ranged_constraints.empty()) {
+    // These are G rows with rhs = lb, so the range is ub - lb.
+    output->Append("RANGES\n");
+    for (const int c : ranged_constraints) {
+      output->Append(StrCat("    RANGE  ", constraint_names[c], "  "));
+      output->AppendDouble(model.constraint(c).upper_bound() -
+                           model.constraint(c).lower_bound());
+      output->Append("\n", 1);
+    }
+  }
+
+  // BOUNDS. The default bounds are [0, +inf).
+  output->Append("BOUNDS\n");
+  const auto append_bound = [output](const char* type,
+                                     const std::string& name, double value,
+                                     bool with_value) {
+    output->Append(type);
+    output->Append(" BOUND  ", 8);
+    output->Append(name);
+    if (with_value) {
+      output->Append("  ", 2);
+      output->AppendDouble(value);
+    }
+    output->Append("\n", 1);
+  };
+  for (int v = 0; v < num_variables; ++v) {
+    const MPVariableProto& variable = model.variable(v);
+    const double lb = variable.lower_bound();
+    const double ub = variable.upper_bound();
+    const std::string& name = variable_names[v];
+    if (lb == ub) {
+      append_bound(" FX", name, lb, true);
+      continue;
+    }
+    if (lb == -kInfinity && ub == kInfinity) {
+      append_bound(" FR", name, 0.0, false);
+      continue;
+    }
+    if (variable.is_integer() && lb == 0.0 && ub == 1.0) {
+      append_bound(" BV", name, 0.0, false);
+      continue;
+    }
+    if (lb == -kInfinity) {
+      append_bound(" MI", name, 0.0, false);
+    } else if (lb != 0.0) {
+      append_bound(" LO", name, lb, true);
+    }
+    if (ub != kInfinity) append_bound(" UP", name, ub, true);
+  }
+  output->Append("ENDATA\n");
+  return true;
+}
+
+inline bool WriteModelAsLp(const MPModelProto& model, bool obfuscated,
+                           ChunkedModelOutput* output) {
+  const int num_variables = model.variable_size();
+  const std::vector<std::string> variable_names = internal::ExportedNames(
+      model.variable(), "V", obfuscated, /*lp_format=*/true);
+  const std::vector<std::string> constraint_names = internal::ExportedNames(
+      model.constraint(), "C", obfuscated, /*lp_format=*/true);
+  const double kInfinity = std::numeric_limits<double>::infinity();
+
+  // Writes one term, and a new line every 10 terms to keep the lines short.
+  int num_terms_on_line = 0;
+  const auto append_term = [output, &variable_names, &num_terms_on_line](
+      double coefficient, int var) {
+    output->Append(coefficient < 0.0 ? " - " : " + ", 3);
+    output->AppendDouble(std::abs(coefficient));
+    output->Append(" ", 1);
+    output->Append(variable_names[var]);
+    if (++num_terms_on_line == 10) {
+      output->Append("\n", 1);
+      num_terms_on_line = 0;
+    }
+  };
+
+  output->Append(StrCat("\\ Generated by the streaming model writer.\n",
+                        "\\ Name: ", obfuscated ? "" : model.name(), "\n"));
+  if (model.objective_offset() != 0.0) {
+    // The LP format has no objective constant, so it is only recorded here.
+    output->Append("\\ Objective offset: ");
+    output->AppendDouble(model.objective_offset());
+    output->Append("\n", 1);
+  }
+  output->Append(model.maximize() ? "Maximize\n Obj:" : "Minimize\n Obj:");
+  for (int v = 0; v < num_variables; ++v) {
+    const double coefficient = model.variable(v).objective_coefficient();
+    if (coefficient != 0.0) append_term(coefficient, v);
+  }
+  output->Append("\nSubject To\n");
+  const auto append_constraint = [&](int c, const std::string& suffix,
+                                     const char* sense, double rhs) {
+    const MPConstraintProto& constraint = model.constraint(c);
+    output->Append(" ", 1);
+    output->Append(constraint_names[c]);
+    output->Append(suffix);
+    output->Append(":", 1);
+    num_terms_on_line = 0;
+    for (int i = 0; i < constraint.var_index_size(); ++i) {
+      const int var = constraint.var_index(i);
+      if (var < 0 || var >= num_variables) return false;
+      append_term(constraint.coefficient(i), var);
+    }
+    output->Append(sense);
+    output->AppendDouble(rhs);
+    output->Append("\n", 1);
+    return true;
+  };
+  for (int c = 0; c < model.constraint_size(); ++c) {
+    const double lb = model.constraint(c).lower_bound();
+    const double ub = model.constraint(c).upper_bound();
+    bool ok = true;
+    if (lb == ub) {
+      ok = append_constraint(c, "", " = ", lb);
+    } else if (lb != -kInfinity && ub != kInfinity) {
+      ok = append_constraint(c, "_lhs", " >= ", lb) &&
+           append_constraint(c, "_rhs", " <= ", ub);
+    } else if (lb != -kInfinity) {
+      ok = append_constraint(c, "", " >= ", lb);
+    } else if (ub != kInfinity) {
+      ok = append_constraint(c, "", " <= ", ub);
+    }
+    if (!ok) {
+      LOG(ERROR) << "Invalid variable index in constraint " << c;
+      return false;
+    }
+  }
+
+  output->Append("Bounds\n");
+  for (int v = 0; v < num_variables; ++v) {
+    const double lb = model.variable(v).lower_bound();
+    const double ub = model.variable(v).upper_bound();
+    const std::string& name = variable_names[v];
+    output->Append(" ", 1);
+    if (lb == -kInfinity && ub == kInfinity) {
+      output->Append(name);
+      output->Append(" free\n");
+      continue;
+    }
+    if (lb == ub) {
+      output->Append(name);
+      output->Append(" = ", 3);
+      output->AppendDouble(lb);
+      output->Append("\n", 1);
+      continue;
+    }
+    if (lb == -kInfinity) {
+      output->Append("-inf");
+    } else {
+      output->AppendDouble(lb);
+    }
+    output->Append(" <= ", 4);
+    output->Append(name);
+    if (ub != kInfinity) {
+      output->Append(" <= ", 4);
+      output->AppendDouble(ub);
+    }
+    output->Append("\n", 1);
+  }
+
+  bool has_integer_variables = false;
+  num_terms_on_line = 0;
+  for (int v = 0; v < num_variables; ++v) {
+    if (!model.variable(v).is_integer()) continue;
+    if (!has_integer_variables) output->Append("Generals\n");
+    has_integer_variables = true;
+    output->Append(" ", 1);
+    output->Append(variable_names[v]);
+    if (++num_terms_on_line == 10) {
+      output->Append("\n", 1);
+      num_terms_on_line = 0;
+    }
+  }
+  if (has_integer_variables) output->Append("\n", 1);
+  output->Append("End\n");
+  return true;
+}
+
+inline util::Status WriteModelToFile(const MPModelProto& model,
+                                     const std::string& filename,
+                                     bool obfuscated) {
+  const bool gzipped = HasSuffixString(filename, ".gz");
+  const std::string base_name =
+      gzipped ? filename.substr(0, filename.size() - 3) : filename;
+  const bool lp_format = HasSuffixString(base_name, ".lp");
+  if (!lp_format && !HasSuffixString(base_name, ".mps")) {
+    return util::Status(util::error::INVALID_ARGUMENT,
+                        StrCat("Unknown model format for '", filename, "'."));
+  }
+
+  File* file = nullptr;
+  std::unique_ptr<ChunkedModelOutput> output;
+  if (gzipped) {
+    const gzFile gz_file = gzopen(filename.c_str(), "wb");
+    if (gz_file == nullptr) {
+      return util::Status(util::error::INTERNAL,
+                          StrCat("Could not open '", filename, "'."));
+    }
+    output.reset(new ChunkedModelOutput(gz_file));
+  } else {
+    file = File::Open(filename, "w");
+    if (file == nullptr) {
+      return util::Status(util::error::INTERNAL,
+                          StrCat("Could not open '", filename, "'."));
+    }
+    output.reset(new ChunkedModelOutput(file));
+  }
+  const bool written = lp_format
+                           ? WriteModelAsLp(model, obfuscated, output.get())
+                           : WriteModelAsMps(model, obfuscated, output.get());
+  const bool closed = output->Close();
+  if (file != nullptr && !file->Close()) {
+    return util::Status(util::error::INTERNAL,
+                        StrCat("Could not close '", filename, "'."));
+  }
+  if (!written || !closed) {
+    return util::Status(util::error::INTERNAL,
+                        StrCat("Error while writing '", filename, "'."));
+  }
+  return util::Status();
+}
+
+}  // namespace operations_research
+
+#endif  // OR_TOOLS_LINEAR_SOLVER_MODEL_STREAM_WRITER_H_
@@ -0,0 +1,654 @@
+// Copyright 2010-2014 Google
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#ifndef OR_TOOLS_LINEAR_SOLVER_PARALLEL_MPS_READER_H_
+#define OR_TOOLS_LINEAR_SOLVER_PARALLEL_MPS_READER_H_
+
+// A reader of free MPS files (optionally gzipped) that fills a SparseMPModel,
+// and from there an MPModelProto or a glop::LinearProgram.
+//
+// The file is memory-mapped (see util/mapped_file.h) and the COLUMNS section,
+// which contains almost all the data of a large model, is cut at line
+// boundaries into one chunk per thread. The chunks are parsed in parallel,
+// and then appended in order to the model with SparseMPModel::AddColumns().
+// The other sections are small and parsed sequentially.
+//
+// The supported format is the free MPS format as written by the
+// MPModelProtoExporter and by the streaming writer of model_stream_writer.h:
+// the fields are separated by spaces, so the names can't contain any. This
+// also covers the fixed MPS files whose names have no spaces, which is the
+// vast majority of them. Free rows other than the objective are ignored, and
+// the integer columns have the default bounds [0, +inf).
+
+#include <algorithm>
+#include <cstdlib>
+#include <cstring>
+#include <limits>
+#include <memory>
+#include <string>
+#include <vector>
+
+#include "base/callback.h"
+#include "base/hash.h"
+#include "base/integral_types.h"
+#include "base/join.h"
+#include "base/logging.h"
+#include "base/macros.h"
+#include "base/status.h"
+#include "base/stringpiece.h"
+#include "base/threadpool.h"
+#include "linear_solver/linear_solver.pb.h"
+#include "linear_solver/sparse_model.h"
+#include "lp_data/lp_data.h"
+#include "util/mapped_file.h"
+
+namespace operations_research {
+
+class ParallelMpsReader {
+ public:
+  ParallelMpsReader();
+
+  // Number of threads used to parse the COLUMNS section. Small sections are
+  // always parsed by the calling thread.
+  void set_num_threads(int num_threads) { num_threads_ = num_threads; }
+
+  // Parses the given file, gzipped if its name ends in ".gz", and appends its
+  // content to the given empty model.
+  util::Status ParseFile(const std::string& filename, SparseMPModel* model);
+
+  // Same as ParseFile() on the given data.
+  util::Status ParseData(const char* data, int64 size, SparseMPModel* model);
+
+  // The name of the problem as given in the NAME section.
+  const std::string& problem_name() const { return problem_name_; }
+
+ private:
+  // Sentinels of the row index for the objective and the ignored free rows.
+  static const int kObjectiveRow = -1;
+  static const int kIgnoredRow = -2;
+
+  // A COLUMNS section chunk, parsed independently of the others. The integer
+  // state of a column is 1 inside an INTORG/INTEND block, 0 outside, and -1
+  // if no marker was seen in the chunk before it (its state is then the one
+  // at the end of the previous chunk).
+  struct ColumnsChunk {
+    const char* begin;
+    const char* end;
+    std::vector<std::string> names;
+    std::vector<int> starts;
+    std::vector<int> rows;
+    std::vector<double> coefficients;
+    std::vector<double> objective_coefficients;
+    std::vector<int8> integer_states;
+    int8 final_integer_state;
+    util::Status status;
+  };
+
+  void Reset();
+
+  // Parses one line of the NAME, ROWS, RHS, RANGES and BOUNDS sections.
+  util::Status ProcessRowLine(const StringPiece* fields, int num_fields);
+  util::Status ProcessRhsOrRangeLine(const StringPiece* fields, int num_fields,
+                                     bool is_range);
+  util::Status ProcessBoundLine(const StringPiece* fields, int num_fields,
+                                SparseMPModel* model);
+
+  // Parses the COLUMNS section [begin, end) and appends it to the model.
+  util::Status ProcessColumnsSection(const char* begin, const char* end,
+                                     SparseMPModel* model);
+  void ParseColumnsChunk(ColumnsChunk* chunk) const;
+
+  // Sets the row bounds from the RHS and RANGES sections.
+  void SetRowBounds(SparseMPModel* model) const;
+
+  int num_threads_;
+  std::string problem_name_;
+  bool has_objective_row_;
+  double objective_offset_;
+  hash_map<std::string, int> row_indices_;
+  std::vector<std::string> row_names_;
+  hash_map<std::string, int> column_indices_;
+  std::vector<char> row_types_;
+  std::vector<double> right_hand_sides_;
+  std::vector<double> ranges_;
+  std::vector<bool> row_has_range_;
+
+  DISALLOW_COPY_AND_ASSIGN(ParallelMpsReader);
+};
+
+// Reads the given MPS file into a proto or a LinearProgram, which are cleared
+// first, using the given number of threads.
+util::Status ReadMpsFileToProto(const std::string& filename, int num_threads,
+                                MPModelProto* model_proto);
+util::Status ReadMpsFileToLinearProgram(const std::string& filename,
+                                        int num_threads,
+                                        glop::LinearProgram* lp);
+
+// ============================================================================
+// Implementation.
+// ============================================================================
+
+namespace internal {
+
+// Returns the next line of [*position, end) without its end of line, and
+// moves *position after it.
+inline StringPiece NextMpsLine(const char** position, const char* end) {
+  const char* const begin = *position;
+  const char* eol =
+      static_cast<const char*>(memchr(begin, '\n', end - begin));
+  if (eol == nullptr) eol = end;
+  *position = eol == end ? end : eol + 1;
+  if (eol > begin && eol[-1] == '\r') --eol;
+  return StringPiece(begin, eol - begin);
+}
+
+// Splits the line into at most max_fields fields separated by blanks, and
+// returns their number, or max_fields + 1 if there are more.
+inline int SplitMpsFields(StringPiece line, StringPiece* fields,
+                          int max_fields) {
+  int num_fields = 0;
+  const char* p = line.data();
+  const char* const end = p + line.size();
+  while (true) {
+    while (p < end && (*p == ' ' || *p == '\t')) ++p;
+    if (p == end) return num_fields;
+    if (num_fields == max_fields) return max_fields + 1;
+    const char* const field_begin = p;
+    while (p < end && *p != ' ' && *p != '\t') ++p;
+    fields[num_fields++] = StringPiece(field_begin, p - field_begin);
+  }
+}
+
+// Parses a number. The field is copied since the mapped data is not null
+// terminated.
+inline bool ParseMpsNumber(StringPiece field, double* value) {
+  char buffer[64];
+  if (field.empty() || field.size() >= static_cast<int>(sizeof(buffer))) {
+    return false;
+  }
+  memcpy(buffer, field.data(), field.size());
+  buffer[field.size()] = '\0';
+  char* number_end;
+  *value = strtod(buffer, &number_end);
+  return number_end == buffer + field.size();
+}
+
+inline bool IsMpsSectionHeader(StringPiece line) {
+  return !line.empty() && line[0] != ' ' && line[0] != '\t' && line[0] != '*';
+}
+
+inline util::Status MpsError(const std::string& message, StringPiece line) {
+  return util::Status(util::error::INVALID_ARGUMENT,
+                      StrCat(message, " Line: '", line.ToString(), "'."));
+}
+
+}  // namespace internal
+
+inline ParallelMpsReader::ParallelMpsReader()
+    : num_threads_(1), has_objective_row_(false), objective_offset_(0.0) {}
+
+inline void ParallelMpsReader::Reset() {
+  problem_name_.clear();
+  has_objective_row_ = false;
+  objective_offset_ = 0.0;
+  row_indices_.clear();
+  row_names_.clear();
+  column_indices_.clear();
+  row_types_.clear();
+  right_hand_sides_.clear();
+  ranges_.clear();
+  row_has_range_.clear();
+}
+
+inline util::Status ParallelMpsReader::ParseFile(const std::string& filename,
+                                                 SparseMPModel* model) {
+  MappedFile file;
+  const util::Status status = file.Open(filename);
+  if (!status.ok()) return status;
+  return ParseData(file.data(), file.size(), model);
+}
+
+inline util::Status ParallelMpsReader::ParseData(const char* data, int64 size,
+                                                 SparseMPModel* model) {
+  CHECK_EQ(0, model->num_columns());
+  CHECK_EQ(0, model->num_rows());
+  Reset();
+  enum Section { NONE, OBJSENSE, ROWS, RHS, RANGES, BOUNDS };
+  Section section = NONE;
+  bool rows_added = false;
+  const char* position = data;
+  const char* const end = data + size;
+  const int kMaxFields = 6;
+  StringPiece fields[kMaxFields];
+  while (position < end) {
+    const StringPiece line = internal::NextMpsLine(&position, end);
+    const int num_fields = internal::SplitMpsFields(line, fields, kMaxFields);
+    if (num_fields == 0 || line[0] == '*') continue;
+    if (num_fields > kMaxFields) {
+      return internal::MpsError("Too many fields.", line);
+    }
+    if (!internal::IsMpsSectionHeader(line)) {
+      util::Status status;
+      switch (section) {
+        case NONE:
+          return internal::MpsError("Data line outside a section.", line);
+        case OBJSENSE:
+          if (fields[0] == "MAX" || fields[0] == "MAXIMIZE") {
+            model->SetMaximization(true);
+          } else if (fields[0] != "MIN" && fields[0] != "MINIMIZE") {
+            return internal::MpsError("Unknown objective sense.", line);
+          }
+          break;
+        case ROWS:
+          status = ProcessRowLine(fields, num_fields);
+          break;
+        case RHS:
+          status = ProcessRhsOrRangeLine(fields, num_fields, false);
+          break;
+        case RANGES:
+          status = ProcessRhsOrRangeLine(fields, num_fields, true);
+          break;
+        case BOUNDS:
+          status = ProcessBoundLine(fields, num_fields, model);
+          break;
+      }
+      if (!status.ok()) return internal::MpsError(status.error_message(), line);
+      continue;
+    }
+
+    // A section header. The rows are created when the ROWS section ends,
+    // which is always before the COLUMNS section.
+    if (section == ROWS && !rows_added) {
+      const int num_rows = row_types_.size();
+      const std::vector<double> zeros(num_rows, 0.0);
+      model->AddRows(num_rows, zeros.data(), zeros.data(), nullptr, nullptr,
+                     nullptr);
+      for (int row = 0; row < num_rows; ++row) {
+        model->SetRowName(row, row_names_[row]);
+      }
+      rows_added = true;
+    }
+    if (fields[0] == "NAME") {
+      section = NONE;
+      if (num_fields > 1) {
+        problem_name_ = StringPiece(fields[1].data(),
+                                    line.data() + line.size() -
+                                        fields[1].data()).ToString();
+      }
+    } else if (fields[0] == "OBJSENSE") {
+      section = OBJSENSE;
+      if (num_fields > 1 && (fields[1] == "MAX" || fields[1] == "MAXIMIZE")) {
+        model->SetMaximization(true);
+      }
+    } else if (fields[0] == "ROWS") {
+      section = ROWS;
+    } else if (fields[0] == "COLUMNS") {
+      if (!rows_added) return internal::MpsError("No ROWS section.", line);
+      // The section ends at the next header line.
+      const char* const columns_begin = position;
+      const char* columns_end = position;
+      while (columns_end < end) {
+        const char* next = columns_end;
+        if (internal::IsMpsSectionHeader(internal::NextMpsLine(&next, end))) {
+          break;
+        }
+        columns_end = next;
+      }
+      const util::Status status =
+          ProcessColumnsSection(columns_begin, columns_end, model);
+      if (!status.ok()) return status;
+      position = columns_end;
+      section = NONE;
+    } else if (fields[0] == "RHS") {
+      section = RHS;
+    } else if (fields[0] == "RANGES") {
+      section = RANGES;
+    } else if (fields[0] == "BOUNDS") {
+      section = BOUNDS;
+    } else if (fields[0] == "ENDATA") {
+      break;
+    } else {
+      return internal::MpsError("Unknown section.", line);
+    }
+  }
+  if (!rows_added) {
+    return util::Status(util::error::INVALID_ARGUMENT, "No ROWS section.");
+  }
+  SetRowBounds(model);
+  return util::Status();
+}
+
+inline util::Status ParallelMpsReader::ProcessRowLine(
+    const StringPiece* fields, int num_fields) {
+  if (num_fields != 2 || fields[0].size() != 1) {
+    return util::Status(util::error::INVALID_ARGUMENT, "Invalid row.");
+  }
+  const char type = fields[0][0];
+  const std::string name = fields[1].ToString();
+  int index;
+  if (type == 'N') {
+    index = has_objective_row_ ? kIgnoredRow : kObjectiveRow;
+    has_objective_row_ = true;
+  } else if (type == 'E' || type == 'L' || type == 'G') {
+    index = row_types_.size();
+    row_types_.push_back(type);
+    row_names_.push_back(name);
+    right_hand_sides_.push_back(0.0);
+    ranges_.push_back(0.0);
+    row_has_range_.push_back(false);
+  } else {
+    return util::Status(util::error::INVALID_ARGUMENT, "Invalid row type.");
+  }
+  if (!row_indices_.insert(std::make_pair(name, index)).second) {
+    return util::Status(util::error::INVALID_ARGUMENT, "Duplicate row name.");
+  }
+  return util::Status();
+}
+
+inline util::Status ParallelMpsReader::ProcessColumnsSection(
+    const char* begin, const char* end, SparseMPModel* model) {
+  // Cuts the section in chunks of at least kMinChunkSize bytes.
+  const int64 kMinChunkSize = 1 << 20;
+  const int num_chunks = static_cast<int>(std::max<int64>(
+      1, std::min<int64>(num_threads_, (end - begin) / kMinChunkSize)));
+  std::vector<ColumnsChunk> chunks(num_chunks);
+  const char* chunk_begin = begin;
+  for (int i = 0; i < num_chunks; ++i) {
+    const char* chunk_end = i + 1 == num_chunks
+                                ? end
+                                : begin + (end - begin) * (i + 1) / num_chunks;
+    if (chunk_end < chunk_begin) chunk_end = chunk_begin;
+    if (chunk_end < end) {
+      const char* eol = static_cast<const char*>(
+          memchr(chunk_end, '\n', end - chunk_end));
+      chunk_end = eol == nullptr ? end : eol + 1;
+    }
+    chunks[i].begin = chunk_begin;
+    chunks[i].end = chunk_end;
+    chunk_begin = chunk_end;
+  }
+  if (num_chunks == 1) {
+    ParseColumnsChunk(&chunks[0]);
+  } else {
+    ThreadPool pool("ParallelMpsReader", num_chunks);
+    pool.StartWorkers();
+    for (ColumnsChunk& chunk : chunks) {
+      pool.Add(NewCallback(this, &ParallelMpsReader::ParseColumnsChunk,
+                           &chunk));
+    }
+  }
+
+  // Merges the chunks in order. A column can be split between two chunks, in
+  // which case it is the last column of the model when the second chunk is
+  // merged.
+  const double kInfinity = std::numeric_limits<double>::infinity();
+  bool in_integer_block = false;
+  std::vector<double> lower_bounds;
+  std::vector<double> upper_bounds;
+  for (ColumnsChunk& chunk : chunks) {
+    if (!chunk.status.ok()) return chunk.status;
+    const int num_local_columns = chunk.names.size();
+    int first = 0;
+    if (num_local_columns > 0 && model->num_columns() > 0) {
+      const int last_column = model->num_columns() - 1;
+      const auto it = column_indices_.find(chunk.names[0]);
+      if (it != column_indices_.end() && it->second == last_column) {
+        for (int k = chunk.starts[0]; k < chunk.starts[1]; ++k) {
+          model->SetCoefficient(chunk.rows[k], last_column,
+                                chunk.coefficients[k]);
+        }
+        if (chunk.objective_coefficients[0] != 0.0) {
+          model->SetObjectiveCoefficient(last_column,
+                                         chunk.objective_coefficients[0]);
+        }
+        first = 1;
+      }
+    }
+    const int num_new_columns = num_local_columns - first;
+    lower_bounds.assign(num_new_columns, 0.0);
+    upper_bounds.assign(num_new_columns, kInfinity);
+    std::unique_ptr<bool[]> is_integer(new bool[num_new_columns + 1]);
+    for (int i = 0; i < num_new_columns; ++i) {
+      const int8 state = chunk.integer_states[first + i];
+      is_integer[i] = state == -1 ? in_integer_block : state == 1;
+    }
+    if (chunk.final_integer_state != -1) {
+      in_integer_block = chunk.final_integer_state == 1;
+    }
+    if (num_new_columns == 0) continue;
+    const int first_column = model->AddColumns(
+        num_new_columns, lower_bounds.data(), upper_bounds.data(),
+        chunk.objective_coefficients.data() + first, is_integer.get(),
+        chunk.starts.data() + first, chunk.rows.data(),
+        chunk.coefficients.data());
+    for (int i = 0; i < num_new_columns; ++i) {
+      const std::string& name = chunk.names[first + i];
+      if (!column_indices_.insert(std::make_pair(name, first_column + i))
+               .second) {
+        return util::Status(
+            util::error::INVALID_ARGUMENT,
+            StrCat("The entries of column '", name, "' are not contiguous."));
+      }
+      model->SetColumnName(first_column + i, name);
+    }
+  }
+  return util::Status();
+}
+
+inline void ParallelMpsReader::ParseColumnsChunk(ColumnsChunk* chunk) const {
+  int8 integer_state = -1;
+  const char* position = chunk->begin;
+  const int kMaxFields = 5;
+  StringPiece fields[kMaxFields];
+  chunk->starts.push_back(0);
+  while (position < chunk->end) {
+    const StringPiece line = internal::NextMpsLine(&position, chunk->end);
+    const int num_fields = internal::SplitMpsFields(line, fields, kMaxFields);
+    if (num_fields == 0 || line[0] == '*') continue;
+    if (num_fields >= 3 && fields[1] == "'MARKER'") {
+      if (fields[2] == "'INTORG'") {
+        integer_state = 1;
+      } else if (fields[2] == "'INTEND'") {
+        integer_state = 0;
+      } else {
+        chunk->status = internal::MpsError("Unknown marker.", line);
+        return;
+      }
+      continue;
+    }
+    if (num_fields != 3 && num_fields != 5) {
+      chunk->status = internal::MpsError("Invalid number of fields.", line);
+      return;
+    }
+    if (chunk->names.empty() || fields[0] != chunk->names.back()) {
+      if (!chunk->names.empty()) chunk->starts.push_back(chunk->rows.size());
+      chunk->names.push_back(fields[0].ToString());
+      chunk->objective_coefficients.push_back(0.0);
+      chunk->integer_states.push_back(integer_state);
+    }
+    for (int i = 1; i < num_fields; i += 2) {
+      const auto it = row_indices_.find(fields[i].ToString());
+      double value;
+      if (it == row_indices_.end()) {
+        chunk->status = internal::MpsError("Unknown row.", line);
+        return;
+      }
+      if (!internal::ParseMpsNumber(fields[i + 1], &value)) {
+        chunk->status = internal::MpsError("Invalid number.", line);
+        return;
+      }
+      if (it->second == kObjectiveRow) {
+        chunk->objective_coefficients.back() = value;
+      } else if (it->second != kIgnoredRow && value != 0.0) {
+        chunk->rows.push_back(it->second);
+        chunk->coefficients.push_back(value);
+      }
+    }
+  }
+  if (!chunk->names.empty()) chunk->starts.push_back(chunk->rows.size());
+  chunk->final_integer_state = integer_state;
+}
+
+inline util::Status ParallelMpsReader::ProcessRhsOrRangeLine(
+    const StringPiece* fields, int num_fields, bool is_range) {
+  // The name of the RHS or RANGES vector is optional.
+  const int first = num_fields % 2 == 0 ? 0 : 1;
+  if (num_fields < 2 || num_fields > 5) {
+    return util::Status(util::error::INVALID_ARGUMENT,
+                        "Invalid number of fields.");
+  }
+  for (int i = first; i < num_fields; i += 2) {
+    const auto it = row_indices_.find(fields[i].ToString());
+    double value;
+    if (it == row_indices_.end()) {
+      return util::Status(util::error::INVALID_ARGUMENT, "Unknown row.");
+    }
+    if (!internal::ParseMpsNumber(fields[i + 1], &value)) {
+      return util::Status(util::error::INVALID_ARGUMENT, "Invalid number.");
+    }
+    const int row = it->second;
+    if (row == kObjectiveRow) {
+      // The right hand side of the objective is minus its offset, as in the
+      // MPModelProtoExporter.
+      if (!is_range) objective_offset_ = -value;
+    } else if (row != kIgnoredRow) {
+      if (is_range) {
+        ranges_[row] = value;
+        row_has_range_[row] = true;
+      } else {
+        right_hand_sides_[row] = value;
+      }
+    }
+  }
+  return util::Status();
+}
+
+inline util::Status ParallelMpsReader::ProcessBoundLine(
+    const StringPiece* fields, int num_fields, SparseMPModel* model) {
+  // The name of the BOUNDS vector is optional, and so is the value of the
+  // FR, MI, PL and BV bounds.
+  if (num_fields < 2 || num_fields > 4) {
+    return util::Status(util::error::INVALID_ARGUMENT,
+                        "Invalid number of fields.");
+  }
+  const StringPiece type = fields[0];
+  const bool has_no_value =
+      type == "FR" || type == "MI" || type == "PL" || type == "BV";
+  const int column_field =
+      has_no_value ? (num_fields >= 3 ? 2 : 1) : (num_fields == 4 ? 2 : 1);
+  if (!has_no_value && column_field + 1 >= num_fields) {
+    return util::Status(util::error::INVALID_ARGUMENT, "Missing bound value.");
+  }
+  const auto it = column_indices_.find(fields[column_field].ToString());
+  if (it == column_indices_.end()) {
+    return util::Status(util::error::INVALID_ARGUMENT, "Unknown column.");
+  }
+  const int column = it->second;
+  double value = 0.0;
+  if (!has_no_value &&
+      !internal::ParseMpsNumber(fields[column_field + 1], &value)) {
+    return util::Status(util::error::INVALID_ARGUMENT, "Invalid number.");
+  }
+  const double kInfinity = std::numeric_limits<double>::infinity();
+  double lb = model->ColumnLowerBound(column);
+  double ub = model->ColumnUpperBound(column);
+  if (type == "UP" || type == "UI") {
+    // A negative upper bound on a column with the default lower bound makes
+    // it unbounded below, as in most MPS readers.
+    if (value < 0.0 && lb == 0.0) lb = -kInfinity;
+    ub = value;
+  } else if (type == "LO" || type == "LI") {
+    lb = value;
+  } else if (type == "FX") {
+    lb = value;
+    ub = value;
+  } else if (type == "FR") {
+    lb = -kInfinity;
+    ub = kInfinity;
+  } else if (type == "MI") {
+    lb = -kInfinity;
+  } else if (type == "PL") {
+    ub = kInfinity;
+  } else if (type == "BV") {
+    lb = 0.0;
+    ub = 1.0;
+  } else {
+    return util::Status(util::error::INVALID_ARGUMENT, "Unknown bound type.");
+  }
+  if (type == "UI" || type == "LI" || type == "BV") {
+    model->SetColumnIntegrality(column, true);
+  }
+  model->SetColumnBounds(column, lb, ub);
+  return util::Status();
+}
+
+inline void ParallelMpsReader::SetRowBounds(SparseMPModel* model) const {
+  const double kInfinity = std::numeric_limits<double>::infinity();
+  model->SetObjectiveOffset(objective_offset_);
+  const int num_rows = row_types_.size();
+  for (int row = 0; row < num_rows; ++row) {
+    const double rhs = right_hand_sides_[row];
+    const double range = ranges_[row];
+    double lb = rhs;
+    double ub = rhs;
+    switch (row_types_[row]) {
+      case 'E':
+        if (row_has_range_[row]) {
+          if (range >= 0.0) {
+            ub = rhs + range;
+          } else {
+            lb = rhs + range;
+          }
+        }
+        break;
+      case 'L':
+        lb = row_has_range_[row] ? rhs - std::abs(range) : -kInfinity;
+        break;
+      case 'G':
+        ub = row_has_range_[row] ? rhs + std::abs(range) : kInfinity;
+        break;
+    }
+    model->SetRowBounds(row, lb, ub);
+  }
+}
+
+inline util::Status ReadMpsFileToProto(const std::string& filename,
+                                       int num_threads,
+                                       MPModelProto* model_proto) {
+  SparseMPModel model;
+  ParallelMpsReader reader;
+  reader.set_num_threads(num_threads);
+  const util::Status status = reader.ParseFile(filename, &model);
+  if (!status.ok()) return status;
+  model_proto->Clear();
+  model.ExportModelToProto(model_proto);
+  model_proto->set_name(reader.problem_name());
+  return util::Status();
+}
+
+inline util::Status ReadMpsFileToLinearProgram(const std::string& filename,
+                                               int num_threads,
+                                               glop::LinearProgram* lp) {
+  SparseMPModel model;
+  ParallelMpsReader reader;
+  reader.set_num_threads(num_threads);
+  const util::Status status = reader.ParseFile(filename, &model);
+  if (!status.ok()) return status;
+  model.ExtractToLinearProgram(lp);
+  lp->SetName(reader.problem_name());
+  return util::Status();
+}
+
+}  // namespace operations_research
+
+#endif  // OR_TOOLS_LINEAR_SOLVER_PARALLEL_MPS_READER_H_
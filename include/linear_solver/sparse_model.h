@@ -0,0 +1,602 @@
+// Copyright 2010-2014 Google
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#ifndef OR_TOOLS_LINEAR_SOLVER_SPARSE_MODEL_H_
+#define OR_TOOLS_LINEAR_SOLVER_SPARSE_MODEL_H_
+
+// A linear (or mixed integer) model stored in flat arrays, for building large
+// models fast. The MPSolver API creates one heap object per variable and per
+// constraint, and stores the coefficients of each constraint in a hash map,
+// which dominates the building time of models with millions of non-zeros.
+//
+// Here the variables and constraints are just indices, their attributes are
+// stored in one vector per attribute, and the non-zeros are appended to
+// coordinate (row, column, value) arrays. They can be added one by one, or in
+// bulk with AddColumns() and AddRows() that take compressed sparse arrays.
+// The hash index needed to read or overwrite a single coefficient is only
+// built on demand.
+//
+// The model can then be given to GLOP directly with ExtractToLinearProgram(),
+// which fills the LinearProgram column by column in a single pass, or to any
+// MPSolver back-end through ExportModelToProto().
+//
+// All the modifications are also recorded in a change journal, so that a
+// LinearProgram (used by GLOP, and by BOP through the IntegralSolver) can be
+// kept up to date with SynchronizeLinearProgram() in time proportional to the
+// size of the changes. Since the LPSolver reuses its basis when only the
+// bounds or the objective changed, a re-solve after a few changes is cheap.
+//
+// Example:
+//   SparseMPModel model;
+//   // Two columns with their objective coefficients and no entries.
+//   const double lb[] = {0.0, 0.0};
+//   const double ub[] = {1.0, 1.0};
+//   const double obj[] = {1.0, 2.0};
+//   model.AddColumns(2, lb, ub, obj, nullptr, nullptr, nullptr, nullptr);
+//   // One row 1 <= x0 + x1 <= 1.
+//   const double row_lb[] = {1.0};
+//   const double row_ub[] = {1.0};
+//   const int starts[] = {0, 2};
+//   const int cols[] = {0, 1};
+//   const double coeffs[] = {1.0, 1.0};
+//   model.AddRows(1, row_lb, row_ub, starts, cols, coeffs);
+
+#include <algorithm>
+#include <string>
+#include <utility>
+#include <vector>
+
+#include "base/hash.h"
+#include "base/integral_types.h"
+#include "base/logging.h"
+#include "glop/lp_solver.h"
+#include "linear_solver/linear_solver.h"
+#include "linear_solver/linear_solver.pb.h"
+#include "lp_data/lp_data.h"
+#include "lp_data/lp_types.h"
+
+namespace operations_research {
+
+class SparseMPModel {
+ public:
+  SparseMPModel()
+      : entry_index_is_valid_(false),
+        maximize_(false),
+        objective_offset_(0.0),
+        is_synchronized_(false),
+        synchronized_num_columns_(0),
+        synchronized_num_rows_(0),
+        synchronized_num_entries_(0) {}
+
+  // Reserves the memory for the given number of columns, rows and non-zeros.
+  void Reserve(int num_columns, int num_rows, int64 num_entries);
+
+  // Adds num_columns new columns and returns the index of the first one. The
+  // i-th new column has the bounds [lower_bounds[i], upper_bounds[i]] and
+  // the objective coefficient objective_coefficients[i]. is_integer can be
+  // nullptr if all the new columns are continuous.
+  //
+  // If starts is not nullptr, the entries of the i-th new column are given in
+  // compressed sparse column format: for k in [starts[i], starts[i + 1]), the
+  // coefficient of the row row_indices[k] is coefficients[k]. The rows must
+  // already exist, and a row can't appear twice in a column.
+  int AddColumns(int num_columns, const double* lower_bounds,
+                 const double* upper_bounds,
+                 const double* objective_coefficients, const bool* is_integer,
+                 const int* starts, const int* row_indices,
+                 const double* coefficients);
+
+  // Same as AddColumns() for rows, with the bounds of the constraints. The
+  // entries are given in compressed sparse row format and can be nullptr. The
+  // columns must already exist.
+  int AddRows(int num_rows, const double* lower_bounds,
+              const double* upper_bounds, const int* starts,
+              const int* column_indices, const double* coefficients);
+
+  // Single element API, similar to MPSolver::MakeNumVar() and
+  // MPSolver::MakeRowConstraint().
+  int AddColumn(double lower_bound, double upper_bound, bool is_integer);
+  int AddRow(double lower_bound, double upper_bound);
+
+  // Sets the coefficient of the given row and column, overwriting any
+  // previous value. This is O(1) and does not build the hash index unless it
+  // already exists, in which case it is kept up to date.
+  void SetCoefficient(int row, int column, double value);
+
+  // Returns the coefficient of the given row and column (0.0 if unset). The
+  // first call builds the hash index of all the entries in O(num_entries).
+  double GetCoefficient(int row, int column) const;
+
+  // Bounds.
+  void SetColumnBounds(int column, double lower_bound, double upper_bound);
+  void SetColumnIntegrality(int column, bool is_integer);
+  void SetRowBounds(int row, double lower_bound, double upper_bound);
+  double ColumnLowerBound(int column) const {
+    return column_lower_bounds_[column];
+  }
+  double ColumnUpperBound(int column) const {
+    return column_upper_bounds_[column];
+  }
+  double RowLowerBound(int row) const { return row_lower_bounds_[row]; }
+  double RowUpperBound(int row) const { return row_upper_bounds_[row]; }
+
+  // Objective.
+  void SetObjectiveCoefficient(int column, double value) {
+    objective_coefficients_[column] = value;
+    MarkColumnAsModified(column);
+  }
+  double ObjectiveCoefficient(int column) const {
+    return objective_coefficients_[column];
+  }
+  void SetObjectiveOffset(double value) { objective_offset_ = value; }
+  void SetMaximization(bool maximize) { maximize_ = maximize; }
+
+  // Names. They are optional and the vectors storing them are only allocated
+  // on the first call.
+  void SetColumnName(int column, const std::string& name);
+  void SetRowName(int row, const std::string& name);
+
+  int num_columns() const { return column_lower_bounds_.size(); }
+  int num_rows() const { return row_lower_bounds_.size(); }
+
+  // Note that this counts an overwritten coefficient twice when the hash
+  // index was not built.
+  int64 num_entries() const { return entry_values_.size(); }
+
+  // Fills the given LinearProgram with this model. The entries are sorted by
+  // column with a counting sort and given to the LinearProgram in its
+  // column-major order, so this is linear in the size of the model.
+  void ExtractToLinearProgram(glop::LinearProgram* lp) const;
+
+  // Exports the model to the format accepted by MPSolver::LoadModelFromProto()
+  // for the other back-ends.
+  void ExportModelToProto(MPModelProto* output_model) const;
+
+  // Brings the given LinearProgram up to date with this model and clears the
+  // change journal. The first call does a full extraction. The next ones must
+  // be given the same LinearProgram, unmodified, and only replay the changes
+  // recorded since the previous call: the new rows and columns, the modified
+  // bounds, integrality and objective coefficients, and the new or
+  // overwritten coefficients.
+  void SynchronizeLinearProgram(glop::LinearProgram* lp);
+
+  // Forgets the change journal, so that the next SynchronizeLinearProgram()
+  // does a full extraction.
+  void ResetSynchronization();
+
+  // Returns the number of recorded changes, i.e. roughly the work of the next
+  // SynchronizeLinearProgram().
+  int64 NumPendingChanges() const;
+
+ private:
+  static int64 EntryKey(int row, int column) {
+    return (static_cast<int64>(row) << 32) | static_cast<uint32>(column);
+  }
+
+  // Builds the hash index of the entries if needed.
+  void BuildIndexIfNeeded() const;
+
+  // Records that the attributes of an already synchronized column (resp.
+  // row) were modified. The new ones are always fully extracted.
+  void MarkColumnAsModified(int column);
+  void MarkRowAsModified(int row);
+
+  // Calls f(row, value) for each non-zero entry of each column, column after
+  // column, with the overwritten entries removed, and f_end(column) after
+  // each column.
+  template <typename EntryFunction, typename ColumnEndFunction>
+  void ForEachEntryByColumn(const EntryFunction& f,
+                            const ColumnEndFunction& f_end) const;
+
+  std::vector<double> column_lower_bounds_;
+  std::vector<double> column_upper_bounds_;
+  std::vector<double> objective_coefficients_;
+  std::vector<bool> column_is_integer_;
+  std::vector<std::string> column_names_;
+
+  std::vector<double> row_lower_bounds_;
+  std::vector<double> row_upper_bounds_;
+  std::vector<std::string> row_names_;
+
+  // The entries in coordinate format, in their insertion order.
+  std::vector<int> entry_rows_;
+  std::vector<int> entry_columns_;
+  std::vector<double> entry_values_;
+
+  // The position in the entry vectors of each (row, column) pair. This is
+  // only built by GetCoefficient(), and is invalidated by the bulk functions.
+  mutable hash_map<int64, int64> entry_index_;
+  mutable bool entry_index_is_valid_;
+
+  bool maximize_;
+  double objective_offset_;
+
+  // The change journal. Everything at or after the synchronized_* indices is
+  // new. The modified vectors only contain indices before them, and the
+  // overwritten entries are positions before synchronized_num_entries_.
+  bool is_synchronized_;
+  int synchronized_num_columns_;
+  int synchronized_num_rows_;
+  int64 synchronized_num_entries_;
+  std::vector<int> modified_columns_;
+  std::vector<bool> column_is_modified_;
+  std::vector<int> modified_rows_;
+  std::vector<bool> row_is_modified_;
+  std::vector<int64> overwritten_entries_;
+
+  DISALLOW_COPY_AND_ASSIGN(SparseMPModel);
+};
+
+// ============================================================================
+// Implementation.
+// ============================================================================
+
+inline void SparseMPModel::Reserve(int num_columns, int num_rows,
+                                   int64 num_entries) {
+  column_lower_bounds_.reserve(num_columns);
+  column_upper_bounds_.reserve(num_columns);
+  objective_coefficients_.reserve(num_columns);
+  column_is_integer_.reserve(num_columns);
+  row_lower_bounds_.reserve(num_rows);
+  row_upper_bounds_.reserve(num_rows);
+  entry_rows_.reserve(num_entries);
+  entry_columns_.reserve(num_entries);
+  entry_values_.reserve(num_entries);
+}
+
+inline int SparseMPModel::AddColumns(
+    int num_columns, const double* lower_bounds, const double* upper_bounds,
+    const double* objective_coefficients, const bool* is_integer,
+    const int* starts, const int* row_indices, const double* coefficients) {
+  const int first_column = this->num_columns();
+  column_lower_bounds_.insert(column_lower_bounds_.end(), lower_bounds,
+                              lower_bounds + num_columns);
+  column_upper_bounds_.insert(column_upper_bounds_.end(), upper_bounds,
+                              upper_bounds + num_columns);
+  objective_coefficients_.insert(objective_coefficients_.end(),
+                                 objective_coefficients,
+                                 objective_coefficients + num_columns);
+  if (is_integer == nullptr) {
+    column_is_integer_.resize(first_column + num_columns, false);
+  } else {
+    column_is_integer_.insert(column_is_integer_.end(), is_integer,
+                              is_integer + num_columns);
+  }
+  if (!column_names_.empty()) column_names_.resize(this->num_columns());
+  if (starts != nullptr) {
+    const int num_new_entries = starts[num_columns] - starts[0];
+    entry_rows_.insert(entry_rows_.end(), row_indices + starts[0],
+                       row_indices + starts[num_columns]);
+    entry_values_.insert(entry_values_.end(), coefficients + starts[0],
+                         coefficients + starts[num_columns]);
+    entry_columns_.reserve(entry_columns_.size() + num_new_entries);
+    for (int i = 0; i < num_columns; ++i) {
+      entry_columns_.insert(entry_columns_.end(), starts[i + 1] - starts[i],
+                            first_column + i);
+    }
+    for (int k = starts[0]; k < starts[num_columns]; ++k) {
+      DCHECK_GE(row_indices[k], 0);
+      DCHECK_LT(row_indices[k], num_rows());
+    }
+    entry_index_is_valid_ = false;
+  }
+  return first_column;
+}
+
+inline int SparseMPModel::AddRows(int num_rows, const double* lower_bounds,
+                                  const double* upper_bounds,
+                                  const int* starts, const int* column_indices,
+                                  const double* coefficients) {
+  const int first_row = this->num_rows();
+  row_lower_bounds_.insert(row_lower_bounds_.end(), lower_bounds,
+                           lower_bounds + num_rows);
+  row_upper_bounds_.insert(row_upper_bounds_.end(), upper_bounds,
+                           upper_bounds + num_rows);
+  if (!row_names_.empty()) row_names_.resize(this->num_rows());
+  if (starts != nullptr) {
+    const int num_new_entries = starts[num_rows] - starts[0];
+    entry_columns_.insert(entry_columns_.end(), column_indices + starts[0],
+                          column_indices + starts[num_rows]);
+    entry_values_.insert(entry_values_.end(), coefficients + starts[0],
+                         coefficients + starts[num_rows]);
+    entry_rows_.reserve(entry_rows_.size() + num_new_entries);
+    for (int i = 0; i < num_rows; ++i) {
+      entry_rows_.insert(entry_rows_.end(), starts[i + 1] - starts[i],
+                         first_row + i);
+    }
+    for (int k = starts[0]; k < starts[num_rows]; ++k) {
+      DCHECK_GE(column_indices[k], 0);
+      DCHECK_LT(column_indices[k], num_columns());
+    }
+    entry_index_is_valid_ = false;
+  }
+  return first_row;
+}
+
+inline int SparseMPModel::AddColumn(double lower_bound, double upper_bound,
+                                    bool is_integer) {
+  column_lower_bounds_.push_back(lower_bound);
+  column_upper_bounds_.push_back(upper_bound);
+  objective_coefficients_.push_back(0.0);
+  column_is_integer_.push_back(is_integer);
+  if (!column_names_.empty()) column_names_.resize(num_columns());
+  return num_columns() - 1;
+}
+
+inline int SparseMPModel::AddRow(double lower_bound, double upper_bound) {
+  row_lower_bounds_.push_back(lower_bound);
+  row_upper_bounds_.push_back(upper_bound);
+  if (!row_names_.empty()) row_names_.resize(num_rows());
+  return num_rows() - 1;
+}
+
+inline void SparseMPModel::SetCoefficient(int row, int column, double value) {
+  DCHECK_GE(row, 0);
+  DCHECK_LT(row, num_rows());
+  DCHECK_GE(column, 0);
+  DCHECK_LT(column, num_columns());
+  if (entry_index_is_valid_) {
+    const auto insertion = entry_index_.insert(
+        std::make_pair(EntryKey(row, column), entry_values_.size()));
+    if (!insertion.second) {
+      const int64 position = insertion.first->second;
+      entry_values_[position] = value;
+      if (is_synchronized_ && position < synchronized_num_entries_) {
+        overwritten_entries_.push_back(position);
+      }
+      return;
+    }
+  }
+
+  // Without the index, the entry is appended and the last one wins.
+  entry_rows_.push_back(row);
+  entry_columns_.push_back(column);
+  entry_values_.push_back(value);
+}
+
+inline void SparseMPModel::BuildIndexIfNeeded() const {
+  if (entry_index_is_valid_) return;
+  entry_index_.clear();
+  for (int64 k = 0; k < entry_values_.size(); ++k) {
+    // The last entry wins (see SetCoefficient()).
+    entry_index_[EntryKey(entry_rows_[k], entry_columns_[k])] = k;
+  }
+  entry_index_is_valid_ = true;
+}
+
+inline double SparseMPModel::GetCoefficient(int row, int column) const {
+  BuildIndexIfNeeded();
+  const auto it = entry_index_.find(EntryKey(row, column));
+  return it == entry_index_.end() ? 0.0 : entry_values_[it->second];
+}
+
+inline void SparseMPModel::SetColumnBounds(int column, double lower_bound,
+                                           double upper_bound) {
+  column_lower_bounds_[column] = lower_bound;
+  column_upper_bounds_[column] = upper_bound;
+  MarkColumnAsModified(column);
+}
+
+inline void SparseMPModel::SetColumnIntegrality(int column, bool is_integer) {
+  column_is_integer_[column] = is_integer;
+  MarkColumnAsModified(column);
+}
+
+inline void SparseMPModel::SetRowBounds(int row, double lower_bound,
+                                        double upper_bound) {
+  row_lower_bounds_[row] = lower_bound;
+  row_upper_bounds_[row] = upper_bound;
+  MarkRowAsModified(row);
+}
+
+inline void SparseMPModel::MarkColumnAsModified(int column) {
+  if (!is_synchronized_ || column >= synchronized_num_columns_) return;
+  if (column_is_modified_[column]) return;
+  column_is_modified_[column] = true;
+  modified_columns_.push_back(column);
+}
+
+inline void SparseMPModel::MarkRowAsModified(int row) {
+  if (!is_synchronized_ || row >= synchronized_num_rows_) return;
+  if (row_is_modified_[row]) return;
+  row_is_modified_[row] = true;
+  modified_rows_.push_back(row);
+}
+
+inline void SparseMPModel::SetColumnName(int column, const std::string& name) {
+  if (column_names_.empty()) column_names_.resize(num_columns());
+  column_names_[column] = name;
+}
+
+inline void SparseMPModel::SetRowName(int row, const std::string& name) {
+  if (row_names_.empty()) row_names_.resize(num_rows());
+  row_names_[row] = name;
+}
+
+template <typename EntryFunction, typename ColumnEndFunction>
+void SparseMPModel::ForEachEntryByColumn(
+    const EntryFunction& f, const ColumnEndFunction& f_end) const {
+  // Counting sort of the entries by column. It is stable, so the overwritten
+  // entries of a column come before the ones that overwrite them.
+  const int num_cols = num_columns();
+  std::vector<int64> starts(num_cols + 1, 0);
+  for (const int column : entry_columns_) ++starts[column + 1];
+  for (int c = 0; c < num_cols; ++c) starts[c + 1] += starts[c];
+  std::vector<int64> sorted(entry_values_.size());
+  {
+    std::vector<int64> next(starts.begin(), starts.end() - 1);
+    for (int64 k = 0; k < entry_values_.size(); ++k) {
+      sorted[next[entry_columns_[k]]++] = k;
+    }
+  }
+
+  // Within a column, only the last entry of each row is kept.
+  std::vector<int64> last_entry_of_row(num_rows(), -1);
+  for (int c = 0; c < num_cols; ++c) {
+    for (int64 i = starts[c]; i < starts[c + 1]; ++i) {
+      last_entry_of_row[entry_rows_[sorted[i]]] = sorted[i];
+    }
+    for (int64 i = starts[c]; i < starts[c + 1]; ++i) {
+      const int64 k = sorted[i];
+      const int row = entry_rows_[k];
+      if (last_entry_of_row[row] != k) continue;
+      if (entry_values_[k] != 0.0) f(row, entry_values_[k]);
+    }
+    f_end(c);
+  }
+}
+
+inline void SparseMPModel::ExtractToLinearProgram(
+    glop::LinearProgram* lp) const {
+  lp->Clear();
+  for (int r = 0; r < num_rows(); ++r) {
+    const glop::RowIndex row = lp->CreateNewConstraint();
+    lp->SetConstraintBounds(row, row_lower_bounds_[r], row_upper_bounds_[r]);
+    if (!row_names_.empty() && !row_names_[r].empty()) {
+      lp->SetConstraintName(row, row_names_[r]);
+    }
+  }
+  for (int c = 0; c < num_columns(); ++c) {
+    const glop::ColIndex col = lp->CreateNewVariable();
+    lp->SetVariableBounds(col, column_lower_bounds_[c],
+                          column_upper_bounds_[c]);
+    lp->SetObjectiveCoefficient(col, objective_coefficients_[c]);
+    lp->SetVariableIntegrality(col, column_is_integer_[c]);
+    if (!column_names_.empty() && !column_names_[c].empty()) {
+      lp->SetVariableName(col, column_names_[c]);
+    }
+  }
+  glop::ColIndex col(0);
+  ForEachEntryByColumn(
+      [lp, &col](int row, double value) {
+        lp->SetCoefficient(glop::RowIndex(row), col, value);
+      },
+      [&col](int c) { col = glop::ColIndex(c + 1); });
+  lp->SetMaximizationProblem(maximize_);
+  lp->SetObjectiveOffset(objective_offset_);
+  lp->CleanUp();
+}
+
+inline void SparseMPModel::SynchronizeLinearProgram(glop::LinearProgram* lp) {
+  if (!is_synchronized_) {
+    ExtractToLinearProgram(lp);
+  } else {
+    DCHECK_EQ(lp->num_variables(), glop::ColIndex(synchronized_num_columns_));
+    DCHECK_EQ(lp->num_constraints(), glop::RowIndex(synchronized_num_rows_));
+    for (int r = synchronized_num_rows_; r < num_rows(); ++r) {
+      const glop::RowIndex row = lp->CreateNewConstraint();
+      if (!row_names_.empty() && !row_names_[r].empty()) {
+        lp->SetConstraintName(row, row_names_[r]);
+      }
+      modified_rows_.push_back(r);
+    }
+    for (int c = synchronized_num_columns_; c < num_columns(); ++c) {
+      const glop::ColIndex col = lp->CreateNewVariable();
+      if (!column_names_.empty() && !column_names_[c].empty()) {
+        lp->SetVariableName(col, column_names_[c]);
+      }
+      modified_columns_.push_back(c);
+    }
+    for (const int r : modified_rows_) {
+      lp->SetConstraintBounds(glop::RowIndex(r), row_lower_bounds_[r],
+                              row_upper_bounds_[r]);
+    }
+    for (const int c : modified_columns_) {
+      const glop::ColIndex col(c);
+      lp->SetVariableBounds(col, column_lower_bounds_[c],
+                            column_upper_bounds_[c]);
+      lp->SetObjectiveCoefficient(col, objective_coefficients_[c]);
+      lp->SetVariableIntegrality(col, column_is_integer_[c]);
+    }
+
+    // The LinearProgram keeps the last value given for an entry, which is
+    // also the semantic of the entry vectors.
+    for (const int64 k : overwritten_entries_) {
+      lp->SetCoefficient(glop::RowIndex(entry_rows_[k]),
+                         glop::ColIndex(entry_columns_[k]), entry_values_[k]);
+    }
+    for (int64 k = synchronized_num_entries_; k < num_entries(); ++k) {
+      lp->SetCoefficient(glop::RowIndex(entry_rows_[k]),
+                         glop::ColIndex(entry_columns_[k]), entry_values_[k]);
+    }
+    lp->SetMaximizationProblem(maximize_);
+    lp->SetObjectiveOffset(objective_offset_);
+    lp->CleanUp();
+  }
+
+  is_synchronized_ = true;
+  synchronized_num_columns_ = num_columns();
+  synchronized_num_rows_ = num_rows();
+  synchronized_num_entries_ = num_entries();
+  modified_columns_.clear();
+  modified_rows_.clear();
+  overwritten_entries_.clear();
+  column_is_modified_.assign(num_columns(), false);
+  row_is_modified_.assign(num_rows(), false);
+}
+
+inline void SparseMPModel::ResetSynchronization() {
+  is_synchronized_ = false;
+  modified_columns_.clear();
+  modified_rows_.clear();
+  overwritten_entries_.clear();
+}
+
+inline int64 SparseMPModel::NumPendingChanges() const {
+  if (!is_synchronized_) return num_columns() + num_rows() + num_entries();
+  return (num_columns() - synchronized_num_columns_) +
+         (num_rows() - synchronized_num_rows_) +
+         (num_entries() - synchronized_num_entries_) +
+         modified_columns_.size() + modified_rows_.size() +
+         overwritten_entries_.size();
+}
+
+inline void SparseMPModel::ExportModelToProto(
+    MPModelProto* output_model) const {
+  output_model->Clear();
+  output_model->set_maximize(maximize_);
+  output_model->set_objective_offset(objective_offset_);
+  for (int c = 0; c < num_columns(); ++c) {
+    MPVariableProto* variable = output_model->add_variable();
+    variable->set_lower_bound(column_lower_bounds_[c]);
+    variable->set_upper_bound(column_upper_bounds_[c]);
+    variable->set_objective_coefficient(objective_coefficients_[c]);
+    variable->set_is_integer(column_is_integer_[c]);
+    if (!column_names_.empty() && !column_names_[c].empty()) {
+      variable->set_name(column_names_[c]);
+    }
+  }
+  for (int r = 0; r < num_rows(); ++r) {
+    MPConstraintProto* constraint = output_model->add_constraint();
+    constraint->set_lower_bound(row_lower_bounds_[r]);
+    constraint->set_upper_bound(row_upper_bounds_[r]);
+    if (!row_names_.empty() && !row_names_[r].empty()) {
+      constraint->set_name(row_names_[r]);
+    }
+  }
+
+  // The proto is row-major, but visiting the entries by column gives them in
+  // increasing column order in each row.
+  int column = 0;
+  ForEachEntryByColumn(
+      [output_model, &column](int row, double value) {
+        MPConstraintProto* constraint = output_model->mutable_constraint(row);
+        constraint->add_var_index(column);
+        constraint->add_coefficient(value);
+      },
+      [&column](int c) { column = c + 1; });
+}
+
+}  // namespace operations_research
+
+#endif  // OR_TOOLS_LINEAR_SOLVER_SPARSE_MODEL_H_
@@ -0,0 +1,521 @@
+// Copyright 2010-2014 Google
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+// A binary implication graph stored in a compressed sparse row (CSR) format.
+//
+// Compared to the BinaryImplicationGraph of clause.h that uses one vector per
+// literal, all the implications are stored contiguously in a single array,
+// which is a lot more cache friendly when binary propagation dominates (like
+// on the 2-SAT heavy encodings). Because the CSR format is static, the new
+// binary clauses are first stored in a small per-literal overflow and merged
+// into the compact array by Rebuild(), which should be called at the level
+// zero simplification points.
+//
+// This class also provides two level-zero simplifications on the graph:
+// - DetectEquivalentLiterals() computes the strongly connected components of
+//   the implication graph. All the literals of a component are equivalent.
+// - TransitiveReduction() removes the implications a => b that are implied by
+//   a longer path from a to b.
+
+#ifndef OR_TOOLS_SAT_COMPACT_IMPLICATION_GRAPH_H_
+#define OR_TOOLS_SAT_COMPACT_IMPLICATION_GRAPH_H_
+
+#include <algorithm>
+#include <utility>
+#include <vector>
+
+#include "base/integral_types.h"
+#include "base/logging.h"
+#include "base/int_type_indexed_vector.h"
+#include "sat/sat_base.h"
+#include "util/bitset.h"
+#include "util/stats.h"
+
+namespace operations_research {
+namespace sat {
+
+// Note that, like the BinaryImplicationGraph, the graph always contains both
+// the implication (not a => b) and its contrapositive (not b => a) for a
+// binary clause (a OR b).
+//
+// It can be used as an extra propagator of a SatSolver, and the binary
+// clauses of an existing BinaryImplicationGraph can be imported with
+// graph.ExtractAllBinaryClauses(&compact_graph).
+class CompactBinaryImplicationGraph : public Propagator {
+ public:
+  CompactBinaryImplicationGraph()
+      : Propagator("CompactBinaryImplicationGraph"),
+        num_overflow_implications_(0),
+        is_dag_(false),
+        num_propagations_(0),
+        num_inspections_(0),
+        num_rebuilds_(0),
+        num_equivalent_literals_(0),
+        num_redundant_implications_(0),
+        stats_("CompactBinaryImplicationGraph") {}
+  ~CompactBinaryImplicationGraph() {
+    IF_STATS_ENABLED({
+      LOG(INFO) << stats_.StatString();
+      LOG(INFO) << "num_rebuilds " << num_rebuilds_;
+      LOG(INFO) << "num_equivalent_literals " << num_equivalent_literals_;
+      LOG(INFO) << "num_redundant_implications " << num_redundant_implications_;
+    });
+  }
+
+  bool Propagate(Trail* trail) final;
+  ClauseRef Reason(const Trail& trail, int trail_index) const final;
+
+  // Resizes the data structure.
+  void Resize(int num_variables);
+
+  // Adds the binary clause (a OR b), which is the same as (not a => b).
+  // Note that it is also equivalent to (not b => a). The implications go to
+  // the overflow until the next Rebuild().
+  void AddBinaryClause(Literal a, Literal b);
+
+  // Same as AddBinaryClause() but enqueues a possible unit propagation.
+  void AddBinaryConflict(Literal a, Literal b, Trail* trail);
+
+  // Merges the overflow into the compact array. The implication lists are
+  // sorted and the duplicates are removed. This is in O(num_implications) and
+  // does not change the propagation semantic, but it must not be called from
+  // inside Propagate().
+  void Rebuild();
+
+  // This must only be called at decision level 0 after all the possible
+  // propagations. It removes all the implications involving an assigned
+  // variable and calls Rebuild().
+  void RemoveFixedVariables(const Trail& trail);
+
+  // Computes the strongly connected components of the implication graph, and
+  // replaces each of them by a representative: all the implications of the
+  // component are moved to its representative, and each other literal l of
+  // the component is only linked to it by l => rep and rep => l. Returns false
+  // if a literal is equivalent to its negation, i.e. the problem is UNSAT.
+  //
+  // The representative of a component is its literal with the smallest
+  // variable index, so RepresentativeOf(not l) is always not
+  // RepresentativeOf(l).
+  bool DetectEquivalentLiterals();
+  Literal RepresentativeOf(Literal l) const {
+    return Literal(representative_[l.Index()]);
+  }
+
+  // Removes the redundant implications a => b such that b can be reached from
+  // another direct implication of a. Because such a reduction is only well
+  // defined on an acyclic graph, this calls DetectEquivalentLiterals() first
+  // if needed and returns false if the problem was found UNSAT. The work (in
+  // number of inspected arcs) is bounded by the given limit, in which case the
+  // reduction is only partial.
+  bool TransitiveReduction(int64 work_limit);
+
+  // Number of literal propagated by this class (including conflicts).
+  int64 num_propagations() const { return num_propagations_; }
+
+  // Number of literals inspected by this class during propagation.
+  int64 num_inspections() const { return num_inspections_; }
+
+  // Number of literals that are not the representative of their component.
+  int64 num_equivalent_literals() const { return num_equivalent_literals_; }
+
+  // Number of implications removed by transitive reduction.
+  int64 num_redundant_implications() const {
+    return num_redundant_implications_;
+  }
+
+  // Returns the number of current implications, including the overflow.
+  int64 NumberOfImplications() const {
+    return implied_.size() + num_overflow_implications_;
+  }
+
+  // Extract all the binary clauses managed by this class. The Output type must
+  // support an AddBinaryClause(Literal a, Literal b) function.
+  template <typename Output>
+  void ExtractAllBinaryClauses(Output* out) const {
+    for (LiteralIndex i(0); i < overflow_.size(); ++i) {
+      const Literal a = Literal(i).Negated();
+      for (int p = starts_[i.value()]; p < starts_[i.value() + 1]; ++p) {
+        if (a < implied_[p]) out->AddBinaryClause(a, implied_[p]);
+      }
+      for (const Literal b : overflow_[i]) {
+        if (a < b) out->AddBinaryClause(a, b);
+      }
+    }
+  }
+
+ private:
+  // The propagation checks the implied literals by batches of this size: a
+  // batch whose literals are all already true (the common case) is skipped by
+  // a branch-free loop that the compiler can vectorize.
+  static const int kBatchSize = 8;
+
+  // Propagates all the direct implications of the given literal becoming true.
+  // Returns false if a conflict was encountered, in which case
+  // trail->MutableConflict() will be filled with the correct size 2 clause.
+  bool PropagateOnTrue(Literal true_literal, Trail* trail);
+  bool PropagateRange(Literal true_literal, const Literal* begin,
+                      const Literal* end, Trail* trail);
+
+  // Removes all the implications of the compact array for which
+  // keep(from, position) is false, where position is an index in implied_.
+  // The overflow must be empty.
+  template <typename Predicate>
+  void FilterImplications(const Predicate& keep);
+
+  // The compact array: the literals implied by the literal of index i are in
+  // implied_[starts_[i], starts_[i + 1]).
+  std::vector<int> starts_;
+  std::vector<Literal> implied_;
+
+  // The implications added since the last Rebuild().
+  ITIVector<LiteralIndex, std::vector<Literal>> overflow_;
+  int64 num_overflow_implications_;
+
+  // Binary reasons by trail_index.
+  std::vector<Literal> reasons_;
+
+  // Computed by DetectEquivalentLiterals(). is_dag_ is true if no implication
+  // was added since, in which case the graph restricted to the representatives
+  // is acyclic.
+  ITIVector<LiteralIndex, LiteralIndex> representative_;
+  bool is_dag_;
+
+  // Some stats.
+  int64 num_propagations_;
+  int64 num_inspections_;
+  int64 num_rebuilds_;
+  int64 num_equivalent_literals_;
+  int64 num_redundant_implications_;
+
+  // Temporary data used by the level zero algorithms.
+  std::vector<Literal> tmp_literals_;
+  std::vector<std::pair<int, int>> dfs_stack_;
+  SparseBitset<LiteralIndex> is_marked_;
+
+  mutable StatsGroup stats_;
+  DISALLOW_COPY_AND_ASSIGN(CompactBinaryImplicationGraph);
+};
+
+// ============================================================================
+// Implementation.
+// ============================================================================
+
+inline void CompactBinaryImplicationGraph::Resize(int num_variables) {
+  SCOPED_TIME_STAT(&stats_);
+  const int old_num_literals = overflow_.size();
+  const int num_literals = 2 * num_variables;
+  overflow_.resize(num_literals);
+  if (starts_.empty()) starts_.push_back(0);
+  starts_.resize(num_literals + 1, starts_.back());
+  representative_.resize(num_literals);
+  for (int i = old_num_literals; i < num_literals; ++i) {
+    representative_[LiteralIndex(i)] = LiteralIndex(i);
+  }
+  reasons_.resize(num_variables);
+  is_marked_.ClearAndResize(LiteralIndex(num_literals));
+}
+
+inline void CompactBinaryImplicationGraph::AddBinaryClause(Literal a,
+                                                           Literal b) {
+  SCOPED_TIME_STAT(&stats_);
+  overflow_[a.NegatedIndex()].push_back(b);
+  overflow_[b.NegatedIndex()].push_back(a);
+  num_overflow_implications_ += 2;
+  is_dag_ = false;
+}
+
+inline void CompactBinaryImplicationGraph::AddBinaryConflict(Literal a,
+                                                             Literal b,
+                                                             Trail* trail) {
+  SCOPED_TIME_STAT(&stats_);
+  AddBinaryClause(a, b);
+  const VariablesAssignment& assignment = trail->Assignment();
+  if (assignment.LiteralIsFalse(a) && !assignment.IsLiteralAssigned(b)) {
+    reasons_[trail->Index()] = a;
+    trail->Enqueue(b, propagator_id_);
+  } else if (assignment.LiteralIsFalse(b) &&
+             !assignment.IsLiteralAssigned(a)) {
+    reasons_[trail->Index()] = b;
+    trail->Enqueue(a, propagator_id_);
+  }
+}
+
+inline bool CompactBinaryImplicationGraph::Propagate(Trail* trail) {
+  if (NumberOfImplications() == 0) {
+    propagation_trail_index_ = trail->Index();
+    return true;
+  }
+  while (propagation_trail_index_ < trail->Index()) {
+    const Literal literal = (*trail)[propagation_trail_index_++];
+    if (!PropagateOnTrue(literal, trail)) return false;
+  }
+  return true;
+}
+
+inline bool CompactBinaryImplicationGraph::PropagateOnTrue(
+    Literal true_literal, Trail* trail) {
+  SCOPED_TIME_STAT(&stats_);
+  const VariablesAssignment& assignment = trail->Assignment();
+  const int index = true_literal.Index().value();
+  const Literal* begin = implied_.data() + starts_[index];
+  const Literal* const end = implied_.data() + starts_[index + 1];
+  num_inspections_ += end - begin;
+  for (; end - begin >= kBatchSize; begin += kBatchSize) {
+    int num_true = 0;
+    for (int i = 0; i < kBatchSize; ++i) {
+      num_true += assignment.LiteralIsTrue(begin[i]);
+    }
+    if (num_true == kBatchSize) continue;
+    if (!PropagateRange(true_literal, begin, begin + kBatchSize, trail)) {
+      return false;
+    }
+  }
+  if (!PropagateRange(true_literal, begin, end, trail)) return false;
+
+  const std::vector<Literal>& overflow = overflow_[true_literal.Index()];
+  if (overflow.empty()) return true;
+  num_inspections_ += overflow.size();
+  return PropagateRange(true_literal, overflow.data(),
+                        overflow.data() + overflow.size(), trail);
+}
+
+inline bool CompactBinaryImplicationGraph::PropagateRange(
+    Literal true_literal, const Literal* begin, const Literal* end,
+    Trail* trail) {
+  const VariablesAssignment& assignment = trail->Assignment();
+  for (const Literal* it = begin; it < end; ++it) {
+    const Literal literal = *it;
+    if (assignment.LiteralIsTrue(literal)) continue;
+    ++num_propagations_;
+    if (assignment.LiteralIsFalse(literal)) {
+      // Conflict.
+      *(trail->MutableConflict()) = {true_literal.Negated(), literal};
+      return false;
+    }
+    reasons_[trail->Index()] = true_literal.Negated();
+    trail->Enqueue(literal, propagator_id_);
+  }
+  return true;
+}
+
+inline ClauseRef CompactBinaryImplicationGraph::Reason(const Trail& trail,
+                                                       int trail_index) const {
+  return ClauseRef(&reasons_[trail_index], &reasons_[trail_index] + 1);
+}
+
+inline void CompactBinaryImplicationGraph::Rebuild() {
+  SCOPED_TIME_STAT(&stats_);
+  ++num_rebuilds_;
+  const int num_literals = overflow_.size();
+  std::vector<int> new_starts(num_literals + 1, 0);
+  std::vector<Literal> new_implied;
+  new_implied.reserve(NumberOfImplications());
+  for (int i = 0; i < num_literals; ++i) {
+    std::vector<Literal>& overflow = overflow_[LiteralIndex(i)];
+    tmp_literals_.assign(implied_.begin() + starts_[i],
+                         implied_.begin() + starts_[i + 1]);
+    tmp_literals_.insert(tmp_literals_.end(), overflow.begin(),
+                         overflow.end());
+    std::sort(tmp_literals_.begin(), tmp_literals_.end());
+    tmp_literals_.erase(std::unique(tmp_literals_.begin(), tmp_literals_.end()),
+                        tmp_literals_.end());
+    for (const Literal l : tmp_literals_) {
+      if (l.Index() != LiteralIndex(i)) new_implied.push_back(l);
+    }
+    new_starts[i + 1] = new_implied.size();
+
+    // Free the memory, the overflow is supposed to stay small.
+    std::vector<Literal>().swap(overflow);
+  }
+  num_overflow_implications_ = 0;
+  starts_.swap(new_starts);
+  implied_.swap(new_implied);
+}
+
+template <typename Predicate>
+void CompactBinaryImplicationGraph::FilterImplications(const Predicate& keep) {
+  DCHECK_EQ(0, num_overflow_implications_);
+  int new_size = 0;
+  int start = 0;
+  for (int i = 0; i + 1 < starts_.size(); ++i) {
+    const int end = starts_[i + 1];
+    for (int p = start; p < end; ++p) {
+      if (keep(LiteralIndex(i), p)) implied_[new_size++] = implied_[p];
+    }
+    start = end;
+    starts_[i + 1] = new_size;
+  }
+  implied_.resize(new_size);
+  implied_.shrink_to_fit();
+}
+
+inline void CompactBinaryImplicationGraph::RemoveFixedVariables(
+    const Trail& trail) {
+  SCOPED_TIME_STAT(&stats_);
+  CHECK_EQ(trail.CurrentDecisionLevel(), 0);
+  Rebuild();
+
+  // If a literal is true, its implications were already propagated and it
+  // cannot appear in a conflict. If it is false, it will never propagate
+  // anything. If an implied literal is false, its antecedent is false too.
+  const VariablesAssignment& assignment = trail.Assignment();
+  FilterImplications([this, &assignment](LiteralIndex from, int position) {
+    return !assignment.VariableIsAssigned(Literal(from).Variable()) &&
+           !assignment.VariableIsAssigned(implied_[position].Variable());
+  });
+}
+
+inline bool CompactBinaryImplicationGraph::DetectEquivalentLiterals() {
+  SCOPED_TIME_STAT(&stats_);
+  Rebuild();
+  const int num_literals = overflow_.size();
+
+  // Iterative Tarjan algorithm. dfs_stack_ contains (literal, position in its
+  // implication list) pairs.
+  const int kUnvisited = -1;
+  std::vector<int> index(num_literals, kUnvisited);
+  std::vector<int> lowlink(num_literals, 0);
+  std::vector<bool> on_stack(num_literals, false);
+  std::vector<int> scc_stack;
+  int next_index = 0;
+  bool is_unsat = false;
+  num_equivalent_literals_ = 0;
+  for (int root = 0; root < num_literals; ++root) {
+    if (index[root] != kUnvisited) continue;
+    dfs_stack_.clear();
+    dfs_stack_.push_back(std::make_pair(root, starts_[root]));
+    index[root] = lowlink[root] = next_index++;
+    scc_stack.push_back(root);
+    on_stack[root] = true;
+    while (!dfs_stack_.empty()) {
+      const int node = dfs_stack_.back().first;
+      int& position = dfs_stack_.back().second;
+      if (position < starts_[node + 1]) {
+        const int head = implied_[position++].Index().value();
+        if (index[head] == kUnvisited) {
+          index[head] = lowlink[head] = next_index++;
+          scc_stack.push_back(head);
+          on_stack[head] = true;
+          dfs_stack_.push_back(std::make_pair(head, starts_[head]));
+        } else if (on_stack[head]) {
+          lowlink[node] = std::min(lowlink[node], index[head]);
+        }
+        continue;
+      }
+      dfs_stack_.pop_back();
+      if (!dfs_stack_.empty()) {
+        const int parent = dfs_stack_.back().first;
+        lowlink[parent] = std::min(lowlink[parent], lowlink[node]);
+      }
+      if (lowlink[node] != index[node]) continue;
+
+      // node is the root of a component: pop it and choose as representative
+      // the literal with the smallest variable.
+      const int scc_begin =
+          std::find(scc_stack.rbegin(), scc_stack.rend(), node).base() -
+          scc_stack.begin() - 1;
+      Literal rep = Literal(LiteralIndex(node));
+      for (int k = scc_begin; k < scc_stack.size(); ++k) {
+        const Literal l(LiteralIndex(scc_stack[k]));
+        if (l.Variable() < rep.Variable()) rep = l;
+      }
+      for (int k = scc_begin; k < scc_stack.size(); ++k) {
+        const LiteralIndex l(scc_stack[k]);
+        on_stack[l.value()] = false;
+        if (Literal(l).Variable() == rep.Variable() && l != rep.Index()) {
+          is_unsat = true;
+        }
+        representative_[l] = rep.Index();
+        if (l != rep.Index()) ++num_equivalent_literals_;
+      }
+      scc_stack.resize(scc_begin);
+    }
+  }
+  if (is_unsat) return false;
+
+  // Rebuild the graph on the representatives.
+  for (int i = 0; i < num_literals; ++i) {
+    const LiteralIndex from(i);
+    const LiteralIndex rep = representative_[from];
+    if (rep != from) {
+      overflow_[from].push_back(Literal(rep));
+      overflow_[rep].push_back(Literal(from));
+      num_overflow_implications_ += 2;
+    }
+    for (int p = starts_[i]; p < starts_[i + 1]; ++p) {
+      const LiteralIndex to = representative_[implied_[p].Index()];
+      if (to == rep) continue;
+      overflow_[rep].push_back(Literal(to));
+      ++num_overflow_implications_;
+    }
+  }
+  implied_.clear();
+  starts_.assign(num_literals + 1, 0);
+  Rebuild();
+  is_dag_ = true;
+  return true;
+}
+
+inline bool CompactBinaryImplicationGraph::TransitiveReduction(
+    int64 work_limit) {
+  if (!is_dag_ && !DetectEquivalentLiterals()) return false;
+  SCOPED_TIME_STAT(&stats_);
+
+  // Only the implications between representatives are considered, the other
+  // ones are the equivalence links l => rep and rep => l that must be kept.
+  std::vector<bool> is_redundant(implied_.size(), false);
+  std::vector<int> to_visit;
+  int64 work_done = 0;
+  const int num_literals = overflow_.size();
+  for (int i = 0; i < num_literals && work_done < work_limit; ++i) {
+    const LiteralIndex from(i);
+    if (representative_[from] != from) continue;
+    if (starts_[i + 1] - starts_[i] < 2) continue;
+
+    // Marks all the literals reachable from a direct implication of from by a
+    // path of at least one arc. Such direct implications are redundant.
+    is_marked_.SparseClearAll();
+    for (int p = starts_[i]; p < starts_[i + 1]; ++p) {
+      const LiteralIndex start = implied_[p].Index();
+      if (representative_[start] != start || is_marked_[start]) continue;
+      to_visit.assign(1, start.value());
+      while (!to_visit.empty() && work_done < work_limit) {
+        const int node = to_visit.back();
+        to_visit.pop_back();
+        for (int q = starts_[node]; q < starts_[node + 1]; ++q) {
+          ++work_done;
+          const LiteralIndex head = implied_[q].Index();
+          if (representative_[head] != head || is_marked_[head]) continue;
+          is_marked_.Set(head);
+          to_visit.push_back(head.value());
+        }
+      }
+    }
+    if (work_done >= work_limit) break;
+    for (int p = starts_[i]; p < starts_[i + 1]; ++p) {
+      if (is_marked_[implied_[p].Index()]) {
+        is_redundant[p] = true;
+        ++num_redundant_implications_;
+      }
+    }
+  }
+  FilterImplications([&is_redundant](LiteralIndex from, int position) {
+    return !is_redundant[position];
+  });
+  return true;
+}
+
+}  // namespace sat
+}  // namespace operations_research
+
+#endif  // OR_TOOLS_SAT_COMPACT_IMPLICATION_GRAPH_H_
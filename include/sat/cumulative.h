@@ -0,0 +1,764 @@
+// Copyright 2010-2014 Google
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#ifndef OR_TOOLS_SAT_CUMULATIVE_H_
+#define OR_TOOLS_SAT_CUMULATIVE_H_
+
+#include <algorithm>
+#include <limits>
+#include <vector>
+
+#include "sat/integer.h"
+#include "sat/intervals.h"
+#include "sat/model.h"
+#include "sat/sat_base.h"
+#include "util/stats.h"
+
+namespace operations_research {
+namespace sat {
+
+// Enforces that at any time, the sum of the demands of the present intervals
+// overlapping this time is lower or equal to the (upper bound of the) given
+// capacity. The demands must be non-negative.
+inline std::function<void(Model*)> Cumulative(
+    const std::vector<IntervalVariable>& vars,
+    const std::vector<IntegerVariable>& demands, IntegerVariable capacity);
+
+// The Theta-Lambda tree of Petr Vilim "Edge Finding Filtering Algorithm for
+// Discrete Cumulative Resources in O(kn log n)" (CP 2009). The leaves are the
+// tasks sorted by increasing min-start, and each leaf holds an energy and an
+// envelope "base" (capacity * min-start in the classical version). A leaf can
+// be in Theta (always counted), in Lambda (at most one such leaf counted in
+// the "optional" quantities) or empty.
+//
+// All the operations are in O(log(n)).
+class CumulativeThetaLambdaTree {
+ public:
+  CumulativeThetaLambdaTree() : first_leaf_(1) {}
+
+  // Resets the tree to num_leaves empty leaves.
+  void Reset(int num_leaves);
+
+  // Leaf modifications. The energy of a Lambda leaf must be positive.
+  void AddOrUpdateTheta(int leaf, int64 base, int64 energy);
+  void AddOrUpdateLambda(int leaf, int64 base, int64 energy);
+  void RemoveLeaf(int leaf);
+
+  // Returns max over the Theta leaves l of (base(l) + sum of the energies of
+  // the Theta leaves >= l). The optional version allows one Lambda leaf to
+  // contribute to the sum (or to be the leaf l itself).
+  int64 Envelope() const { return nodes_[1].envelope; }
+  int64 OptionalEnvelope() const { return nodes_[1].envelope_opt; }
+
+  // Returns the leaf l achieving Envelope().
+  int LeafStartingEnvelope() const;
+
+  // Returns the leaf l achieving OptionalEnvelope() and the Lambda leaf that
+  // contributes to it. This must only be called if OptionalEnvelope() is
+  // strictly greater than Envelope().
+  void LeavesOfOptionalEnvelope(int* start_leaf, int* lambda_leaf) const;
+
+ private:
+  struct Node {
+    int64 energy;
+    int64 envelope;
+    int64 energy_opt;
+    int64 envelope_opt;
+  };
+
+  // Large enough so that adding a few energies to it never overflows.
+  static const int64 kMinusInfinity = kint64min / 4;
+
+  void SetLeafAndUpdateParents(int leaf, const Node& node);
+  int DescendToLambdaLeafOfOptionalEnergy(int node) const;
+  int DescendToLeafStartingEnvelope(int node) const;
+
+  int first_leaf_;
+  std::vector<Node> nodes_;
+};
+
+// This class contains the propagation algorithms with explanation for a
+// cumulative constraint:
+// - The time-tabling rule, which pushes each task after the parts of the
+//   resource profile (built from the compulsory parts of the other tasks) that
+//   leave not enough capacity for it.
+// - The timetable edge-finding rule of Vilim "Timetable Edge Finding Filtering
+//   Algorithm for Discrete Cumulative Resources" (CPAIOR 2011), where the
+//   energy of a task interval is the free energy of its tasks plus the energy
+//   of the profile in the same window. The overload checking and the detection
+//   of the tasks that must end after a set of tasks are done in O(n log(n))
+//   with a CumulativeThetaLambdaTree. The bound adjustment of a detected task
+//   uses the classical edge-finding update and is linear in the number of
+//   tasks.
+//
+// Only the tasks known to be present are considered, and only the min demands
+// and the max capacity are used.
+class CumulativeConstraint : public PropagatorInterface {
+ public:
+  CumulativeConstraint(const std::vector<IntervalVariable>& vars,
+                       const std::vector<IntegerVariable>& demands,
+                       IntegerVariable capacity, IntegerTrail* integer_trail,
+                       IntervalsRepository* intervals);
+
+  ~CumulativeConstraint() final {
+    IF_STATS_ENABLED(LOG(INFO) << stats_.StatString());
+  }
+
+  bool Propagate(Trail* trail) final;
+
+  // Registers this constraint with the GenericLiteralWatcher.
+  void RegisterWith(GenericLiteralWatcher* watcher);
+
+ private:
+  // A rectangle of the resource profile. It starts at the given time and ends
+  // at the start of the next rectangle in profile_.
+  struct ProfileRectangle {
+    int start;
+    int height;
+    bool operator<(const ProfileRectangle& other) const {
+      return start < other.start;
+    }
+  };
+
+  // Reverses the time, see DisjunctiveConstraint::SwitchToMirrorProblem().
+  void SwitchToMirrorProblem() {
+    std::swap(start_vars_, minus_end_vars_);
+  }
+
+  // Helpers for the current bounds of a task.
+  int MinDuration(int t) const {
+    return duration_vars_[t] == kNoLbVar
+               ? fixed_durations_[t]
+               : integer_trail_->Value(duration_vars_[t]);
+  }
+  int MinDemand(int t) const { return integer_trail_->LowerBound(demands_[t]); }
+  int MinStart(int t) const { return integer_trail_->Value(start_vars_[t]); }
+  int MaxEnd(int t) const { return -integer_trail_->Value(minus_end_vars_[t]); }
+  int MaxStart(int t) const { return MaxEnd(t) - MinDuration(t); }
+  int MinEnd(int t) const { return MinStart(t) + MinDuration(t); }
+  int Capacity() const { return integer_trail_->UpperBound(capacity_); }
+
+  // Returns the energy of t that is not in its compulsory part.
+  int64 FreeEnergy(int t) const {
+    const int compulsory = std::max(0, MinEnd(t) - MaxStart(t));
+    return static_cast<int64>(MinDemand(t)) * (MinDuration(t) - compulsory);
+  }
+
+  // Fills tasks_ with the tasks that need to be considered by the passes.
+  void FillPresentTasks(const Trail& trail);
+
+  // Builds profile_ and profile_energy_ from the compulsory parts of tasks_.
+  void BuildProfile();
+
+  // Returns the energy of the profile in (-infinity, time).
+  int64 ProfileEnergyBefore(int time) const;
+
+  // Helper functions to compute the reason of a propagation.
+  // Append to literal_reason_ and integer_reason_ the corresponding reason.
+  void AddPresenceDurationAndDemandReason(int t);
+  void AddMinStartReason(int t, int lower_bound);
+  void AddMaxEndReason(int t, int upper_bound);
+  void AddCapacityReason();
+
+  // Reason for t to be executed inside [window_start, window_end].
+  void AddWindowReason(int t, int window_start, int window_end);
+
+  // Reason for the compulsory part of t to contain the given time.
+  void AddCompulsoryPartReason(int t, int time);
+
+  // Reason for the profile energy inside [window_start, window_end).
+  void AddProfileReason(int window_start, int window_end);
+
+  // Reports a conflict with the current reason. Always returns false.
+  bool ReportConflict(Trail* trail);
+
+  // Checks that the interval [min_start_t, max_end_t] is larger than
+  // min_duration_t. Returns false and report an conflict otherwise.
+  bool CheckIntervalForConflict(int t, Trail* trail);
+
+  // The two propagation passes. They only push the min-start of the tasks and
+  // must be called a second time on the mirror problem.
+  bool TimeTablingPass(Trail* trail);
+  bool TimeTableEdgeFindingPass(Trail* trail);
+
+  // The task data. The index is local to this constraint.
+  std::vector<LbVar> start_vars_;
+  std::vector<LbVar> minus_end_vars_;
+  std::vector<LbVar> duration_vars_;
+  std::vector<int> fixed_durations_;
+  std::vector<IntegerVariable> demands_;
+  std::vector<LiteralIndex> presence_literals_;
+  const IntegerVariable capacity_;
+
+  // Tasks considered by the current pass. See FillPresentTasks().
+  std::vector<int> tasks_;
+
+  // The current profile. It always starts with a sentinel rectangle of height
+  // zero at kint32min and ends with one of height zero. profile_energy_[i] is
+  // the profile energy before profile_[i].start.
+  std::vector<ProfileRectangle> profile_;
+  std::vector<int64> profile_energy_;
+
+  // Data used by TimeTableEdgeFindingPass().
+  CumulativeThetaLambdaTree tree_;
+  std::vector<int> task_by_increasing_min_start_;
+  std::vector<int> task_by_decreasing_max_end_;
+  std::vector<int> leaf_of_task_;
+  std::vector<bool> leaf_is_in_theta_;
+
+  // Reason vectors. Declared here to avoid costly initialization.
+  std::vector<Literal> literal_reason_;
+  std::vector<IntegerLiteral> integer_reason_;
+
+  IntegerTrail* integer_trail_;
+  IntervalsRepository* intervals_;
+  const std::vector<IntervalVariable> vars_;
+
+  mutable StatsGroup stats_;
+
+  DISALLOW_COPY_AND_ASSIGN(CumulativeConstraint);
+};
+
+// ============================================================================
+// Implementation.
+// ============================================================================
+
+inline std::function<void(Model*)> Cumulative(
+    const std::vector<IntervalVariable>& vars,
+    const std::vector<IntegerVariable>& demands, IntegerVariable capacity) {
+  return [=](Model* model) {
+    CumulativeConstraint* constraint = new CumulativeConstraint(
+        vars, demands, capacity, model->GetOrCreate<IntegerTrail>(),
+        model->GetOrCreate<IntervalsRepository>());
+    constraint->RegisterWith(model->GetOrCreate<GenericLiteralWatcher>());
+    model->TakeOwnership(constraint);
+  };
+}
+
+inline void CumulativeThetaLambdaTree::Reset(int num_leaves) {
+  first_leaf_ = 1;
+  while (first_leaf_ < num_leaves) first_leaf_ *= 2;
+  const Node empty = {0, kMinusInfinity, 0, kMinusInfinity};
+  nodes_.assign(2 * first_leaf_, empty);
+}
+
+inline void CumulativeThetaLambdaTree::AddOrUpdateTheta(int leaf, int64 base,
+                                                        int64 energy) {
+  const Node node = {energy, base + energy, energy, base + energy};
+  SetLeafAndUpdateParents(leaf, node);
+}
+
+inline void CumulativeThetaLambdaTree::AddOrUpdateLambda(int leaf, int64 base,
+                                                         int64 energy) {
+  DCHECK_GT(energy, 0);
+  const Node node = {0, kMinusInfinity, energy, base + energy};
+  SetLeafAndUpdateParents(leaf, node);
+}
+
+inline void CumulativeThetaLambdaTree::RemoveLeaf(int leaf) {
+  const Node empty = {0, kMinusInfinity, 0, kMinusInfinity};
+  SetLeafAndUpdateParents(leaf, empty);
+}
+
+inline void CumulativeThetaLambdaTree::SetLeafAndUpdateParents(
+    int leaf, const Node& node) {
+  int index = first_leaf_ + leaf;
+  nodes_[index] = node;
+  for (index /= 2; index > 0; index /= 2) {
+    const Node& left = nodes_[2 * index];
+    const Node& right = nodes_[2 * index + 1];
+    Node& parent = nodes_[index];
+    parent.energy = left.energy + right.energy;
+    parent.envelope = std::max(right.envelope, left.envelope + right.energy);
+    parent.energy_opt = std::max(left.energy_opt + right.energy,
+                                 left.energy + right.energy_opt);
+    parent.envelope_opt =
+        std::max(right.envelope_opt, std::max(left.envelope_opt + right.energy,
+                                              left.envelope + right.energy_opt));
+  }
+}
+
+inline int CumulativeThetaLambdaTree::DescendToLeafStartingEnvelope(
+    int node) const {
+  while (node < first_leaf_) {
+    const int right = 2 * node + 1;
+    node = nodes_[node].envelope == nodes_[right].envelope ? right : right - 1;
+  }
+  return node - first_leaf_;
+}
+
+inline int CumulativeThetaLambdaTree::LeafStartingEnvelope() const {
+  return DescendToLeafStartingEnvelope(1);
+}
+
+// Note that the descents below always follow a branch whose optional value is
+// strictly greater than its non-optional one, so they end on a Lambda leaf.
+inline int CumulativeThetaLambdaTree::DescendToLambdaLeafOfOptionalEnergy(
+    int node) const {
+  while (node < first_leaf_) {
+    const int left = 2 * node;
+    const int right = left + 1;
+    if (nodes_[node].energy_opt ==
+        nodes_[left].energy_opt + nodes_[right].energy) {
+      node = left;
+    } else {
+      node = right;
+    }
+  }
+  return node - first_leaf_;
+}
+
+inline void CumulativeThetaLambdaTree::LeavesOfOptionalEnvelope(
+    int* start_leaf, int* lambda_leaf) const {
+  DCHECK_GT(OptionalEnvelope(), Envelope());
+  int node = 1;
+  while (node < first_leaf_) {
+    const int left = 2 * node;
+    const int right = left + 1;
+    const int64 target = nodes_[node].envelope_opt;
+    if (target == nodes_[right].envelope_opt) {
+      node = right;
+    } else if (target == nodes_[left].envelope_opt + nodes_[right].energy) {
+      node = left;
+    } else {
+      *start_leaf = DescendToLeafStartingEnvelope(left);
+      *lambda_leaf = DescendToLambdaLeafOfOptionalEnergy(right);
+      return;
+    }
+  }
+  *start_leaf = node - first_leaf_;
+  *lambda_leaf = node - first_leaf_;
+}
+
+inline CumulativeConstraint::CumulativeConstraint(
+    const std::vector<IntervalVariable>& vars,
+    const std::vector<IntegerVariable>& demands, IntegerVariable capacity,
+    IntegerTrail* integer_trail, IntervalsRepository* intervals)
+    : demands_(demands),
+      capacity_(capacity),
+      integer_trail_(integer_trail),
+      intervals_(intervals),
+      vars_(vars),
+      stats_("CumulativeConstraint") {
+  CHECK_EQ(vars.size(), demands.size());
+  for (const IntervalVariable i : vars) {
+    start_vars_.push_back(LbVarOf(intervals->StartVar(i)));
+    minus_end_vars_.push_back(MinusUbVarOf(intervals->EndVar(i)));
+    if (intervals->SizeVar(i) == kNoIntegerVariable) {
+      duration_vars_.push_back(kNoLbVar);
+      fixed_durations_.push_back(intervals->FixedSize(i));
+    } else {
+      duration_vars_.push_back(LbVarOf(intervals->SizeVar(i)));
+      fixed_durations_.push_back(0);
+    }
+    presence_literals_.push_back(intervals->IsOptional(i)
+                                     ? intervals->IsPresentLiteral(i).Index()
+                                     : kNoLiteralIndex);
+  }
+}
+
+inline void CumulativeConstraint::RegisterWith(
+    GenericLiteralWatcher* watcher) {
+  const int id = watcher->Register(this);
+  for (int t = 0; t < vars_.size(); ++t) {
+    watcher->WatchIntegerVariable(intervals_->StartVar(vars_[t]), id);
+    watcher->WatchIntegerVariable(intervals_->EndVar(vars_[t]), id);
+    if (intervals_->SizeVar(vars_[t]) != kNoIntegerVariable) {
+      watcher->WatchLbVar(LbVarOf(intervals_->SizeVar(vars_[t])), id);
+    }
+    watcher->WatchLbVar(LbVarOf(demands_[t]), id);
+    if (presence_literals_[t] != kNoLiteralIndex) {
+      watcher->WatchLiteral(Literal(presence_literals_[t]), id);
+    }
+  }
+  watcher->WatchLbVar(MinusUbVarOf(capacity_), id);
+}
+
+inline bool CumulativeConstraint::Propagate(Trail* trail) {
+  SCOPED_TIME_STAT(&stats_);
+  FillPresentTasks(*trail);
+  if (tasks_.empty()) return true;
+
+  // The mirror problem must always be switched back, even on conflict.
+  if (!TimeTablingPass(trail)) return false;
+  SwitchToMirrorProblem();
+  bool ok = TimeTablingPass(trail);
+  SwitchToMirrorProblem();
+  if (!ok) return false;
+
+  if (!TimeTableEdgeFindingPass(trail)) return false;
+  SwitchToMirrorProblem();
+  ok = TimeTableEdgeFindingPass(trail);
+  SwitchToMirrorProblem();
+  return ok;
+}
+
+inline void CumulativeConstraint::FillPresentTasks(const Trail& trail) {
+  tasks_.clear();
+  for (int t = 0; t < start_vars_.size(); ++t) {
+    if (presence_literals_[t] != kNoLiteralIndex &&
+        !trail.Assignment().LiteralIsTrue(Literal(presence_literals_[t]))) {
+      continue;
+    }
+    if (MinDemand(t) <= 0 || MinDuration(t) <= 0) continue;
+    tasks_.push_back(t);
+  }
+}
+
+inline void CumulativeConstraint::BuildProfile() {
+  // Each compulsory part gives two events. We use ProfileRectangle to store
+  // them with the height being the demand delta.
+  profile_.clear();
+  for (const int t : tasks_) {
+    const int start = MaxStart(t);
+    const int end = MinEnd(t);
+    if (start < end) {
+      profile_.push_back({start, MinDemand(t)});
+      profile_.push_back({end, -MinDemand(t)});
+    }
+  }
+  std::sort(profile_.begin(), profile_.end());
+
+  // Merge the events with the same time into rectangles. Note that we keep the
+  // rectangles with the same height separate, this doesn't matter.
+  int num_rectangles = 0;
+  int height = 0;
+  ProfileRectangle sentinel = {kint32min, 0};
+  std::vector<ProfileRectangle> events;
+  events.swap(profile_);
+  profile_.push_back(sentinel);
+  for (int i = 0; i < events.size();) {
+    const int time = events[i].start;
+    for (; i < events.size() && events[i].start == time; ++i) {
+      height += events[i].height;
+    }
+    profile_.push_back({time, height});
+    ++num_rectangles;
+  }
+  DCHECK_EQ(height, 0);
+  if (num_rectangles == 0) profile_.push_back({kint32max, 0});
+
+  profile_energy_.assign(profile_.size(), 0);
+  for (int i = 1; i < profile_.size(); ++i) {
+    const int64 width =
+        static_cast<int64>(profile_[i].start) - profile_[i - 1].start;
+    profile_energy_[i] =
+        profile_energy_[i - 1] + (profile_[i - 1].height == 0
+                                      ? 0
+                                      : width * profile_[i - 1].height);
+  }
+}
+
+inline int64 CumulativeConstraint::ProfileEnergyBefore(int time) const {
+  const ProfileRectangle target = {time, 0};
+  const int index =
+      std::upper_bound(profile_.begin(), profile_.end(), target) -
+      profile_.begin() - 1;
+  if (profile_[index].height == 0) return profile_energy_[index];
+  return profile_energy_[index] +
+         profile_[index].height *
+             (static_cast<int64>(time) - profile_[index].start);
+}
+
+inline void CumulativeConstraint::AddPresenceDurationAndDemandReason(int t) {
+  if (presence_literals_[t] != kNoLiteralIndex) {
+    literal_reason_.push_back(Literal(presence_literals_[t]).Negated());
+  }
+  if (duration_vars_[t] != kNoLbVar) {
+    integer_reason_.push_back(
+        IntegerLiteral::FromLbVar(duration_vars_[t], MinDuration(t)));
+  }
+  integer_reason_.push_back(
+      IntegerLiteral::GreaterOrEqual(demands_[t], MinDemand(t)));
+}
+
+inline void CumulativeConstraint::AddMinStartReason(int t, int lower_bound) {
+  integer_reason_.push_back(
+      IntegerLiteral::FromLbVar(start_vars_[t], lower_bound));
+}
+
+inline void CumulativeConstraint::AddMaxEndReason(int t, int upper_bound) {
+  integer_reason_.push_back(
+      IntegerLiteral::FromLbVar(minus_end_vars_[t], -upper_bound));
+}
+
+inline void CumulativeConstraint::AddCapacityReason() {
+  integer_reason_.push_back(
+      IntegerLiteral::LowerOrEqual(capacity_, Capacity()));
+}
+
+inline void CumulativeConstraint::AddWindowReason(int t, int window_start,
+                                                  int window_end) {
+  AddPresenceDurationAndDemandReason(t);
+  AddMinStartReason(t, window_start);
+  AddMaxEndReason(t, window_end);
+}
+
+inline void CumulativeConstraint::AddCompulsoryPartReason(int t, int time) {
+  // start >= time + 1 - duration implies end > time, and
+  // end <= time + duration implies start <= time.
+  const int duration = MinDuration(t);
+  AddPresenceDurationAndDemandReason(t);
+  AddMinStartReason(t, time + 1 - duration);
+  AddMaxEndReason(t, time + duration);
+}
+
+inline void CumulativeConstraint::AddProfileReason(int window_start,
+                                                   int window_end) {
+  for (const int t : tasks_) {
+    const int start = MaxStart(t);
+    const int end = MinEnd(t);
+    if (start < end && start < window_end && end > window_start) {
+      AddPresenceDurationAndDemandReason(t);
+      AddMinStartReason(t, MinStart(t));
+      AddMaxEndReason(t, MaxEnd(t));
+    }
+  }
+}
+
+inline bool CumulativeConstraint::ReportConflict(Trail* trail) {
+  std::vector<Literal>* conflict = trail->MutableConflict();
+  *conflict = literal_reason_;
+  integer_trail_->MergeReasonInto(integer_reason_, conflict);
+  return false;
+}
+
+inline bool CumulativeConstraint::CheckIntervalForConflict(int t,
+                                                           Trail* trail) {
+  if (MinStart(t) + MinDuration(t) <= MaxEnd(t)) return true;
+  literal_reason_.clear();
+  integer_reason_.clear();
+  AddPresenceDurationAndDemandReason(t);
+  AddMinStartReason(t, MinStart(t));
+  AddMaxEndReason(t, MaxEnd(t));
+  return ReportConflict(trail);
+}
+
+inline bool CumulativeConstraint::TimeTablingPass(Trail* trail) {
+  BuildProfile();
+  const int capacity = Capacity();
+
+  // Overload of the profile.
+  for (int r = 0; r < profile_.size(); ++r) {
+    if (profile_[r].height <= capacity) continue;
+    const int time = profile_[r].start;
+    literal_reason_.clear();
+    integer_reason_.clear();
+    AddCapacityReason();
+    for (const int t : tasks_) {
+      if (MaxStart(t) <= time && time < MinEnd(t)) {
+        AddCompulsoryPartReason(t, time);
+      }
+    }
+    return ReportConflict(trail);
+  }
+
+  for (const int t : tasks_) {
+    const int demand = MinDemand(t);
+    if (demand > capacity) {
+      literal_reason_.clear();
+      integer_reason_.clear();
+      AddCapacityReason();
+      AddPresenceDurationAndDemandReason(t);
+      return ReportConflict(trail);
+    }
+    const int duration = MinDuration(t);
+    const int own_start = MaxStart(t);
+    const int own_end = MinEnd(t);
+    int start = MinStart(t);
+
+    // Find the rectangle containing start and scan the ones overlapping with
+    // [start, start + duration).
+    const ProfileRectangle target = {start, 0};
+    int r = std::upper_bound(profile_.begin(), profile_.end(), target) -
+            profile_.begin() - 1;
+    for (; r + 1 < profile_.size() && profile_[r].start < start + duration;
+         ++r) {
+      const int rectangle_end = profile_[r + 1].start;
+      if (rectangle_end <= start) continue;
+
+      // The rectangles are either fully inside or outside the compulsory part
+      // of t since its boundaries are events of the profile.
+      int height = profile_[r].height;
+      if (own_start <= profile_[r].start && profile_[r].start < own_end) {
+        height -= demand;
+      }
+      if (height + demand <= capacity) continue;
+
+      // Push t after the rectangle. Each step uses a single time point as an
+      // explanation (the "pointwise" explanation of Schutt et al.): if t
+      // started in [time + 1 - duration, time] it would overload the resource
+      // at time.
+      while (start < rectangle_end) {
+        const int time = std::min(rectangle_end - 1, start + duration - 1);
+        literal_reason_.clear();
+        integer_reason_.clear();
+        AddCapacityReason();
+        AddPresenceDurationAndDemandReason(t);
+        AddMinStartReason(t, time + 1 - duration);
+        for (const int other : tasks_) {
+          if (other != t && MaxStart(other) <= time && time < MinEnd(other)) {
+            AddCompulsoryPartReason(other, time);
+          }
+        }
+        start = time + 1;
+        integer_trail_->Enqueue(
+            IntegerLiteral::FromLbVar(start_vars_[t], start), literal_reason_,
+            integer_reason_);
+        if (!CheckIntervalForConflict(t, trail)) return false;
+      }
+    }
+  }
+  return true;
+}
+
+inline bool CumulativeConstraint::TimeTableEdgeFindingPass(Trail* trail) {
+  BuildProfile();
+  const int64 capacity = Capacity();
+  const int num_tasks = tasks_.size();
+
+  task_by_increasing_min_start_ = tasks_;
+  std::sort(task_by_increasing_min_start_.begin(),
+            task_by_increasing_min_start_.end(),
+            [this](int a, int b) { return MinStart(a) < MinStart(b); });
+  task_by_decreasing_max_end_ = tasks_;
+  std::sort(task_by_decreasing_max_end_.begin(),
+            task_by_decreasing_max_end_.end(),
+            [this](int a, int b) { return MaxEnd(a) > MaxEnd(b); });
+
+  // Initially all the tasks are in Theta. The base of a leaf is such that its
+  // envelope minus (capacity * window_end - profile energy before window_end)
+  // is the overload of the window [min_start, window_end).
+  tree_.Reset(num_tasks);
+  leaf_of_task_.resize(start_vars_.size());
+  leaf_is_in_theta_.assign(num_tasks, true);
+  std::vector<int64> leaf_base(num_tasks);
+  for (int leaf = 0; leaf < num_tasks; ++leaf) {
+    const int t = task_by_increasing_min_start_[leaf];
+    leaf_of_task_[t] = leaf;
+    leaf_base[leaf] =
+        capacity * MinStart(t) - ProfileEnergyBefore(MinStart(t));
+    tree_.AddOrUpdateTheta(leaf, leaf_base[leaf], FreeEnergy(t));
+  }
+
+  for (const int j : task_by_decreasing_max_end_) {
+    // All the tasks in Theta end before window_end.
+    const int window_end = MaxEnd(j);
+    const int64 threshold =
+        capacity * window_end - ProfileEnergyBefore(window_end);
+
+    // Timetable overload checking.
+    if (tree_.Envelope() > threshold) {
+      const int start_leaf = tree_.LeafStartingEnvelope();
+      const int window_start =
+          MinStart(task_by_increasing_min_start_[start_leaf]);
+      literal_reason_.clear();
+      integer_reason_.clear();
+      AddCapacityReason();
+      for (int leaf = start_leaf; leaf < num_tasks; ++leaf) {
+        if (!leaf_is_in_theta_[leaf]) continue;
+        AddWindowReason(task_by_increasing_min_start_[leaf], window_start,
+                        window_end);
+      }
+      AddProfileReason(window_start, window_end);
+      return ReportConflict(trail);
+    }
+
+    // Timetable edge-finding detection: each Lambda task responsible for an
+    // overload must end after window_end.
+    while (tree_.OptionalEnvelope() > threshold) {
+      int start_leaf = -1;
+      int lambda_leaf = -1;
+      tree_.LeavesOfOptionalEnvelope(&start_leaf, &lambda_leaf);
+      tree_.RemoveLeaf(lambda_leaf);
+      const int i = task_by_increasing_min_start_[lambda_leaf];
+      const int window_start =
+          MinStart(task_by_increasing_min_start_[start_leaf]);
+      const int duration = MinDuration(i);
+      const int64 demand = MinDemand(i);
+
+      // i ends after window_end, so it starts after window_end - duration.
+      const int end_after = window_end + 1 - duration;
+      if (end_after > MinStart(i)) {
+        literal_reason_.clear();
+        integer_reason_.clear();
+        AddCapacityReason();
+        AddPresenceDurationAndDemandReason(i);
+        AddMinStartReason(i, window_start);
+        for (int leaf = start_leaf; leaf < num_tasks; ++leaf) {
+          if (!leaf_is_in_theta_[leaf]) continue;
+          AddWindowReason(task_by_increasing_min_start_[leaf], window_start,
+                          window_end);
+        }
+        AddProfileReason(window_start, window_end);
+        integer_trail_->Enqueue(
+            IntegerLiteral::FromLbVar(start_vars_[i], end_after),
+            literal_reason_, integer_reason_);
+        if (!CheckIntervalForConflict(i, trail)) return false;
+      }
+
+      // Classical edge-finding update with the sets of Theta tasks starting
+      // after a given time: if the energy left to i in [time, window_end] is
+      // not enough, i must start later.
+      int64 energy = 0;
+      int best_bound = MinStart(i);
+      int best_window_start = 0;
+      for (int leaf = num_tasks - 1; leaf >= 0; --leaf) {
+        if (!leaf_is_in_theta_[leaf]) continue;
+        const int t = task_by_increasing_min_start_[leaf];
+        energy += static_cast<int64>(MinDemand(t)) * MinDuration(t);
+        const int64 rest =
+            energy - (capacity - demand) * (window_end - MinStart(t));
+        if (rest <= 0) continue;
+        const int64 bound = MinStart(t) + (rest + demand - 1) / demand;
+        if (bound > best_bound) {
+          best_bound = bound;
+          best_window_start = MinStart(t);
+        }
+      }
+      if (best_bound > MinStart(i)) {
+        literal_reason_.clear();
+        integer_reason_.clear();
+        AddCapacityReason();
+        AddPresenceDurationAndDemandReason(i);
+        AddMinStartReason(i, end_after);
+        for (int leaf = 0; leaf < num_tasks; ++leaf) {
+          if (!leaf_is_in_theta_[leaf]) continue;
+          const int t = task_by_increasing_min_start_[leaf];
+          if (MinStart(t) < best_window_start) continue;
+          AddWindowReason(t, best_window_start, window_end);
+        }
+        integer_trail_->Enqueue(
+            IntegerLiteral::FromLbVar(start_vars_[i], best_bound),
+            literal_reason_, integer_reason_);
+        if (!CheckIntervalForConflict(i, trail)) return false;
+      }
+    }
+
+    // Move j from Theta to Lambda.
+    const int leaf = leaf_of_task_[j];
+    leaf_is_in_theta_[leaf] = false;
+    const int64 free_energy = FreeEnergy(j);
+    if (free_energy > 0) {
+      tree_.AddOrUpdateLambda(leaf, leaf_base[leaf], free_energy);
+    } else {
+      tree_.RemoveLeaf(leaf);
+    }
+  }
+  return true;
+}
+
+}  // namespace sat
+}  // namespace operations_research
+
+#endif  // OR_TOOLS_SAT_CUMULATIVE_H_
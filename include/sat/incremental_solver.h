@@ -0,0 +1,297 @@
+// Copyright 2010-2014 Google
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+// An incremental interface on top of the SatSolver for clients that issue
+// many small queries under assumptions against the same base formula.
+//
+// Compared to SatSolver::ResetAndSolveWithGivenAssumptions() that always
+// backtracks to level zero, this keeps the longest prefix of the previous
+// assumptions that is still on the trail, so consecutive queries sharing a
+// prefix do not pay again for its propagation. The learned clauses are kept
+// across queries as usual.
+//
+// It also supports push/pop groups of clauses: each group is guarded by a
+// fresh selector literal that is assumed while the group is open, and fixed
+// to false when the group is popped. The clauses learned while a group was
+// open all contain its negated selector, so they stay valid afterwards.
+
+#ifndef OR_TOOLS_SAT_INCREMENTAL_SOLVER_H_
+#define OR_TOOLS_SAT_INCREMENTAL_SOLVER_H_
+
+#include <algorithm>
+#include <vector>
+
+#include "base/integral_types.h"
+#include "base/logging.h"
+#include "base/int_type_indexed_vector.h"
+#include "sat/sat_base.h"
+#include "sat/sat_solver.h"
+#include "util/bitset.h"
+#include "util/stats.h"
+
+namespace operations_research {
+namespace sat {
+
+class IncrementalSatSolver {
+ public:
+  // The given solver must outlive this class. The clauses of the base formula
+  // can be added to it directly, or through AddClause() with no open group.
+  explicit IncrementalSatSolver(SatSolver* solver)
+      : solver_(solver),
+        num_queries_(0),
+        num_reused_levels_(0),
+        num_enqueued_assumptions_(0),
+        stats_("IncrementalSatSolver") {}
+  ~IncrementalSatSolver() {
+    IF_STATS_ENABLED({
+      LOG(INFO) << stats_.StatString();
+      LOG(INFO) << "num_queries " << num_queries_;
+      LOG(INFO) << "num_reused_levels " << num_reused_levels_;
+      LOG(INFO) << "num_enqueued_assumptions " << num_enqueued_assumptions_;
+    });
+  }
+
+  // Opens a new group of clauses. All the clauses added by AddClause() until
+  // the matching PopGroup() belong to it. Groups can be nested. Returns the
+  // number of open groups.
+  int PushGroup();
+
+  // Removes all the clauses of the innermost open group. Note that the
+  // selector variable of the group is fixed and never reused.
+  void PopGroup();
+
+  int NumOpenGroups() const { return selectors_.size(); }
+
+  // Adds a clause to the innermost open group, or to the base formula if
+  // there is none. Returns false if the problem is detected to be UNSAT (this
+  // can only happen for a clause of the base formula).
+  bool AddClause(const std::vector<Literal>& literals);
+
+  // Solves the problem with the clauses of all the open groups and under the
+  // given assumptions. The status has the same meaning as the one of
+  // SatSolver::ResetAndSolveWithGivenAssumptions(). On MODEL_SAT, the solution
+  // is in solver->Assignment().
+  //
+  // Nothing is undone after the solve, so that the next query can reuse the
+  // current decisions. The solver must not be modified in-between except
+  // through this class or by adding clauses (which backtracks to level zero).
+  SatSolver::Status Solve(const std::vector<Literal>& assumptions);
+
+  // After Solve() returned ASSUMPTIONS_UNSAT, returns a subset of the given
+  // assumptions that cannot be all true together, in the order in which they
+  // were given. This may be empty if the open groups alone are UNSAT.
+  const std::vector<Literal>& LastCore() const { return core_; }
+
+  // Stats.
+  int64 num_queries() const { return num_queries_; }
+  int64 num_reused_levels() const { return num_reused_levels_; }
+  int64 num_enqueued_assumptions() const { return num_enqueued_assumptions_; }
+
+ private:
+  // Returns the largest decision level whose decisions are all a prefix of
+  // assumptions_ (allowing assumptions that are implied by the previous ones).
+  int ReusableDecisionLevel() const;
+
+  // Enqueues all the assumptions_ that are not already true as decisions.
+  // Returns false if one of them is false, in which case the core is filled,
+  // or if the model is UNSAT.
+  bool EnqueueAssumptions();
+
+  // Fills core_ with the given assumption currently assigned to false and all
+  // the decisions that caused this assignment.
+  void FillCoreOfFalseAssumption(Literal false_assumption);
+
+  // Sets core_ to the given decisions without the selectors, sorted in the
+  // order of the user assumptions.
+  void SetCoreFromDecisions(const std::vector<Literal>& decisions);
+
+  SatSolver* solver_;
+
+  // The selector of each open group. The clauses of the group i are of the
+  // form (clause OR not(selectors_[i])).
+  std::vector<Literal> selectors_;
+  ITIVector<BooleanVariable, bool> is_selector_;
+
+  // The selectors followed by the user assumptions of the current query.
+  std::vector<Literal> assumptions_;
+  std::vector<Literal> core_;
+  SparseBitset<BooleanVariable> is_marked_;
+
+  int64 num_queries_;
+  int64 num_reused_levels_;
+  int64 num_enqueued_assumptions_;
+  mutable StatsGroup stats_;
+  DISALLOW_COPY_AND_ASSIGN(IncrementalSatSolver);
+};
+
+// ============================================================================
+// Implementation.
+// ============================================================================
+
+inline int IncrementalSatSolver::PushGroup() {
+  solver_->Backtrack(0);
+  const BooleanVariable var = solver_->NewBooleanVariable();
+  is_selector_.resize(solver_->NumVariables(), false);
+  is_selector_[var] = true;
+  selectors_.push_back(Literal(var, true));
+  return selectors_.size();
+}
+
+inline void IncrementalSatSolver::PopGroup() {
+  CHECK(!selectors_.empty());
+  solver_->Backtrack(0);
+  solver_->AddUnitClause(selectors_.back().Negated());
+  selectors_.pop_back();
+}
+
+inline bool IncrementalSatSolver::AddClause(
+    const std::vector<Literal>& literals) {
+  solver_->Backtrack(0);
+  if (selectors_.empty()) return solver_->AddProblemClause(literals);
+  std::vector<Literal> guarded = literals;
+  guarded.push_back(selectors_.back().Negated());
+  return solver_->AddProblemClause(guarded);
+}
+
+inline SatSolver::Status IncrementalSatSolver::Solve(
+    const std::vector<Literal>& assumptions) {
+  SCOPED_TIME_STAT(&stats_);
+  ++num_queries_;
+  core_.clear();
+  if (solver_->IsModelUnsat()) return SatSolver::MODEL_UNSAT;
+  assumptions_ = selectors_;
+  assumptions_.insert(assumptions_.end(), assumptions.begin(),
+                      assumptions.end());
+
+  const int level = ReusableDecisionLevel();
+  num_reused_levels_ += level;
+  solver_->Backtrack(level);
+  solver_->SetAssumptionLevel(level);
+  if (!EnqueueAssumptions()) {
+    return solver_->IsModelUnsat() ? SatSolver::MODEL_UNSAT
+                                   : SatSolver::ASSUMPTIONS_UNSAT;
+  }
+  solver_->SetAssumptionLevel(solver_->CurrentDecisionLevel());
+  const SatSolver::Status status = solver_->Solve();
+  if (status == SatSolver::ASSUMPTIONS_UNSAT) {
+    SetCoreFromDecisions(solver_->GetLastIncompatibleDecisions());
+  }
+  return status;
+}
+
+inline int IncrementalSatSolver::ReusableDecisionLevel() const {
+  const int max_level =
+      std::min(solver_->AssumptionLevel(), solver_->CurrentDecisionLevel());
+  const std::vector<SatSolver::Decision>& decisions = solver_->Decisions();
+  const Trail& trail = solver_->LiteralTrail();
+  int level = 0;
+  for (const Literal literal : assumptions_) {
+    if (level < max_level && decisions[level].literal == literal) {
+      ++level;
+      continue;
+    }
+    if (trail.Assignment().LiteralIsTrue(literal) &&
+        trail.Info(literal.Variable()).level <= level) {
+      continue;
+    }
+    break;
+  }
+  return level;
+}
+
+inline bool IncrementalSatSolver::EnqueueAssumptions() {
+  const VariablesAssignment& assignment = solver_->Assignment();
+  int i = 0;
+  while (i < assumptions_.size()) {
+    const Literal literal = assumptions_[i];
+    if (assignment.LiteralIsTrue(literal)) {
+      ++i;
+      continue;
+    }
+    if (assignment.LiteralIsFalse(literal)) {
+      FillCoreOfFalseAssumption(literal);
+      return false;
+    }
+    const int level = solver_->CurrentDecisionLevel();
+    ++num_enqueued_assumptions_;
+    solver_->EnqueueDecisionAndBacktrackOnConflict(literal);
+    if (solver_->IsModelUnsat()) return false;
+
+    // On conflict, the solver may have backjumped over some of the previous
+    // assumptions before trying to re-enqueue them, so we check them again.
+    // Note that the true ones are skipped right away.
+    if (solver_->CurrentDecisionLevel() <= level) i = 0;
+  }
+  return true;
+}
+
+inline void IncrementalSatSolver::FillCoreOfFalseAssumption(
+    Literal false_assumption) {
+  const Trail& trail = solver_->LiteralTrail();
+  is_marked_.ClearAndResize(BooleanVariable(solver_->NumVariables()));
+  std::vector<Literal> decisions;
+  const BooleanVariable false_var = false_assumption.Variable();
+  int num_pending = 0;
+  if (trail.Info(false_var).level > 0) {
+    is_marked_.Set(false_var);
+    ++num_pending;
+  }
+
+  // Standard backward traversal of the trail, expanding the reason of all the
+  // marked literals until only decisions are left.
+  for (int index = trail.Info(false_var).trail_index;
+       num_pending > 0 && index >= 0; --index) {
+    const BooleanVariable var = trail[index].Variable();
+    if (!is_marked_[var]) continue;
+    --num_pending;
+    if (trail.AssignmentType(var) == AssignmentType::kSearchDecision) {
+      decisions.push_back(trail[index]);
+      continue;
+    }
+    for (const Literal literal : trail.Reason(var)) {
+      const BooleanVariable reason_var = literal.Variable();
+      if (is_marked_[reason_var] || trail.Info(reason_var).level == 0) {
+        continue;
+      }
+      is_marked_.Set(reason_var);
+      ++num_pending;
+    }
+  }
+  decisions.push_back(false_assumption);
+  SetCoreFromDecisions(decisions);
+}
+
+inline void IncrementalSatSolver::SetCoreFromDecisions(
+    const std::vector<Literal>& decisions) {
+  is_marked_.ClearAndResize(BooleanVariable(solver_->NumVariables()));
+  for (const Literal literal : decisions) {
+    if (literal.Variable() < is_selector_.size() &&
+        is_selector_[literal.Variable()]) {
+      continue;
+    }
+    is_marked_.Set(literal.Variable());
+  }
+  core_.clear();
+  for (int i = selectors_.size(); i < assumptions_.size(); ++i) {
+    const BooleanVariable var = assumptions_[i].Variable();
+    if (is_marked_[var]) {
+      core_.push_back(assumptions_[i]);
+      is_marked_.Clear(var);
+    }
+  }
+}
+
+}  // namespace sat
+}  // namespace operations_research
+
+#endif  // OR_TOOLS_SAT_INCREMENTAL_SOLVER_H_
@@ -0,0 +1,565 @@
+// Copyright 2010-2014 Google
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+// Parallel optimization of a LinearBooleanProblem. Several workers, each with
+// its own SatSolver, run concurrently on the same problem and exchange their
+// bounds through a SharedOptimizationState:
+// - The core-guided workers (a stratified variant of the algorithm behind
+//   SolveWithCardinalityEncodingAndCore()) improve the lower bound, and use
+//   the best known solution as an objective constraint.
+// - The linear scan workers (as in SolveWithLinearScan()) improve the upper
+//   bound, and use the best lower bound to constrain their objective too.
+// The search stops as soon as the two bounds meet.
+//
+// TODO(user): Currently, only the MINIMIZATION problem type is supported.
+
+#ifndef OR_TOOLS_SAT_PARALLEL_OPTIMIZATION_H_
+#define OR_TOOLS_SAT_PARALLEL_OPTIMIZATION_H_
+
+#include <atomic>
+#include <deque>
+#include <memory>
+#include <vector>
+
+#include "base/callback.h"
+#include "base/mutex.h"
+#include "base/threadpool.h"
+#include "base/hash.h"
+#include "sat/boolean_problem.h"
+#include "sat/encoding.h"
+#include "sat/optimization.h"
+#include "sat/sat_solver.h"
+#include "util/time_limit.h"
+
+namespace operations_research {
+namespace sat {
+
+// Runs num_workers optimization workers in parallel on the given problem and
+// returns the best solution found. The workers alternate between core-guided
+// and linear scan algorithms, and use different random seeds. With only one
+// worker, this is a core-guided search that also produces solutions.
+//
+// The status has the same meaning as for the Solve*() functions in
+// optimization.h.
+SatSolver::Status SolveWithParallelPortfolio(LogBehavior log,
+                                             const LinearBooleanProblem& problem,
+                                             const SatParameters& parameters,
+                                             int num_workers,
+                                             std::vector<bool>* solution);
+
+// The bounds and the best solution shared by the parallel workers. All the
+// values are in the unscaled objective space, i.e. the one returned by
+// ComputeObjectiveValue(). This class is thread-safe.
+class SharedOptimizationState {
+ public:
+  SharedOptimizationState(LogBehavior log, const LinearBooleanProblem& problem);
+
+  // Reports a new feasible solution. Returns true if it improves the best
+  // known one.
+  bool NewSolution(const std::vector<bool>& solution);
+
+  // Reports a new valid lower bound on the objective.
+  void NewLowerBound(Coefficient lower_bound);
+
+  // Reports that the problem has no feasible solution.
+  void MarkProblemInfeasible();
+
+  // Returns the current bounds. UpperBound() is the cost of the best solution
+  // or kCoefficientMax if there is none.
+  Coefficient LowerBound() const;
+  Coefficient UpperBound() const;
+
+  // Returns true if the optimum is proven or the problem is infeasible. In
+  // this case the workers should stop. This does not lock the mutex.
+  bool IsDone() const { return stop_.load(std::memory_order_acquire); }
+
+  // Returns the final status and the best solution.
+  SatSolver::Status Status() const;
+  std::vector<bool> BestSolution() const;
+
+ private:
+  void UpdateStopFlag() EXCLUSIVE_LOCKS_REQUIRED(mutex_);
+
+  const LogBehavior log_;
+  const LinearBooleanProblem& problem_;
+
+  mutable Mutex mutex_;
+  Coefficient lower_bound_ GUARDED_BY(mutex_);
+  Coefficient upper_bound_ GUARDED_BY(mutex_);
+  bool infeasible_ GUARDED_BY(mutex_);
+  std::vector<bool> best_solution_ GUARDED_BY(mutex_);
+
+  // This is written under the mutex, but read without it by the workers
+  // between their chunks. It only goes from false to true.
+  std::atomic<bool> stop_;
+
+  DISALLOW_COPY_AND_ASSIGN(SharedOptimizationState);
+};
+
+// Base class of the workers. Each worker owns its SatSolver, and solves in
+// chunks of parameters.max_number_of_conflicts() conflicts so that it can
+// import the bounds found by the other workers in-between.
+class OptimizationWorker {
+ public:
+  OptimizationWorker(const LinearBooleanProblem& problem,
+                     const SatParameters& parameters,
+                     SharedOptimizationState* state)
+      : problem_(problem), parameters_(parameters), state_(state) {}
+  virtual ~OptimizationWorker() {}
+
+  // Runs the worker until the state IsDone(), the time limit is reached or
+  // the worker cannot make progress anymore.
+  void Run();
+
+ protected:
+  // Returns false when this worker cannot make progress anymore.
+  virtual bool RunOneChunk() = 0;
+
+  // Loads the problem in solver_. Returns false if it is infeasible.
+  bool LoadProblem();
+
+  // Copies the current solver assignment to the shared state.
+  void ExportSolution();
+
+  // Sets the time limits of solver_ to what is left of time_limit_, for the
+  // solves that can't be given time_limit_ directly.
+  void LimitSolverToTimeLeft();
+
+  const LinearBooleanProblem& problem_;
+  SatParameters parameters_;
+  SharedOptimizationState* state_;
+  std::unique_ptr<SatSolver> solver_;
+  std::unique_ptr<TimeLimit> time_limit_;
+
+ private:
+  DISALLOW_COPY_AND_ASSIGN(OptimizationWorker);
+};
+
+// Linear scan: each solution found is followed by a constraint asking for a
+// strictly better one. The shared lower bound is added to the same objective
+// constraint.
+class LinearScanWorker : public OptimizationWorker {
+ public:
+  LinearScanWorker(const LinearBooleanProblem& problem,
+                   const SatParameters& parameters,
+                   SharedOptimizationState* state)
+      : OptimizationWorker(problem, parameters, state),
+        constrained_lower_bound_(kint64min),
+        constrained_upper_bound_(kCoefficientMax) {}
+
+ protected:
+  bool RunOneChunk() override;
+
+ private:
+  Coefficient constrained_lower_bound_;
+  Coefficient constrained_upper_bound_;
+};
+
+// Core-guided search with stratification. The objective is represented by a
+// set of weighted EncodingNode, and each core found under the assumptions
+// "node <= node.lb()" is merged into a new node (like in
+// SolveWithCardinalityEncodingAndCore()). With stratification, only the nodes
+// with a weight larger than the current stratum are assumed; a solution found
+// with a non-minimal stratum is exported and the stratum is then lowered.
+class CoreGuidedWorker : public OptimizationWorker {
+ public:
+  CoreGuidedWorker(const LinearBooleanProblem& problem,
+                   const SatParameters& parameters,
+                   SharedOptimizationState* state)
+      : OptimizationWorker(problem, parameters, state),
+        offset_(0),
+        stratum_(0),
+        constrained_upper_bound_(kCoefficientMax),
+        initialized_(false) {}
+
+ protected:
+  bool RunOneChunk() override;
+
+ private:
+  void CreateInitialNodes();
+
+  // Removes the fixed literals from the nodes, drops the nodes that are fully
+  // fixed and returns the current lower bound.
+  Coefficient ReduceNodesAndComputeLowerBound();
+
+  // Returns the largest weight strictly smaller than the given one, or zero.
+  Coefficient NextStratum(Coefficient weight) const;
+
+  // Merges the nodes of the given core into a new node.
+  void ProcessCore(const std::vector<Literal>& core);
+
+  std::deque<EncodingNode> repository_;
+  std::vector<EncodingNode*> nodes_;
+  Coefficient offset_;
+  Coefficient stratum_;
+  Coefficient constrained_upper_bound_;
+  bool initialized_;
+};
+
+// ============================================================================
+// Implementation.
+// ============================================================================
+
+inline SharedOptimizationState::SharedOptimizationState(
+    LogBehavior log, const LinearBooleanProblem& problem)
+    : log_(log),
+      problem_(problem),
+      lower_bound_(kint64min),
+      upper_bound_(kCoefficientMax),
+      infeasible_(false),
+      stop_(false) {}
+
+inline bool SharedOptimizationState::NewSolution(
+    const std::vector<bool>& solution) {
+  DCHECK(IsAssignmentValid(problem_, solution));
+  const Coefficient objective = ComputeObjectiveValue(problem_, solution);
+  MutexLock lock(&mutex_);
+  if (objective >= upper_bound_) return false;
+  upper_bound_ = objective;
+  best_solution_ = solution;
+  if (log_ == STDOUT_LOG) {
+    printf("o %lld\n", static_cast<long long int>(objective.value()));  // NOLINT
+  } else {
+    LOG(INFO) << "New solution: " << objective << " (lower bound "
+              << lower_bound_ << ")";
+  }
+  UpdateStopFlag();
+  return true;
+}
+
+inline void SharedOptimizationState::NewLowerBound(Coefficient lower_bound) {
+  MutexLock lock(&mutex_);
+  if (lower_bound <= lower_bound_) return;
+  lower_bound_ = lower_bound;
+  if (log_ == DEFAULT_LOG) {
+    LOG(INFO) << "New lower bound: " << lower_bound << " (upper bound "
+              << upper_bound_ << ")";
+  }
+  UpdateStopFlag();
+}
+
+inline void SharedOptimizationState::MarkProblemInfeasible() {
+  MutexLock lock(&mutex_);
+  infeasible_ = true;
+  UpdateStopFlag();
+}
+
+inline Coefficient SharedOptimizationState::LowerBound() const {
+  MutexLock lock(&mutex_);
+  return lower_bound_;
+}
+
+inline Coefficient SharedOptimizationState::UpperBound() const {
+  MutexLock lock(&mutex_);
+  return upper_bound_;
+}
+
+inline void SharedOptimizationState::UpdateStopFlag() {
+  if (infeasible_ || lower_bound_ >= upper_bound_) {
+    stop_.store(true, std::memory_order_release);
+  }
+}
+
+inline SatSolver::Status SharedOptimizationState::Status() const {
+  MutexLock lock(&mutex_);
+  if (infeasible_ && best_solution_.empty()) return SatSolver::MODEL_UNSAT;
+  if (!best_solution_.empty() && lower_bound_ >= upper_bound_) {
+    return SatSolver::MODEL_SAT;
+  }
+  return SatSolver::LIMIT_REACHED;
+}
+
+inline std::vector<bool> SharedOptimizationState::BestSolution() const {
+  MutexLock lock(&mutex_);
+  return best_solution_;
+}
+
+inline void OptimizationWorker::Run() {
+  // The workers check IsDone() between their chunks, which are bounded by
+  // the conflict limit of the parameters.
+  time_limit_ = TimeLimit::FromParameters(parameters_);
+  solver_.reset(new SatSolver());
+  solver_->SetParameters(parameters_);
+  if (!LoadProblem()) {
+    state_->MarkProblemInfeasible();
+  } else {
+    while (!state_->IsDone() && !time_limit_->LimitReached()) {
+      if (!RunOneChunk()) break;
+    }
+  }
+}
+
+inline bool OptimizationWorker::LoadProblem() {
+  if (!LoadBooleanProblem(problem_, solver_.get())) return false;
+  UseObjectiveForSatAssignmentPreference(problem_, solver_.get());
+  return !solver_->IsModelUnsat();
+}
+
+inline void OptimizationWorker::ExportSolution() {
+  std::vector<bool> solution;
+  ExtractAssignment(problem_, *solver_, &solution);
+  state_->NewSolution(solution);
+}
+
+inline void OptimizationWorker::LimitSolverToTimeLeft() {
+  SatParameters parameters = parameters_;
+  parameters.set_max_time_in_seconds(time_limit_->GetTimeLeft());
+  parameters.set_max_deterministic_time(
+      time_limit_->GetDeterministicTimeLeft());
+  solver_->SetParameters(parameters);
+}
+
+inline bool LinearScanWorker::RunOneChunk() {
+  // Import the shared bounds. Note that the strict upper bound is encoded as
+  // an objective <= upper_bound - 1 constraint.
+  const Coefficient lower_bound = state_->LowerBound();
+  const Coefficient upper_bound = state_->UpperBound();
+  if (lower_bound > constrained_lower_bound_ ||
+      upper_bound < constrained_upper_bound_) {
+    constrained_lower_bound_ = lower_bound;
+    constrained_upper_bound_ = upper_bound;
+    solver_->Backtrack(0);
+    if (!AddObjectiveConstraint(
+            problem_, lower_bound != kint64min, lower_bound,
+            upper_bound != kCoefficientMax, upper_bound - 1, solver_.get())) {
+      // No solution in [lower_bound, upper_bound): the best one is optimal.
+      if (upper_bound == kCoefficientMax) {
+        state_->MarkProblemInfeasible();
+      } else {
+        state_->NewLowerBound(upper_bound);
+      }
+      return false;
+    }
+  }
+
+  switch (solver_->SolveWithTimeLimit(time_limit_.get())) {
+    case SatSolver::MODEL_SAT:
+      ExportSolution();
+      return true;
+    case SatSolver::MODEL_UNSAT:
+      if (constrained_upper_bound_ == kCoefficientMax) {
+        state_->MarkProblemInfeasible();
+      } else {
+        state_->NewLowerBound(constrained_upper_bound_);
+      }
+      return false;
+    case SatSolver::LIMIT_REACHED:
+      // The conflict limit of one chunk. The next Solve() resumes the search.
+      return true;
+    case SatSolver::ASSUMPTIONS_UNSAT:
+      break;
+  }
+  LOG(DFATAL) << "Unexpected status without assumptions.";
+  return false;
+}
+
+inline void CoreGuidedWorker::CreateInitialNodes() {
+  // Every objective term c.l is rewritten as |c|.l' with l' = l if c > 0 and
+  // l' = not(l) otherwise, the difference going into offset_.
+  const LinearObjective& objective = problem_.objective();
+  for (int i = 0; i < objective.literals_size(); ++i) {
+    const Literal literal(objective.literals(i));
+    const Coefficient coefficient(objective.coefficients(i));
+    if (coefficient == 0) continue;
+    repository_.push_back(
+        EncodingNode(coefficient > 0 ? literal : literal.Negated()));
+    if (coefficient < 0) offset_ += coefficient;
+    repository_.back().set_weight(coefficient > 0 ? coefficient
+                                                  : -coefficient);
+    nodes_.push_back(&repository_.back());
+  }
+  stratum_ = Coefficient(1);
+  if (parameters_.max_sat_stratification() !=
+      SatParameters::STRATIFICATION_NONE) {
+    for (EncodingNode* node : nodes_) {
+      stratum_ = std::max(stratum_, node->weight());
+    }
+  }
+}
+
+inline Coefficient CoreGuidedWorker::ReduceNodesAndComputeLowerBound() {
+  solver_->Backtrack(0);
+  Coefficient lower_bound = offset_;
+  int new_size = 0;
+  for (EncodingNode* node : nodes_) {
+    node->Reduce(*solver_);
+    if (node->size() == 0 && node->current_ub() < node->ub()) {
+      IncreaseNodeSize(node, solver_.get());
+    }
+    if (node->size() == 0) {
+      // This node is fixed, its contribution is now a constant.
+      offset_ += node->weight() * node->lb();
+      lower_bound += node->weight() * node->lb();
+      continue;
+    }
+    lower_bound += node->weight() * node->lb();
+    nodes_[new_size++] = node;
+  }
+  nodes_.resize(new_size);
+  return lower_bound;
+}
+
+inline Coefficient CoreGuidedWorker::NextStratum(Coefficient weight) const {
+  Coefficient result(0);
+  for (const EncodingNode* node : nodes_) {
+    if (node->weight() < weight) result = std::max(result, node->weight());
+  }
+  return result;
+}
+
+inline void CoreGuidedWorker::ProcessCore(const std::vector<Literal>& core) {
+  hash_map<int, EncodingNode*> literal_to_node;
+  for (EncodingNode* node : nodes_) {
+    literal_to_node[node->literal(0).Negated().Index().value()] = node;
+  }
+  std::vector<EncodingNode*> to_merge;
+  Coefficient min_weight = kCoefficientMax;
+  for (const Literal literal : core) {
+    EncodingNode* node = FindOrDie(literal_to_node, literal.Index().value());
+    to_merge.push_back(node);
+    min_weight = std::min(min_weight, node->weight());
+  }
+
+  // The core nodes keep their extra weight, the merged node gets min_weight.
+  // At least one of them is above its lower bound, so the first literal of
+  // the merged node is true.
+  int new_size = 0;
+  for (EncodingNode* node : nodes_) {
+    if (std::find(to_merge.begin(), to_merge.end(), node) != to_merge.end()) {
+      node->set_weight(node->weight() - min_weight);
+      if (node->weight() == 0) continue;
+    }
+    nodes_[new_size++] = node;
+  }
+  nodes_.resize(new_size);
+  EncodingNode* merged =
+      LazyMergeAllNodeWithPQ(to_merge, solver_.get(), &repository_);
+  IncreaseNodeSize(merged, solver_.get());
+  merged->set_weight(min_weight);
+  solver_->Backtrack(0);
+  solver_->AddUnitClause(merged->literal(0));
+  nodes_.push_back(merged);
+}
+
+inline bool CoreGuidedWorker::RunOneChunk() {
+  if (!initialized_) {
+    CreateInitialNodes();
+    initialized_ = true;
+  }
+
+  // Import the best known solution cost as a strict objective upper bound.
+  const Coefficient upper_bound = state_->UpperBound();
+  if (upper_bound < constrained_upper_bound_) {
+    constrained_upper_bound_ = upper_bound;
+    solver_->Backtrack(0);
+    if (!AddObjectiveUpperBound(problem_, upper_bound, solver_.get())) {
+      state_->NewLowerBound(upper_bound);
+      return false;
+    }
+  }
+
+  const Coefficient lower_bound = ReduceNodesAndComputeLowerBound();
+  if (solver_->IsModelUnsat()) {
+    if (constrained_upper_bound_ == kCoefficientMax) {
+      state_->MarkProblemInfeasible();
+    } else {
+      state_->NewLowerBound(constrained_upper_bound_);
+    }
+    return false;
+  }
+  state_->NewLowerBound(lower_bound);
+  if (state_->IsDone()) return false;
+
+  std::vector<Literal> assumptions;
+  for (EncodingNode* node : nodes_) {
+    if (node->weight() >= stratum_) {
+      assumptions.push_back(node->literal(0).Negated());
+    }
+  }
+
+  // There is no variant of ResetAndSolveWithGivenAssumptions() with a time
+  // limit, so the solver gets the time left through its parameters.
+  LimitSolverToTimeLeft();
+  const double deterministic_time = solver_->deterministic_time();
+  const SatSolver::Status status =
+      solver_->ResetAndSolveWithGivenAssumptions(assumptions);
+  time_limit_->AdvanceDeterministicTime(solver_->deterministic_time() -
+                                        deterministic_time);
+  switch (status) {
+    case SatSolver::MODEL_SAT: {
+      ExportSolution();
+      const Coefficient next = NextStratum(stratum_);
+      if (next == 0) {
+        // All the nodes were assumed at their lower bound.
+        state_->NewLowerBound(lower_bound);
+        return false;
+      }
+      stratum_ = next;
+      return true;
+    }
+    case SatSolver::ASSUMPTIONS_UNSAT: {
+      std::vector<Literal> core = solver_->GetLastIncompatibleDecisions();
+      if (parameters_.minimize_core()) MinimizeCore(solver_.get(), &core);
+      if (core.empty()) return true;
+      ProcessCore(core);
+      return true;
+    }
+    case SatSolver::MODEL_UNSAT:
+      if (constrained_upper_bound_ == kCoefficientMax) {
+        state_->MarkProblemInfeasible();
+      } else {
+        state_->NewLowerBound(constrained_upper_bound_);
+      }
+      return false;
+    case SatSolver::LIMIT_REACHED:
+      return true;
+  }
+  return false;
+}
+
+inline SatSolver::Status SolveWithParallelPortfolio(
+    LogBehavior log, const LinearBooleanProblem& problem,
+    const SatParameters& parameters, int num_workers,
+    std::vector<bool>* solution) {
+  CHECK_GE(num_workers, 1);
+  SharedOptimizationState state(log, problem);
+  std::vector<std::unique_ptr<OptimizationWorker>> workers;
+  for (int i = 0; i < num_workers; ++i) {
+    SatParameters worker_parameters = parameters;
+    worker_parameters.set_random_seed(parameters.random_seed() + i);
+    if (!worker_parameters.has_max_number_of_conflicts()) {
+      worker_parameters.set_max_number_of_conflicts(10000);
+    }
+    if (i % 2 == 0) {
+      workers.emplace_back(
+          new CoreGuidedWorker(problem, worker_parameters, &state));
+    } else {
+      workers.emplace_back(
+          new LinearScanWorker(problem, worker_parameters, &state));
+    }
+  }
+  {
+    ThreadPool pool("ParallelOptimization", num_workers);
+    pool.StartWorkers();
+    for (const std::unique_ptr<OptimizationWorker>& worker : workers) {
+      pool.Add(NewCallback(worker.get(), &OptimizationWorker::Run));
+    }
+  }
+  *solution = state.BestSolution();
+  return state.Status();
+}
+
+}  // namespace sat
+}  // namespace operations_research
+
+#endif  // OR_TOOLS_SAT_PARALLEL_OPTIMIZATION_H_
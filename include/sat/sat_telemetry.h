@@ -0,0 +1,50 @@
+// Copyright 2010-2014 Google
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+// Publishes the progress of a SatSolver into the counters of a
+// TelemetryStream (see util/telemetry.h).
+//
+// The statistics of the SatSolver are plain fields, so they must be read on
+// the solving thread. The usual pattern is to solve in slices, and publish
+// between them:
+//   TelemetryStream stream("sat", 1.0, 1024);
+//   stream.Start();
+//   SatSolver::Status status = SatSolver::LIMIT_REACHED;
+//   while (status == SatSolver::LIMIT_REACHED &&
+//          !global_limit->LimitReached()) {
+//     std::unique_ptr<TimeLimit> slice(TimeLimit::FromDeterministicTime(0.1));
+//     status = solver.SolveWithTimeLimit(slice.get());
+//     PublishSatSolverTelemetry(solver, stream.counters());
+//   }
+//   stream.Stop();
+
+#ifndef OR_TOOLS_SAT_SAT_TELEMETRY_H_
+#define OR_TOOLS_SAT_SAT_TELEMETRY_H_
+
+#include "sat/sat_solver.h"
+#include "util/telemetry.h"
+
+namespace operations_research {
+namespace sat {
+
+inline void PublishSatSolverTelemetry(const SatSolver& solver,
+                                      TelemetryCounters* const counters) {
+  counters->set_branches(solver.num_branches());
+  counters->set_failures(solver.num_failures());
+  counters->set_depth(solver.CurrentDecisionLevel());
+}
+
+}  // namespace sat
+}  // namespace operations_research
+
+#endif  // OR_TOOLS_SAT_SAT_TELEMETRY_H_
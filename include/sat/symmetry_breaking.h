@@ -0,0 +1,286 @@
+// Copyright 2010-2014 Google
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+// Symmetry detection and static symmetry breaking for a LinearBooleanProblem.
+//
+// The symmetries are the automorphisms of a colored graph built from the
+// problem, and are computed with the GraphSymmetryFinder (partition refinement
+// and search with pruning by the generators already found). Contrary to
+// FindLinearBooleanProblemSymmetries(), the detection is bounded by a time
+// limit: all the generators found before it is reached are valid symmetries
+// and are returned.
+//
+// The generators can either be used dynamically by the SymmetryPropagator of
+// symmetry.h, or statically with the lex-leader clauses of
+// AddLexLeaderSymmetryBreakingClauses(). The two must not be combined: once
+// the lex-leader clauses are added, the problem is no longer symmetric.
+
+#ifndef OR_TOOLS_SAT_SYMMETRY_BREAKING_H_
+#define OR_TOOLS_SAT_SYMMETRY_BREAKING_H_
+
+#include <algorithm>
+#include <map>
+#include <memory>
+#include <utility>
+#include <vector>
+
+#include "base/integral_types.h"
+#include "base/logging.h"
+#include "base/timer.h"
+#include "base/hash.h"
+#include "algorithms/find_graph_symmetries.h"
+#include "algorithms/sparse_permutation.h"
+#include "sat/boolean_problem.pb.h"
+#include "sat/sat_base.h"
+#include "sat/sat_solver.h"
+
+namespace operations_research {
+namespace sat {
+
+// Returns the undirected colored graph whose automorphisms are the symmetries
+// of the given problem, and fills initial_equivalence_classes with the color
+// of each node. The first 2 * num_variables nodes are the literals, in their
+// index representation, and each literal is linked to its negation. Then:
+// - Each constraint has a node whose color depends on its bounds.
+// - If all the coefficients of a constraint are equal, its literals are
+//   directly linked to it. Otherwise, each term has an intermediate node whose
+//   color is the coefficient.
+// - The color of a literal node is its cost in the objective (the cost of
+//   not(l) is minus the one of l, the difference being a constant offset).
+GraphSymmetryFinder::Graph* GenerateGraphForSymmetryDetection(
+    const LinearBooleanProblem& problem,
+    std::vector<int>* initial_equivalence_classes);
+
+// Same as FindLinearBooleanProblemSymmetries() but stops after the given
+// time limit. Each returned generator is a symmetry of the problem, but if the
+// limit was reached they may only generate a subgroup of the symmetry group.
+void FindLinearBooleanProblemSymmetriesWithTimeLimit(
+    const LinearBooleanProblem& problem, double time_limit_seconds,
+    std::vector<std::unique_ptr<SparsePermutation>>* generators);
+
+// Adds to the solver the clauses encoding x <=_lex p(x) for each generator p,
+// where x is the vector of the variables of the support of p in increasing
+// index order. Only the first max_support_size variables of each support are
+// considered, which keeps the encoding small and is still valid (any prefix of
+// a lex-leader constraint is implied by it).
+//
+// Since the lexicographically smallest solution of each orbit under the whole
+// group satisfies all these constraints, at least one optimal solution is kept.
+// The encoding uses one new variable per compared position ("the prefix is
+// equal so far"), as in Aloul et al. "Efficient Symmetry Breaking for Boolean
+// Satisfiability", IJCAI 2003.
+//
+// This must be called at level zero. Returns false if the problem is detected
+// to be UNSAT.
+bool AddLexLeaderSymmetryBreakingClauses(
+    const std::vector<std::unique_ptr<SparsePermutation>>& generators,
+    int max_support_size, SatSolver* solver);
+
+// ============================================================================
+// Implementation.
+// ============================================================================
+
+inline GraphSymmetryFinder::Graph* GenerateGraphForSymmetryDetection(
+    const LinearBooleanProblem& problem,
+    std::vector<int>* initial_equivalence_classes) {
+  const int num_literals = 2 * problem.num_variables();
+
+  // The color of a node is given by a "key" vector whose first element is the
+  // node type.
+  enum NodeType { LITERAL, CONSTRAINT, COEFFICIENT };
+  std::map<std::vector<int64>, int> color_of_key;
+  std::vector<int> node_colors;
+  const auto new_node = [&color_of_key, &node_colors](
+      const std::vector<int64>& key) {
+    const int color =
+        color_of_key.insert(std::make_pair(key, color_of_key.size()))
+            .first->second;
+    node_colors.push_back(color);
+    return static_cast<int>(node_colors.size() - 1);
+  };
+
+  // Literal nodes, colored by their objective cost.
+  std::vector<int64> literal_costs(num_literals, 0);
+  const LinearObjective& objective = problem.objective();
+  for (int i = 0; i < objective.literals_size(); ++i) {
+    const Literal literal(objective.literals(i));
+    literal_costs[literal.Index().value()] += objective.coefficients(i);
+    literal_costs[literal.NegatedIndex().value()] -= objective.coefficients(i);
+  }
+  for (int i = 0; i < num_literals; ++i) {
+    new_node({LITERAL, literal_costs[i]});
+  }
+
+  std::vector<std::pair<int, int>> edges;
+  for (int i = 0; i < num_literals; i += 2) edges.push_back({i, i + 1});
+  for (const LinearBooleanConstraint& constraint : problem.constraints()) {
+    if (constraint.literals_size() == 0) continue;
+    bool all_equal = true;
+    for (int i = 1; i < constraint.coefficients_size(); ++i) {
+      if (constraint.coefficients(i) != constraint.coefficients(0)) {
+        all_equal = false;
+        break;
+      }
+    }
+    std::vector<int64> key = {
+        CONSTRAINT, constraint.has_lower_bound(), constraint.lower_bound(),
+        constraint.has_upper_bound(), constraint.upper_bound(),
+        all_equal ? constraint.coefficients(0) : 0, all_equal};
+    const int constraint_node = new_node(key);
+    for (int i = 0; i < constraint.literals_size(); ++i) {
+      const int literal_node = Literal(constraint.literals(i)).Index().value();
+      if (all_equal) {
+        edges.push_back({literal_node, constraint_node});
+      } else {
+        const int coefficient_node =
+            new_node({COEFFICIENT, constraint.coefficients(i)});
+        edges.push_back({literal_node, coefficient_node});
+        edges.push_back({coefficient_node, constraint_node});
+      }
+    }
+  }
+
+  // The GraphSymmetryFinder does not support multi-arcs.
+  std::sort(edges.begin(), edges.end());
+  edges.erase(std::unique(edges.begin(), edges.end()), edges.end());
+
+  GraphSymmetryFinder::Graph* graph =
+      new GraphSymmetryFinder::Graph(node_colors.size(), 2 * edges.size());
+  for (const std::pair<int, int>& edge : edges) {
+    graph->AddArc(edge.first, edge.second);
+    graph->AddArc(edge.second, edge.first);
+  }
+  graph->Build();
+  initial_equivalence_classes->swap(node_colors);
+  return graph;
+}
+
+inline void FindLinearBooleanProblemSymmetriesWithTimeLimit(
+    const LinearBooleanProblem& problem, double time_limit_seconds,
+    std::vector<std::unique_ptr<SparsePermutation>>* generators) {
+  WallTimer timer;
+  timer.Start();
+  std::vector<int> equivalence_classes;
+  std::unique_ptr<GraphSymmetryFinder::Graph> graph(
+      GenerateGraphForSymmetryDetection(problem, &equivalence_classes));
+  LOG(INFO) << "Graph for symmetry has " << graph->num_nodes() << " nodes and "
+            << graph->num_arcs() << " arcs (built in " << timer.Get() << "s).";
+
+  GraphSymmetryFinder symmetry_finder(*graph, /*is_undirected=*/true);
+  std::vector<std::unique_ptr<SparsePermutation>> graph_generators;
+  std::vector<int> factorized_automorphism_group_size;
+  const util::Status status = symmetry_finder.FindSymmetries(
+      std::max(0.0, time_limit_seconds - timer.Get()), &equivalence_classes,
+      &graph_generators, &factorized_automorphism_group_size);
+  if (!status.ok()) {
+    LOG(INFO) << "Symmetry detection incomplete: " << status.ToString();
+  }
+
+  // Only keep the cycles on the literal nodes. Note that since the literal
+  // nodes have their own colors, a cycle contains either only literal nodes
+  // or none of them.
+  const int num_literals = 2 * problem.num_variables();
+  generators->clear();
+  double average_support_size = 0.0;
+  for (const std::unique_ptr<SparsePermutation>& graph_generator :
+       graph_generators) {
+    std::unique_ptr<SparsePermutation> permutation(
+        new SparsePermutation(num_literals));
+    for (int c = 0; c < graph_generator->NumCycles(); ++c) {
+      if (*graph_generator->Cycle(c).begin() >= num_literals) continue;
+      for (const int node : graph_generator->Cycle(c)) {
+        DCHECK_LT(node, num_literals);
+        permutation->AddToCurrentCycle(node);
+      }
+      permutation->CloseCurrentCycle();
+    }
+    if (permutation->NumCycles() == 0) continue;
+    average_support_size += permutation->Support().size();
+    generators->push_back(std::move(permutation));
+  }
+  if (!generators->empty()) average_support_size /= generators->size();
+  LOG(INFO) << "# of generators: " << generators->size()
+            << " average support size: " << average_support_size
+            << " time: " << timer.Get() << "s";
+}
+
+inline bool AddLexLeaderSymmetryBreakingClauses(
+    const std::vector<std::unique_ptr<SparsePermutation>>& generators,
+    int max_support_size, SatSolver* solver) {
+  CHECK_EQ(solver->CurrentDecisionLevel(), 0);
+  int num_added_clauses = 0;
+  hash_map<int, int> image;
+  std::vector<BooleanVariable> support;
+  for (const std::unique_ptr<SparsePermutation>& permutation : generators) {
+    image.clear();
+    support.clear();
+    for (int c = 0; c < permutation->NumCycles(); ++c) {
+      int element = permutation->LastElementInCycle(c);
+      for (const int next : permutation->Cycle(c)) {
+        image[element] = next;
+        support.push_back(Literal(LiteralIndex(element)).Variable());
+        element = next;
+      }
+    }
+    std::sort(support.begin(), support.end());
+    support.erase(std::unique(support.begin(), support.end()), support.end());
+    if (support.size() > max_support_size) support.resize(max_support_size);
+
+    // prefix_equal is the literal "x and p(x) are equal on the variables
+    // before the current one". It is true for the first one, in which case
+    // it is omitted from the clauses.
+    bool has_prefix_literal = false;
+    Literal prefix_equal;
+    std::vector<Literal> clause;
+    const auto add_clause = [&clause, &has_prefix_literal, &prefix_equal,
+                             &num_added_clauses, solver]() {
+      if (has_prefix_literal) clause.push_back(prefix_equal.Negated());
+      ++num_added_clauses;
+      return solver->AddProblemClause(clause);
+    };
+    for (int i = 0; i < support.size(); ++i) {
+      const Literal x(support[i], true);
+      const Literal y(LiteralIndex(FindOrDie(image, x.Index().value())));
+      if (y == x.Negated()) {
+        // x <= not(x) forces x to false, and the prefix can't stay equal.
+        clause = {x.Negated()};
+        if (!add_clause()) return false;
+        break;
+      }
+
+      // x <= y, i.e. x => y.
+      clause = {x.Negated(), y};
+      if (!add_clause()) return false;
+      if (i + 1 == support.size()) break;
+
+      // The prefix stays equal if x = y, i.e. if x is true or y is false (the
+      // case x true and y false being forbidden above): prefix_equal and
+      // (x or not(y)) imply next_prefix_equal.
+      const Literal next_prefix_equal(solver->NewBooleanVariable(), true);
+      clause = {x.Negated(), next_prefix_equal};
+      if (!add_clause()) return false;
+      clause = {y, next_prefix_equal};
+      if (!add_clause()) return false;
+      prefix_equal = next_prefix_equal;
+      has_prefix_literal = true;
+    }
+  }
+  LOG(INFO) << "Added " << num_added_clauses
+            << " lex-leader symmetry breaking clauses.";
+  return !solver->IsModelUnsat();
+}
+
+}  // namespace sat
+}  // namespace operations_research
+
+#endif  // OR_TOOLS_SAT_SYMMETRY_BREAKING_H_
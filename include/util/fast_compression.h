@@ -0,0 +1,175 @@
+// Copyright 2010-2014 Google
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+// A fast LZ77 block compressor, in the spirit of LZ4: a single pass with a
+// hash table of the last positions of 4-byte sequences, and no entropy
+// coding. It compresses and decompresses at several hundred MB/s, an order of
+// magnitude faster than zlib, at the price of a lower compression ratio. It is
+// meant for in-memory data, like the cold blocks of a trail, and the format
+// is not stable across versions.
+//
+// The compressed data is a sequence of (literals, match) pairs. Each pair
+// starts with a token byte whose high nibble is the number of literals and
+// low nibble the match length minus 4, both extended by additional bytes when
+// they are equal to 15. The literals follow, then the match offset on two
+// bytes. The last pair has no match.
+
+#ifndef OR_TOOLS_UTIL_FAST_COMPRESSION_H_
+#define OR_TOOLS_UTIL_FAST_COMPRESSION_H_
+
+#include <string.h>
+#include <algorithm>
+#include <string>
+#include <vector>
+
+#include "base/integral_types.h"
+#include "base/logging.h"
+
+namespace operations_research {
+
+// Compresses 'size' bytes at 'data' and replaces the content of 'output'.
+void FastCompress(const void* data, int size, std::string* output);
+
+// Decompresses 'compressed' into 'size' bytes at 'output'. Returns false if
+// the data is corrupted or doesn't decompress to exactly 'size' bytes.
+bool FastUncompress(const std::string& compressed, int size, void* output);
+
+// ============================================================================
+// Implementation.
+// ============================================================================
+
+namespace fast_compression_internal {
+
+static const int kMinMatch = 4;
+static const int kHashBits = 12;
+static const int kMaxOffset = 65535;
+
+inline uint32 Load32(const uint8* p) {
+  uint32 value;
+  memcpy(&value, p, sizeof(value));
+  return value;
+}
+
+inline uint32 Hash(uint32 sequence) {
+  return (sequence * 2654435761U) >> (32 - kHashBits);
+}
+
+inline void AppendLength(int length, std::string* output) {
+  while (length >= 255) {
+    output->push_back(static_cast<char>(255));
+    length -= 255;
+  }
+  output->push_back(static_cast<char>(length));
+}
+
+// Appends the given literals, followed by a match if 'match_length' > 0.
+inline void AppendSequence(const uint8* literals, int num_literals, int offset,
+                           int match_length, std::string* output) {
+  const int match_code = match_length > 0 ? match_length - kMinMatch : 0;
+  const int token = (std::min(num_literals, 15) << 4) |
+                    std::min(match_code, 15);
+  output->push_back(static_cast<char>(token));
+  if (num_literals >= 15) AppendLength(num_literals - 15, output);
+  output->append(reinterpret_cast<const char*>(literals), num_literals);
+  if (match_length == 0) return;
+  output->push_back(static_cast<char>(offset & 0xFF));
+  output->push_back(static_cast<char>(offset >> 8));
+  if (match_code >= 15) AppendLength(match_code - 15, output);
+}
+
+// Reads an extended length. Returns false on truncated data.
+inline bool ReadLength(const uint8** input, const uint8* end, int* length) {
+  uint8 byte;
+  do {
+    if (*input == end) return false;
+    byte = *(*input)++;
+    *length += byte;
+  } while (byte == 255);
+  return true;
+}
+
+}  // namespace fast_compression_internal
+
+inline void FastCompress(const void* data, int size, std::string* output) {
+  using namespace fast_compression_internal;  // NOLINT
+  const uint8* const input = static_cast<const uint8*>(data);
+  output->clear();
+  output->reserve(size / 2 + 16);
+  std::vector<int> last_position(1 << kHashBits, -1);
+  int anchor = 0;
+  int position = 0;
+  while (position + kMinMatch <= size) {
+    const uint32 sequence = Load32(input + position);
+    int* const slot = &last_position[Hash(sequence)];
+    const int candidate = *slot;
+    *slot = position;
+    if (candidate < 0 || position - candidate > kMaxOffset ||
+        Load32(input + candidate) != sequence) {
+      ++position;
+      continue;
+    }
+    int length = kMinMatch;
+    while (position + length < size &&
+           input[candidate + length] == input[position + length]) {
+      ++length;
+    }
+    AppendSequence(input + anchor, position - anchor, position - candidate,
+                   length, output);
+    position += length;
+    anchor = position;
+  }
+  AppendSequence(input + anchor, size - anchor, 0, 0, output);
+}
+
+inline bool FastUncompress(const std::string& compressed, int size,
+                           void* output) {
+  using namespace fast_compression_internal;  // NOLINT
+  const uint8* input = reinterpret_cast<const uint8*>(compressed.data());
+  const uint8* const input_end = input + compressed.size();
+  uint8* const begin = static_cast<uint8*>(output);
+  uint8* out = begin;
+  uint8* const end = begin + size;
+  while (input < input_end) {
+    const int token = *input++;
+    int num_literals = token >> 4;
+    if (num_literals == 15 && !ReadLength(&input, input_end, &num_literals)) {
+      return false;
+    }
+    if (num_literals > input_end - input || num_literals > end - out) {
+      return false;
+    }
+    memcpy(out, input, num_literals);
+    input += num_literals;
+    out += num_literals;
+    if (input == input_end) break;
+    if (input_end - input < 2) return false;
+    const int offset = input[0] | (input[1] << 8);
+    input += 2;
+    int match_length = token & 15;
+    if (match_length == 15 && !ReadLength(&input, input_end, &match_length)) {
+      return false;
+    }
+    match_length += kMinMatch;
+    if (offset == 0 || offset > out - begin || match_length > end - out) {
+      return false;
+    }
+    // The match can overlap the output, so it is copied byte by byte.
+    const uint8* from = out - offset;
+    for (int i = 0; i < match_length; ++i) *out++ = *from++;
+  }
+  return out == end;
+}
+
+}  // namespace operations_research
+
+#endif  // OR_TOOLS_UTIL_FAST_COMPRESSION_H_
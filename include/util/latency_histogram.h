@@ -0,0 +1,159 @@
+// Copyright 2010-2014 Google
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#ifndef OR_TOOLS_UTIL_LATENCY_HISTOGRAM_H_
+#define OR_TOOLS_UTIL_LATENCY_HISTOGRAM_H_
+
+#include <algorithm>
+#include <cmath>
+#include <string>
+#include <vector>
+
+#include "base/integral_types.h"
+#include "base/logging.h"
+#include "base/stringprintf.h"
+#include "util/stats.h"
+
+namespace operations_research {
+
+// Statistic on the distribution of a sequence of latencies, in seconds. On
+// top of the DistributionStat summary, the values are counted in buckets of
+// logarithmic width (kBucketsPerOctave buckets per power of two, starting at
+// one microsecond) so that the quantiles can be estimated with a relative
+// error of about 2^(1 / kBucketsPerOctave) - 1, i.e. 19%.
+//
+// Like the other stats, a LatencyHistogram is not thread-safe. The usual
+// pattern is one histogram per thread, merged with Merge() at the end.
+class LatencyHistogram : public DistributionStat {
+ public:
+  static const int kBucketsPerOctave = 4;
+  static const int kNumOctaves = 40;
+  static const int kNumBuckets = kBucketsPerOctave * kNumOctaves;
+
+  explicit LatencyHistogram(const std::string& name)
+      : DistributionStat(name), buckets_(kNumBuckets, 0) {}
+  LatencyHistogram(const std::string& name, StatsGroup* group)
+      : DistributionStat(name, group), buckets_(kNumBuckets, 0) {}
+
+  std::string ValueAsString() const override;
+  int Priority() const override { return 100; }
+  void Reset() override;
+
+  // Adds a latency in seconds to this distribution.
+  void AddTimeInSec(double seconds);
+
+  // Adds all the values of the given histogram to this one.
+  void Merge(const LatencyHistogram& other);
+
+  // Returns an estimate of the given quantile (in [0, 1]) in seconds, or 0.0
+  // if the histogram is empty.
+  double QuantileInSec(double quantile) const;
+
+  // The number of values in the given bucket, and the upper bound of the
+  // values of this bucket in seconds.
+  int64 BucketCount(int bucket) const { return buckets_[bucket]; }
+  static double BucketUpperBoundInSec(int bucket) {
+    return 1e-6 * std::pow(2.0, static_cast<double>(bucket + 1) /
+                                    kBucketsPerOctave);
+  }
+
+ private:
+  static int BucketIndex(double seconds);
+  static std::string FormatSeconds(double seconds);
+
+  std::vector<int64> buckets_;
+};
+
+// ============================================================================
+// Implementation.
+// ============================================================================
+
+inline int LatencyHistogram::BucketIndex(double seconds) {
+  const double microseconds = seconds * 1e6;
+  if (!(microseconds > 1.0)) return 0;
+  const int index =
+      static_cast<int>(std::log2(microseconds) * kBucketsPerOctave);
+  return std::min(index, kNumBuckets - 1);
+}
+
+inline void LatencyHistogram::Reset() {
+  DistributionStat::Reset();
+  buckets_.assign(kNumBuckets, 0);
+}
+
+inline void LatencyHistogram::AddTimeInSec(double seconds) {
+  DCHECK_GE(seconds, 0.0);
+  AddToDistribution(seconds);
+  ++buckets_[BucketIndex(seconds)];
+}
+
+inline void LatencyHistogram::Merge(const LatencyHistogram& other) {
+  if (other.num_ == 0) return;
+  if (num_ == 0) {
+    sum_ = other.sum_;
+    average_ = other.average_;
+    sum_squares_from_average_ = other.sum_squares_from_average_;
+    min_ = other.min_;
+    max_ = other.max_;
+    num_ = other.num_;
+  } else {
+    // Parallel version of the Welford algorithm used by DistributionStat.
+    const double n = num_;
+    const double other_n = other.num_;
+    const double delta = other.average_ - average_;
+    sum_squares_from_average_ += other.sum_squares_from_average_ +
+                                 delta * delta * n * other_n / (n + other_n);
+    average_ += delta * other_n / (n + other_n);
+    sum_ += other.sum_;
+    min_ = std::min(min_, other.min_);
+    max_ = std::max(max_, other.max_);
+    num_ += other.num_;
+  }
+  for (int b = 0; b < kNumBuckets; ++b) buckets_[b] += other.buckets_[b];
+}
+
+inline double LatencyHistogram::QuantileInSec(double quantile) const {
+  if (num_ == 0) return 0.0;
+  const int64 rank = std::max<int64>(
+      1, static_cast<int64>(std::ceil(quantile * static_cast<double>(num_))));
+  int64 count = 0;
+  for (int b = 0; b < kNumBuckets; ++b) {
+    count += buckets_[b];
+    if (count >= rank) {
+      // The bucket bound can't be more precise than the exact extrema.
+      return std::max(min_, std::min(max_, BucketUpperBoundInSec(b)));
+    }
+  }
+  return max_;
+}
+
+inline std::string LatencyHistogram::FormatSeconds(double seconds) {
+  if (seconds < 1e-3) return StringPrintf("%.2fus", seconds * 1e6);
+  if (seconds < 1.0) return StringPrintf("%.2fms", seconds * 1e3);
+  return StringPrintf("%.2fs", seconds);
+}
+
+inline std::string LatencyHistogram::ValueAsString() const {
+  return StringPrintf(
+      "%8llu [%8s, %8s] %8s %8s p50: %8s p90: %8s p99: %8s\n",
+      static_cast<unsigned long long>(num_),  // NOLINT
+      FormatSeconds(min_).c_str(), FormatSeconds(max_).c_str(),
+      FormatSeconds(Average()).c_str(), FormatSeconds(StdDeviation()).c_str(),
+      FormatSeconds(QuantileInSec(0.5)).c_str(),
+      FormatSeconds(QuantileInSec(0.9)).c_str(),
+      FormatSeconds(QuantileInSec(0.99)).c_str());
+}
+
+}  // namespace operations_research
+
+#endif  // OR_TOOLS_UTIL_LATENCY_HISTOGRAM_H_
@@ -0,0 +1,155 @@
+// Copyright 2010-2014 Google
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+// Read-only view of the whole content of a file:
+//   MappedFile file;
+//   const util::Status status = file.Open("model.mps");
+//   if (!status.ok()) ...
+//   ... use file.data() and file.size() ...
+//
+// On POSIX systems the file is memory-mapped, so opening it is O(1) and the
+// pages are only read when they are accessed. A file whose name ends in ".gz"
+// can't be mapped: it is decompressed in memory instead. On the other systems
+// the file is read in memory with file::GetContents().
+#ifndef OR_TOOLS_UTIL_MAPPED_FILE_H_
+#define OR_TOOLS_UTIL_MAPPED_FILE_H_
+
+#include <zlib.h>
+#include <string>
+
+#if !defined(_MSC_VER)
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+#include "base/file.h"
+#include "base/integral_types.h"
+#include "base/join.h"
+#include "base/logging.h"
+#include "base/macros.h"
+#include "base/status.h"
+#include "base/strutil.h"
+
+namespace operations_research {
+
+class MappedFile {
+ public:
+  MappedFile() : mapped_data_(nullptr), mapped_size_(0) {}
+  ~MappedFile() { Close(); }
+
+  // Maps or reads the given file. Any previously opened file is closed.
+  util::Status Open(const std::string& filename);
+  void Close();
+
+  // The content of the file. It stays valid until Close() is called.
+  const char* data() const {
+    return mapped_data_ != nullptr ? mapped_data_ : buffer_.data();
+  }
+  int64 size() const {
+    return mapped_data_ != nullptr ? mapped_size_ : buffer_.size();
+  }
+
+  // Returns true if the content is memory-mapped rather than in memory.
+  bool is_mapped() const { return mapped_data_ != nullptr; }
+
+ private:
+  util::Status ReadGzipFile(const std::string& filename);
+
+  const char* mapped_data_;
+  int64 mapped_size_;
+  std::string buffer_;
+
+  DISALLOW_COPY_AND_ASSIGN(MappedFile);
+};
+
+// ============================================================================
+// Implementation.
+// ============================================================================
+
+inline util::Status MappedFile::Open(const std::string& filename) {
+  Close();
+  if (HasSuffixString(filename, ".gz")) return ReadGzipFile(filename);
+#if defined(_MSC_VER)
+  return file::GetContents(filename, &buffer_, file::Defaults());
+#else
+  const int fd = open(filename.c_str(), O_RDONLY);
+  if (fd < 0) {
+    return util::Status(util::error::INVALID_ARGUMENT,
+                        StrCat("Could not open '", filename, "'."));
+  }
+  struct stat file_stat;
+  if (fstat(fd, &file_stat) != 0) {
+    close(fd);
+    return util::Status(util::error::INTERNAL,
+                        StrCat("Could not stat '", filename, "'."));
+  }
+  // mmap() fails on an empty file, which is simply represented by buffer_.
+  if (file_stat.st_size > 0) {
+    void* const address =
+        mmap(nullptr, file_stat.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+    if (address == MAP_FAILED) {
+      close(fd);
+      return util::Status(util::error::INTERNAL,
+                          StrCat("Could not map '", filename, "'."));
+    }
+    madvise(address, file_stat.st_size, MADV_SEQUENTIAL);
+    mapped_data_ = static_cast<const char*>(address);
+    mapped_size_ = file_stat.st_size;
+  }
+  close(fd);
+  return util::Status();
+#endif
+}
+
+inline void MappedFile::Close() {
+#if !defined(_MSC_VER)
+  if (mapped_data_ != nullptr) {
+    munmap(const_cast<char*>(mapped_data_), mapped_size_);
+  }
+#endif
+  mapped_data_ = nullptr;
+  mapped_size_ = 0;
+  buffer_.clear();
+}
+
+inline util::Status MappedFile::ReadGzipFile(const std::string& filename) {
+  const gzFile gz_file = gzopen(filename.c_str(), "rb");
+  if (gz_file == nullptr) {
+    return util::Status(util::error::INVALID_ARGUMENT,
+                        StrCat("Could not open '", filename, "'."));
+  }
+  gzbuffer(gz_file, 1 << 20);
+  const int kChunkSize = 1 << 22;
+  while (true) {
+    const size_t old_size = buffer_.size();
+    buffer_.resize(old_size + kChunkSize);
+    const int num_read = gzread(gz_file, &buffer_[old_size], kChunkSize);
+    if (num_read < 0) {
+      gzclose(gz_file);
+      buffer_.clear();
+      return util::Status(util::error::INTERNAL,
+                          StrCat("Error while decompressing '", filename,
+                                 "'."));
+    }
+    buffer_.resize(old_size + num_read);
+    if (num_read < kChunkSize) break;
+  }
+  gzclose(gz_file);
+  return util::Status();
+}
+
+}  // namespace operations_research
+
+#endif  // OR_TOOLS_UTIL_MAPPED_FILE_H_
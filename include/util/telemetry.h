@@ -0,0 +1,462 @@
+// Copyright 2010-2014 Google
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+// Live, machine-readable telemetry for long-running searches.
+//
+// The search thread only publishes its counters (branches, failures, depth,
+// objective, ...) into a TelemetryCounters with relaxed atomic stores, which
+// cost about as much as plain stores. A timer thread owned by a
+// TelemetryStream samples them periodically, computes the rates, and:
+// - pushes the record into a lock-free ring buffer, which any thread can read
+//   without ever blocking the sampler,
+// - writes it to the registered TelemetryWriters, as JSON lines or as
+//   fixed-size binary records.
+// All the formatting and I/O happens on the timer thread.
+//
+// Usage:
+//   TelemetryStream stream("my_search", /*period_in_seconds=*/1.0, 1024);
+//   stream.AddWriter(new JsonTelemetryWriter(File::OpenOrDie(path, "w")));
+//   stream.Start();
+//   ... the search publishes into stream.counters() ...
+//   stream.Stop();
+//
+// See constraint_solver/search_telemetry.h for the CP solver and routing
+// library, and sat/sat_telemetry.h for the SAT solver.
+
+#ifndef OR_TOOLS_UTIL_TELEMETRY_H_
+#define OR_TOOLS_UTIL_TELEMETRY_H_
+
+#include <string.h>
+#include <algorithm>
+#include <atomic>
+#include <chrono>  // NOLINT
+#include <cmath>
+#include <condition_variable>  // NOLINT
+#include <limits>
+#include <memory>
+#include <mutex>  // NOLINT
+#include <string>
+#include <thread>  // NOLINT
+#include <vector>
+
+#include "base/file.h"
+#include "base/integral_types.h"
+#include "base/logging.h"
+#include "base/macros.h"
+#include "base/stringprintf.h"
+#include "base/sysinfo.h"
+#include "base/timer.h"
+
+namespace operations_research {
+
+// One sample of the telemetry of a search. The objective fields are NaN when
+// unknown. The layout is also the binary format, in host byte order.
+struct TelemetryRecord {
+  // Index of the record in its stream.
+  int64 sequence;
+  // Seconds since the start of the stream.
+  double wall_time;
+  int64 branches;
+  int64 failures;
+  int64 solutions;
+  int64 depth;
+  // Memory usage of the process, in bytes.
+  int64 memory_usage;
+  // Objective of the best solution, and best known bound on it.
+  double objective;
+  double objective_bound;
+  // Rates since the previous record.
+  double branches_per_second;
+  double failures_per_second;
+};
+
+// Formats the record as a single line JSON object.
+std::string TelemetryRecordToJson(const std::string& source,
+                                  const TelemetryRecord& record);
+
+// The counters published by the search. They are written by the search
+// thread and read by the sampler thread.
+class TelemetryCounters {
+ public:
+  TelemetryCounters();
+
+  void set_branches(int64 value) {
+    branches_.store(value, std::memory_order_relaxed);
+  }
+  void set_failures(int64 value) {
+    failures_.store(value, std::memory_order_relaxed);
+  }
+  void set_solutions(int64 value) {
+    solutions_.store(value, std::memory_order_relaxed);
+  }
+  void set_depth(int64 value) {
+    depth_.store(value, std::memory_order_relaxed);
+  }
+  void set_objective(double value) {
+    objective_.store(value, std::memory_order_relaxed);
+  }
+  void set_objective_bound(double value) {
+    objective_bound_.store(value, std::memory_order_relaxed);
+  }
+
+  int64 branches() const { return branches_.load(std::memory_order_relaxed); }
+  int64 failures() const { return failures_.load(std::memory_order_relaxed); }
+  int64 solutions() const {
+    return solutions_.load(std::memory_order_relaxed);
+  }
+  int64 depth() const { return depth_.load(std::memory_order_relaxed); }
+  double objective() const {
+    return objective_.load(std::memory_order_relaxed);
+  }
+  double objective_bound() const {
+    return objective_bound_.load(std::memory_order_relaxed);
+  }
+
+ private:
+  std::atomic<int64> branches_;
+  std::atomic<int64> failures_;
+  std::atomic<int64> solutions_;
+  std::atomic<int64> depth_;
+  std::atomic<double> objective_;
+  std::atomic<double> objective_bound_;
+
+  DISALLOW_COPY_AND_ASSIGN(TelemetryCounters);
+};
+
+// A ring buffer of the last records of a stream, with a single writer and
+// any number of readers. It is a sequence lock per slot: the writer never
+// waits, and readers skip the records overwritten while they read them.
+class TelemetryRing {
+ public:
+  // The capacity is rounded up to a power of two.
+  explicit TelemetryRing(int capacity);
+
+  // Must only be called by one thread at a time.
+  void Push(const TelemetryRecord& record);
+
+  // Appends to 'records' the records of sequence >= *next_sequence that are
+  // still in the ring, and sets *next_sequence to the sequence of the next
+  // record to be pushed. Starting from 0 and passing the same
+  // *next_sequence to successive calls reads each record once, unless it is
+  // overwritten first.
+  void ReadFrom(int64* next_sequence,
+                std::vector<TelemetryRecord>* records) const;
+
+  // Number of records pushed so far.
+  int64 num_pushed() const {
+    return num_pushed_.load(std::memory_order_acquire);
+  }
+
+ private:
+  static const int kNumWords = sizeof(TelemetryRecord) / sizeof(uint64);
+  struct Slot {
+    // 2 * sequence + 1 while the record is written, 2 * sequence + 2 once it
+    // is complete.
+    std::atomic<uint64> version;
+    std::atomic<uint64> words[kNumWords];
+  };
+
+  bool Read(int64 sequence, TelemetryRecord* record) const;
+
+  const int capacity_;
+  std::unique_ptr<Slot[]> slots_;
+  std::atomic<int64> num_pushed_;
+
+  DISALLOW_COPY_AND_ASSIGN(TelemetryRing);
+};
+
+// Receives the records of a stream, on the sampler thread.
+class TelemetryWriter {
+ public:
+  virtual ~TelemetryWriter() {}
+  virtual void Write(const std::string& source,
+                     const TelemetryRecord& record) = 0;
+  virtual void Flush() {}
+};
+
+// Writes one JSON object per line. Takes ownership of the file, and closes it.
+class JsonTelemetryWriter : public TelemetryWriter {
+ public:
+  explicit JsonTelemetryWriter(File* const file) : file_(file) {}
+  ~JsonTelemetryWriter() override { file_->Close(); }
+  void Write(const std::string& source,
+             const TelemetryRecord& record) override {
+    file_->WriteLine(TelemetryRecordToJson(source, record));
+  }
+  void Flush() override { file_->Flush(); }
+
+ private:
+  File* const file_;
+  DISALLOW_COPY_AND_ASSIGN(JsonTelemetryWriter);
+};
+
+// Writes the 8-byte magic string "ORTELEM1", then the records as raw
+// TelemetryRecords. Takes ownership of the file, and closes it.
+class BinaryTelemetryWriter : public TelemetryWriter {
+ public:
+  explicit BinaryTelemetryWriter(File* const file) : file_(file) {
+    file_->WriteString("ORTELEM1");
+  }
+  ~BinaryTelemetryWriter() override { file_->Close(); }
+  void Write(const std::string& source,
+             const TelemetryRecord& record) override {
+    file_->Write(&record, sizeof(record));
+  }
+  void Flush() override { file_->Flush(); }
+
+ private:
+  File* const file_;
+  DISALLOW_COPY_AND_ASSIGN(BinaryTelemetryWriter);
+};
+
+// Samples a TelemetryCounters on a timer thread.
+class TelemetryStream {
+ public:
+  TelemetryStream(const std::string& source, double period_in_seconds,
+                  int ring_capacity);
+  // Stops the stream if needed.
+  ~TelemetryStream();
+
+  // Takes ownership of the writer. Must be called before Start().
+  void AddWriter(TelemetryWriter* const writer);
+
+  // Starts the timer thread. The first record is taken immediately. The
+  // stream can be started again after Stop(): the wall time restarts at 0,
+  // and the rates of the first record only count the new branches and
+  // failures.
+  void Start();
+  // Takes a last record, flushes the writers and joins the timer thread.
+  // Does nothing if the stream is not started.
+  void Stop();
+
+  TelemetryCounters* counters() { return &counters_; }
+  const TelemetryRing& ring() const { return ring_; }
+  const std::string& source() const { return source_; }
+
+ private:
+  void Run();
+  void Sample();
+
+  const std::string source_;
+  const std::chrono::nanoseconds period_;
+  TelemetryCounters counters_;
+  TelemetryRing ring_;
+  std::vector<std::unique_ptr<TelemetryWriter> > writers_;
+  WallTimer timer_;
+  // Values of the previous record, for the rates.
+  TelemetryRecord previous_;
+  std::mutex mutex_;
+  std::condition_variable stop_condition_;
+  bool stop_requested_;
+  std::thread thread_;
+
+  DISALLOW_COPY_AND_ASSIGN(TelemetryStream);
+};
+
+// ============================================================================
+// Implementation.
+// ============================================================================
+
+namespace telemetry_internal {
+
+inline int RoundUpToPowerOfTwo(int n) {
+  int power = 1;
+  while (power < n) power <<= 1;
+  return power;
+}
+
+inline void AppendJsonNumber(const char* name, double value,
+                             std::string* out) {
+  if (std::isfinite(value)) {
+    StringAppendF(out, ",\"%s\":%.15g", name, value);
+  } else {
+    StringAppendF(out, ",\"%s\":null", name);
+  }
+}
+
+inline void AppendJsonInteger(const char* name, int64 value,
+                              std::string* out) {
+  StringAppendF(out, ",\"%s\":%" GG_LL_FORMAT "d", name, value);
+}
+
+}  // namespace telemetry_internal
+
+inline std::string TelemetryRecordToJson(const std::string& source,
+                                         const TelemetryRecord& record) {
+  using telemetry_internal::AppendJsonInteger;
+  using telemetry_internal::AppendJsonNumber;
+  // The source is a name chosen by the caller, only quotes and backslashes
+  // are escaped.
+  std::string out = "{\"source\":\"";
+  for (const char c : source) {
+    if (c == '"' || c == '\\') out += '\\';
+    out += c;
+  }
+  out += '"';
+  AppendJsonInteger("sequence", record.sequence, &out);
+  AppendJsonNumber("wall_time", record.wall_time, &out);
+  AppendJsonInteger("branches", record.branches, &out);
+  AppendJsonInteger("failures", record.failures, &out);
+  AppendJsonInteger("solutions", record.solutions, &out);
+  AppendJsonInteger("depth", record.depth, &out);
+  AppendJsonInteger("memory_usage", record.memory_usage, &out);
+  AppendJsonNumber("objective", record.objective, &out);
+  AppendJsonNumber("objective_bound", record.objective_bound, &out);
+  AppendJsonNumber("branches_per_second", record.branches_per_second, &out);
+  AppendJsonNumber("failures_per_second", record.failures_per_second, &out);
+  out += '}';
+  return out;
+}
+
+inline TelemetryCounters::TelemetryCounters()
+    : branches_(0),
+      failures_(0),
+      solutions_(0),
+      depth_(0),
+      objective_(std::numeric_limits<double>::quiet_NaN()),
+      objective_bound_(std::numeric_limits<double>::quiet_NaN()) {}
+
+inline TelemetryRing::TelemetryRing(int capacity)
+    : capacity_(telemetry_internal::RoundUpToPowerOfTwo(capacity)),
+      slots_(new Slot[capacity_]),
+      num_pushed_(0) {
+  for (int i = 0; i < capacity_; ++i) {
+    slots_[i].version.store(0, std::memory_order_relaxed);
+  }
+}
+
+inline void TelemetryRing::Push(const TelemetryRecord& record) {
+  static_assert(sizeof(TelemetryRecord) == kNumWords * sizeof(uint64),
+                "TelemetryRecord must be made of 64-bit fields");
+  const int64 sequence = num_pushed_.load(std::memory_order_relaxed);
+  Slot* const slot = &slots_[sequence & (capacity_ - 1)];
+  slot->version.store(2 * sequence + 1, std::memory_order_relaxed);
+  std::atomic_thread_fence(std::memory_order_release);
+  uint64 words[kNumWords];
+  memcpy(words, &record, sizeof(record));
+  for (int i = 0; i < kNumWords; ++i) {
+    slot->words[i].store(words[i], std::memory_order_relaxed);
+  }
+  slot->version.store(2 * sequence + 2, std::memory_order_release);
+  num_pushed_.store(sequence + 1, std::memory_order_release);
+}
+
+inline bool TelemetryRing::Read(int64 sequence, TelemetryRecord* record) const {
+  const Slot& slot = slots_[sequence & (capacity_ - 1)];
+  const uint64 expected = 2 * sequence + 2;
+  if (slot.version.load(std::memory_order_acquire) != expected) return false;
+  uint64 words[kNumWords];
+  for (int i = 0; i < kNumWords; ++i) {
+    words[i] = slot.words[i].load(std::memory_order_relaxed);
+  }
+  std::atomic_thread_fence(std::memory_order_acquire);
+  if (slot.version.load(std::memory_order_relaxed) != expected) return false;
+  memcpy(record, words, sizeof(*record));
+  return true;
+}
+
+inline void TelemetryRing::ReadFrom(
+    int64* next_sequence, std::vector<TelemetryRecord>* records) const {
+  const int64 end = num_pushed_.load(std::memory_order_acquire);
+  TelemetryRecord record;
+  for (int64 sequence = std::max(*next_sequence, end - capacity_);
+       sequence < end; ++sequence) {
+    if (Read(sequence, &record)) records->push_back(record);
+  }
+  *next_sequence = end;
+}
+
+inline TelemetryStream::TelemetryStream(const std::string& source,
+                                        double period_in_seconds,
+                                        int ring_capacity)
+    : source_(source),
+      period_(static_cast<int64>(period_in_seconds * 1e9)),
+      ring_(ring_capacity),
+      stop_requested_(false) {
+  CHECK_GT(period_in_seconds, 0.0);
+  memset(&previous_, 0, sizeof(previous_));
+}
+
+inline TelemetryStream::~TelemetryStream() {
+  if (thread_.joinable()) Stop();
+}
+
+inline void TelemetryStream::AddWriter(TelemetryWriter* const writer) {
+  CHECK(!thread_.joinable());
+  writers_.emplace_back(writer);
+}
+
+inline void TelemetryStream::Start() {
+  CHECK(!thread_.joinable());
+  stop_requested_ = false;
+  memset(&previous_, 0, sizeof(previous_));
+  previous_.branches = counters_.branches();
+  previous_.failures = counters_.failures();
+  timer_.Restart();
+  thread_ = std::thread(&TelemetryStream::Run, this);
+}
+
+inline void TelemetryStream::Stop() {
+  if (!thread_.joinable()) return;
+  {
+    std::unique_lock<std::mutex> lock(mutex_);
+    stop_requested_ = true;
+  }
+  stop_condition_.notify_all();
+  thread_.join();
+}
+
+inline void TelemetryStream::Run() {
+  std::unique_lock<std::mutex> lock(mutex_);
+  while (true) {
+    lock.unlock();
+    Sample();
+    lock.lock();
+    if (stop_condition_.wait_for(lock, period_,
+                                 [this] { return stop_requested_; })) {
+      break;
+    }
+  }
+  lock.unlock();
+  Sample();
+  for (const std::unique_ptr<TelemetryWriter>& writer : writers_) {
+    writer->Flush();
+  }
+}
+
+inline void TelemetryStream::Sample() {
+  TelemetryRecord record;
+  record.sequence = ring_.num_pushed();
+  record.wall_time = timer_.Get();
+  record.branches = counters_.branches();
+  record.failures = counters_.failures();
+  record.solutions = counters_.solutions();
+  record.depth = counters_.depth();
+  record.memory_usage = GetProcessMemoryUsage();
+  record.objective = counters_.objective();
+  record.objective_bound = counters_.objective_bound();
+  const double elapsed = record.wall_time - previous_.wall_time;
+  record.branches_per_second =
+      elapsed > 0.0 ? (record.branches - previous_.branches) / elapsed : 0.0;
+  record.failures_per_second =
+      elapsed > 0.0 ? (record.failures - previous_.failures) / elapsed : 0.0;
+  previous_ = record;
+  ring_.Push(record);
+  for (const std::unique_ptr<TelemetryWriter>& writer : writers_) {
+    writer->Write(source_, record);
+  }
+}
+
+}  // namespace operations_research
+
+#endif  // OR_TOOLS_UTIL_TELEMETRY_H_